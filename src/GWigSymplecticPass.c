@@ -325,10 +325,12 @@ void GWigSymplecticPass(double **coord, long num_particles, double pCentral,
   }
 
   if (!singleStep && cwiggler->fieldOutputInitialized) {
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WritePage(cwiggler->SDDSFieldOutput)) {
       printf("*** Error: unable to write SDDS page for CWIGGLER field output\n");
       SDDS_PrintErrors(stdout, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
 
   if (cwiggler->dx || cwiggler->dy || cwiggler->dz) {
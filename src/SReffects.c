@@ -155,14 +155,14 @@ void track_SReffects(double **coord, long np, SREFFECTS *SReffects0, double Po,
       for (ip = 0; ip < np; ip++) {
         part = coord[ip];
         xpEta = part[5] * twiss->etapx;
-        part[1] = (part[1] - xpEta) * Fx + Srxp * gauss_rn_lim(0.0, 1.0, cutoff, random_2) + xpEta;
+        part[1] = (part[1] - xpEta) * Fx + Srxp * gauss_rn_lim_elegant(0.0, 1.0, cutoff, random_2_elegant) + xpEta;
         ypEta = part[5] * twiss->etapy;
-        part[3] = (part[3] - ypEta) * Fy + Sryp * gauss_rn_lim(0.0, 1.0, cutoff, random_2) + ypEta;
+        part[3] = (part[3] - ypEta) * Fy + Sryp * gauss_rn_lim_elegant(0.0, 1.0, cutoff, random_2_elegant) + ypEta;
         P = (1 + part[5]) * Po;
         beta = P / sqrt(sqr(P) + 1);
         t = part[4] / beta;
         deltaChange = -part[5];
-        part[5] = Ddelta + part[5] * Fdelta + Srdelta * gauss_rn_lim(0.0, 1.0, cutoff, random_2);
+        part[5] = Ddelta + part[5] * Fdelta + Srdelta * gauss_rn_lim_elegant(0.0, 1.0, cutoff, random_2_elegant);
         deltaChange += part[5];
         if (SReffects.includeOffsets) {
           /* This is required to keep the beam at the same distance from the off-momentum closed orbit,
@@ -282,22 +282,22 @@ void finish_bunched_beam_setup(
 
   if (one_random_bunch) {
     /* make a seed for reinitializing the beam RN generator */
-    beamRepeatSeed = 1e8 * random_4(1);
+    beamRepeatSeed = 1e8 * random_4_elegant(1);
 #if SDDS_MPI_IO
     /* All processors will have same beamRepeatSeed after here. This will make
        it easy for the serial version to generate the same sequence */
     MPI_Bcast(&beamRepeatSeed, 1, MPI_LONG, 1, MPI_COMM_WORLD);
 #endif
-    random_4(-beamRepeatSeed);
+    random_4_elegant(-beamRepeatSeed);
   }
 #if !SDDS_MPI_IO
   else if ((run->random_sequence_No > 1) && (control->n_steps == 1)) { /* This part will take effect for regression test when random_sequence_No>1 */
-    beamRepeatSeed = 1e8 * random_4(1);
-    random_4(-beamRepeatSeed);
+    beamRepeatSeed = 1e8 * random_4_elegant(1);
+    random_4_elegant(-beamRepeatSeed);
   }
 #else
   else if (control->n_steps == 1) {
-    beamRepeatSeed = 1e8 * random_4(1);
+    beamRepeatSeed = 1e8 * random_4_elegant(1);
     MPI_Bcast(&beamRepeatSeed, 1, MPI_LONG, 1, MPI_COMM_WORLD);
   }
 #endif
@@ -424,6 +424,11 @@ void setup_bunched_beam_moments(
   finish_bunched_beam_setup(beam, run, control, errcon, optim, output, beamline, n_elements, save_original);
 }
 
+/* used by the step workers, since the fiducial beam is the first one generated by each process */
+long bunchedBeamFirstIsFiducial() {
+  return firstIsFiducial;
+}
+
 long new_bunched_beam(
   BEAM *beam,
   RUN *run,
@@ -511,11 +516,11 @@ long new_bunched_beam(
 #if SDDS_MPI_IO
       /* There will be no same sequence for different processors */
       if (notSinglePart)
-        random_4(-(beamRepeatSeed + 2 * (myid - 1)));
+        random_4_elegant(-(beamRepeatSeed + 2 * (myid - 1)));
       else
-        random_4(-beamRepeatSeed);
+        random_4_elegant(-beamRepeatSeed);
 #else
-      random_4(-beamRepeatSeed);
+      random_4_elegant(-beamRepeatSeed);
 #endif
       /* For the Halton sequence, we need reset the start point */
       for (i = 0; i < 3; i++) {
@@ -536,13 +541,13 @@ long new_bunched_beam(
 #if SDDS_MPI_IO
     else if (control->n_steps == 1) {
       if (notSinglePart)
-        random_4(-(beamRepeatSeed + 2 * (myid - 1)));
+        random_4_elegant(-(beamRepeatSeed + 2 * (myid - 1)));
       else
-        random_4(-beamRepeatSeed);
+        random_4_elegant(-beamRepeatSeed);
     }
 #else
     else if ((run->random_sequence_No > 1) && (control->n_steps == 1)) {
-      random_4(-beamRepeatSeed);
+      random_4_elegant(-beamRepeatSeed);
     }
 #endif
     if (control->cell) {
@@ -593,7 +598,7 @@ long new_bunched_beam(
       for (i = 0; i < work_processors; i++) {
         /* This will make the serial version has the same start seed as each of the sequences 
 	       in the parallel version */
-        random_4(-(beamRepeatSeed + 2 * i));
+        random_4_elegant(-(beamRepeatSeed + 2 * i));
         my_nToTrack = beam->n_to_track / work_processors;
         if (i < (beam->n_to_track % work_processors))
           my_nToTrack++;
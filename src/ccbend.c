@@ -1114,7 +1114,7 @@ int integrate_kick_KnL(double *restrict coord,       /* coordinates of the parti
       if (rad_coef)
         dp -= rad_coef * deltaFactor * F2 * dsFactor;
       if (isr_coef > 0)
-        dp -= isr_coef * deltaFactor * pow(F2, 0.75) * sqrt(dsFactor) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+        dp -= isr_coef * deltaFactor * pow(F2, 0.75) * sqrt(dsFactor) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
       if (sigmaDelta2)
         *sigmaDelta2 += sqr(isr_coef * deltaFactor) * pow(F2, 1.5) * dsFactor;
       qx *= (1 + dp);
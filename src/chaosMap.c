@@ -58,6 +58,11 @@ static SDDS_DEFINITION parameter_definition[N_PARAMETERS] = {
 
 static SDDS_DATASET SDDS_cmap;
 
+typedef struct {
+  double x, y, delta;
+  long ix, iy, idelta;
+} CMAP_GRID_POINT;
+
 void setupChaosMap(
   NAMELIST_TEXT *nltext,
   RUN *run,
@@ -128,7 +133,9 @@ long doChaosMap(
   short survived[3];
   double **trackingBuffer = NULL;
   double dx, dy, ddelta, x, y, delta;
-  long ix, iy, idelta, ip;
+  long ix, iy, idelta, ip, j;
+  CMAP_GRID_POINT *gridPoint;
+  long nPoints, batchSize, nBatch, iPoint0, ib, perPoint, nTrack, nLeft, *survivorRow;
   LINE_LIST *btBeamline; /* back-tracking beamline */
   static double **one_part;
   double p, dJx, dJy, dF;
@@ -219,142 +226,189 @@ long doChaosMap(
   ip = 0;
   /* turns = control->n_passes; */
 
-  trackingBuffer = (double **)czarray_2d(sizeof(**trackingBuffer), 3, totalPropertiesPerParticle);
-
+  /* Make the list of grid points handled by this processor */
+  gridPoint = tmalloc(sizeof(*gridPoint) * ndelta * nx * ny);
+  nPoints = 0;
   for (idelta = 0; idelta < ndelta; idelta++) {
     delta = delta_min + idelta * ddelta;
     for (ix = 0; ix < nx; ix++) {
       x = xmin + ix * dx;
       for (iy = 0; iy < ny; iy++) {
         y = ymin + iy * dy;
-        memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
-        startingCoord[0] += x;
-        startingCoord[2] += y;
-        startingCoord[5] += delta;
 #if USE_MPI
         if (myid == (idelta * nx * ny + ix * ny + iy) % n_processors) /* Partition the job according to particle ID */
 #endif
         {
-          if (forward_backward > 0) {
-            int iteration;
-            memcpy(trackingBuffer[0], startingCoord, sizeof(*startingCoord) * 6);
-            trackingBuffer[0][6] = 1;
-            p = run->p_central;
-            memset(survived, 0, 3 * sizeof(*survived));
-            for (iteration = 0; iteration < forward_backward; iteration++) {
-              if (!(survived[0] = do_tracking(NULL, trackingBuffer, 1, NULL, beamline,
-                                              &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
-                                              NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
-                                              NULL, NULL, NULL, NULL, NULL)))
-                break;
-              if (!(survived[1] = do_tracking(NULL, trackingBuffer, 1, NULL, btBeamline,
-                                              &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
-                                              NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
-                                              NULL, NULL, NULL, NULL, NULL)))
-                break;
-            }
-            /* Compute deltas */
-            dF = 0;
-            if (survived[0] && survived[1]) {
-              double beta, alpha, du, dup;
-              beta = beamline->twiss0->betax;
-              alpha = beamline->twiss0->alphax;
-              du = (startingCoord[0] - trackingBuffer[0][0]) / beta;
-              dup = (startingCoord[1] - trackingBuffer[0][1]) + alpha * du;
-              dF = fabs(du) + fabs(dup);
+          gridPoint[nPoints].x = x;
+          gridPoint[nPoints].y = y;
+          gridPoint[nPoints].delta = delta;
+          gridPoint[nPoints].ix = ix;
+          gridPoint[nPoints].iy = iy;
+          gridPoint[nPoints].idelta = idelta;
+          nPoints++;
+        }
+      }
+    }
+  }
+
+  /* Grid points are tracked together in batches of this size. For the multi-turn method
+   * each grid point needs three particles (reference, x change, y change).
+   */
+  if ((batchSize = particles_per_batch) <= 0 || batchSize > nPoints)
+    batchSize = nPoints;
+  if (batchSize < 1)
+    batchSize = 1;
+  perPoint = forward_backward > 0 ? 1 : 3;
+  trackingBuffer = (double **)czarray_2d(sizeof(**trackingBuffer), perPoint * batchSize, totalPropertiesPerParticle);
+  survivorRow = tmalloc(sizeof(*survivorRow) * perPoint * batchSize);
+
+  for (iPoint0 = 0; iPoint0 < nPoints; iPoint0 += nBatch) {
+    if ((nBatch = nPoints - iPoint0) > batchSize)
+      nBatch = batchSize;
+    nTrack = perPoint * nBatch;
+    for (ib = 0; ib < nBatch; ib++) {
+      memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
+      startingCoord[0] += gridPoint[iPoint0 + ib].x;
+      startingCoord[2] += gridPoint[iPoint0 + ib].y;
+      startingCoord[5] += gridPoint[iPoint0 + ib].delta;
+      for (j = 0; j < perPoint; j++) {
+        memcpy(trackingBuffer[perPoint * ib + j], startingCoord, sizeof(*startingCoord) * 6);
+        trackingBuffer[perPoint * ib + j][6] = perPoint * ib + j + 1;
+      }
+      if (perPoint == 3) {
+        trackingBuffer[3 * ib + 1][0] += change_x;
+        trackingBuffer[3 * ib + 2][2] += change_y;
+      }
+    }
+    /* All particles of the batch are tracked together. Survivors are at the start of the
+     * buffer and are located afterwards using the particle ID.
+     */
+    p = run->p_central;
+    nLeft = nTrack;
+    if (forward_backward > 0) {
+      int iteration;
+      for (iteration = 0; iteration < forward_backward && nLeft; iteration++) {
+        if ((nLeft = do_tracking(NULL, trackingBuffer, nLeft, NULL, beamline,
+                                 &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
+                                 NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
+                                 NULL, NULL, NULL, NULL, NULL)))
+          nLeft = do_tracking(NULL, trackingBuffer, nLeft, NULL, btBeamline,
+                              &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
+                              NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
+                              NULL, NULL, NULL, NULL, NULL);
+      }
+    } else
+      nLeft = do_tracking(NULL, trackingBuffer, nTrack, NULL, beamline, &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
+                          NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
+                          NULL, NULL, NULL, NULL, NULL);
+    for (j = 0; j < nTrack; j++)
+      survivorRow[j] = -1;
+    for (j = 0; j < nLeft; j++)
+      survivorRow[(long)trackingBuffer[j][6] - 1] = j;
 
-              beta = beamline->twiss0->betay;
-              alpha = beamline->twiss0->alphay;
-              du = (startingCoord[2] - trackingBuffer[0][2]) / beta;
-              dup = (startingCoord[3] - trackingBuffer[0][3]) + alpha * du;
-              dF += fabs(du) + fabs(dup);
-            }
-            /* Log the data */
-            if (!SDDS_SetRowValues(&SDDS_cmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
-                                   IC_X, x, IC_Y, y, IC_DELTA, delta,
-                                   IC_SURVIVED, survived[0] * survived[1],
-                                   IC_DF, dF, IC_LOGDF, log(dF + 1e-300),
-                                   -1)) {
-              SDDS_SetError("Problem setting SDDS row values (doChaosMap)");
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
-            }
-          } else {
-            /* Method using multi-turn tracking */
-            /* Do the tracking */
-            memcpy(trackingBuffer[0], startingCoord, sizeof(*startingCoord) * 6);
-            trackingBuffer[0][6] = 1;
-            p = run->p_central;
-            memset(survived, 0, 3 * sizeof(*survived));
-            if ((survived[0] = do_tracking(NULL, trackingBuffer, 1, NULL, beamline, &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
-                                           NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
-                                           NULL, NULL, NULL, NULL, NULL))) {
-              memcpy(trackingBuffer[1], startingCoord, sizeof(*startingCoord) * 6);
-              trackingBuffer[1][0] += change_x;
-              trackingBuffer[1][6] = 2;
-              survived[1] = do_tracking(NULL, trackingBuffer + 1, 1, NULL, beamline, &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
-                                        NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
-                                        NULL, NULL, NULL, NULL, NULL);
+    for (ib = 0; ib < nBatch; ib++) {
+      x = gridPoint[iPoint0 + ib].x;
+      y = gridPoint[iPoint0 + ib].y;
+      delta = gridPoint[iPoint0 + ib].delta;
+      ix = gridPoint[iPoint0 + ib].ix;
+      iy = gridPoint[iPoint0 + ib].iy;
+      idelta = gridPoint[iPoint0 + ib].idelta;
+      memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
+      startingCoord[0] += x;
+      startingCoord[2] += y;
+      startingCoord[5] += delta;
+      if (forward_backward > 0) {
+        double *coord;
+        /* Compute deltas */
+        dF = 0;
+        survived[0] = survived[1] = survivorRow[ib] >= 0;
+        if (survived[0] && survived[1]) {
+          double beta, alpha, du, dup;
+          coord = trackingBuffer[survivorRow[ib]];
+          beta = beamline->twiss0->betax;
+          alpha = beamline->twiss0->alphax;
+          du = (startingCoord[0] - coord[0]) / beta;
+          dup = (startingCoord[1] - coord[1]) + alpha * du;
+          dF = fabs(du) + fabs(dup);
 
-              memcpy(trackingBuffer[2], startingCoord, sizeof(*startingCoord) * 6);
-              trackingBuffer[2][2] += change_y;
-              trackingBuffer[2][6] = 3;
-              survived[2] = do_tracking(NULL, trackingBuffer + 2, 1, NULL, beamline, &p, (double **)NULL, (BEAM_SUMS **)NULL, (long *)NULL,
-                                        NULL, run, 0, TEST_PARTICLES, control->n_passes, 0,
-                                        NULL, NULL, NULL, NULL, NULL);
-            }
-            /* Compute deltas */
-            dJx = dJy = DBL_MAX;
-            if (survived[0]) {
-              if (survived[1]) {
-                double J1, J2, beta, alpha, gamma;
-                beta = beamline->twiss0->betax;
-                alpha = beamline->twiss0->alphax;
-                gamma = (1 + alpha * alpha) / beta;
-                J1 = (sqr(trackingBuffer[0][0]) * gamma + 2 * alpha * trackingBuffer[0][0] * trackingBuffer[0][1] + sqr(trackingBuffer[0][1]) * beta) / 2;
-                J2 = (sqr(trackingBuffer[1][0]) * gamma + 2 * alpha * trackingBuffer[1][0] * trackingBuffer[1][1] + sqr(trackingBuffer[1][1]) * beta) / 2;
-                dJx = J2 - J1;
-              }
-              if (survived[2]) {
-                double J1, J2, beta, alpha, gamma;
-                beta = beamline->twiss0->betay;
-                alpha = beamline->twiss0->alphay;
-                gamma = (1 + alpha * alpha) / beta;
-                J1 = (sqr(trackingBuffer[0][2]) * gamma + 2 * alpha * trackingBuffer[0][2] * trackingBuffer[0][3] + sqr(trackingBuffer[0][3]) * beta) / 2;
-                J2 = (sqr(trackingBuffer[1][2]) * gamma + 2 * alpha * trackingBuffer[1][2] * trackingBuffer[1][3] + sqr(trackingBuffer[1][3]) * beta) / 2;
-                dJy = J2 - J1;
-              }
-            }
-            /* Log the data */
-            if (!SDDS_SetRowValues(&SDDS_cmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
-                                   IC_X, x, IC_Y, y, IC_DELTA, delta,
-                                   IC_DJX, dJx, IC_DJY, dJy, IC_SURVIVED, survived[0] * survived[1] * survived[2],
-                                   IC_LOGDJX, log(fabs(dJx)), IC_LOGDJY, log(fabs(dJy)),
-                                   -1)) {
-              SDDS_SetError("Problem setting SDDS row values (doChaosMap)");
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
-            }
+          beta = beamline->twiss0->betay;
+          alpha = beamline->twiss0->alphay;
+          du = (startingCoord[2] - coord[2]) / beta;
+          dup = (startingCoord[3] - coord[3]) + alpha * du;
+          dF += fabs(du) + fabs(dup);
+        }
+        /* Log the data */
+        if (!SDDS_SetRowValues(&SDDS_cmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
+                               IC_X, x, IC_Y, y, IC_DELTA, delta,
+                               IC_SURVIVED, survived[0] * survived[1],
+                               IC_DF, dF, IC_LOGDF, log(dF + 1e-300),
+                               -1)) {
+          SDDS_SetError("Problem setting SDDS row values (doChaosMap)");
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+        }
+      } else {
+        /* Method using multi-turn tracking */
+        double *coord[3];
+        for (j = 0; j < 3; j++) {
+          survived[j] = survivorRow[3 * ib + j] >= 0;
+          coord[j] = survived[j] ? trackingBuffer[survivorRow[3 * ib + j]] : NULL;
+        }
+        if (!survived[0])
+          survived[1] = survived[2] = 0;
+        /* Compute deltas */
+        dJx = dJy = DBL_MAX;
+        if (survived[0]) {
+          if (survived[1]) {
+            double J1, J2, beta, alpha, gamma;
+            beta = beamline->twiss0->betax;
+            alpha = beamline->twiss0->alphax;
+            gamma = (1 + alpha * alpha) / beta;
+            J1 = (sqr(coord[0][0]) * gamma + 2 * alpha * coord[0][0] * coord[0][1] + sqr(coord[0][1]) * beta) / 2;
+            J2 = (sqr(coord[1][0]) * gamma + 2 * alpha * coord[1][0] * coord[1][1] + sqr(coord[1][1]) * beta) / 2;
+            dJx = J2 - J1;
           }
-          ip++;
-          if (verbosity) {
+          if (survived[2]) {
+            double J1, J2, beta, alpha, gamma;
+            beta = beamline->twiss0->betay;
+            alpha = beamline->twiss0->alphay;
+            gamma = (1 + alpha * alpha) / beta;
+            J1 = (sqr(coord[0][2]) * gamma + 2 * alpha * coord[0][2] * coord[0][3] + sqr(coord[0][3]) * beta) / 2;
+            J2 = (sqr(coord[2][2]) * gamma + 2 * alpha * coord[2][2] * coord[2][3] + sqr(coord[2][3]) * beta) / 2;
+            dJy = J2 - J1;
+          }
+        }
+        /* Log the data */
+        if (!SDDS_SetRowValues(&SDDS_cmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
+                               IC_X, x, IC_Y, y, IC_DELTA, delta,
+                               IC_DJX, dJx, IC_DJY, dJy, IC_SURVIVED, survived[0] * survived[1] * survived[2],
+                               IC_LOGDJX, log(fabs(dJx)), IC_LOGDJY, log(fabs(dJy)),
+                               -1)) {
+          SDDS_SetError("Problem setting SDDS row values (doChaosMap)");
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+        }
+      }
+      ip++;
+      if (verbosity) {
 #if USE_MPI
-            if (myid == 1) {
-              double newPercentage = 100 * (idelta * nx * ny + ix * ny + iy + 1.0) / (ndelta * nx * ny);
-              if ((newPercentage - oldPercentage) >= 1) {
-                printf("About %.1f%% done\n", newPercentage);
-                oldPercentage = newPercentage;
-                fflush(stdout);
-              }
-            }
-#else
-            printf("Done with particle %ld of %ld\n",
-                   ix * ny * ndelta + iy * ndelta + idelta + 1, nx * ny * ndelta);
+        if (myid == 1) {
+          double newPercentage = 100 * (idelta * nx * ny + ix * ny + iy + 1.0) / (ndelta * nx * ny);
+          if ((newPercentage - oldPercentage) >= 1) {
+            printf("About %.1f%% done\n", newPercentage);
+            oldPercentage = newPercentage;
             fflush(stdout);
-#endif
           }
         }
+#else
+        printf("Done with particle %ld of %ld\n",
+               ix * ny * ndelta + iy * ndelta + idelta + 1, nx * ny * ndelta);
+        fflush(stdout);
+#endif
       }
     }
   }
+  free(gridPoint);
+  free(survivorRow);
+  free_czarray_2d((void **)trackingBuffer, perPoint * batchSize, totalPropertiesPerParticle);
 
   if (forward_backward > 0)
     free_beamlines(btBeamline);
@@ -20,5 +20,6 @@
     double change_x = 1e-6;
     double change_y = 1e-6;
     long verbosity = 1;
+    long particles_per_batch = 1;
 #end
 
@@ -0,0 +1,528 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: checkpoint.c
+ * purpose: checkpoint and restart of long tracking runs.
+ *
+ * With track checkpoint=<file> and checkpoint_interval=N, do_tracking() writes
+ * a binary file every N passes with the particle coordinates (including lost
+ * particles), the pass number, the central momentum, the state of the random
+ * number generators, and the internal state of elements that carry history
+ * from pass to pass:
+ *   RFMODE     beam-induced voltage phasor, generator/feedback state, IIR filters
+ *   TRFMODE    voltage phasors
+ *   LRWAKE     bunch history or resonator sums
+ *   RFCA/RFCW  fiducial phase and time
+ *   IONEFFECTS ion populations and saved fit parameters
+ *   TFBPICKUP  past readings and filter outputs
+ *   TFBDRIVER  output signal buffers and cavity model state
+ * Restarting with track restart_from=<file> reproduces the rest of the original
+ * run exactly. Writing a checkpoint doesn't change the run that writes it.
+ * FRFMODE and FTRFMODE, which compute the whole run's wake at once, aren't saved.
+ *
+ * In Pelegant each processor writes its own file, named by appending the
+ * processor ID, and a restart must use the same number of processors.
+ */
+#include "mdb.h"
+#include "track.h"
+#include "matlib.h"
+
+#define CHECKPOINT_MAGIC "elegant-checkpoint"
+#define CHECKPOINT_VERSION 3
+
+typedef struct {
+  char magic[32];
+  long version, step, pass, nProcessors, processorID;
+  long nToTrack, nMaximum, nLost, propertiesPerParticle, nElementRecords;
+  double Po;
+  ELEGANT_RANDOM_STATE randomState;
+} CHECKPOINT_HEADER;
+
+/* element state read from a checkpoint that must wait until the element
+ * has been set up by its tracking routine
+ */
+typedef struct {
+  void *p_elem;
+  char *name;
+  long type, nData;
+  double *data;
+} PENDING_STATE;
+
+static PENDING_STATE *pendingState = NULL;
+static long nPendingStates = 0;
+
+static long elementHasCheckpointState(long type) {
+  switch (type) {
+  case T_RFMODE:
+  case T_TRFMODE:
+  case T_LRWAKE:
+  case T_RFCA:
+  case T_RFCW:
+  case T_IONEFFECTS:
+  case T_TFBPICKUP:
+  case T_TFBDRIVER:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static char *checkpointFilename(char *filename) {
+#if USE_MPI
+  static char buffer[16384];
+  snprintf(buffer, 16384, "%s-%04d", filename, myid);
+  return buffer;
+#else
+  return filename;
+#endif
+}
+
+static void checkpointWrite(FILE *fp, void *data, size_t size, long n, char *filename) {
+  if (n > 0 && fwrite(data, size, n, fp) != (size_t)n)
+    bombElegantVA("Error: problem writing checkpoint file %s\n", filename);
+}
+
+static void checkpointRead(FILE *fp, void *data, size_t size, long n, char *filename) {
+  if (n > 0 && fread(data, size, n, fp) != (size_t)n)
+    bombElegantVA("Error: problem reading checkpoint file %s (file truncated?)\n", filename);
+}
+
+static void packIIRFilters(double *data, long *n, IIRFILTER *filter, long nFilters) {
+  long i, j;
+  for (i = 0; i < nFilters; i++) {
+    if (filter[i].nTerms <= 0)
+      continue;
+    if (data) {
+      for (j = 0; j < filter[i].nTerms; j++) {
+        data[*n + 2 * j] = filter[i].xn[j];
+        data[*n + 2 * j + 1] = filter[i].yn[j];
+      }
+      data[*n + 2 * filter[i].nTerms] = filter[i].iBuffer;
+    }
+    *n += 2 * filter[i].nTerms + 1;
+  }
+}
+
+static void unpackIIRFilters(double *data, long *n, IIRFILTER *filter, long nFilters) {
+  long i, j;
+  for (i = 0; i < nFilters; i++) {
+    if (filter[i].nTerms <= 0)
+      continue;
+    for (j = 0; j < filter[i].nTerms; j++) {
+      filter[i].xn[j] = data[*n + 2 * j];
+      filter[i].yn[j] = data[*n + 2 * j + 1];
+    }
+    filter[i].iBuffer = data[*n + 2 * filter[i].nTerms];
+    *n += 2 * filter[i].nTerms + 1;
+  }
+}
+
+/* Copies the state of an element to or from data. Returns the number of
+ * values. With data==NULL, only counts the values.
+ */
+static long transferElementState(void *p_elem, long type, double *data, short restore) {
+  long n, i;
+  RFMODE *rfmode;
+  TRFMODE *trfmode;
+  LRWAKE *lrwake;
+  RFCA *rfca;
+  TFBPICKUP *tfbp;
+  TFBDRIVER *tfbd;
+  double *value[32];
+  MATRIX *matrix[2];
+
+  n = 0;
+  switch (type) {
+  case T_RFMODE:
+    rfmode = (RFMODE *)p_elem;
+    value[n++] = &rfmode->V;
+    value[n++] = &rfmode->Vr;
+    value[n++] = &rfmode->Vi;
+    value[n++] = &rfmode->last_t;
+    value[n++] = &rfmode->last_phase;
+    value[n++] = &rfmode->last_omega;
+    value[n++] = &rfmode->last_Q;
+    value[n++] = &rfmode->setpointAdjustment;
+    value[n++] = &rfmode->fbVCavity;
+    value[n++] = &rfmode->Vg;
+    value[n++] = &rfmode->phaseg;
+    value[n++] = &rfmode->tg;
+    value[n++] = &rfmode->V0;
+    value[n++] = &rfmode->last_phase0;
+    value[n++] = &rfmode->fbLastTickTime;
+    value[n++] = &rfmode->fbNextTickTime;
+    value[n++] = &rfmode->fbNextTickTimeError;
+    value[n++] = &rfmode->tGenerator;
+    for (i = 0; i < n; i++) {
+      if (data) {
+        if (restore)
+          *value[i] = data[i];
+        else
+          data[i] = *value[i];
+      }
+    }
+    if (data) {
+      if (restore) {
+        rfmode->fbRunning = data[n];
+        rfmode->sample_counter = data[n + 1];
+        rfmode->fbSample = data[n + 2];
+      } else {
+        data[n] = rfmode->fbRunning;
+        data[n + 1] = rfmode->sample_counter;
+        data[n + 2] = rfmode->fbSample;
+      }
+    }
+    n += 3;
+    matrix[0] = rfmode->Viq;
+    matrix[1] = rfmode->Iiq;
+    for (i = 0; i < 2; i++) {
+      if (!matrix[i])
+        continue;
+      if (data) {
+        if (restore) {
+          matrix[i]->a[0][0] = data[n];
+          matrix[i]->a[1][0] = data[n + 1];
+        } else {
+          data[n] = matrix[i]->a[0][0];
+          data[n + 1] = matrix[i]->a[1][0];
+        }
+      }
+      n += 2;
+    }
+    if (data && restore) {
+      unpackIIRFilters(data, &n, rfmode->amplitudeFilter, rfmode->nAmplitudeFilters);
+      unpackIIRFilters(data, &n, rfmode->phaseFilter, rfmode->nPhaseFilters);
+      unpackIIRFilters(data, &n, rfmode->IFilter, rfmode->nIFilters);
+      unpackIIRFilters(data, &n, rfmode->QFilter, rfmode->nQFilters);
+    } else {
+      packIIRFilters(data, &n, rfmode->amplitudeFilter, rfmode->nAmplitudeFilters);
+      packIIRFilters(data, &n, rfmode->phaseFilter, rfmode->nPhaseFilters);
+      packIIRFilters(data, &n, rfmode->IFilter, rfmode->nIFilters);
+      packIIRFilters(data, &n, rfmode->QFilter, rfmode->nQFilters);
+    }
+    break;
+  case T_TRFMODE:
+    trfmode = (TRFMODE *)p_elem;
+    value[n++] = &trfmode->Vx;
+    value[n++] = &trfmode->Vxr;
+    value[n++] = &trfmode->Vxi;
+    value[n++] = &trfmode->Vy;
+    value[n++] = &trfmode->Vyr;
+    value[n++] = &trfmode->Vyi;
+    value[n++] = &trfmode->last_t;
+    value[n++] = &trfmode->last_xphase;
+    value[n++] = &trfmode->last_yphase;
+    for (i = 0; data && i < n; i++) {
+      if (restore)
+        *value[i] = data[i];
+      else
+        data[i] = *value[i];
+    }
+    break;
+  case T_LRWAKE:
+    lrwake = (LRWAKE *)p_elem;
+    if (restore) {
+      /* set_up_lrwake() keeps history arrays of the right size */
+      lrwake->nHistory = (n = data[0]);
+      lrwake->tHistory = trealloc(lrwake->tHistory, sizeof(*lrwake->tHistory) * (n ? n : 1));
+      lrwake->QHistory = trealloc(lrwake->QHistory, sizeof(*lrwake->QHistory) * (n ? n : 1));
+      lrwake->xHistory = trealloc(lrwake->xHistory, sizeof(*lrwake->xHistory) * (n ? n : 1));
+      lrwake->yHistory = trealloc(lrwake->yHistory, sizeof(*lrwake->yHistory) * (n ? n : 1));
+      for (i = 0; i < n; i++) {
+        lrwake->tHistory[i] = data[1 + 4 * i];
+        lrwake->QHistory[i] = data[2 + 4 * i];
+        lrwake->xHistory[i] = data[3 + 4 * i];
+        lrwake->yHistory[i] = data[4 + 4 * i];
+      }
+      n = 1 + 4 * n;
+      /* resonator sums, if RESONATOR_MODES or RESONATOR_FILE was used */
+      if ((lrwake->nModeState = data[n++])) {
+        lrwake->modeState = trealloc(lrwake->modeState, sizeof(*lrwake->modeState) * lrwake->nModeState);
+        memcpy(lrwake->modeState, data + n, sizeof(*lrwake->modeState) * lrwake->nModeState);
+      }
+      n += lrwake->nModeState;
+    } else {
+      n = lrwake->tHistory ? lrwake->nHistory : 0;
+      if (data) {
+        data[0] = n;
+        for (i = 0; i < n; i++) {
+          data[1 + 4 * i] = lrwake->tHistory[i];
+          data[2 + 4 * i] = lrwake->QHistory[i];
+          data[3 + 4 * i] = lrwake->xHistory[i];
+          data[4 + 4 * i] = lrwake->yHistory[i];
+        }
+      }
+      n = 1 + 4 * n;
+      if (data) {
+        data[n] = lrwake->modeState ? lrwake->nModeState : 0;
+        if (lrwake->modeState)
+          memcpy(data + n + 1, lrwake->modeState, sizeof(*lrwake->modeState) * lrwake->nModeState);
+      }
+      n += 1 + (lrwake->modeState ? lrwake->nModeState : 0);
+    }
+    break;
+  case T_RFCA:
+  case T_RFCW:
+    rfca = type == T_RFCA ? (RFCA *)p_elem : &(((RFCW *)p_elem)->rfca);
+    if (data) {
+      if (restore) {
+        rfca->fiducial_seen = data[0];
+        rfca->phase_fiducial = data[1];
+        rfca->t_fiducial = data[2];
+      } else {
+        data[0] = rfca->fiducial_seen;
+        data[1] = rfca->phase_fiducial;
+        data[2] = rfca->t_fiducial;
+      }
+    }
+    n = 3;
+    break;
+  case T_IONEFFECTS:
+    n = transferIonEffectsState((IONEFFECTS *)p_elem, data, restore);
+    break;
+  case T_TFBPICKUP:
+    tfbp = (TFBPICKUP *)p_elem;
+    if (data) {
+      if (restore) {
+        tfbp->pass0 = data[1];
+        tfbp->tReference = data[2];
+        tfbp->tReferenceSet = data[3];
+      } else {
+        data[0] = tfbp->nBunches;
+        data[1] = tfbp->pass0;
+        data[2] = tfbp->tReference;
+        data[3] = tfbp->tReferenceSet;
+      }
+    }
+    n = 4;
+    for (i = 0; i < tfbp->nBunches; i++) {
+      if (data) {
+        if (restore) {
+          memcpy(tfbp->data[i], data + n, sizeof(**tfbp->data) * TFB_FILTER_LENGTH);
+          tfbp->filterOutput[i] = data[n + TFB_FILTER_LENGTH];
+        } else {
+          memcpy(data + n, tfbp->data[i], sizeof(**tfbp->data) * TFB_FILTER_LENGTH);
+          data[n + TFB_FILTER_LENGTH] = tfbp->filterOutput[i];
+        }
+      }
+      n += TFB_FILTER_LENGTH + 1;
+    }
+    break;
+  case T_TFBDRIVER:
+    tfbd = (TFBDRIVER *)p_elem;
+    if (data) {
+      if (restore) {
+        tfbd->pass0 = data[1];
+        if (data[2])
+          tfbd->initialized |= TFBDRIVER_CLOCK_INIT;
+        else
+          tfbd->initialized &= ~TFBDRIVER_CLOCK_INIT;
+      } else {
+        data[0] = tfbd->nBunches;
+        data[1] = tfbd->pass0;
+        data[2] = (tfbd->initialized & TFBDRIVER_CLOCK_INIT) ? 1 : 0;
+      }
+    }
+    value[n++] = &tfbd->lastV;
+    value[n++] = &tfbd->lastVp;
+    value[n++] = &tfbd->lastIg;
+    value[n++] = &tfbd->lastTime;
+    value[n++] = &tfbd->thisTime;
+    value[n++] = &tfbd->VResidual;
+    for (i = 0; data && i < n; i++) {
+      if (restore)
+        *value[i] = data[3 + i];
+      else
+        data[3 + i] = *value[i];
+    }
+    n += 3;
+    for (i = 0; i < tfbd->nBunches; i++) {
+      if (data) {
+        if (restore)
+          memcpy(tfbd->driverSignal[i], data + n, sizeof(**tfbd->driverSignal) * (tfbd->delay + 1 + TFB_FILTER_LENGTH));
+        else
+          memcpy(data + n, tfbd->driverSignal[i], sizeof(**tfbd->driverSignal) * (tfbd->delay + 1 + TFB_FILTER_LENGTH));
+      }
+      n += tfbd->delay + 1 + TFB_FILTER_LENGTH;
+    }
+    break;
+  default:
+    break;
+  }
+  return n;
+}
+
+void writeTrackingCheckpoint(RUN *run, LINE_LIST *beamline, double **coord, long nToTrack, long nMaximum,
+                             long nLost, double Po, long pass, long step) {
+  CHECKPOINT_HEADER header;
+  ELEMENT_LIST *eptr;
+  FILE *fp;
+  char *filename, *tmpName;
+  long i, index, nData, maxData;
+  double *data;
+
+  filename = checkpointFilename(run->checkpointFile);
+
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, CHECKPOINT_MAGIC);
+  header.version = CHECKPOINT_VERSION;
+  header.step = step;
+  header.pass = pass;
+#if USE_MPI
+  header.nProcessors = n_processors;
+  header.processorID = myid;
+#else
+  header.nProcessors = 1;
+  header.processorID = 0;
+#endif
+  header.nToTrack = nToTrack;
+  header.nMaximum = nMaximum;
+  header.nLost = nLost;
+  header.propertiesPerParticle = totalPropertiesPerParticle;
+  header.Po = Po;
+  getElegantRandomNumberState(&header.randomState);
+  for (eptr = beamline->elem; eptr; eptr = eptr->succ)
+    if (elementHasCheckpointState(eptr->type))
+      header.nElementRecords++;
+
+  /* write to a temporary file and rename it, so a crash while writing leaves the last checkpoint intact */
+  tmpName = tmalloc(sizeof(*tmpName) * (strlen(filename) + 5));
+  sprintf(tmpName, "%s.tmp", filename);
+  if (!(fp = fopen(tmpName, "wb")))
+    bombElegantVA("Error: unable to open checkpoint file %s\n", tmpName);
+  checkpointWrite(fp, &header, sizeof(header), 1, tmpName);
+  for (i = 0; i < nMaximum; i++)
+    checkpointWrite(fp, coord[i], sizeof(**coord), totalPropertiesPerParticle, tmpName);
+
+  data = NULL;
+  maxData = 0;
+  for (eptr = beamline->elem, index = 0; eptr; eptr = eptr->succ, index++) {
+    if (!elementHasCheckpointState(eptr->type))
+      continue;
+    nData = transferElementState(eptr->p_elem, eptr->type, NULL, 0);
+    if (nData > maxData)
+      data = trealloc(data, sizeof(*data) * (maxData = nData));
+    transferElementState(eptr->p_elem, eptr->type, data, 0);
+    checkpointWrite(fp, &index, sizeof(index), 1, tmpName);
+    checkpointWrite(fp, &eptr->type, sizeof(eptr->type), 1, tmpName);
+    checkpointWrite(fp, &nData, sizeof(nData), 1, tmpName);
+    checkpointWrite(fp, data, sizeof(*data), nData, tmpName);
+  }
+  if (data)
+    free(data);
+  if (fclose(fp))
+    bombElegantVA("Error: problem closing checkpoint file %s\n", tmpName);
+  if (rename(tmpName, filename))
+    bombElegantVA("Error: unable to rename %s to %s\n", tmpName, filename);
+  free(tmpName);
+}
+
+/* Restores a tracking run from a checkpoint. Returns the first pass to track,
+ * or -1 if the checkpoint belongs to a different step.
+ */
+long readTrackingCheckpoint(RUN *run, LINE_LIST *beamline, double **coord, long nCapacity, long *nToTrack,
+                            long *nMaximum, long *nLost, double *Po, long step) {
+  CHECKPOINT_HEADER header;
+  ELEMENT_LIST *eptr;
+  FILE *fp;
+  char *filename;
+  long i, index, type, nData, iElem;
+  double *data;
+
+  filename = checkpointFilename(run->restartFile);
+  if (!(fp = fopen(filename, "rb")))
+    bombElegantVA("Error: unable to open checkpoint file %s\n", filename);
+  checkpointRead(fp, &header, sizeof(header), 1, filename);
+  if (strncmp(header.magic, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC)) != 0 || header.version != CHECKPOINT_VERSION)
+    bombElegantVA("Error: %s is not a checkpoint file from this version of elegant\n", filename);
+  if (header.step != step) {
+    fclose(fp);
+    printf("Checkpoint %s is for step %ld, not tracking step %ld from the start\n", filename, header.step, step);
+    fflush(stdout);
+    return -1;
+  }
+#if USE_MPI
+  if (header.nProcessors != n_processors || header.processorID != myid)
+    bombElegantVA("Error: checkpoint %s was written by processor %ld of %ld; restart must use the same number of processors\n",
+                  filename, header.processorID, header.nProcessors);
+#endif
+  if (header.propertiesPerParticle != totalPropertiesPerParticle)
+    bombElegantVA("Error: checkpoint %s has %ld properties per particle, expected %ld\n",
+                  filename, header.propertiesPerParticle, (long)totalPropertiesPerParticle);
+  if (header.nMaximum > nCapacity)
+    bombElegantVA("Error: checkpoint %s has %ld particles, but the beam buffer holds only %ld\n",
+                  filename, header.nMaximum, nCapacity);
+
+  for (i = 0; i < header.nMaximum; i++)
+    checkpointRead(fp, coord[i], sizeof(**coord), totalPropertiesPerParticle, filename);
+  *nToTrack = header.nToTrack;
+  *nMaximum = header.nMaximum;
+  *nLost = header.nLost;
+  *Po = header.Po;
+  setElegantRandomNumberState(&header.randomState);
+
+  for (i = 0; i < nPendingStates; i++)
+    free(pendingState[i].data);
+  nPendingStates = 0;
+  eptr = beamline->elem;
+  iElem = 0;
+  for (i = 0; i < header.nElementRecords; i++) {
+    checkpointRead(fp, &index, sizeof(index), 1, filename);
+    checkpointRead(fp, &type, sizeof(type), 1, filename);
+    checkpointRead(fp, &nData, sizeof(nData), 1, filename);
+    data = tmalloc(sizeof(*data) * (nData ? nData : 1));
+    checkpointRead(fp, data, sizeof(*data), nData, filename);
+    while (eptr && iElem < index) {
+      eptr = eptr->succ;
+      iElem++;
+    }
+    if (!eptr || eptr->type != type)
+      bombElegantVA("Error: checkpoint %s doesn't match the beamline (element %ld)\n", filename, index);
+    if ((type == T_TFBPICKUP || type == T_TFBDRIVER) && nData && data[0] == 0) {
+      /* feedback wasn't active yet, so there's nothing to restore */
+      free(data);
+      continue;
+    }
+    if (type == T_RFMODE || type == T_TRFMODE || type == T_TFBPICKUP || type == T_TFBDRIVER) {
+      /* these are set up on the first pass, so apply the state afterwards */
+      pendingState = trealloc(pendingState, sizeof(*pendingState) * (nPendingStates + 1));
+      pendingState[nPendingStates].p_elem = eptr->p_elem;
+      pendingState[nPendingStates].name = eptr->name;
+      pendingState[nPendingStates].type = type;
+      pendingState[nPendingStates].nData = nData;
+      pendingState[nPendingStates].data = data;
+      nPendingStates++;
+    } else {
+      if (nData != transferElementState(eptr->p_elem, type, data, 1))
+        bombElegantVA("Error: checkpoint %s has the wrong amount of data for %s\n", filename, eptr->name);
+      free(data);
+    }
+  }
+  fclose(fp);
+
+  printf("Restarted from checkpoint %s at pass %ld with %ld particles\n", filename, header.pass + 1, header.nToTrack);
+  fflush(stdout);
+  return header.pass + 1;
+}
+
+/* Applies state read from a checkpoint to an element that has just been set up */
+void restoreCheckpointElementState(void *p_elem) {
+  long i;
+  for (i = 0; i < nPendingStates; i++) {
+    if (pendingState[i].p_elem != p_elem)
+      continue;
+    if (pendingState[i].nData != transferElementState(p_elem, pendingState[i].type, NULL, 0))
+      bombElegantVA("Error: checkpoint has the wrong amount of data for %s (number of bunches changed?)\n",
+                    pendingState[i].name);
+    transferElementState(p_elem, pendingState[i].type, pendingState[i].data, 1);
+    free(pendingState[i].data);
+    pendingState[i] = pendingState[--nPendingStates];
+    return;
+  }
+}
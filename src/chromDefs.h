@@ -53,6 +53,11 @@ void computeHigherOrderChromaticities(LINE_LIST *beamline, double *clorb, RUN *r
 				      long concatOrder, double deltaStep, long deltaPoints, long quickMode);
 void computeChromCorrectionMatrix(RUN *run, LINE_LIST *beamline, CHROM_CORRECTION *chrom, long step);
 void computeChromaticTuneLimits(LINE_LIST *beamline);
+
+/* prototypes for tpsa.c */
+#define TPSA_MAX_ORDER 7
+long computeTpsaChromaticities(double chrom[2][TPSA_MAX_ORDER], long chromOrder, double *tune,
+                               LINE_LIST *beamline, double *clorb, RUN *run);
 #ifdef __cplusplus
 }
 #endif
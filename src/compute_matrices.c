@@ -24,6 +24,7 @@ VMATRIX *rfdf_matrix(RFDF *rfdf, double Preference);
 VMATRIX *sextupoleFringeMatrix(double K2, double length, long maxOrder, long side);
 VMATRIX *mult_matrix(MULT *mult, double P, long maxOrder);
 VMATRIX *interpolateMatrixWithIdentityMatrix(VMATRIX *M0, double fraction, long order);
+VMATRIX *matrixTreeProduct(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order);
 
 static double timeCounter[N_TYPES];
 static long runCounter[N_TYPES];
@@ -74,7 +75,10 @@ VMATRIX *full_matrix(ELEMENT_LIST *elem, RUN *run, long order) {
   fflush(stdout);
 #endif
 
-  M = accumulate_matrices(elem, run, NULL, order, 1);
+  if (run && run->matrixTree)
+    M = matrixTreeProduct(elem, run, NULL, order);
+  else
+    M = accumulate_matrices(elem, run, NULL, order, 1);
   log_exit("full_matrix");
   return M;
 }
@@ -156,9 +160,207 @@ VMATRIX *accumulate_matrices(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long ord
 }
 
 VMATRIX *append_full_matrix(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order) {
+  if (run && run->matrixTree)
+    return matrixTreeProduct(elem, run, M0, order);
   return accumulate_matrices(elem, run, M0, order, 1);
 }
 
+/* Balanced binary tree of partial matrix products over the elements of a beamline,
+ * used by full_matrix() when run_setup matrix_tree is set. Each node holds the product
+ * of the matrices of its range of elements. An element whose matrix changes, e.g., after
+ * compute_changed_matrices() recomputes it for an optimizer step, invalidates only the
+ * nodes on its path to the root, so the full matrix is rebuilt with O(log N)
+ * concatenations. Leaves are matched by element and matrix address and by the matrix
+ * serial number, which is new for each matrix initialization.
+ */
+typedef struct {
+  ELEMENT_LIST *first;
+  long order, nLeaves;
+  ELEMENT_LIST **leaf;
+  VMATRIX **leafMatrix;
+  unsigned long *leafSerial;
+  VMATRIX **product; /* products for internal nodes, indexed as a heap from 1 */
+  short *valid, *hasRF;
+} MATRIX_TREE;
+
+#define MAX_MATRIX_TREES 8
+static MATRIX_TREE *matrixTree[MAX_MATRIX_TREES];
+static long nMatrixTrees = 0;
+
+static void freeMatrixTree(MATRIX_TREE *tree) {
+  long i;
+  for (i = 0; i < 4 * tree->nLeaves; i++) {
+    if (tree->product[i]) {
+      free_matrices(tree->product[i]);
+      tfree(tree->product[i]);
+    }
+  }
+  tfree(tree->product);
+  tfree(tree->valid);
+  tfree(tree->hasRF);
+  tfree(tree->leaf);
+  tfree(tree->leafMatrix);
+  tfree(tree->leafSerial);
+  tfree(tree);
+}
+
+void freeMatrixTrees() {
+  long i;
+  for (i = 0; i < nMatrixTrees; i++)
+    freeMatrixTree(matrixTree[i]);
+  nMatrixTrees = 0;
+}
+
+static short setMatrixTreeRF(MATRIX_TREE *tree, long node, long lo, long hi) {
+  long mid;
+  if (hi - lo == 1)
+    return tree->hasRF[node] = entity_description[tree->leaf[lo]->type].flags & HAS_RF_MATRIX ? 1 : 0;
+  mid = (lo + hi) / 2;
+  tree->hasRF[node] = setMatrixTreeRF(tree, 2 * node, lo, mid);
+  tree->hasRF[node] |= setMatrixTreeRF(tree, 2 * node + 1, mid, hi);
+  return tree->hasRF[node];
+}
+
+static void invalidateMatrixTreeLeaf(MATRIX_TREE *tree, long iLeaf) {
+  long node, lo, hi, mid;
+  node = 1;
+  lo = 0;
+  hi = tree->nLeaves;
+  while (hi - lo > 1) {
+    tree->valid[node] = 0;
+    mid = (lo + hi) / 2;
+    if (iLeaf < mid) {
+      node = 2 * node;
+      hi = mid;
+    } else {
+      node = 2 * node + 1;
+      lo = mid;
+    }
+  }
+}
+
+static VMATRIX *matrixTreeNode(MATRIX_TREE *tree, long node, long lo, long hi) {
+  VMATRIX *M0, *M1;
+  long mid;
+  if (hi - lo == 1)
+    return tree->leaf[lo]->matrix;
+  if (!tree->valid[node]) {
+    mid = (lo + hi) / 2;
+    M0 = matrixTreeNode(tree, 2 * node, lo, mid);
+    M1 = matrixTreeNode(tree, 2 * node + 1, mid, hi);
+    if (!tree->product[node])
+      initialize_matrices(tree->product[node] = tmalloc(sizeof(*tree->product[node])), tree->order);
+    /* path length is excluded from the input to rf elements, as in accumulate_matrices() */
+    concat_matrices(tree->product[node], M1, M0, tree->hasRF[2 * node + 1] ? CONCAT_EXCLUDE_S0 : 0);
+    tree->valid[node] = 1;
+  }
+  return tree->product[node];
+}
+
+VMATRIX *matrixTreeProduct(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order) {
+  MATRIX_TREE *tree;
+  ELEMENT_LIST *member;
+  VMATRIX *M;
+  double Pref_input;
+  long i, iTree, nLeaves, rebuild;
+
+  log_entry("matrixTreeProduct");
+
+  if (!elem) {
+    fputs("error: NULL element pointer passed to matrixTreeProduct", stdout);
+    abort();
+  }
+
+  for (iTree = 0; iTree < nMatrixTrees; iTree++)
+    if (matrixTree[iTree]->first == elem && matrixTree[iTree]->order == order)
+      break;
+  tree = iTree < nMatrixTrees ? matrixTree[iTree] : NULL;
+
+  /* bring element matrices up to date, as accumulate_matrices() does, and find changed leaves */
+  nLeaves = rebuild = 0;
+  for (member = elem; member; member = member->succ) {
+    if (member->type < 0 || member->type >= N_TYPES) {
+      printf("error: bad element type %ld (matrixTreeProduct)\n", member->type);
+      fflush(stdout);
+      abort();
+    }
+    if (member->pred)
+      Pref_input = member->pred->Pref_output;
+    else
+      Pref_input = member->Pref_input;
+    if (!member->matrix || Pref_input != member->Pref_input)
+      compute_matrix(member, run, NULL);
+    if (entity_description[member->type].flags & HAS_MATRIX && !member->matrix) {
+      printf("programming error: matrix not computed for element %s\n", member->name);
+      fflush(stdout);
+      abort();
+    }
+    if (!member->matrix)
+      continue;
+    if (tree && !rebuild) {
+      if (nLeaves >= tree->nLeaves || tree->leaf[nLeaves] != member)
+        rebuild = 1;
+      else if (tree->leafMatrix[nLeaves] != member->matrix || tree->leafSerial[nLeaves] != member->matrix->serial) {
+        invalidateMatrixTreeLeaf(tree, nLeaves);
+        tree->leafMatrix[nLeaves] = member->matrix;
+        tree->leafSerial[nLeaves] = member->matrix->serial;
+      }
+    }
+    nLeaves++;
+  }
+  if (tree && (rebuild || nLeaves != tree->nLeaves)) {
+    freeMatrixTree(tree);
+    matrixTree[iTree] = matrixTree[--nMatrixTrees];
+    tree = NULL;
+  }
+
+  if (!tree && nLeaves) {
+    if (nMatrixTrees == MAX_MATRIX_TREES) {
+      freeMatrixTree(matrixTree[0]);
+      for (i = 1; i < nMatrixTrees; i++)
+        matrixTree[i - 1] = matrixTree[i];
+      nMatrixTrees--;
+    }
+    tree = matrixTree[nMatrixTrees++] = tmalloc(sizeof(*tree));
+    tree->first = elem;
+    tree->order = order;
+    tree->nLeaves = nLeaves;
+    tree->leaf = tmalloc(sizeof(*tree->leaf) * nLeaves);
+    tree->leafMatrix = tmalloc(sizeof(*tree->leafMatrix) * nLeaves);
+    tree->leafSerial = tmalloc(sizeof(*tree->leafSerial) * nLeaves);
+    tree->product = tmalloc(sizeof(*tree->product) * 4 * nLeaves);
+    tree->valid = tmalloc(sizeof(*tree->valid) * 4 * nLeaves);
+    tree->hasRF = tmalloc(sizeof(*tree->hasRF) * 4 * nLeaves);
+    for (i = 0; i < 4 * nLeaves; i++) {
+      tree->product[i] = NULL;
+      tree->valid[i] = 0;
+    }
+    for (member = elem, i = 0; member; member = member->succ) {
+      if (!member->matrix)
+        continue;
+      tree->leaf[i] = member;
+      tree->leafMatrix[i] = member->matrix;
+      tree->leafSerial[i] = member->matrix->serial;
+      i++;
+    }
+    setMatrixTreeRF(tree, 1, 0, nLeaves);
+  }
+
+  initialize_matrices(M = tmalloc(sizeof(*M)), order);
+  if (!tree) {
+    for (i = 0; i < 6; i++)
+      M->R[i][i] = 1;
+    if (M0)
+      copy_matrices1(M, M0);
+  } else if (M0)
+    concat_matrices(M, matrixTreeNode(tree, 1, 0, tree->nLeaves), M0, tree->hasRF[1] ? CONCAT_EXCLUDE_S0 : 0);
+  else
+    copy_matrices1(M, matrixTreeNode(tree, 1, 0, tree->nLeaves));
+
+  log_exit("matrixTreeProduct");
+  return M;
+}
+
 VMATRIX *accumulateRadiationMatrices(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order, long radiation, long nSlices, long sliceEtilted) {
   VMATRIX *M1, *M2, *Ml1, *Ml2, *tmp;
   ELEMENT_LIST *member;
@@ -20,11 +20,27 @@
 void copy_matrices1(VMATRIX *M1, VMATRIX *M0);
 void free_elements1(ELEMENT_LIST *elemlist);
 
+/* Concatenated matrices are cached per segment (a run of consecutive
+ * concatenable elements). A segment is identified by its first element and
+ * the number of members, and is valid as long as the member matrices are
+ * unchanged. A copy of their coefficients is kept with the segment and
+ * compared whenever the hash of the coefficients matches. When an element is
+ * varied or perturbed, only the segment containing it is re-concatenated.
+ * With run_setup polynomial_map_order, each segment also gets a map of that
+ * order (see tpsa.c), which is used instead of the matrix for tracking.
+ */
+static void appendMatrixCoefficients(double **coef, long *nCoef, long *maxCoef, VMATRIX *M, short rf);
+static uint64_t hashDoubles(uint64_t hash, double *data, long n);
+static long concatSegmentBoundary(ELEMENT_LIST *elem, RUN *run);
+static VMATRIX *concatenateSegment(ELEMENT_LIST *first, long nMembers, long order);
+
 void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
-  ELEMENT_LIST *lastelem, *elem, *ecat;
-  VMATRIX *M1, *M2, *tmp;
-  long new_seq, n_seqs, in_seq;
-  long n_matrices, n_nonmatrices;
+  ELEMENT_LIST *elem, *ecat, *seqFirst;
+  CONCAT_SEGMENT *segment;
+  long in_seq, n_seqs, nMembers, nSegments, iOld, i;
+  long n_matrices, n_nonmatrices, n_reused, nCoef, maxCoef;
+  uint64_t hash;
+  double *coef;
   char s[100];
   double z, z_begin, z_end;
   ELEMENT_LIST *pred, *succ;
@@ -49,14 +65,14 @@ void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
   fflush(stdout);
 #endif
 
-  M1 = tmalloc(sizeof(*M1));
-  initialize_matrices(M1, run->concat_order);
-  M2 = tmalloc(sizeof(*M2));
-  initialize_matrices(M2, run->concat_order);
-
-  new_seq = 1;
-  n_seqs = in_seq = 0;
-  n_matrices = n_nonmatrices = 0;
+  segment = NULL;
+  nSegments = iOld = 0;
+  seqFirst = NULL;
+  hash = 0;
+  coef = NULL;
+  nCoef = maxCoef = 0;
+  in_seq = n_seqs = nMembers = 0;
+  n_matrices = n_nonmatrices = n_reused = 0;
   z = elem->beg_pos;
   z_begin = elem->beg_pos;
   z_end = elem->end_pos;
@@ -73,56 +89,86 @@ void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
       z += ((DRIFT *)elem->p_elem)->length;
     else
       z += elem->end_pos - elem->beg_pos;
-    if (entity_description[elem->type].flags & HAS_MATRIX && elem->matrix->order <= run->concat_order &&
-        !(entity_description[elem->type].flags & DONT_CONCAT)) {
-#if DEBUG
-      printf("element has matrix of order %ld\n", elem->matrix->order);
-      fflush(stdout);
-#endif
-      if (new_seq) {
-        /* start concatenating new sequence of matrices */
-#if DEBUG
-        printf("starting new sequence of concatenated matrices\n");
-        fflush(stdout);
-#endif
-        copy_matrices1(M1, elem->matrix);
+    if (!concatSegmentBoundary(elem, run)) {
+      if (!in_seq) {
+        /* start new sequence of matrices */
+        seqFirst = elem;
+        nMembers = 0;
+        nCoef = 0;
         z_begin = elem->beg_pos;
-        z_end = elem->end_pos;
-        new_seq = 0;
-      } else {
-        concat_matrices(M2, elem->matrix, M1,
-                        entity_description[elem->type].flags & HAS_RF_MATRIX ? CONCAT_EXCLUDE_S0 : 0);
-        tmp = M1;
-        M1 = M2;
-        M2 = tmp;
-        z_end = elem->end_pos;
+        in_seq = 1;
       }
-      in_seq = 1;
-    } else {
-      if (in_seq) {
-        /*  end of sequence--copy concatenated matrix into ecat list */
-#if DEBUG
-        printf("ending sequence of concatenated matrices\n");
-        fflush(stdout);
-#endif
-        ecat->matrix = tmalloc(sizeof(*(ecat->matrix)));
-        copy_matrices(ecat->matrix, M1);
-        sprintf(s, "M%ld", n_seqs++);
-        cp_str(&ecat->name, s);
-        ecat->type = T_MATR;
-        ecat->end_pos = z_end;
-        ecat->beg_pos = z_begin;
-        ecat->flags = 0;
-        ecat->p_elem = NULL;
+      appendMatrixCoefficients(&coef, &nCoef, &maxCoef, elem->matrix,
+                               entity_description[elem->type].flags & HAS_RF_MATRIX ? 1 : 0);
+      nMembers++;
+      z_end = elem->end_pos;
+    }
+    if (in_seq && (concatSegmentBoundary(elem, run) || !elem->succ)) {
+      /*  end of sequence--find or make the concatenated matrix and put it into ecat list */
+      hash = hashDoubles(14695981039346656037ULL, coef, nCoef);
+      segment = trealloc(segment, sizeof(*segment) * (nSegments + 1));
+      segment[nSegments].first = seqFirst;
+      segment[nSegments].nMembers = nMembers;
+      segment[nSegments].order = run->concat_order;
+      segment[nSegments].hash = hash;
+      segment[nSegments].coef = coef;
+      segment[nSegments].nCoef = nCoef;
+      coef = NULL;
+      maxCoef = 0;
+      segment[nSegments].matrix = NULL;
+      segment[nSegments].polyMapOrder = run->polynomialMapOrder;
+      segment[nSegments].polyMap = NULL;
+      for (i = iOld; i < beamline->nConcatSegments; i++) {
+        if (beamline->concatSegment[i].first == seqFirst) {
+          if (beamline->concatSegment[i].nMembers == nMembers && beamline->concatSegment[i].hash == hash &&
+              beamline->concatSegment[i].nCoef == nCoef &&
+              memcmp(beamline->concatSegment[i].coef, segment[nSegments].coef, sizeof(*coef) * nCoef) == 0 &&
+              beamline->concatSegment[i].order == run->concat_order &&
+              beamline->concatSegment[i].polyMapOrder == run->polynomialMapOrder &&
+              (!beamline->concatSegment[i].polyMap ||
+               beamline->concatSegment[i].polyMap->symplectic == (run->symplectifyPolynomialMap ? 1 : 0))) {
+            segment[nSegments].matrix = beamline->concatSegment[i].matrix;
+            segment[nSegments].polyMap = beamline->concatSegment[i].polyMap;
+            beamline->concatSegment[i].matrix = NULL;
+            beamline->concatSegment[i].polyMap = NULL;
+            n_reused++;
+          }
+          iOld = i + 1;
+          break;
+        }
+      }
+      if (!segment[nSegments].matrix)
+        segment[nSegments].matrix = concatenateSegment(seqFirst, nMembers, run->concat_order);
+      if (run->polynomialMapOrder && !segment[nSegments].polyMap)
+        segment[nSegments].polyMap = makePolynomialMap(seqFirst, nMembers, run->polynomialMapOrder, run);
+      ecat->matrix = tmalloc(sizeof(*(ecat->matrix)));
+      copy_matrices(ecat->matrix, segment[nSegments].matrix);
+      /* owned by the segment */
+      ecat->polyMap = segment[nSegments].polyMap;
+      nSegments++;
+      sprintf(s, "M%ld", n_seqs++);
+      cp_str(&ecat->name, s);
+      ecat->type = T_MATR;
+      ecat->end_pos = z_end;
+      ecat->beg_pos = z_begin;
+      ecat->flags = 0;
+      ecat->p_elem = NULL;
 #if DEBUG
-        printf("concatenated matrix %s has order %ld\n", ecat->name, ecat->matrix->order);
-        fflush(stdout);
+      printf("concatenated matrix %s has order %ld\n", ecat->name, ecat->matrix->order);
+      fflush(stdout);
 #endif
-        extend_elem_list(&ecat);
-        in_seq = 0;
-        n_matrices++;
-        beamline->ncat_elems++;
+      in_seq = 0;
+      n_matrices++;
+      beamline->ncat_elems++;
+      if (!concatSegmentBoundary(elem, run)) {
+        /* last element of the beamline */
+        ecat->twiss = elem->twiss;
+        ecat->succ = NULL;
+        break;
       }
+      extend_elem_list(&ecat);
+    }
+    if (concatSegmentBoundary(elem, run)) {
       /* non-matrix element--just copy everything and extend the list */
 #if DEBUG
       printf("copying non-matrix element %s\n", elem->name);
@@ -134,6 +180,7 @@ void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
       ecat->pred = pred;
       ecat->succ = succ;
       ecat->flags = 0;
+      ecat->polyMap = NULL;
       if (ecat->type == T_RECIRC)
         beamline->ecat_recirc = ecat;
       if (entity_description[ecat->type].flags & HAS_MATRIX) {
@@ -148,44 +195,23 @@ void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
         n_nonmatrices++;
       }
       beamline->ncat_elems++;
+      if (!elem->succ) {
+        ecat->succ = NULL;
+        break;
+      }
       extend_elem_list(&ecat);
-      new_seq = 1;
     }
-    lastelem = elem;
   } while ((elem = elem->succ));
+  if (coef)
+    tfree(coef);
 
-  if (in_seq) {
-    /*  end of sequence--copy concatenated matrix into ecat list */
-    elem = lastelem;
-    ecat->matrix = tmalloc(sizeof(*(ecat->matrix)));
-    copy_matrices(ecat->matrix, M1);
-    sprintf(s, "M%ld", n_seqs++);
-    cp_str(&ecat->name, s);
-    ecat->type = T_MATR;
-    ecat->end_pos = z_end;
-    ecat->beg_pos = z_begin;
-    ecat->flags = 0;
-    ecat->p_elem = NULL;
-    ecat->twiss = lastelem->twiss;
-    if (ecat->succ) {
-      ecat = ecat->succ;
-      if (ecat->matrix) {
-        free_matrices(ecat->matrix);
-        tfree(ecat->matrix);
-        ecat->matrix = NULL;
-      }
-      if (ecat->name) {
-        tfree(ecat->name);
-        ecat->name = NULL;
-      }
-    }
-    n_matrices++;
-    beamline->ncat_elems++;
-    ecat->succ = NULL;
-  } else
-    ecat->pred->succ = NULL;
+  /* segments that weren't matched are out of date */
+  freeConcatSegments(beamline);
+  beamline->concatSegment = segment;
+  beamline->nConcatSegments = nSegments;
 
 #if DEBUG
+  printf("%ld of %ld concatenated segments reused\n", n_reused, nSegments);
   printf("concatenated element list:\n");
   fflush(stdout);
   print_elem_list(stdout, beamline->ecat);
@@ -195,6 +221,135 @@ void concatenate_beamline(LINE_LIST *beamline, RUN *run) {
   log_exit("concatenate_beamline");
 }
 
+void freeConcatSegments(LINE_LIST *beamline) {
+  long i;
+  for (i = 0; i < beamline->nConcatSegments; i++) {
+    if (beamline->concatSegment[i].matrix) {
+      free_matrices(beamline->concatSegment[i].matrix);
+      tfree(beamline->concatSegment[i].matrix);
+    }
+    freePolynomialMap(beamline->concatSegment[i].polyMap);
+    if (beamline->concatSegment[i].coef)
+      tfree(beamline->concatSegment[i].coef);
+  }
+  if (beamline->concatSegment)
+    tfree(beamline->concatSegment);
+  beamline->concatSegment = NULL;
+  beamline->nConcatSegments = 0;
+}
+
+/* Returns nonzero if the element can't be merged into a concatenated matrix.
+ * Watch points, apertures, and collective elements have no matrix or are
+ * flagged DONT_CONCAT, so they always end a segment.
+ * With concat_accuracy_guard, nonlinear multipoles (sextupoles, octupoles,
+ * multipoles of order 2 and higher, and bends with a sextupole term) are
+ * tracked individually, since their products with neighboring matrices,
+ * truncated to concat_order, drop terms that element-by-element tracking
+ * keeps (e.g., the third-order terms from two sextupoles at concat_order=2,
+ * or the fourth-order terms at concat_order=3). So is MATTER, whose
+ * scattering and energy loss aren't in its matrix.
+ */
+static long concatSegmentBoundary(ELEMENT_LIST *elem, RUN *run) {
+  short nonlinear;
+
+  if (!(entity_description[elem->type].flags & HAS_MATRIX) || (entity_description[elem->type].flags & DONT_CONCAT) ||
+      elem->matrix->order > run->concat_order)
+    return 1;
+  if (run->concatAccuracyGuard) {
+    nonlinear = 0;
+    switch (elem->type) {
+    case T_MATTER:
+      return 1;
+    case T_SEXT:
+      nonlinear = ((SEXT *)elem->p_elem)->k2 != 0;
+      break;
+    case T_KSEXT:
+      nonlinear = ((KSEXT *)elem->p_elem)->k2 != 0;
+      break;
+    case T_OCT:
+      nonlinear = ((OCTU *)elem->p_elem)->k3 != 0;
+      break;
+    case T_KOCT:
+      nonlinear = ((KOCT *)elem->p_elem)->k3 != 0;
+      break;
+    case T_MULT:
+      nonlinear = ((MULT *)elem->p_elem)->order > 1 && ((MULT *)elem->p_elem)->KnL != 0;
+      break;
+    case T_SBEN:
+    case T_RBEN:
+      nonlinear = ((BEND *)elem->p_elem)->k2 != 0;
+      break;
+    default:
+      break;
+    }
+    if (nonlinear)
+      return 1;
+  }
+  return 0;
+}
+
+static VMATRIX *concatenateSegment(ELEMENT_LIST *first, long nMembers, long order) {
+  VMATRIX *M1, *M2, *tmp;
+  ELEMENT_LIST *elem;
+  long i;
+
+  M1 = tmalloc(sizeof(*M1));
+  initialize_matrices(M1, order);
+  M2 = tmalloc(sizeof(*M2));
+  initialize_matrices(M2, order);
+  copy_matrices1(M1, first->matrix);
+  for (i = 1, elem = first->succ; i < nMembers; i++, elem = elem->succ) {
+    concat_matrices(M2, elem->matrix, M1,
+                    entity_description[elem->type].flags & HAS_RF_MATRIX ? CONCAT_EXCLUDE_S0 : 0);
+    tmp = M1;
+    M1 = M2;
+    M2 = tmp;
+  }
+  free_matrices(M2);
+  tfree(M2);
+  return M1;
+}
+
+/* FNV-1a hash of the matrix coefficients */
+static uint64_t hashDoubles(uint64_t hash, double *data, long n) {
+  unsigned char *byte;
+  long i;
+  byte = (unsigned char *)data;
+  for (i = 0; i < n * (long)sizeof(*data); i++)
+    hash = (hash ^ byte[i]) * 1099511628211ULL;
+  return hash;
+}
+
+static void appendDoubles(double **coef, long *nCoef, long *maxCoef, double *data, long n) {
+  if (*nCoef + n > *maxCoef) {
+    *maxCoef = 2 * (*nCoef + n);
+    *coef = trealloc(*coef, sizeof(**coef) * (*maxCoef));
+  }
+  memcpy(*coef + *nCoef, data, sizeof(*data) * n);
+  *nCoef += n;
+}
+
+/* Appends the order, the RF flag, and the coefficients of the matrix to coef[] */
+static void appendMatrixCoefficients(double **coef, long *nCoef, long *maxCoef, VMATRIX *M, short rf) {
+  long i, j, k;
+  double header[2];
+  header[0] = M->order;
+  header[1] = rf;
+  appendDoubles(coef, nCoef, maxCoef, header, 2);
+  appendDoubles(coef, nCoef, maxCoef, M->C, 6);
+  for (i = 0; i < 6; i++)
+    appendDoubles(coef, nCoef, maxCoef, M->R[i], 6);
+  if (M->order >= 2)
+    for (i = 0; i < 6; i++)
+      for (j = 0; j < 6; j++)
+        appendDoubles(coef, nCoef, maxCoef, M->T[i][j], j + 1);
+  if (M->order >= 3)
+    for (i = 0; i < 6; i++)
+      for (j = 0; j < 6; j++)
+        for (k = 0; k <= j; k++)
+          appendDoubles(coef, nCoef, maxCoef, M->Q[i][j][k], k + 1);
+}
+
 void copy_matrices1(VMATRIX *M1, VMATRIX *M0) {
   register long i, j, k, l;
 
@@ -261,6 +261,10 @@ void correction_setup(
   _correct->CMFx->T = _correct->CMFy->T = NULL;
   _correct->CMFx->C = _correct->CMFy->C = NULL;
   _correct->CMFx->Cp = _correct->CMFy->Cp = NULL;
+  _correct->CMFx->Csaved = _correct->CMFy->Csaved = NULL;
+  _correct->CMFx->Tsaved = _correct->CMFy->Tsaved = NULL;
+  _correct->CMFx->weightSaved = _correct->CMFy->weightSaved = NULL;
+  _correct->CMFx->response_reuse_tolerance = _correct->CMFy->response_reuse_tolerance = response_reuse_tolerance;
   _correct->CMFx->bpmPlane = _correct->CMFx->corrPlane = 0;
   _correct->CMFy->bpmPlane = _correct->CMFy->corrPlane = 1;
 
@@ -478,6 +482,12 @@ void clean_up_CM(CORMON_DATA *CM, short full) {
       matrix_free(CM->T);
     if (CM->C)
       matrix_free(CM->C);
+    if (CM->Csaved)
+      matrix_free(CM->Csaved);
+    if (CM->Tsaved)
+      matrix_free(CM->Tsaved);
+    if (CM->weightSaved)
+      tfree(CM->weightSaved);
     if (CM->kick)
       free_czarray_2d((void **)CM->kick, CM->n_iterations + 1, CM->ncor);
     if (full) {
@@ -1373,6 +1383,76 @@ long do_correction(CORRECTION *correct, RUN *run, LINE_LIST *beamline, double *s
   return (!bombed);
 }
 
+/* Invert the response matrix CM->C, reusing the previous inverse if the response matrix
+ * and the inversion settings are unchanged. With use_perturbed_matrix=1 the response matrix
+ * is recomputed for every error seed and correction step but often changes little or not at
+ * all, so the SVD, which dominates the time for large rings, can be skipped. The response
+ * matrix is considered unchanged if no element differs from the saved one by more than
+ * response_reuse_tolerance times the largest saved element (negative disables reuse).
+ * A positive tolerance means the inverse of a slightly different matrix may be applied; a
+ * warning is issued whenever that happens. The inverse is not updated (e.g., by a low-rank
+ * correction), so only the default of 0 leaves the correction exact.
+ */
+static MAT *invertResponseMatrix(CORMON_DATA *CM, double *conditionNumber) {
+  long i, n;
+  double maxC, maxDelta;
+
+  n = CM->C->m * CM->C->n;
+  if (CM->Tsaved && CM->response_reuse_tolerance >= 0 &&
+      CM->Csaved->m == CM->C->m && CM->Csaved->n == CM->C->n &&
+      CM->equalWSaved == CM->equalW &&
+      CM->SVsSaved[0] == CM->keep_largest_SVs && CM->SVsSaved[1] == CM->remove_smallest_SVs &&
+      CM->SVsSaved[2] == CM->Tikhonov_n &&
+      CM->SVsRatioSaved[0] == CM->minimum_SV_ratio && CM->SVsRatioSaved[1] == CM->Tikhonov_relative_alpha) {
+    for (i = 0; i < CM->C->m; i++)
+      if (CM->weightSaved[i] != CM->weight[i])
+        break;
+    if (i == CM->C->m) {
+      maxC = maxDelta = 0;
+      for (i = 0; i < n; i++) {
+        if (fabs(CM->Csaved->base[i]) > maxC)
+          maxC = fabs(CM->Csaved->base[i]);
+        if (fabs(CM->C->base[i] - CM->Csaved->base[i]) > maxDelta)
+          maxDelta = fabs(CM->C->base[i] - CM->Csaved->base[i]);
+      }
+      if (maxDelta <= CM->response_reuse_tolerance * maxC) {
+        if (maxDelta) {
+          char warningText[1024];
+          snprintf(warningText, 1024, "Largest change is %le relative to the largest element; response_reuse_tolerance is %le.",
+                   maxC ? maxDelta / maxC : maxDelta, CM->response_reuse_tolerance);
+          printWarning("correct: using stale inverse of changed response matrix.", warningText);
+        }
+        *conditionNumber = CM->conditionNumberSaved;
+        return matrix_copy(CM->Tsaved);
+      }
+    }
+  }
+
+  if (CM->Csaved)
+    matrix_free(CM->Csaved);
+  if (CM->Tsaved)
+    matrix_free(CM->Tsaved);
+  CM->Csaved = CM->Tsaved = NULL;
+  if (CM->response_reuse_tolerance < 0)
+    return matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
+                         CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
+                         0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, conditionNumber);
+  CM->Tsaved = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
+                             CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
+                             0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, conditionNumber);
+  CM->Csaved = matrix_copy(CM->C);
+  CM->weightSaved = trealloc(CM->weightSaved, sizeof(*CM->weightSaved) * CM->C->m);
+  memcpy(CM->weightSaved, CM->weight, sizeof(*CM->weightSaved) * CM->C->m);
+  CM->equalWSaved = CM->equalW;
+  CM->SVsSaved[0] = CM->keep_largest_SVs;
+  CM->SVsSaved[1] = CM->remove_smallest_SVs;
+  CM->SVsSaved[2] = CM->Tikhonov_n;
+  CM->SVsRatioSaved[0] = CM->minimum_SV_ratio;
+  CM->SVsRatioSaved[1] = CM->Tikhonov_relative_alpha;
+  CM->conditionNumberSaved = *conditionNumber;
+  return matrix_copy(CM->Tsaved);
+}
+
 void compute_trajcor_matrices(CORMON_DATA *CM, STEERING_LIST *SL, long coord, RUN *run, LINE_LIST *beamline, unsigned long flags,
                               short rpn_store_response_matrix) {
   ELEMENT_LIST *corr;
@@ -1600,9 +1680,7 @@ void compute_trajcor_matrices(CORMON_DATA *CM, STEERING_LIST *SL, long coord, RU
       printf("Removing %ld smallest singular values to prevent instability\n", (long)CM->remove_smallest_SVs);
     }
 
-    CM->T = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
-                          CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n, 
-                          0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &conditionNumber);
+    CM->T = invertResponseMatrix(CM, &conditionNumber);
     matrix_scmul(CM->T, -1);
 
     if (!(flags & COMPUTE_RESPONSE_SILENT)) {
@@ -2626,9 +2704,7 @@ void compute_orbcor_matrices(CORMON_DATA *CM, STEERING_LIST *SL, long coord, RUN
       CM->remove_smallest_SVs = CM->C->n - CM->C->m;
       printf("Removing %ld smallest singular values to prevent instability\n", (long)CM->remove_smallest_SVs);
     }
-    CM->T = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
-                          CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
-                          0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &conditionNumber);
+    CM->T = invertResponseMatrix(CM, &conditionNumber);
     matrix_scmul(CM->T, -1);
 
     if (!(flags & COMPUTE_RESPONSE_SILENT)) {
@@ -2863,9 +2939,7 @@ void compute_orbcor_matrices1(CORRECTION *_correct, long coord, RUN *run, LINE_L
       CM->remove_smallest_SVs = CM->C->n - CM->C->m;
       printf("Removing %ld smallest singular values to prevent instability\n", (long)CM->remove_smallest_SVs);
     }
-    CM->T = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
-                          CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
-                          0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &conditionNumber);
+    CM->T = invertResponseMatrix(CM, &conditionNumber);
     matrix_scmul(CM->T, -1);
     
     if (!(flags & COMPUTE_RESPONSE_SILENT)) {
@@ -3289,9 +3363,7 @@ void compute_orbcor_matrices1p(CORRECTION *_correct, RUN *run, LINE_LIST *beamli
         CM->remove_smallest_SVs = CM->C->n - CM->C->m;
         printf("Removing %ld smallest singular values to prevent instability\n", (long)CM->remove_smallest_SVs);
       }
-      CM->T = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
-                            CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
-                            0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &conditionNumber);
+      CM->T = invertResponseMatrix(CM, &conditionNumber);
       matrix_scmul(CM->T, -1);
       
       if (!(flags & COMPUTE_RESPONSE_SILENT)) {
@@ -3815,14 +3887,14 @@ long find_index(long key, long *list, long n_listed) {
 double noise_value(double xamplitude, double xcutoff, long xerror_type) {
   switch (xerror_type) {
   case UNIFORM_ERRORS:
-    return (2 * xamplitude * (random_3(0) - 0.5));
+    return (2 * xamplitude * (random_3_elegant(0) - 0.5));
   case GAUSSIAN_ERRORS:
-    return (gauss_rn_lim(0.0, xamplitude, xcutoff, random_3));
+    return (gauss_rn_lim_elegant(0.0, xamplitude, xcutoff, random_3_elegant));
   case PLUS_OR_MINUS_ERRORS:
     /* return a number on [-x-1, x-1]), which is added to 1 in the calling routine
              * (since these are implemented as fractional errors)
              */
-    return (xamplitude * (random_3(0) > 0.5 ? 1.0 : -1.0) - 1);
+    return (xamplitude * (random_3_elegant(0) > 0.5 ? 1.0 : -1.0) - 1);
   default:
     bombElegant("unknown error type in perturbation()", NULL);
     exitElegant(1);
@@ -4163,6 +4235,8 @@ void copy_CM_structure(CORMON_DATA *CMA, CORMON_DATA *CM) {
   memcpy(CMA, CM, sizeof(*CMA));
   CMA->C = NULL;
   CMA->T = NULL;
+  CMA->Csaved = CMA->Tsaved = NULL;
+  CMA->weightSaved = NULL;
 
   CMA->ucorr = NULL;
   CMA->kick = NULL;
@@ -4385,9 +4459,7 @@ void compute_coupled_trajcor_matrices(
       printf("Removing %ld smallest singular values to prevent instability\n", (long)CM->remove_smallest_SVs);
     }
 
-    CM->T = matrix_invert(CM->C, CM->equalW ? NULL : CM->weight, (int32_t)CM->keep_largest_SVs, (int32_t)CM->remove_smallest_SVs,
-                          CM->minimum_SV_ratio, CM->Tikhonov_relative_alpha, CM->Tikhonov_n,
-                          0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &conditionNumber);
+    CM->T = invertResponseMatrix(CM, &conditionNumber);
     matrix_scmul(CM->T, -1);
 
     if (!(flags & COMPUTE_RESPONSE_SILENT)) {
@@ -49,6 +49,7 @@
     double closed_orbit_multiplier_interval = 5;
     long closed_orbit_tracking_turns = 0;
     long use_perturbed_matrix = 0;
+    double response_reuse_tolerance = 0;
     long use_response_from_computed_orbits = 0;
     long rpn_store_response_matrix = 0;
 #end
@@ -47,6 +47,13 @@ typedef struct {
     /* Cp is the slope response. Not used for correction but useful for output. */
     /* Mij(Cp, i, j) = dX'(monitor i)/dK(corrector j) */
     MAT *Cp;
+    /* last response matrix inverted, its inverse, and the settings used, for reuse of the inverse */
+    MAT *Csaved, *Tsaved;
+    double *weightSaved, conditionNumberSaved;
+    short equalWSaved;
+    long SVsSaved[3];
+    double SVsRatioSaved[2];
+    double response_reuse_tolerance;
     /* information about last correction */
     long n_cycles_done;
     /* at present these are used only for response matrix for cross-plane correction */
@@ -128,6 +128,11 @@ void setup_coupled_twiss_output(
   initialized = 1;
 }
 
+/* returns non-zero if run_coupled_twiss_output() needs the radiation integrals */
+long coupledTwissUsesRadiationIntegrals() {
+  return initialized && emittances_from_twiss_command;
+}
+
 int run_coupled_twiss_output(RUN *run, LINE_LIST *beamline, double *starting_coord) {
   char JOBVL, JOBVR;
   int N, LDA, LDVL, LDVR, lwork, info, i, j, k;
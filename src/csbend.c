@@ -662,7 +662,8 @@ long track_through_csbend(double **part, long n_part, CSBEND *csbend, double p_e
                           long iSlice,
                           ELEMENT_LIST *eptr) {
   double h;
-  long i_part, i_top, particle_lost, j;
+  long i_part, i_top, i_lost, nLeft, nThreads, particle_lost, j;
+  short *lost;
   double rho, s, Fx, Fy;
   double x, xp, y, yp, dp, dp0;
   double n, fse, dp_prime;
@@ -1085,322 +1086,358 @@ long track_through_csbend(double **part, long n_part, CSBEND *csbend, double p_e
   if (sigmaDelta2)
     *sigmaDelta2 = 0;
 
-  for (i_part = 0; i_part <= i_top; i_part++) {
-    if (!part) {
-      printf("error: null particle array found (working on particle %ld) (track_through_csbend)\n", i_part);
-      fflush(stdout);
-      abort();
-    }
-    if (!(coord = part[i_part])) {
-      printf("error: null coordinate pointer for particle %ld (track_through_csbend)\n", i_part);
-      fflush(stdout);
-      abort();
-    }
-    if (accepted && !accepted[i_part]) {
-      printf("error: null accepted particle pointer for particle %ld (track_through_csbend)\n", i_part);
-      fflush(stdout);
-      abort();
-    }
-
-    if (csbend->malignMethod == 0 && iSlice <= 0) {
-      coord[4] += dzi * sqrt(1 + sqr(coord[1]) + sqr(coord[3]));
-      coord[0] = coord[0] + dxi + dzi * coord[1];
-      coord[2] = coord[2] + dyi + dzi * coord[3];
-
-      x = coord[0] * cos_ttilt + coord[2] * sin_ttilt;
-      y = -coord[0] * sin_ttilt + coord[2] * cos_ttilt;
-      xp = coord[1] * cos_ttilt + coord[3] * sin_ttilt;
-      yp = -coord[1] * sin_ttilt + coord[3] * cos_ttilt;
-      s = coord[4];
-      dp = dp0 = coord[5];
-    } else {
-      x = coord[0];
-      y = coord[2];
-      xp = coord[1];
-      yp = coord[3];
-      s = coord[4];
-      dp = dp0 = coord[5];
-    }
-
-    if (iSlice <= 0) {
-      if (csbend->edgeFlags & BEND_EDGE1_EFFECTS) {
-        if (csbend->edge_order <= 1 && csbend->edge_effects[csbend->e1Index] == 1) {
-          /* apply edge focusing, nonsymplectic method */
-          rho = (1 + dp) * rho_actual;
-          delta_xp = tan(e1) / rho * x;
-          if (e1_kick_limit > 0 && fabs(delta_xp) > e1_kick_limit)
-            delta_xp = SIGN(delta_xp) * e1_kick_limit;
-          xp += delta_xp;
-          yp -= tan(e1 - psi1 / (1 + dp)) / rho * y;
-        } else if (csbend->edge_order >= 2 && csbend->edge_effects[csbend->e1Index] == 1) {
-          /* apply edge focusing, nonsymplectic method */
-          rho = (1 + dp) * rho_actual;
-          apply_edge_effects(&x, &xp, &y, &yp, rho, n, e1, he1, psi1 * (1 + dp), -1);
-        } else if (csbend->edge_effects[csbend->e1Index] == 2) {
-          /* K. Hwang's approach */
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          dipoleFringeKHwang(Qf, Qi, rho_actual, -1., csbend->edge_order, csbend->b[1] / rho0, e1, 2 * csbend->hgap,
-                             csbend->fint[csbend->e1Index] >= 0 ? csbend->fint[csbend->e1Index] : csbend->fintBoth,
-                             csbend->h[csbend->e1Index]);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-          x = Qf[0];
-          xp = Qf[1];
-          y = Qf[2];
-          yp = Qf[3];
-          dp = Qf[5];
-        } else if (csbend->edge_effects[csbend->e1Index] == 3) {
-          /* simple-minded symplectic approach */
-          applySimpleDipoleEdgeKick(&xp, &yp, x, y, dp, rho_actual, e1, psi1, e1_kick_limit, csbend->expandHamiltonian);
-        } else if (csbend->edge_effects[csbend->e1Index] == 4) {
-          /* K. Hwang's approach as symplectified by R. Lindberg */
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          dipoleFringeKHwangRLindberg(Qf, Qi, rho_actual, -1., csbend->b[1] / rho0, e1,
-                                      2 * csbend->hgap,
-                                      csbend->fint[csbend->e1Index] >= 0 ? csbend->fint[csbend->e1Index] : csbend->fintBoth,
-                                      csbend->h[csbend->e1Index]);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-          x = Qf[0];
-          xp = Qf[1];
-          y = Qf[2];
-          yp = Qf[3];
-          dp = Qf[5];
-        } else if (csbend->edge_effects[csbend->e1Index] == 5) {
-          /* New curved dipole treatment by R. Lindberg */
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          curvedDipoleFringe(Qf, Qi, rho_actual, -1, csbend->edge_order, csbend->b[1] / rho0, e1,
-                             csbend->fringeInt[csbend->e1Index], csbend->edgeFlip);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-          x = Qf[0];
-          xp = Qf[1];
-          y = Qf[2];
-          yp = Qf[3];
-          s += Qf[4];
-          dp = Qf[5];
-        }
+  /* Random-number draws, radiation statistics, and reference-trajectory recording
+   * depend on particle order, so those cases are always tracked on one thread.
+   */
+  lost = NULL;
+  if ((nThreads = particleThreadsToUse(n_part)) > 1 &&
+      (rad_coef || isrConstant || sigmaDelta2 || distributionBasedRadiation || csbend->photonOutputFile ||
+       refTrajectoryMode == RECORD_TRAJECTORY))
+    nThreads = 1;
+  if (nThreads > 1)
+    lost = tmalloc(sizeof(*lost) * n_part);
+
+#if defined(_OPENMP)
+#  pragma omp parallel num_threads(nThreads) if (nThreads > 1) private(i_part, i_top, i_lost, particle_lost, rho, s, Fx, Fy, x, xp, y, yp, dp, dp0, dp_prime, coord, dz_lost, Qi, Qf, delta_xp)
+#endif
+  {
+    long i_first;
+    particleThreadRange(n_part, &i_first, &i_top);
+    for (i_part = i_first; i_part <= i_top; i_part++) {
+      if (!part) {
+        printf("error: null particle array found (working on particle %ld) (track_through_csbend)\n", i_part);
+        fflush(stdout);
+        abort();
       }
-    }
-
-    /* load input coordinates into arrays */
-    Qi[0] = x;
-    Qi[1] = xp;
-    Qi[2] = y;
-    Qi[3] = yp;
-    Qi[4] = 0;
-    Qi[5] = dp;
-
-    if (iSlice <= 0) {
-      if (csbend->edgeFlags & BEND_EDGE1_EFFECTS && e1 != 0 && rad_coef) {
-        /* pre-adjust dp/p to anticipate error made by integrating over entire sector */
-        computeCSBENDFields(&Fx, &Fy, x, y);
-
-        dp_prime = -rad_coef * (sqr(Fx) + sqr(Fy)) * sqr(1 + dp) * sqrt(sqr(1 + x / rho0) + sqr(xp) + sqr(yp));
-        Qi[5] -= dp_prime * x * tan(e1);
+      if (!(coord = part[i_part])) {
+        printf("error: null coordinate pointer for particle %ld (track_through_csbend)\n", i_part);
+        fflush(stdout);
+        abort();
       }
-
-      convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-    }
-
-    if (csbend->expandHamiltonian)
-      particle_lost = !integrate_csbend_ordn_expanded(Qf, Qi, sigmaDelta2, csbend->length, csbend->nSlices, iSlice, rho0, Po, &dz_lost,
-                                                      &apertureData, csbend->integration_order, eptr);
-    else
-      particle_lost = !integrate_csbend_ordn(Qf, Qi, sigmaDelta2, csbend->length, csbend->nSlices, iSlice, rho0, Po, &dz_lost,
-                                             &apertureData, csbend->integration_order, eptr);
-
-    if (iSlice < 0 || iSlice == (csbend->nSlices - 1) || particle_lost) {
-      if (csbend->fseCorrection == 1)
-        Qf[4] -= csbend->fseCorrectionPathError;
-      convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-    }
-
-    if (particle_lost) {
-      if (!part[i_top]) {
-        printf("error: couldn't swap particles %ld and %ld--latter is null pointer (track_through_csbend)\n",
-               i_part, i_top);
+      if (accepted && !accepted[i_part]) {
+        printf("error: null accepted particle pointer for particle %ld (track_through_csbend)\n", i_part);
         fflush(stdout);
         abort();
       }
-      memcpy(part[i_part], Qf, sizeof(part[i_part][0]) * 6);
-      convertFromCSBendCoords(part + i_part, 1, rho0, cos_ttilt, sin_ttilt, 0);
-      swapParticles(part[i_part], part[i_top]);
-      if (accepted) {
-        if (!accepted[i_top]) {
-          printf(
-            "error: couldn't swap acceptance data for particles %ld and %ld--latter is null pointer (track_through_csbend)\n",
-            i_part, i_top);
-          fflush(stdout);
-          abort();
+      if (lost)
+        lost[i_part] = 0;
+
+      if (csbend->malignMethod == 0 && iSlice <= 0) {
+        coord[4] += dzi * sqrt(1 + sqr(coord[1]) + sqr(coord[3]));
+        coord[0] = coord[0] + dxi + dzi * coord[1];
+        coord[2] = coord[2] + dyi + dzi * coord[3];
+
+        x = coord[0] * cos_ttilt + coord[2] * sin_ttilt;
+        y = -coord[0] * sin_ttilt + coord[2] * cos_ttilt;
+        xp = coord[1] * cos_ttilt + coord[3] * sin_ttilt;
+        yp = -coord[1] * sin_ttilt + coord[3] * cos_ttilt;
+        s = coord[4];
+        dp = dp0 = coord[5];
+      } else {
+        x = coord[0];
+        y = coord[2];
+        xp = coord[1];
+        yp = coord[3];
+        s = coord[4];
+        dp = dp0 = coord[5];
+      }
+
+      if (iSlice <= 0) {
+        if (csbend->edgeFlags & BEND_EDGE1_EFFECTS) {
+          if (csbend->edge_order <= 1 && csbend->edge_effects[csbend->e1Index] == 1) {
+            /* apply edge focusing, nonsymplectic method */
+            rho = (1 + dp) * rho_actual;
+            delta_xp = tan(e1) / rho * x;
+            if (e1_kick_limit > 0 && fabs(delta_xp) > e1_kick_limit)
+              delta_xp = SIGN(delta_xp) * e1_kick_limit;
+            xp += delta_xp;
+            yp -= tan(e1 - psi1 / (1 + dp)) / rho * y;
+          } else if (csbend->edge_order >= 2 && csbend->edge_effects[csbend->e1Index] == 1) {
+            /* apply edge focusing, nonsymplectic method */
+            rho = (1 + dp) * rho_actual;
+            apply_edge_effects(&x, &xp, &y, &yp, rho, n, e1, he1, psi1 * (1 + dp), -1);
+          } else if (csbend->edge_effects[csbend->e1Index] == 2) {
+            /* K. Hwang's approach */
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            dipoleFringeKHwang(Qf, Qi, rho_actual, -1., csbend->edge_order, csbend->b[1] / rho0, e1, 2 * csbend->hgap,
+                               csbend->fint[csbend->e1Index] >= 0 ? csbend->fint[csbend->e1Index] : csbend->fintBoth,
+                               csbend->h[csbend->e1Index]);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            dp = Qf[5];
+          } else if (csbend->edge_effects[csbend->e1Index] == 3) {
+            /* simple-minded symplectic approach */
+            applySimpleDipoleEdgeKick(&xp, &yp, x, y, dp, rho_actual, e1, psi1, e1_kick_limit, csbend->expandHamiltonian);
+          } else if (csbend->edge_effects[csbend->e1Index] == 4) {
+            /* K. Hwang's approach as symplectified by R. Lindberg */
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            dipoleFringeKHwangRLindberg(Qf, Qi, rho_actual, -1., csbend->b[1] / rho0, e1,
+                                        2 * csbend->hgap,
+                                        csbend->fint[csbend->e1Index] >= 0 ? csbend->fint[csbend->e1Index] : csbend->fintBoth,
+                                        csbend->h[csbend->e1Index]);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            dp = Qf[5];
+          } else if (csbend->edge_effects[csbend->e1Index] == 5) {
+            /* New curved dipole treatment by R. Lindberg */
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            curvedDipoleFringe(Qf, Qi, rho_actual, -1, csbend->edge_order, csbend->b[1] / rho0, e1,
+                               csbend->fringeInt[csbend->e1Index], csbend->edgeFlip);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            s += Qf[4];
+            dp = Qf[5];
+          }
         }
-        swapParticles(accepted[i_part], accepted[i_top]);
       }
-      part[i_top][4] = z_start + dz_lost;
-      part[i_top][5] = Po * (1 + part[i_top][5]);
-      if (globalLossCoordOffset > 0)
-        memcpy(part[i_top] + globalLossCoordOffset, Qf + globalLossCoordOffset, sizeof(double) * GLOBAL_LOSS_PROPERTIES_PER_PARTICLE);
-      i_top--;
-      i_part--;
-      continue;
-    }
 
-    if (iSlice < 0 || iSlice == (csbend->nSlices - 1)) {
-      if (csbend->edgeFlags & BEND_EDGE2_EFFECTS && e2 != 0 && rad_coef) {
-        /* post-adjust dp/p to correct error made by integrating over entire sector */
-        x = Qf[0];
-        xp = Qf[1];
-        y = Qf[2];
-        yp = Qf[3];
-        dp = Qf[5];
+      /* load input coordinates into arrays */
+      Qi[0] = x;
+      Qi[1] = xp;
+      Qi[2] = y;
+      Qi[3] = yp;
+      Qi[4] = 0;
+      Qi[5] = dp;
+
+      if (iSlice <= 0) {
+        if (csbend->edgeFlags & BEND_EDGE1_EFFECTS && e1 != 0 && rad_coef) {
+          /* pre-adjust dp/p to anticipate error made by integrating over entire sector */
+          computeCSBENDFields(&Fx, &Fy, x, y);
+
+          dp_prime = -rad_coef * (sqr(Fx) + sqr(Fy)) * sqr(1 + dp) * sqrt(sqr(1 + x / rho0) + sqr(xp) + sqr(yp));
+          Qi[5] -= dp_prime * x * tan(e1);
+        }
+
+        convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+      }
 
-        computeCSBENDFields(&Fx, &Fy, x, y);
+      if (csbend->expandHamiltonian)
+        particle_lost = !integrate_csbend_ordn_expanded(Qf, Qi, sigmaDelta2, csbend->length, csbend->nSlices, iSlice, rho0, Po, &dz_lost,
+                                                        &apertureData, csbend->integration_order, eptr);
+      else
+        particle_lost = !integrate_csbend_ordn(Qf, Qi, sigmaDelta2, csbend->length, csbend->nSlices, iSlice, rho0, Po, &dz_lost,
+                                               &apertureData, csbend->integration_order, eptr);
 
-        dp_prime = -rad_coef * (sqr(Fx) + sqr(Fy)) * sqr(1 + dp) * sqrt(sqr(1 + x / rho0) + sqr(xp) + sqr(yp));
-        Qf[5] -= dp_prime * x * tan(e2);
+      if (iSlice < 0 || iSlice == (csbend->nSlices - 1) || particle_lost) {
+        if (csbend->fseCorrection == 1)
+          Qf[4] -= csbend->fseCorrectionPathError;
+        convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
       }
 
-      /* get final coordinates */
-      if (rad_coef || isrConstant) {
-        double p0, p1;
-        double beta0, beta1;
-        /* fix previous distance information to reflect new velocity--since distance
-         * is really time-of-flight at the current velocity 
-         */
-        p0 = Po * (1 + dp0);
-        beta0 = p0 / sqrt(sqr(p0) + 1);
-        p1 = Po * (1 + Qf[5]);
-        beta1 = p1 / sqrt(sqr(p1) + 1);
-        s = beta1 * s / beta0 + Qf[4];
-      } else
-        s += Qf[4];
-    } else
-      s += Qf[4];
-    x = Qf[0];
-    xp = Qf[1];
-    y = Qf[2];
-    yp = Qf[3];
-    dp = Qf[5];
-
-    if (iSlice < 0 || iSlice == (csbend->nSlices - 1)) {
-      if (csbend->edgeFlags & BEND_EDGE2_EFFECTS) {
-        /* apply edge focusing */
-        if (csbend->edge_order <= 1 && csbend->edge_effects[csbend->e2Index] == 1) {
-          rho = (1 + dp) * rho_actual;
-          delta_xp = tan(e2) / rho * x;
-          if (e2_kick_limit > 0 && fabs(delta_xp) > e2_kick_limit)
-            delta_xp = SIGN(delta_xp) * e2_kick_limit;
-          xp += delta_xp;
-          yp -= tan(e2 - psi2 / (1 + dp)) / rho * y;
-        } else if (csbend->edge_order >= 2 && csbend->edge_effects[csbend->e2Index] == 1) {
-          rho = (1 + dp) * rho_actual;
-          apply_edge_effects(&x, &xp, &y, &yp, rho, n, e2, he2, psi2 * (1 + dp), 1);
-        } else if (csbend->edge_effects[csbend->e2Index] == 2) {
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          dipoleFringeKHwang(Qf, Qi, rho_actual, 1., csbend->edge_order, csbend->b[1] / rho0, e2, 2 * csbend->hgap,
-                             csbend->fint[csbend->e2Index] >= 0 ? csbend->fint[csbend->e2Index] : csbend->fintBoth,
-                             csbend->h[csbend->e2Index]);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-          x = Qf[0];
-          xp = Qf[1];
-          y = Qf[2];
-          yp = Qf[3];
-          dp = Qf[5];
-        } else if (csbend->edge_effects[csbend->e2Index] == 3) {
-          applySimpleDipoleEdgeKick(&xp, &yp, x, y, dp, rho_actual, e2, psi2, e2_kick_limit, csbend->expandHamiltonian);
-        } else if (csbend->edge_effects[csbend->e2Index] == 4) {
-          /* K. Hwang's approach as symplectified by R. Lindberg */
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          dipoleFringeKHwangRLindberg(Qf, Qi, rho_actual, 1., csbend->b[1] / rho0, e2, 2 * csbend->hgap,
-                                      csbend->fint[csbend->e2Index] >= 0 ? csbend->fint[csbend->e2Index] : csbend->fintBoth,
-                                      csbend->h[csbend->e2Index]);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+      if (particle_lost) {
+        memcpy(part[i_part], Qf, sizeof(part[i_part][0]) * 6);
+        convertFromCSBendCoords(part + i_part, 1, rho0, cos_ttilt, sin_ttilt, 0);
+        if (lost) {
+          /* record the loss in place; compactLostParticles() moves it later */
+          lost[i_part] = 1;
+          i_lost = i_part;
+        } else {
+          if (!part[i_top]) {
+            printf("error: couldn't swap particles %ld and %ld--latter is null pointer (track_through_csbend)\n",
+                   i_part, i_top);
+            fflush(stdout);
+            abort();
+          }
+          swapParticles(part[i_part], part[i_top]);
+          if (accepted) {
+            if (!accepted[i_top]) {
+              printf(
+                "error: couldn't swap acceptance data for particles %ld and %ld--latter is null pointer (track_through_csbend)\n",
+                i_part, i_top);
+              fflush(stdout);
+              abort();
+            }
+            swapParticles(accepted[i_part], accepted[i_top]);
+          }
+          i_lost = i_top;
+        }
+        part[i_lost][4] = z_start + dz_lost;
+        part[i_lost][5] = Po * (1 + part[i_lost][5]);
+        if (globalLossCoordOffset > 0)
+          memcpy(part[i_lost] + globalLossCoordOffset, Qf + globalLossCoordOffset, sizeof(double) * GLOBAL_LOSS_PROPERTIES_PER_PARTICLE);
+        if (!lost) {
+          i_top--;
+          i_part--;
+        }
+        continue;
+      }
+
+      if (iSlice < 0 || iSlice == (csbend->nSlices - 1)) {
+        if (csbend->edgeFlags & BEND_EDGE2_EFFECTS && e2 != 0 && rad_coef) {
+          /* post-adjust dp/p to correct error made by integrating over entire sector */
           x = Qf[0];
           xp = Qf[1];
           y = Qf[2];
           yp = Qf[3];
           dp = Qf[5];
-        } else if (csbend->edge_effects[csbend->e2Index] == 5) {
-          /* New curved dipole treatment by R. Lindberg */
-          /* load input coordinates into arrays */
-          Qi[0] = x;
-          Qi[1] = xp;
-          Qi[2] = y;
-          Qi[3] = yp;
-          Qi[4] = 0;
-          Qi[5] = dp;
-          convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
-          curvedDipoleFringe(Qf, Qi, rho_actual, 1, csbend->edge_order, csbend->b[1] / rho0, e2,
-                             csbend->fringeInt[csbend->e2Index], csbend->edgeFlip);
-          /* retrieve coordinates from arrays */
-          convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
-          x = Qf[0];
-          xp = Qf[1];
-          y = Qf[2];
-          yp = Qf[3];
+
+          computeCSBENDFields(&Fx, &Fy, x, y);
+
+          dp_prime = -rad_coef * (sqr(Fx) + sqr(Fy)) * sqr(1 + dp) * sqrt(sqr(1 + x / rho0) + sqr(xp) + sqr(yp));
+          Qf[5] -= dp_prime * x * tan(e2);
+        }
+
+        /* get final coordinates */
+        if (rad_coef || isrConstant) {
+          double p0, p1;
+          double beta0, beta1;
+          /* fix previous distance information to reflect new velocity--since distance
+           * is really time-of-flight at the current velocity 
+           */
+          p0 = Po * (1 + dp0);
+          beta0 = p0 / sqrt(sqr(p0) + 1);
+          p1 = Po * (1 + Qf[5]);
+          beta1 = p1 / sqrt(sqr(p1) + 1);
+          s = beta1 * s / beta0 + Qf[4];
+        } else
           s += Qf[4];
-          dp = Qf[5];
+      } else
+        s += Qf[4];
+      x = Qf[0];
+      xp = Qf[1];
+      y = Qf[2];
+      yp = Qf[3];
+      dp = Qf[5];
+
+      if (iSlice < 0 || iSlice == (csbend->nSlices - 1)) {
+        if (csbend->edgeFlags & BEND_EDGE2_EFFECTS) {
+          /* apply edge focusing */
+          if (csbend->edge_order <= 1 && csbend->edge_effects[csbend->e2Index] == 1) {
+            rho = (1 + dp) * rho_actual;
+            delta_xp = tan(e2) / rho * x;
+            if (e2_kick_limit > 0 && fabs(delta_xp) > e2_kick_limit)
+              delta_xp = SIGN(delta_xp) * e2_kick_limit;
+            xp += delta_xp;
+            yp -= tan(e2 - psi2 / (1 + dp)) / rho * y;
+          } else if (csbend->edge_order >= 2 && csbend->edge_effects[csbend->e2Index] == 1) {
+            rho = (1 + dp) * rho_actual;
+            apply_edge_effects(&x, &xp, &y, &yp, rho, n, e2, he2, psi2 * (1 + dp), 1);
+          } else if (csbend->edge_effects[csbend->e2Index] == 2) {
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            dipoleFringeKHwang(Qf, Qi, rho_actual, 1., csbend->edge_order, csbend->b[1] / rho0, e2, 2 * csbend->hgap,
+                               csbend->fint[csbend->e2Index] >= 0 ? csbend->fint[csbend->e2Index] : csbend->fintBoth,
+                               csbend->h[csbend->e2Index]);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            dp = Qf[5];
+          } else if (csbend->edge_effects[csbend->e2Index] == 3) {
+            applySimpleDipoleEdgeKick(&xp, &yp, x, y, dp, rho_actual, e2, psi2, e2_kick_limit, csbend->expandHamiltonian);
+          } else if (csbend->edge_effects[csbend->e2Index] == 4) {
+            /* K. Hwang's approach as symplectified by R. Lindberg */
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            dipoleFringeKHwangRLindberg(Qf, Qi, rho_actual, 1., csbend->b[1] / rho0, e2, 2 * csbend->hgap,
+                                        csbend->fint[csbend->e2Index] >= 0 ? csbend->fint[csbend->e2Index] : csbend->fintBoth,
+                                        csbend->h[csbend->e2Index]);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            dp = Qf[5];
+          } else if (csbend->edge_effects[csbend->e2Index] == 5) {
+            /* New curved dipole treatment by R. Lindberg */
+            /* load input coordinates into arrays */
+            Qi[0] = x;
+            Qi[1] = xp;
+            Qi[2] = y;
+            Qi[3] = yp;
+            Qi[4] = 0;
+            Qi[5] = dp;
+            convertToDipoleCanonicalCoordinates(Qi, csbend->expandHamiltonian);
+            curvedDipoleFringe(Qf, Qi, rho_actual, 1, csbend->edge_order, csbend->b[1] / rho0, e2,
+                               csbend->fringeInt[csbend->e2Index], csbend->edgeFlip);
+            /* retrieve coordinates from arrays */
+            convertFromDipoleCanonicalCoordinates(Qf, csbend->expandHamiltonian);
+            x = Qf[0];
+            xp = Qf[1];
+            y = Qf[2];
+            yp = Qf[3];
+            s += Qf[4];
+            dp = Qf[5];
+          }
         }
       }
-    }
-
-    if (csbend->malignMethod == 0 && (iSlice < 0 || iSlice == (csbend->nSlices - 1))) {
-      coord[0] = x * cos_ttilt - y * sin_ttilt + dcoord_etilt[0];
-      coord[2] = x * sin_ttilt + y * cos_ttilt + dcoord_etilt[2];
-      coord[1] = xp * cos_ttilt - yp * sin_ttilt + dcoord_etilt[1];
-      coord[3] = xp * sin_ttilt + yp * cos_ttilt + dcoord_etilt[3];
-      coord[4] = s + dcoord_etilt[4];
-      coord[5] = dp;
 
-      coord[0] += dxf + dzf * coord[1];
-      coord[2] += dyf + dzf * coord[3];
-      coord[4] += dzf * sqrt(1 + sqr(coord[1]) + sqr(coord[3]));
-    } else {
-      coord[0] = x;
-      coord[2] = y;
-      coord[1] = xp;
-      coord[3] = yp;
-      coord[4] = s;
-      coord[5] = dp;
+      if (csbend->malignMethod == 0 && (iSlice < 0 || iSlice == (csbend->nSlices - 1))) {
+        coord[0] = x * cos_ttilt - y * sin_ttilt + dcoord_etilt[0];
+        coord[2] = x * sin_ttilt + y * cos_ttilt + dcoord_etilt[2];
+        coord[1] = xp * cos_ttilt - yp * sin_ttilt + dcoord_etilt[1];
+        coord[3] = xp * sin_ttilt + yp * cos_ttilt + dcoord_etilt[3];
+        coord[4] = s + dcoord_etilt[4];
+        coord[5] = dp;
+
+        coord[0] += dxf + dzf * coord[1];
+        coord[2] += dyf + dzf * coord[3];
+        coord[4] += dzf * sqrt(1 + sqr(coord[1]) + sqr(coord[3]));
+      } else {
+        coord[0] = x;
+        coord[2] = y;
+        coord[1] = xp;
+        coord[3] = yp;
+        coord[4] = s;
+        coord[5] = dp;
+      }
     }
+    if (!lost)
+      nLeft = i_top + 1;
+  }
+  if (lost) {
+    nLeft = compactLostParticles(part, accepted, lost, n_part);
+    free(lost);
   }
+  i_top = nLeft - 1;
 
   if (iSlice < 0 || iSlice == (csbend->nSlices - 1)) {
     if (csbend->malignMethod != 0)
@@ -1427,8 +1464,10 @@ long track_through_csbend(double **part, long n_part, CSBEND *csbend, double p_e
     /* Return average value for all particles */
     *sigmaDelta2 /= i_top + 1;
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (csbend->photonOutputFile && !SDDS_UpdatePage(csbend->SDDSphotons, FLUSH_TABLE))
     SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 
   return (i_top + 1);
 }
@@ -1651,7 +1690,7 @@ long integrate_csbend_ordn(
             DPoP -= rad_coef * deltaFactor * F2 * ds * dsFactor;
           if (isrConstant > 0)
             /* The minus sign is for consistency with the previous version. */
-            DPoP -= isrConstant * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+            DPoP -= isrConstant * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
           if (sigmaDelta2)
             *sigmaDelta2 += sqr(isrConstant * deltaFactor) * pow(F2, 1.5) * dsISR * dsFactor;
           QX *= (1 + DPoP);
@@ -1869,7 +1908,7 @@ long integrate_csbend_ordn_expanded(double *Qf, double *Qi, double *sigmaDelta2,
             DPoP -= rad_coef * deltaFactor * F2 * ds * dsFactor;
           if (isrConstant > 0)
             /* The minus sign is for consistency with the previous version. */
-            DPoP -= isrConstant * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+            DPoP -= isrConstant * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
           if (sigmaDelta2)
             *sigmaDelta2 += sqr(isrConstant * deltaFactor) * pow(F2, 1.5) * dsISR * dsFactor;
           QX *= (1 + DPoP);
@@ -2757,10 +2796,12 @@ long track_through_csbendCSR(double **part, long n_part, CSRCSBEND *csbend, doub
               SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
           }
           convertToCSBendCoords(part, n_part, rho0, cos_ttilt, sin_ttilt, 1);
+          elementProfilerStartCollective(PROFILE_OUTPUT);
           if (!SDDS_WritePage(csbend->SDDSpart))
             SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
           if (!inhibitFileSync)
             SDDS_DoFSync(csbend->SDDSpart);
+          elementProfilerEndCollective(PROFILE_OUTPUT);
         }
       }
 
@@ -2821,12 +2862,14 @@ long track_through_csbendCSR(double **part, long n_part, CSRCSBEND *csbend, doub
           T2[iBin] = dGamma[iBin] / (csbend->length / csbend->nSlices);
         }
         if (isMaster) {
+          elementProfilerStartCollective(PROFILE_OUTPUT);
           if (!SDDS_SetColumn(csbend->SDDSout, SDDS_SET_BY_NAME, T1, nBins, "s") ||
               !SDDS_SetColumn(csbend->SDDSout, SDDS_SET_BY_NAME, T2, nBins, "GammaDeriv") ||
               !SDDS_WritePage(csbend->SDDSout))
             SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
           if (!inhibitFileSync)
             SDDS_DoFSync(csbend->SDDSout);
+          elementProfilerEndCollective(PROFILE_OUTPUT);
         }
       }
     }
@@ -4273,6 +4316,7 @@ void DumpStupakovOutput(char *filename, SDDS_DATASET *SDDSout, long *active,
     ctHist[i] = dct * (i + 0.5 - nBins / 2);
     ctHistDeriv[i] = dGamma[i] / dz;
   }
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_SetColumn(SDDSout, SDDS_SET_BY_NAME, ctHist, nBins, "s") ||
       !SDDS_SetColumn(SDDSout, SDDS_SET_BY_NAME, ctHistDeriv, nBins, "GammaDeriv") ||
       !SDDS_SetParameters(SDDSout, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
@@ -4286,6 +4330,7 @@ void DumpStupakovOutput(char *filename, SDDS_DATASET *SDDSout, long *active,
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDSout);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 }
 
 void apply_edge_effects(
@@ -4576,6 +4621,15 @@ void convertToCSBendCoords(double **part, long np, double rho0,
 }
 
 #include "fftpackC.h"
+/* spectrum buffer for the filter routines, kept between calls since these are
+ * called for every CSR slice
+ */
+static WORK_ARENA *filterWorkArena = NULL;
+
+void freeFilterWorkArena() {
+  freeWorkArena(&filterWorkArena);
+}
+
 long applyLowPassFilter(double *histogram, long bins,
                         double start, /* in units of Nyquist frequency */
                         double end    /* in units of Nyquist frequency */
@@ -4585,8 +4639,7 @@ long applyLowPassFilter(double *histogram, long bins,
   double *realimag;
   long frequencies;
 
-  if (!(realimag = (double *)malloc(sizeof(*realimag) * (bins + 2))))
-    SDDS_Bomb("allocation failure");
+  realimag = getWorkBuffer(&filterWorkArena, 0, sizeof(*realimag) * (bins + 2));
 
   if (end < start)
     end = start;
@@ -4629,7 +4682,6 @@ long applyLowPassFilter(double *histogram, long bins,
     sum += histogram[i];
     histogram[i] = realimag[i];
   }
-  free(realimag);
   return correctDistribution(histogram, bins, sum);
 }
 
@@ -4644,8 +4696,7 @@ long applyLHPassFilters(double *histogram, long bins,
   double *realimag;
   long frequencies;
 
-  if (!(realimag = (double *)malloc(sizeof(*realimag) * (bins + 2))))
-    SDDS_Bomb("allocation failure");
+  realimag = getWorkBuffer(&filterWorkArena, 0, sizeof(*realimag) * (bins + 2));
 
   if (endLP < startLP)
     endLP = startLP;
@@ -4716,7 +4767,6 @@ long applyLHPassFilters(double *histogram, long bins,
     sum += histogram[i];
     histogram[i] = realimag[i];
   }
-  free(realimag);
 
   if (clipNegative)
     /* normalize to keep the sum constant
@@ -4858,8 +4908,7 @@ void applyFilterTable(double *function, long bins, double dx, long fValues,
   long frequencies;
   double sum;
 
-  if (!(realimag = (double *)malloc(sizeof(*realimag) * (bins + 2))))
-    SDDS_Bomb("allocation failure");
+  realimag = getWorkBuffer(&filterWorkArena, 0, sizeof(*realimag) * (bins + 2));
 
   frequencies = bins / 2 + 1;
   length = dx * (bins - 1);
@@ -4880,7 +4929,6 @@ void applyFilterTable(double *function, long bins, double dx, long fValues,
    */
   for (i = sum = 0; i < bins; i++)
     function[i] = realimag[i];
-  free(realimag);
 }
 
 void addRadiationKick(double *Qx, double *Qy, double *dPoP, double *sigmaDelta2,
@@ -4904,7 +4952,7 @@ void addRadiationKick(double *Qx, double *Qy, double *dPoP, double *sigmaDelta2,
       *dPoP -= radCoef * deltaFactor * F2 * ds * dsFactor;
     if (isrCoef > 0)
       /* The minus sign is for consistency with the previous version. */
-      *dPoP -= isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+      *dPoP -= isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(dsISR * dsFactor) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
     if (sigmaDelta2)
       *sigmaDelta2 += sqr(isrCoef * deltaFactor) * pow(F2, 1.5) * dsISR * dsFactor;
     *Qx *= (1 + *dPoP);
@@ -4922,13 +4970,13 @@ void addRadiationKick(double *Qx, double *Qy, double *dPoP, double *sigmaDelta2,
     /* Note that unlike the #photons/radian, this is independent of energy */
     nMean = meanPhotonsPerMeter * dsISR * dsFactor * F;
     /* Pick the actual number of photons emitted from Poisson distribution */
-    nEmitted = inversePoissonCDF(nMean, random_2(1));
+    nEmitted = inversePoissonCDF(nMean, random_2_elegant(1));
     /* Adjust normalized critical energy to local field strength (FSE is already included via rho_actual) */
     normalizedCriticalEnergy = normalizedCriticalEnergy0 * F;
     /* For each photon, pick its energy and emission angles */
     for (i = 0; i < nEmitted; i++) {
       /* Pick photon energy normalized to critical energy */
-      yph = pickNormalizedPhotonEnergy(random_2(1));
+      yph = pickNormalizedPhotonEnergy(random_2_elegant(1));
       /* Multiply by critical energy normalized to central beam energy, adjusting for variation with
        * individual electron energy offset. Note that it goes like (1+delta)^2, not (1+delta)^3 
        * because the bending radius also depends on (1+delta) 
@@ -4943,8 +4991,8 @@ void addRadiationKick(double *Qx, double *Qy, double *dPoP, double *sigmaDelta2,
         logyph = log10(yph);
         thetaRms = dDelta * pow(10, -2.418673276661232e-01 + logyph * (-4.472680955382907e-01 + logyph * (-4.535350424882360e-02 - logyph * 6.181818621278201e-03))) / Po;
         /* Compute change in electron angle due to photon angle */
-        dtheta = thetaRms * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
-        dphi = thetaRms * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+        dtheta = thetaRms * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
+        dphi = thetaRms * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
         if (SDDSphotons)
           logPhoton(dDelta * Po, x, xp - dtheta / dDelta, y, yp - dphi / dDelta, theta, thetaf, 1 / h0);
         /* rhoSign factor is for backward compatibility */
@@ -5494,7 +5542,7 @@ void addCorrectorRadiationKick(double **coord, long np, ELEMENT_LIST *elem, long
     deltaFactor = sqr(1 + dp);
     dp -= radCoef * deltaFactor * F2 * length;
     if (isr)
-      dp += isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(length) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+      dp += isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(length) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
     if (sigmaDelta2)
       *sigmaDelta2 += sqr(isrCoef * deltaFactor) * pow(F2, 1.5) * length;
     p = Po * (1 + dp);
@@ -5508,11 +5556,13 @@ void addCorrectorRadiationKick(double **coord, long np, ELEMENT_LIST *elem, long
 
 void convolveArrays1(double *output, long n, double *a1, double *a2) {
   long ib, ib1;
+  elementProfilerStartCollective(PROFILE_WAKE);
   for (ib = 0; ib < n; ib++) {
     output[ib] = 0;
     for (ib1 = ib; ib1 < n; ib1++)
       output[ib] += a1[ib1] * a2[ib1 - ib];
   }
+  elementProfilerEndCollective(PROFILE_WAKE);
 }
 
 void setUpCsbendPhotonOutputFile(CSBEND *csbend, char *rootname, long np) {
@@ -5589,8 +5639,10 @@ void logPhoton(double Ep, double x, double xp, double y, double yp, double theta
                          -1))
     SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
   if (photonRows % 10000 == 0) {
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_UpdatePage(SDDSphotons, FLUSH_TABLE))
       SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
 }
 
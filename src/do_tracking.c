@@ -83,8 +83,12 @@ void gatherParticles(double ***coord, long *nToTrack, long *nLost, double ***acc
 /* Avoid unnecessary communications by checking if an operation will be executed in advance*/
 int usefulOperation(ELEMENT_LIST *eptr, unsigned long flags, long i_pass);
 balance checkBalance(double my_wtime, int myid, long n_processors, int verbose);
+void migrateParticles(double ***coord, double ***accepted, long *nToTrack, long *nMaximum, long *capacity,
+                      long canGrow, double my_wtime, double nParPerElements, int myid, long n_processors, int verbose);
 #endif
 static void checkBeamStructure(BEAM *beam);
+static void trackRfModeGroup(double **coord, long np, ELEMENT_LIST *eptr, double Po, double z, double zTravel,
+                             long iPass, long nPasses, CHARGE *charge, RUN *run, long nOriginal, double revolutionLength);
 
 #ifdef SORT
 int comp_IDs(const void *coord1, const void *coord2);
@@ -195,6 +199,7 @@ long do_tracking
   long maxampOpenCode = 0, maxampExponent = 0, maxampYExponent = 0;
   double dgamma, dP[3], z, z_recirc, last_z, z_travel;
   long i, j, i_traj = 0, i_sums, i_pass, isConcat, i_elem;
+  long firstPass; /* differs from passOffset when restarting from a checkpoint */
   long i_sums_recirc, saveISR = 0;
   long watch_pt_seen, feedbackDriverSeen;
   double sum, x_max, y_max;
@@ -214,6 +219,7 @@ long do_tracking
   static long warnedAboutChargePosition = 0;
   unsigned long classFlags = 0;
   long nParticlesStartPass = 0;
+  long profiling = 0;
   int myid = 0, active = 1;
   long memoryBefore = 0, memoryAfter = 0;
 #if USE_MPI
@@ -495,7 +501,26 @@ long do_tracking
     sMaxTransmittedMonitorMemory = rpn_create_mem("sMaxTransmittedMonitor", 0);
   rpn_store(sMaxTransmittedMonitor, NULL, sMaxTransmittedMonitorMemory);
 
-  for (i_pass = passOffset; i_pass < n_passes + passOffset; i_pass++) {
+  if (run->elementProfile && !(flags & (TEST_PARTICLES | CLOSED_ORBIT_TRACKING | OPTIMIZING)))
+    profiling = elementProfilerBegin(run, beamline, step);
+
+  firstPass = passOffset;
+  if (run->restartFile && beam && !(flags & (TEST_PARTICLES | CLOSED_ORBIT_TRACKING | OPTIMIZING | PRECORRECTION_BEAM))) {
+#ifdef HAVE_GPU
+    if (getElementOnGpu())
+      bombElegant("restart from a tracking checkpoint is not supported with GPU tracking", NULL);
+#endif
+    if ((firstPass = readTrackingCheckpoint(run, beamline, coord, beam->n_particle, &nToTrack, &nMaximum,
+                                            &beam->n_lost, P_central, step)) < 0)
+      firstPass = passOffset;
+    else {
+      nLeft = nToTrack;
+      /* later steps and calls track from the start */
+      run->restartFile = NULL;
+    }
+  }
+
+  for (i_pass = firstPass; i_pass < n_passes + passOffset; i_pass++) {
 #ifdef DEBUG_CRASH
     printMessageAndTime(stdout, "do_tracking checkpoint 0.35, ");
     printf("pass = %ld\n", i_pass);
@@ -596,7 +621,7 @@ long do_tracking
     else
       eptr = beamline->elem;
 
-    if (i_pass == passOffset) {
+    if (i_pass == firstPass) {
       if (flags & LINEAR_CHROMATIC_MATRIX) {
         if (!isConcat) {
           printf("Error: in order to use the \"linear chromatic matrix\" for\n");
@@ -637,7 +662,7 @@ long do_tracking
         *sums_vs_z = allocateBeamSums(flags, *n_z_points + 1);
         zero_beam_sums(*sums_vs_z, *n_z_points + 1);
         sums_allocated = 1;
-      } else if (!run->combine_bunch_statistics && i_pass == passOffset)
+      } else if (!run->combine_bunch_statistics && i_pass == firstPass)
         zero_beam_sums(*sums_vs_z, *n_z_points + 1);
     }
 
@@ -734,7 +759,7 @@ long do_tracking
 #endif
 
     i_elem = 0;
-    if (i_pass == passOffset && startElem) {
+    if (i_pass == firstPass && startElem) {
       /* start tracking from an interior point in the beamline */
       while (eptr && eptr != startElem) {
         if (eptr->type == T_MAXAMP) {
@@ -852,6 +877,8 @@ long do_tracking
         elementTimingActive = 1;
         tStart = delapsed_time();
       }
+      if (profiling)
+        elementProfilerStartElement(eptr, nToTrack);
       if (run->monitorMemoryUsage)
         memoryBefore = memoryUsage();
 #ifdef DEBUG_CRASH
@@ -1204,7 +1231,7 @@ long do_tracking
           BRANCH *branch;
           long choice = 0;
           branch = (BRANCH *)(eptr->p_elem);
-          if (i_pass == passOffset)
+          if (i_pass == firstPass)
             branch->privateCounter = branch->counter;
           if (flags & TEST_PARTICLES) {
             choice = branch->defaultToElse;
@@ -1353,7 +1380,7 @@ long do_tracking
             case -1:
               break;
             case T_CHARGE:
-              if ((i_pass == passOffset && !startElem) || ((CHARGE *)(eptr->p_elem))->allowChangeWhileRunning) {
+              if ((i_pass == firstPass && !startElem) || ((CHARGE *)(eptr->p_elem))->allowChangeWhileRunning) {
                 if (elementsTracked != 0 && !warnedAboutChargePosition) {
                   warnedAboutChargePosition = 1;
                   if (eptr->pred && eptr->pred->name) {
@@ -1412,7 +1439,7 @@ long do_tracking
               break;
             case T_RECIRC:
               /* Recognize and record recirculation point.  */
-              if (i_pass == passOffset) {
+              if (i_pass == firstPass) {
                 i_sums_recirc = i_sums - 1;
                 z_recirc = last_z;
               }
@@ -1637,7 +1664,7 @@ long do_tracking
                   if (!watch->initialized)
                     set_up_watch_point(watch, run, eptr->occurence, eptr->pred ? eptr->pred->name : NULL, 
                                        eptr->pred ? eptr->pred->occurence: 0, i_pass, beamline->elem);
-                  if (i_pass == passOffset && (n_passes / watch->interval) == 0) {
+                  if (i_pass == firstPass && (n_passes / watch->interval) == 0) {
                     char buffer[16384];
                     snprintf(buffer, 16384,
                              "Settings n_passes=%ld and INTERVAL=%ld prevent WATCH output to file %s",
@@ -1732,7 +1759,7 @@ long do_tracking
                   watch_pt_seen = 1; /* sic */
                   if (!slicePoint->initialized)
                     set_up_slice_point(slicePoint, run, eptr->occurence, eptr->pred ? eptr->pred->name : NULL);
-                  if (i_pass == passOffset && (n_passes / slicePoint->interval) == 0) {
+                  if (i_pass == firstPass && (n_passes / slicePoint->interval) == 0) {
                     char buffer[16384];
                     snprintf(buffer, 16384,
                              "Settings n_passes=%ld and INTERVAL=%ld prevent SLICE output to file %s for element %s",
@@ -1761,7 +1788,7 @@ long do_tracking
                   watch_pt_seen = 1; /* yes, this should be here */
                   if (!histogram->initialized)
                     set_up_histogram(histogram, run, eptr->occurence);
-                  if (i_pass == passOffset && (n_passes / histogram->interval) == 0) {
+                  if (i_pass == firstPass && (n_passes / histogram->interval) == 0) {
                     char buffer[16384];
                     snprintf(buffer, 16384,
                              "Settings n_passes=%ld and INTERVAL=%ld prevent SLICE output to file %s for element %s",
@@ -1791,7 +1818,7 @@ long do_tracking
                 mhist = (MHISTOGRAM *)eptr->p_elem;
                 if (!mhist->disable) {
                   watch_pt_seen = 1; /* yes, this should be here */
-                  if (i_pass == passOffset && (n_passes / mhist->interval) == 0) {
+                  if (i_pass == firstPass && (n_passes / mhist->interval) == 0) {
                     char buffer[16384];
                     snprintf(buffer, 16384,
                              "Settings n_passes=%ld and INTERVAL=%ld prevent MHISTOGRAM output for element %s",
@@ -1906,6 +1933,11 @@ long do_tracking
                                             accepted, *P_central, z);
               break;
             case T_MATR:
+              if (!eptr->p_elem && eptr->polyMap) {
+                /* concatenated segment with run_setup polynomial_map_order */
+                trackPolynomialMap(coord, eptr->polyMap, nToTrack);
+                break;
+              }
               if (!eptr->matrix)
                 eptr->matrix = compute_matrix(eptr, run, NULL);
               matr_element_tracking(coord, eptr->matrix, (MATR *)eptr->p_elem, nToTrack,
@@ -2159,14 +2191,23 @@ long do_tracking
               break;
             case T_RFMODE:
               rfmode = (RFMODE *)eptr->p_elem;
-              if (!rfmode->initialized)
+              if (!rfmode->initialized) {
                 set_up_rfmode(rfmode, eptr->name, z, n_passes, run,
                               nOriginal, *P_central,
                               beamline->revolution_length);
-              if (!(flags&TEST_PARTICLES))
-                track_through_rfmode(coord, nToTrack, (RFMODE *)eptr->p_elem, *P_central,
-                                     eptr->name, z_travel, i_pass, n_passes,
-                                     charge);
+                restoreCheckpointElementState(eptr->p_elem);
+              }
+              if (!(flags&TEST_PARTICLES)) {
+                if (rfmode->groupTracked)
+                  rfmode->groupTracked = 0; /* already tracked with the first element of its group */
+                else if (rfmode->group && !rfmode->binless)
+                  trackRfModeGroup(coord, nToTrack, eptr, *P_central, z, z_travel, i_pass, n_passes, charge,
+                                   run, nOriginal, beamline->revolution_length);
+                else
+                  track_through_rfmode(coord, nToTrack, (RFMODE *)eptr->p_elem, *P_central,
+                                       eptr->name, z_travel, i_pass, n_passes,
+                                       charge);
+              }
               break;
             case T_FRFMODE:
               frfmode = (FRFMODE *)eptr->p_elem;
@@ -2181,8 +2222,10 @@ long do_tracking
               break;
             case T_TRFMODE:
               trfmode = (TRFMODE *)eptr->p_elem;
-              if (!trfmode->initialized)
+              if (!trfmode->initialized) {
                 set_up_trfmode(trfmode, eptr->name, z_travel, n_passes, run, nOriginal);
+                restoreCheckpointElementState(eptr->p_elem);
+              }
               if (!(flags&TEST_PARTICLES))
                 track_through_trfmode(coord, nToTrack, (TRFMODE *)eptr->p_elem, *P_central,
                                       eptr->name, z_travel, i_pass, n_passes,
@@ -2361,7 +2404,7 @@ long do_tracking
             case T_TWISSELEMENT:
               if (((TWISSELEMENT *)eptr->p_elem)->disable || flags & TEST_PARTICLES)
                 break;
-              if (((TWISSELEMENT *)eptr->p_elem)->applyOnce == 0 || i_pass == passOffset) {
+              if (((TWISSELEMENT *)eptr->p_elem)->applyOnce == 0 || i_pass == firstPass) {
                 /* If applying once, do so on the first pass through only */
                 if (((TWISSELEMENT *)eptr->p_elem)->fromBeam) {
                   /* Compute the transformation from the beam, rather than the lattice twiss parameters */
@@ -2578,7 +2621,7 @@ long do_tracking
 #endif
       if (eptr->Pref_output_fiducial == 0)
         bombElegant("problem with fiducialization. Seek expert help!", NULL);
-      if (i_pass == passOffset && traj_vs_z) {
+      if (i_pass == firstPass && traj_vs_z) {
         /* collect trajectory data--used mostly by trajectory correction routines */
         /* this is always false
         if (!traj_vs_z[i_traj].centroid) {
@@ -2775,6 +2818,8 @@ long do_tracking
         timeCounter[last_type] += delapsed_time() - tStart;
         runCounter[last_type] += 1;
       }
+      if (profiling)
+        elementProfilerEndElement(nToTrack);
       if (run->monitorMemoryUsage) {
         if ((memoryAfter = memoryUsage()) > memoryBefore) {
           printf("Memory usage increased by %ld kB in %s %s#%ld, pass %ld\n",
@@ -2830,7 +2875,7 @@ long do_tracking
            cpu_time() / 100.0, page_faults(), memoryUsage());
     fflush(stdout);
 #endif
-    if ((!USE_MPI || !notSinglePart) && (i_pass == passOffset || watch_pt_seen || feedbackDriverSeen)) {
+    if ((!USE_MPI || !notSinglePart) && (i_pass == firstPass || watch_pt_seen || feedbackDriverSeen)) {
       /* if eptr is not NULL, then all particles have been lost */
       /* some work still has to be done, however. */
       while (eptr) {
@@ -2902,7 +2947,7 @@ long do_tracking
         default:
           break;
         }
-        if (i_pass == passOffset && traj_vs_z) {
+        if (i_pass == firstPass && traj_vs_z) {
           /* collect trajectory data--used mostly by trajectory correction routines */
           /* This is always false
           if (!traj_vs_z[i_traj].centroid) {
@@ -2957,7 +3002,7 @@ long do_tracking
 
 #if USE_MPI
     if (notSinglePart) {
-      if (run->load_balancing_on == 1) { /* User can choose if load balancing needs to be done */
+      if (run->load_balancing_on > 0) { /* User can choose if load balancing needs to be done */
         if (balanceStatus == startMode) {
           balanceStatus = checkBalance(my_wtime, myid, n_processors, 1);
           /* calculate the rate for all of the slave processors */
@@ -3014,6 +3059,33 @@ long do_tracking
         if (run->load_balancing_on == -1)
           checkBalance(my_wtime, myid, n_processors, 1); /* Just to check and report, nothing done */
       }
+      if (run->load_balancing_on == 2 && balanceStatus == badBalance && !partOnMaster && parallelStatus == trueParallel) {
+        /* Move only the surplus particles directly between worker processors, instead of
+           gathering the beam on the master and scattering it again before the next element */
+        long capacity;
+        /* Rows allocated for coord and accepted. When particle aliases original, the arrays hold
+           exactly n_original rows; sdds_beam allocates accepted with n_particle*memDistFactor rows.
+           Only the beam's own arrays can be enlarged for incoming particles. */
+        if (beam) {
+          capacity = beam->particle == beam->original ? beam->n_original : beam->n_particle;
+          if (accepted && memDistFactor < 1 && (long)(beam->n_particle * memDistFactor) < capacity)
+            capacity = beam->n_particle * memDistFactor;
+        } else
+          capacity = nOriginal;
+        migrateParticles(&coord, &accepted, &nToTrack, &nMaximum, &capacity, beam != NULL,
+                         my_wtime, nParElements && nElements ? (double)nParElements / (double)nElements : 0.0,
+                         myid, n_processors, 1);
+        if (beam && coord != beam->particle) {
+          /* the arrays were enlarged to receive particles */
+          if (beam->original == beam->particle)
+            beam->original = coord;
+          beam->particle = coord;
+          beam->n_particle = capacity;
+          beam->accepted = accepted;
+        }
+        nLeft = nToTrack;
+        balanceStatus = goodBalance;
+      }
 #  ifdef CHECKFLAGS
       if (myid == 0)
         old_nToTrack = nToTrack;
@@ -3031,7 +3103,21 @@ long do_tracking
 #endif
       accumulateParticleTuneData(coord, nLeft, i_pass, &(outputFiles->particleTunes));
     }
+    if (profiling)
+      elementProfilerEndPass(i_pass);
+    if (run->checkpointFile && beam && !(flags & (TEST_PARTICLES | CLOSED_ORBIT_TRACKING | OPTIMIZING | PRECORRECTION_BEAM)) &&
+        (i_pass + 1 - passOffset) % run->checkpointInterval == 0 && i_pass + 1 < n_passes + passOffset) {
+#if USE_MPI
+      /* particles must be on the worker processors, as they are at the start of tracking */
+      if (partOnMaster && notSinglePart)
+        printWarning("Tracking checkpoint skipped.", "Particles are gathered on the master processor at the end of this pass.");
+      else
+#endif
+        writeTrackingCheckpoint(run, beamline, coord, nToTrack, nMaximum, beam->n_lost, *P_central, i_pass, step);
+    }
   } /* end of the for loop for n_passes*/
+  if (profiling)
+    elementProfilerEnd();
 
 #ifdef DEBUG_CRASH
   printMessageAndTime(stdout, "do_tracking checkpoint 22: ");
@@ -3285,7 +3371,9 @@ long do_tracking
       if (eptr->type == T_WATCH) {
         watch = (WATCH *)eptr->p_elem;
         if (watch->initialized) {
+          elementProfilerStartCollective(PROFILE_OUTPUT);
           SDDS_UpdatePage(watch->SDDS_table, 0);
+          elementProfilerEndCollective(PROFILE_OUTPUT);
         }
       }
       eptr = eptr->succ;
@@ -3308,6 +3396,42 @@ long do_tracking
   return (nToTrack);
 }
 
+/* Tracks through the RFMODE element eptr and the RFMODE elements that immediately follow it with the
+ * same GROUP name, binning the beam only once. The other elements are marked so that they are skipped
+ * when the tracking loop reaches them.
+ */
+static void trackRfModeGroup(double **coord, long np, ELEMENT_LIST *eptr, double Po, double z, double zTravel,
+                             long iPass, long nPasses, CHARGE *charge, RUN *run, long nOriginal, double revolutionLength) {
+  ELEMENT_LIST *eptr1;
+  RFMODE **rfmode, *rfmode1;
+  char **name, *group;
+  long nModes;
+
+  group = ((RFMODE *)eptr->p_elem)->group;
+  rfmode = NULL;
+  name = NULL;
+  nModes = 0;
+  for (eptr1 = eptr; eptr1 && eptr1->type == T_RFMODE; eptr1 = eptr1->succ) {
+    rfmode1 = (RFMODE *)eptr1->p_elem;
+    if (!rfmode1->group || strcmp(rfmode1->group, group) != 0)
+      break;
+    if (!rfmode1->initialized) {
+      set_up_rfmode(rfmode1, eptr1->name, z, nPasses, run, nOriginal, Po, revolutionLength);
+      restoreCheckpointElementState(eptr1->p_elem);
+    }
+    rfmode = trealloc(rfmode, sizeof(*rfmode) * (nModes + 1));
+    name = trealloc(name, sizeof(*name) * (nModes + 1));
+    rfmode[nModes] = rfmode1;
+    name[nModes] = eptr1->name;
+    if (eptr1 != eptr)
+      rfmode1->groupTracked = 1;
+    nModes++;
+  }
+  track_through_rfmode_group(coord, np, rfmode, name, nModes, Po, zTravel, iPass, nPasses, charge);
+  free(rfmode);
+  free(name);
+}
+
 void offset_beam(
   double **coord,
   long nToTrack,
@@ -3783,18 +3907,18 @@ void scatter_ele(double **part, long np, double Po, SCATTER *scat, long iPass) {
     sigma[2] = scat->y;
     sigma[3] = scat->yp;
     for (ip = 0; ip < np; ip++) {
-      if (scat->probability < 1 && random_2(1) > scat->probability)
+      if (scat->probability < 1 && random_2_elegant(1) > scat->probability)
         continue;
       for (i = 0; i < 4; i++) {
         if (!sigma[i])
           continue;
-        part[ip][i] += gauss_rn(0, random_2) * sigma[i];
+        part[ip][i] += gauss_rn_elegant(0, random_2_elegant) * sigma[i];
       }
       if (scat->dp) {
         P = (1 + part[ip][5]) * Po;
         beta = P / sqrt(sqr(P) + 1);
         t = part[ip][4] / beta;
-        part[ip][5] += scat->dp * gauss_rn(0, random_2);
+        part[ip][5] += scat->dp * gauss_rn_elegant(0, random_2_elegant);
         P = (1 + part[ip][5]) * Po;
         beta = P / sqrt(sqr(P) + 1);
         part[ip][4] = t * beta;
@@ -3807,18 +3931,18 @@ void scatter_ele(double **part, long np, double Po, SCATTER *scat, long iPass) {
     u[2] = scat->y;
     u[3] = scat->yp;
     for (ip = 0; ip < np; ip++) {
-      if (scat->probability < 1 && random_2(1) > scat->probability)
+      if (scat->probability < 1 && random_2_elegant(1) > scat->probability)
         continue;
       for (i = 0; i < 4; i++) {
         if (!u[i])
           continue;
-        part[ip][i] += 2 * u[i] * (random_2(1) - 0.5);
+        part[ip][i] += 2 * u[i] * (random_2_elegant(1) - 0.5);
       }
       if (scat->dp) {
         P = (1 + part[ip][5]) * Po;
         beta = P / sqrt(sqr(P) + 1);
         t = part[ip][4] / beta;
-        part[ip][5] += 2 * scat->dp * (random_2(1) - 0.5);
+        part[ip][5] += 2 * scat->dp * (random_2_elegant(1) - 0.5);
         P = (1 + part[ip][5]) * Po;
         beta = P / sqrt(sqr(P) + 1);
         part[ip][4] = t * beta;
@@ -4610,7 +4734,7 @@ void distributionScatter(double **part, long np, double Po, DSCATTER *scat, long
 
   nScattered = 0;
   for (ip = 0; ip < np; ip++) {
-    if (scat->probability < 1 && random_2(1) > scat->probability)
+    if (scat->probability < 1 && random_2_elegant(1) > scat->probability)
       continue;
     if (nLeftThisPass == 0)
       break;
@@ -4636,10 +4760,10 @@ void distributionScatter(double **part, long np, double Po, DSCATTER *scat, long
     }
     nScattered++;
     nLeftThisPass--;
-    cdf = random_2(1);
+    cdf = random_2_elegant(1);
     amplitude = scat->factor * interp(scat->indepData, scat->cdfData, scat->nData, cdf, 0, 1, &interpCode);
     if (scat->randomSign)
-      amplitude *= random_2(1) > 0.5 ? 1 : -1;
+      amplitude *= random_2_elegant(1) > 0.5 ? 1 : -1;
     if (!interpCode) {
       char buffer[16384];
       snprintf(buffer, 16384, ". Element %s, CDF=%e",
@@ -4833,6 +4957,8 @@ void scatterParticles(double **coord, long *nToTrack, double **accepted,
   char s[1000];
 #  endif
 
+  elementProfilerStartCollective(PROFILE_MPI);
+
 #  ifdef HAVE_GPU
   coord = forceParticlesToCpu("scatterParticles");
 #  endif
@@ -5044,6 +5170,7 @@ void scatterParticles(double **coord, long *nToTrack, double **accepted,
 
   free(nToTrackCounts);
   free(rateCounts);
+  elementProfilerEndCollective(PROFILE_MPI);
 }
 
 void gatherParticles(double ***coord, long *nToTrack, long *nLost, double ***accepted, long n_processors, int myid, double *round) {
@@ -5063,6 +5190,8 @@ void gatherParticles(double ***coord, long *nToTrack, long *nLost, double ***acc
   fflush(stdout);
   */
 
+  elementProfilerStartCollective(PROFILE_MPI);
+
   nToTrackCounts = malloc(sizeof(long) * n_processors);
   nLostCounts = malloc(sizeof(long) * n_processors);
 
@@ -5156,6 +5285,7 @@ void gatherParticles(double ***coord, long *nToTrack, long *nLost, double ***acc
     */
   free(nToTrackCounts);
   free(nLostCounts);
+  elementProfilerEndCollective(PROFILE_MPI);
 }
 
 balance checkBalance(double my_wtime, int myid, long n_processors, int verbose) {
@@ -5215,6 +5345,169 @@ balance checkBalance(double my_wtime, int myid, long n_processors, int verbose)
     return badBalance;
 }
 
+/* Incremental load balancing (load_balancing_on=2).
+ * Each worker's throughput is measured as particle-elements tracked per second of element
+ * time in the last pass. The particles are apportioned in proportion to throughput, and only
+ * the surplus is sent point-to-point from overloaded to underloaded workers. Lost particles
+ * stay on the processor where they were lost, behind the surviving ones. All processors
+ * compute the same transfer plan from gathered data, so no coordination by the master is needed.
+ * capacity is the number of rows in coord (and accepted, if any). If canGrow is set, the arrays
+ * are enlarged as needed and capacity is updated; otherwise a worker receives at most as many
+ * particles as fit.
+ */
+void migrateParticles(double ***coord, double ***accepted, long *nToTrack, long *nMaximum, long *capacity,
+                      long canGrow, double my_wtime, double nParPerElements, int myid, long n_processors, int verbose) {
+  double myInfo[4], *info, *rate, sumRate, meanRate, cumRate, minMove;
+  long i, j, nKnown, nTotal, nLostHere, nMoved, nTransfers, nRequests, offset;
+  long *target, *excess, *from, *to, *count;
+  MPI_Request *request;
+
+  elementProfilerStartCollective(PROFILE_MPI);
+
+#  ifdef HAVE_GPU
+  *coord = forceParticlesToCpu("migrateParticles");
+#  endif
+
+  myInfo[0] = myid == 0 ? 0 : *nToTrack;
+  myInfo[1] = myid == 0 ? 0 : my_wtime;
+  myInfo[2] = myid == 0 ? 0 : nParPerElements;
+  myInfo[3] = myid == 0 ? 0 : (canGrow ? -1 : *capacity - *nMaximum); /* room for incoming particles, -1 if unlimited */
+  info = tmalloc(sizeof(*info) * 4 * n_processors);
+  MPI_Allgather(myInfo, 4, MPI_DOUBLE, info, 4, MPI_DOUBLE, MPI_COMM_WORLD);
+
+  rate = tmalloc(sizeof(*rate) * n_processors);
+  target = tmalloc(sizeof(*target) * n_processors);
+  excess = tmalloc(sizeof(*excess) * n_processors);
+  from = tmalloc(sizeof(*from) * n_processors);
+  to = tmalloc(sizeof(*to) * n_processors);
+  count = tmalloc(sizeof(*count) * n_processors);
+
+  /* throughput of each worker; those that tracked nothing get the mean */
+  nTotal = nKnown = 0;
+  meanRate = 0;
+  for (i = 1; i < n_processors; i++) {
+    nTotal += info[4 * i];
+    rate[i] = -1;
+    if (info[4 * i + 1] > 0 && info[4 * i + 2] > 0) {
+      rate[i] = info[4 * i + 2] / info[4 * i + 1];
+      meanRate += rate[i];
+      nKnown++;
+    }
+  }
+  nTransfers = 0;
+  if (nKnown && nTotal) {
+    meanRate /= nKnown;
+    sumRate = 0;
+    for (i = 1; i < n_processors; i++) {
+      if (rate[i] < 0)
+        rate[i] = meanRate;
+      sumRate += rate[i];
+    }
+    /* cumulative rounding keeps the sum of the targets equal to nTotal */
+    cumRate = 0;
+    offset = 0;
+    for (i = 1; i < n_processors; i++) {
+      cumRate += rate[i];
+      target[i] = (long)(nTotal * cumRate / sumRate + 0.5) - offset;
+      offset += target[i];
+      excess[i] = info[4 * i] - target[i];
+      if (excess[i] < 0 && info[4 * i + 3] >= 0 && -excess[i] > info[4 * i + 3])
+        excess[i] = -info[4 * i + 3];
+    }
+    /* moving a handful of particles is not worth the messages */
+    minMove = 0.01 * nTotal / (n_processors - 1);
+    if (minMove < 1)
+      minMove = 1;
+    for (i = j = 1; i < n_processors; i++) {
+      while (excess[i] >= minMove) {
+        while (j < n_processors && -excess[j] < minMove)
+          j++;
+        if (j == n_processors)
+          break;
+        from[nTransfers] = i;
+        to[nTransfers] = j;
+        count[nTransfers] = excess[i] < -excess[j] ? excess[i] : -excess[j];
+        excess[i] -= count[nTransfers];
+        excess[j] += count[nTransfers];
+        nTransfers++;
+      }
+    }
+  }
+
+  /* a processor either sends or receives, never both */
+  nMoved = 0;
+  for (i = 0; i < nTransfers; i++) {
+    if (from[i] == myid)
+      nMoved -= count[i];
+    else if (to[i] == myid)
+      nMoved += count[i];
+  }
+  nLostHere = *nMaximum - *nToTrack;
+  request = tmalloc(sizeof(*request) * 2 * (nTransfers + 1));
+  nRequests = 0;
+  if (nMoved > 0) {
+    if (*nMaximum + nMoved > *capacity) {
+      *capacity = *nMaximum + nMoved;
+      *coord = (double **)resize_czarray_2d((void **)(*coord), sizeof(double), *capacity, totalPropertiesPerParticle);
+      if (accepted && *accepted)
+        *accepted = (double **)resize_czarray_2d((void **)(*accepted), sizeof(double), *capacity, totalPropertiesPerParticle);
+    }
+    /* open a gap between the surviving and the lost particles */
+    if (nLostHere)
+      memmove(&(*coord)[*nToTrack + nMoved][0], &(*coord)[*nToTrack][0], sizeof(double) * nLostHere * totalPropertiesPerParticle);
+    if (nLostHere && accepted && *accepted)
+      memmove(&(*accepted)[*nToTrack + nMoved][0], &(*accepted)[*nToTrack][0], sizeof(double) * nLostHere * totalPropertiesPerParticle);
+    offset = *nToTrack;
+    for (i = 0; i < nTransfers; i++) {
+      if (to[i] != myid)
+        continue;
+      MPI_Irecv(&(*coord)[offset][0], count[i] * totalPropertiesPerParticle, MPI_DOUBLE, from[i], 106, MPI_COMM_WORLD, &request[nRequests++]);
+      if (accepted && *accepted)
+        MPI_Irecv(&(*accepted)[offset][0], count[i] * totalPropertiesPerParticle, MPI_DOUBLE, from[i], 107, MPI_COMM_WORLD, &request[nRequests++]);
+      offset += count[i];
+    }
+  } else if (nMoved < 0) {
+    /* send the particles at the end of the surviving block */
+    offset = *nToTrack;
+    for (i = 0; i < nTransfers; i++) {
+      if (from[i] != myid)
+        continue;
+      offset -= count[i];
+      MPI_Isend(&(*coord)[offset][0], count[i] * totalPropertiesPerParticle, MPI_DOUBLE, to[i], 106, MPI_COMM_WORLD, &request[nRequests++]);
+      if (accepted && *accepted)
+        MPI_Isend(&(*accepted)[offset][0], count[i] * totalPropertiesPerParticle, MPI_DOUBLE, to[i], 107, MPI_COMM_WORLD, &request[nRequests++]);
+    }
+  }
+  if (nRequests)
+    MPI_Waitall(nRequests, request, MPI_STATUSES_IGNORE);
+  if (nMoved < 0 && nLostHere) {
+    /* close the hole left by the departed particles */
+    memmove(&(*coord)[*nToTrack + nMoved][0], &(*coord)[*nToTrack][0], sizeof(double) * nLostHere * totalPropertiesPerParticle);
+    if (accepted && *accepted)
+      memmove(&(*accepted)[*nToTrack + nMoved][0], &(*accepted)[*nToTrack][0], sizeof(double) * nLostHere * totalPropertiesPerParticle);
+  }
+  *nToTrack += nMoved;
+  *nMaximum += nMoved;
+
+  if (verbose && myid == 0) {
+    for (i = nMoved = 0; i < nTransfers; i++)
+      nMoved += count[i];
+    printf("Load rebalancing moved %ld of %ld particles in %ld transfers between worker processors\n",
+           nMoved, nTotal, nTransfers);
+    fflush(stdout);
+  }
+
+  free(info);
+  free(rate);
+  free(target);
+  free(excess);
+  free(from);
+  free(to);
+  free(count);
+  free(request);
+  elementProfilerEndCollective(PROFILE_MPI);
+}
+
 int usefulOperation(ELEMENT_LIST *eptr, unsigned long flags, long i_pass) {
   WATCH *watch;
   HISTOGRAM *histogram;
@@ -5442,6 +5735,7 @@ void mhist_table(ELEMENT_LIST *eptr0, ELEMENT_LIST *eptr, long step, long pass,
   if (mhist->file6d)
     mhist->full6d = chbookn(Name, Units, 6, Min, Max, mhist->bins6d, 0);
 
+  elementProfilerStartCollective(PROFILE_HISTOGRAM);
   for (i = 0; i < np; i++) {
     for (j = 0; j < 6; j++) {
       if (j == 4) {
@@ -5465,7 +5759,9 @@ void mhist_table(ELEMENT_LIST *eptr0, ELEMENT_LIST *eptr, long step, long pass,
     if (mhist->full6d)
       chfilln(mhist->full6d, part, 1, 0);
   }
+  elementProfilerEndCollective(PROFILE_HISTOGRAM);
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (mhist->x1d) {
     chprint1m(mhist->x1d, mhist->file1d, "One dimentional distribution", mhist_table_para,
               mhist_table_paraValue, MHISTOGRAM_TABLE_PARAMETERS, mhist->normalize, 0, mhist->count);
@@ -5496,6 +5792,7 @@ void mhist_table(ELEMENT_LIST *eptr0, ELEMENT_LIST *eptr, long step, long pass,
              mhist_table_paraValue, MHISTOGRAM_TABLE_PARAMETERS, mhist->normalize, 0, mhist->count);
     free_hbookn(mhist->full6d);
   }
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 
   mhist->count++;
 
@@ -5907,10 +6204,12 @@ void flushTransverseFeedbackDriverFiles(TFBDRIVER *tfbd) {
     return;
 #endif
   if (tfbd->initialized && !(tfbd->dataWritten)) {
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WritePage(tfbd->SDDSout)) {
       SDDS_PrintErrors(stdout, SDDS_VERBOSE_PrintErrors);
       SDDS_Bomb("problem writing data for TFBDRIVER output file (flushTransverseFeedbackDriverFiles)");
     }
+    elementProfilerEndCollective(PROFILE_OUTPUT);
     tfbd->dataWritten = 1;
   }
   tfbd->outputIndex = 0;
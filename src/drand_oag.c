@@ -73,9 +73,9 @@ void seedElegantRandomNumbers(long iseed, unsigned long restart) {
 
   /* seed random number generators.  
    * random_1_elegant is used for beamline errors, same on all processors
-   * random_2 is used for random scraping/sampling/scattering
-   * random_3 is used for BPM noise, same on all processors
-   * random_4 is used for beam generation 
+   * random_2_elegant is used for random scraping/sampling/scattering
+   * random_3_elegant is used for BPM noise, same on all processors
+   * random_4_elegant is used for beam generation
    */
 
   if (savedRandomNumberSeed[0] == 987654321)
@@ -84,22 +84,27 @@ void seedElegantRandomNumbers(long iseed, unsigned long restart) {
   if (!restart || restart & RESTART_RN_BEAMLINE)
     random_1_elegant(-savedRandomNumberSeed[0]);
   if (!restart || restart & RESTART_RN_SCATTER)
-    random_2(-savedRandomNumberSeed[1]);
+    random_2_elegant(-savedRandomNumberSeed[1]);
   if (!restart || restart & RESTART_RN_BPMNOISE)
-    random_3(-savedRandomNumberSeed[2]);
+    random_3_elegant(-savedRandomNumberSeed[2]);
   if (!restart || restart & RESTART_RN_BEAMGEN)
-    random_4(-savedRandomNumberSeed[3]);
+    random_4_elegant(-savedRandomNumberSeed[3]);
 }
 
-double random_1_elegant(long iseed) {
+/* random_1_elegant() through random_4_elegant() are elegant's copies of the SDDS
+ * library's random_1() through random_4(), kept here so that their state can be
+ * saved in and restored from tracking checkpoints.
+ */
+static short randomInitialized[N_ELEGANT_RANDOM_GENERATORS] = {0, 0, 0, 0};
+static long int randomSeed[N_ELEGANT_RANDOM_GENERATORS][4];
 
-  static short initialized = 0;
-  static long int seed[4] = {0, 0, 0, 0};
+static double randomElegant(long which, long iseed) {
+  long int *seed;
 
-  if (!initialized || iseed < 0) {
+  seed = randomSeed[which];
+  if (!randomInitialized[which] || iseed < 0) {
     if (iseed < 0)
       iseed = -iseed;
-    /* random_1_elegant() is used for beamline errors, same on all processors */
     if (iseed != 987654321)
       iseed = permuteSeedBitOrder(iseed);
     iseed = (iseed / 2) * 2 + 1;
@@ -107,14 +112,70 @@ double random_1_elegant(long iseed) {
     seed[2] = (iseed >>= 12) & 4095;
     seed[1] = (iseed >>= 12) & 4095;
     seed[0] = (iseed >>= 12) & 4095;
-    initialized = 1;
+    randomInitialized[which] = 1;
   }
-  if (!initialized)
-    bombElegant("random_1_elegant not properly initialized", NULL);
 
   return dlaran_OAG(seed);
 }
 
+/* used for beamline errors, same on all processors */
+double random_1_elegant(long iseed) {
+  return randomElegant(0, iseed);
+}
+
+/* used for random scraping/sampling/scattering */
+double random_2_elegant(long iseed) {
+  return randomElegant(1, iseed);
+}
+
+/* used for BPM noise, same on all processors */
+double random_3_elegant(long iseed) {
+  return randomElegant(2, iseed);
+}
+
+/* used for beam generation */
+double random_4_elegant(long iseed) {
+  return randomElegant(3, iseed);
+}
+
+/* Gaussian deviates by the polar method, as gauss_rn() in the SDDS library.
+ * The second deviate of each pair is kept for the next call; it is shared
+ * by all the uniform generators and is part of the checkpointed state.
+ */
+static short gaussianSaved = 0;
+static double gaussianSavedValue = 0;
+
+double gauss_rn_elegant(long iseed, double (*urandom)(long iseed1)) {
+  double v1, v2, r, fac;
+
+  if (gaussianSaved) {
+    gaussianSaved = 0;
+    return gaussianSavedValue;
+  }
+  do {
+    v1 = 2 * (*urandom)(iseed) - 1;
+    v2 = 2 * (*urandom)(iseed) - 1;
+  } while ((r = sqr(v1) + sqr(v2)) >= 1 || r == 0);
+  fac = sqrt(-2 * log(r) / r);
+  gaussianSavedValue = v1 * fac;
+  gaussianSaved = 1;
+  return v2 * fac;
+}
+
+/* Gaussian deviate with the given mean and sigma, cut off at limit_in_sigmas
+ * (no cutoff if limit_in_sigmas<=0)
+ */
+double gauss_rn_lim_elegant(double mean, double sigma, double limit_in_sigmas, double (*urandom)(long iseed)) {
+  double value;
+
+  if (limit_in_sigmas <= 0)
+    return mean + sigma * gauss_rn_elegant(0, urandom);
+  do {
+    value = gauss_rn_elegant(0, urandom);
+  } while (fabs(value) > limit_in_sigmas);
+  return mean + sigma * value;
+}
+
 double dlaran_OAG(long int *iseed) {
   /* System generated locals */
   double ret_val;
@@ -189,3 +250,40 @@ double dlaran_OAG(long int *iseed) {
   ret_val = ((double)it1 + ((double)it2 + ((double)it3 + (double)it4 * 2.44140625e-4) * 2.44140625e-4) * 2.44140625e-4) * 2.44140625e-4;
   return ret_val;
 }
+
+/* Access to the state of all the generators, for tracking checkpoints */
+void getElegantRandomNumberState(ELEGANT_RANDOM_STATE *state) {
+  long i, j;
+  for (i = 0; i < N_ELEGANT_RANDOM_GENERATORS; i++) {
+    state->initialized[i] = randomInitialized[i];
+    for (j = 0; j < 4; j++)
+      state->seed[i][j] = randomSeed[i][j];
+  }
+  state->gaussianSaved = gaussianSaved;
+  state->gaussianSavedValue = gaussianSavedValue;
+}
+
+void setElegantRandomNumberState(ELEGANT_RANDOM_STATE *state) {
+  long i, j;
+  for (i = 0; i < N_ELEGANT_RANDOM_GENERATORS; i++) {
+    randomInitialized[i] = state->initialized[i];
+    for (j = 0; j < 4; j++)
+      randomSeed[i][j] = state->seed[i][j];
+  }
+  gaussianSaved = state->gaussianSaved;
+  gaussianSavedValue = state->gaussianSavedValue;
+}
+
+/* With run_control n_step_workers>0, all generators are reseeded at the start of
+ * each step from the run's seed and the step number, so that the errors, beam, and
+ * noise for a step don't depend on which process runs it or on what earlier steps drew.
+ */
+void reseedStepRandomNumbers(long step) {
+  long i;
+
+  if (!initialized)
+    bombElegant("reseedStepRandomNumbers called before random numbers were seeded", NULL);
+  for (i = 0; i < N_ELEGANT_RANDOM_GENERATORS; i++)
+    randomElegant(i, -labs(savedRandomNumberSeed[i] + 2 * (step + 1) * 104729));
+  gaussianSaved = 0;
+}
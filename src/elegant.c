@@ -876,6 +876,10 @@ char **argv;
             bombElegant("default_order is out of range", NULL);
           if (concat_order > 3)
             bombElegant("concat_order is out of range", NULL);
+          if (polynomial_map_order && !concat_order)
+            bombElegant("polynomial_map_order requires nonzero concat_order", NULL);
+          if (polynomial_map_order < 0 || polynomial_map_order > TPSA_MAX_ORDER)
+            bombElegantVA("polynomial_map_order is out of range (0 to %d)", TPSA_MAX_ORDER);
           if (p_central && p_central_mev)
             bombElegant("give only one of p_central and p_central_mev", NULL);
           if (p_central_mev != 0 && p_central == 0)
@@ -896,6 +900,10 @@ char **argv;
           run_conditions.p_central = p_central;
           run_conditions.default_order = default_order;
           run_conditions.concat_order = concat_order;
+          run_conditions.concatAccuracyGuard = concat_accuracy_guard;
+          run_conditions.polynomialMapOrder = polynomial_map_order;
+          run_conditions.symplectifyPolynomialMap = symplectify_polynomial_map;
+          run_conditions.matrixTree = matrix_tree;
           run_conditions.print_statistics = print_statistics;
           run_conditions.combine_bunch_statistics = combine_bunch_statistics;
           run_conditions.wrap_around = wrap_around;
@@ -950,6 +958,11 @@ char **argv;
           run_conditions.centroid = compose_filename(centroid, rootname);
           run_conditions.bpmCentroid = compose_filename(bpm_centroid, rootname);
           run_conditions.sigma = compose_filename(sigma, rootname);
+          /* all processors take part in collecting profile data */
+          finishElementProfiler();
+          run_conditions.elementProfile = compose_filename(element_profile, rootname);
+          if ((run_conditions.elementProfileInterval = element_profile_interval) < 0)
+            bombElegant("element_profile_interval is negative", NULL);
 
           if (countIgnoreElementsSpecs(0) != 0) {
             if ((run_conditions.centroid && strlen(run_conditions.centroid)) ||
@@ -1143,6 +1156,16 @@ char **argv;
               if (fexists(run_conditions.trackingInterruptFile))
                 run_conditions.trackingInterruptFileMtime = get_mtime(run_conditions.trackingInterruptFile);
             }
+            run_conditions.checkpointFile = run_conditions.restartFile = NULL;
+            run_conditions.checkpointInterval = 0;
+            if (checkpoint && strlen(checkpoint)) {
+              if (checkpoint_interval <= 0)
+                bombElegant("checkpoint_interval must be positive when checkpoint is given", NULL);
+              run_conditions.checkpointFile = compose_filename(checkpoint, rootname);
+              run_conditions.checkpointInterval = checkpoint_interval;
+            }
+            if (restart_from && strlen(restart_from))
+              run_conditions.restartFile = compose_filename(restart_from, rootname);
             /*
 	      #if USE_MPI
 	      if (stop_tracking_particle_limit!=-1)
@@ -1176,7 +1199,10 @@ char **argv;
             soft_failure = !(run_control.terminate_on_failure);
           else
             soft_failure = 0;
+          startStepWorkers(&run_control, beamline, beam_type == SET_BUNCHED_BEAM && bunchedBeamFirstIsFiducial());
           while (vary_beamline(&run_control, &error_control, &run_conditions, beamline)) {
+            if (!stepWorkerOwnsStep())
+              continue;
             if (run_control.restartFiles)
               setup_output(output_data, &run_conditions, &run_control, &error_control, &optimize.variables, beamline);
             /* vary_beamline asserts changes due to vary_element, error_element, and load_parameters */
@@ -1432,6 +1458,7 @@ char **argv;
 #endif
             }
           }
+          finishStepWorkers();
           if (!run_control.restartFiles) {
             if (commandCode == TRACK)
               finish_output(output_data, &run_conditions, &run_control, &error_control, &optimize.variables,
@@ -1474,8 +1501,14 @@ char **argv;
           final_pass = 0;
           default_order = 2;
           concat_order = 0;
+          concat_accuracy_guard = 0;
+          polynomial_map_order = 0;
+          symplectify_polynomial_map = 1;
+          matrix_tree = 0;
           tracking_updates = 1;
           show_element_timing = monitor_memory_usage = 0;
+          element_profile = NULL;
+          element_profile_interval = 0;
           concat_order = print_statistics = p_central = 0;
           run_setuped = run_controled = error_controled = correction_setuped = do_chromatic_correction =
             fl_do_tune_correction = do_closed_orbit = do_twiss_output = do_coupled_twiss_output = do_response_output =
@@ -1591,8 +1624,14 @@ char **argv;
           final_pass = 0;
           default_order = 2;
           concat_order = 0;
+          concat_accuracy_guard = 0;
+          polynomial_map_order = 0;
+          symplectify_polynomial_map = 1;
+          matrix_tree = 0;
           tracking_updates = 1;
           show_element_timing = monitor_memory_usage = 0;
+          element_profile = NULL;
+          element_profile_interval = 0;
           concat_order = print_statistics = p_central = 0;
           run_setuped = run_controled = error_controled = correction_setuped = do_chromatic_correction =
             fl_do_tune_correction = do_closed_orbit = do_twiss_output = do_coupled_twiss_output = do_response_output =
@@ -1921,8 +1960,14 @@ char **argv;
           final_pass = 0;
           default_order = 2;
           concat_order = 0;
+          concat_accuracy_guard = 0;
+          polynomial_map_order = 0;
+          symplectify_polynomial_map = 1;
+          matrix_tree = 0;
           tracking_updates = 1;
           show_element_timing = monitor_memory_usage = 0;
+          element_profile = NULL;
+          element_profile_interval = 0;
           concat_order = print_statistics = p_central = 0;
           run_setuped = run_controled = error_controled = correction_setuped = do_chromatic_correction =
             fl_do_tune_correction = do_closed_orbit = do_twiss_output = do_coupled_twiss_output = do_response_output =
@@ -2020,8 +2065,14 @@ char **argv;
 	  final_pass = 0;
 	  default_order = 2;
 	  concat_order = 0;
+	  concat_accuracy_guard = 0;
+	  polynomial_map_order = 0;
+	  symplectify_polynomial_map = 1;
+	  matrix_tree = 0;
 	  tracking_updates = 1;
 	  show_element_timing = monitor_memory_usage = 0;
+	  element_profile = NULL;
+	  element_profile_interval = 0;
 	  concat_order = print_statistics = p_central = 0;
 	  run_setuped = run_controled = error_controled = correction_setuped = do_chromatic_correction =
 	    fl_do_tune_correction = do_closed_orbit = do_twiss_output = do_coupled_twiss_output = do_response_output = 
@@ -2162,6 +2213,7 @@ char **argv;
   fflush(stdout);
   lorentz_report();
   finish_load_parameters();
+  finishElementProfiler();
   free_beamdata(&beam);
   free(macroTag);
   free(macroValue);
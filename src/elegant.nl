@@ -42,8 +42,14 @@
     long final_pass = 0;
     long default_order = 2;
     long concat_order = 0;
+    long concat_accuracy_guard = 0;
+    long polynomial_map_order = 0;
+    long symplectify_polynomial_map = 1;
+    long matrix_tree = 0;
     long print_statistics = 0;
     long show_element_timing = 0;
+    STRING element_profile = NULL;
+    long element_profile_interval = 0;
     long monitor_memory_usage = 0;
     long random_number_seed = 987654321;
     long correction_iterations = 1;
@@ -79,6 +85,9 @@
     long stop_tracking_particle_limit = -1;
     long check_beam_structure = 0;
     STRING interrupt_file = "%s.interrupt";
+    STRING checkpoint = NULL;
+    long checkpoint_interval = 0;
+    STRING restart_from = NULL;
 #end
 
 #namelist print_dictionary static
@@ -0,0 +1,345 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: elementProfiler.c
+ * purpose: per-element-occurrence profiling of tracking, with SDDS output.
+ *
+ * Requested with run_setup element_profile=<filename>. For each element
+ * occurrence the profiler records the number of calls, the wall time, and
+ * the number of particles going in and out. Time spent in collective
+ * operations (MPI particle redistribution, wake and impedance convolutions,
+ * particle binning and histogram fills, and SDDS output) is also recorded
+ * where it is spent and charged to the element being tracked at the time;
+ * these are subsets of the element's total time. One page is written per tracking
+ * run, or every element_profile_interval passes if that is nonzero.
+ * In Pelegant, times are the maximum over processors and particle counts
+ * are summed.
+ */
+#include "mdb.h"
+#include "track.h"
+
+typedef struct {
+  ELEMENT_LIST *eptr;
+  long calls;
+  double time, particlesIn, particlesOut;
+  double collectiveTime[N_PROFILE_CATEGORIES];
+} ELEMENT_PROFILE;
+
+#define IC_NAME 0
+#define IC_OCCURENCE 1
+#define IC_TYPE 2
+#define IC_S 3
+#define IC_CALLS 4
+#define IC_TIME 5
+#define IC_TIME_PER_CALL 6
+#define IC_TIME_FRACTION 7
+#define IC_PARTICLES_IN 8
+#define IC_PARTICLES_LOST 9
+#define IC_MPI_TIME 10
+#define N_COLUMNS (IC_MPI_TIME + N_PROFILE_CATEGORIES)
+static SDDS_DEFINITION column_definition[N_COLUMNS] = {
+  {"ElementName", "&column name=ElementName, type=string &end"},
+  {"ElementOccurence", "&column name=ElementOccurence, type=long &end"},
+  {"ElementType", "&column name=ElementType, type=string &end"},
+  {"s", "&column name=s, units=m, type=double, description=\"Position at end of element\" &end"},
+  {"Calls", "&column name=Calls, type=long &end"},
+  {"Time", "&column name=Time, units=s, type=double, description=\"Wall time spent in element\" &end"},
+  {"TimePerCall", "&column name=TimePerCall, units=s, type=double &end"},
+  {"TimeFraction", "&column name=TimeFraction, type=double, description=\"Fraction of total element time\" &end"},
+  {"ParticlesIn", "&column name=ParticlesIn, type=double, description=\"Particles entering, summed over calls\" &end"},
+  {"ParticlesLost", "&column name=ParticlesLost, type=double, description=\"Particles lost, summed over calls\" &end"},
+  {"MPITime", "&column name=MPITime, units=s, type=double, description=\"Time in MPI particle redistribution\" &end"},
+  {"WakeTime", "&column name=WakeTime, units=s, type=double, description=\"Time computing wake and impedance voltages\" &end"},
+  {"HistogramTime", "&column name=HistogramTime, units=s, type=double, description=\"Time binning particles and filling histograms\" &end"},
+  {"OutputTime", "&column name=OutputTime, units=s, type=double, description=\"Time writing SDDS output\" &end"},
+};
+
+#define IP_STEP 0
+#define IP_FIRST_PASS 1
+#define IP_LAST_PASS 2
+#define IP_TOTAL_TIME 3
+#define IP_OTHER_MPI_TIME 4
+#define N_PARAMETERS (IP_OTHER_MPI_TIME + N_PROFILE_CATEGORIES)
+static SDDS_DEFINITION parameter_definition[N_PARAMETERS] = {
+  {"Step", "&parameter name=Step, type=long, description=\"Simulation step\" &end"},
+  {"FirstPass", "&parameter name=FirstPass, type=long &end"},
+  {"LastPass", "&parameter name=LastPass, type=long &end"},
+  {"TotalTime", "&parameter name=TotalTime, units=s, type=double, description=\"Total time in elements\" &end"},
+  {"OtherMPITime", "&parameter name=OtherMPITime, units=s, type=double, description=\"MPI time outside of elements\" &end"},
+  {"OtherWakeTime", "&parameter name=OtherWakeTime, units=s, type=double &end"},
+  {"OtherHistogramTime", "&parameter name=OtherHistogramTime, units=s, type=double &end"},
+  {"OtherOutputTime", "&parameter name=OtherOutputTime, units=s, type=double &end"},
+};
+
+static SDDS_DATASET SDDS_profile;
+static char *profileFile = NULL, *profileRunfile = NULL, *profileLattice = NULL;
+static short profileFileOpen = 0;
+static long profileInterval = 0;
+
+static ELEMENT_PROFILE *profile = NULL;
+static long nProfile = 0, maxProfile = 0;
+static ELEMENT_PROFILE *current = NULL;
+static double otherCollectiveTime[N_PROFILE_CATEGORIES];
+static double elementStartTime, collectiveStartTime[N_PROFILE_CATEGORIES];
+static short collectiveDepth[N_PROFILE_CATEGORIES];
+static long profileStep, firstPass, lastPass;
+static short profilerActive = 0;
+
+static void resetElementProfileData() {
+  long i, j;
+  for (i = 0; i < nProfile; i++) {
+    profile[i].calls = 0;
+    profile[i].time = profile[i].particlesIn = profile[i].particlesOut = 0;
+    for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+      profile[i].collectiveTime[j] = 0;
+  }
+  for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+    otherCollectiveTime[j] = 0;
+  firstPass = -1;
+}
+
+static void writeElementProfilePage() {
+  long i, j, row, calls;
+  double totalTime, *buffer;
+#if USE_MPI
+  double *reduced;
+#endif
+
+  if (firstPass < 0)
+    return;
+
+  buffer = tmalloc(sizeof(*buffer) * (nProfile * (4 + N_PROFILE_CATEGORIES) + N_PROFILE_CATEGORIES));
+  for (i = 0; i < nProfile; i++) {
+    buffer[i * (4 + N_PROFILE_CATEGORIES) + 0] = profile[i].calls;
+    buffer[i * (4 + N_PROFILE_CATEGORIES) + 1] = profile[i].time;
+    buffer[i * (4 + N_PROFILE_CATEGORIES) + 2] = profile[i].particlesIn;
+    buffer[i * (4 + N_PROFILE_CATEGORIES) + 3] = profile[i].particlesOut;
+    for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+      buffer[i * (4 + N_PROFILE_CATEGORIES) + 4 + j] = profile[i].collectiveTime[j];
+  }
+  for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+    buffer[nProfile * (4 + N_PROFILE_CATEGORIES) + j] = otherCollectiveTime[j];
+#if USE_MPI
+  if (notSinglePart) {
+    long n;
+    double *counts, *countsSum;
+    n = nProfile * (4 + N_PROFILE_CATEGORIES) + N_PROFILE_CATEGORIES;
+    reduced = tmalloc(sizeof(*reduced) * n);
+    counts = tmalloc(sizeof(*counts) * 2 * nProfile);
+    countsSum = tmalloc(sizeof(*countsSum) * 2 * nProfile);
+    for (i = 0; i < nProfile; i++) {
+      counts[2 * i] = profile[i].particlesIn;
+      counts[2 * i + 1] = profile[i].particlesOut;
+    }
+    /* times and calls are the maximum over processors, particle counts are summed */
+    MPI_Reduce(buffer, reduced, n, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(counts, countsSum, 2 * nProfile, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    for (i = 0; i < nProfile; i++) {
+      reduced[i * (4 + N_PROFILE_CATEGORIES) + 2] = countsSum[2 * i];
+      reduced[i * (4 + N_PROFILE_CATEGORIES) + 3] = countsSum[2 * i + 1];
+    }
+    free(counts);
+    free(countsSum);
+    free(buffer);
+    buffer = reduced;
+  }
+  if (myid != 0) {
+    free(buffer);
+    resetElementProfileData();
+    return;
+  }
+#endif
+
+  if (!profileFileOpen) {
+    SDDS_ElegantOutputSetup(&SDDS_profile, profileFile, SDDS_BINARY, 1, "element profile",
+                            profileRunfile, profileLattice, parameter_definition, N_PARAMETERS,
+                            column_definition, N_COLUMNS, "writeElementProfilePage", SDDS_EOS_NEWFILE);
+    if (!SDDS_WriteLayout(&SDDS_profile)) {
+      SDDS_SetError("Unable to write SDDS layout for element profile");
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+    }
+    profileFileOpen = 1;
+  }
+
+  totalTime = 0;
+  for (i = 0; i < nProfile; i++)
+    totalTime += buffer[i * (4 + N_PROFILE_CATEGORIES) + 1];
+  if (!SDDS_StartPage(&SDDS_profile, nProfile) ||
+      !SDDS_SetParameters(&SDDS_profile, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                          IP_STEP, profileStep, IP_FIRST_PASS, firstPass, IP_LAST_PASS, lastPass,
+                          IP_TOTAL_TIME, totalTime, -1)) {
+    SDDS_SetError("Unable to start SDDS page (writeElementProfilePage)");
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+  }
+  for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+    if (!SDDS_SetParameters(&SDDS_profile, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE,
+                            IP_OTHER_MPI_TIME + j, buffer[nProfile * (4 + N_PROFILE_CATEGORIES) + j], -1)) {
+      SDDS_SetError("Unable to set SDDS parameters (writeElementProfilePage)");
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+    }
+  for (i = row = 0; i < nProfile; i++) {
+    double *data;
+    data = buffer + i * (4 + N_PROFILE_CATEGORIES);
+    if (!(calls = data[0]))
+      continue;
+    if (!SDDS_SetRowValues(&SDDS_profile, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, row,
+                           IC_NAME, profile[i].eptr->name,
+                           IC_OCCURENCE, profile[i].eptr->occurence,
+                           IC_TYPE, entity_name[profile[i].eptr->type],
+                           IC_S, profile[i].eptr->end_pos,
+                           IC_CALLS, calls,
+                           IC_TIME, data[1],
+                           IC_TIME_PER_CALL, data[1] / calls,
+                           IC_TIME_FRACTION, totalTime > 0 ? data[1] / totalTime : 0.0,
+                           IC_PARTICLES_IN, data[2],
+                           IC_PARTICLES_LOST, data[2] - data[3],
+                           -1)) {
+      SDDS_SetError("Problem setting SDDS row values (writeElementProfilePage)");
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+    }
+    for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+      if (!SDDS_SetRowValues(&SDDS_profile, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, row,
+                             IC_MPI_TIME + j, data[4 + j], -1)) {
+        SDDS_SetError("Problem setting SDDS row values (writeElementProfilePage)");
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+      }
+    row++;
+  }
+  if (!SDDS_WritePage(&SDDS_profile)) {
+    SDDS_SetError("Problem writing SDDS page (writeElementProfilePage)");
+    SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+  }
+  if (!inhibitFileSync)
+    SDDS_DoFSync(&SDDS_profile);
+  free(buffer);
+  resetElementProfileData();
+}
+
+/* Called by do_tracking() before the first pass. Returns 1 if this tracking run is
+ * profiled, in which case elementProfilerEnd() must be called afterwards. Nested
+ * calls (e.g., tracking done by an element) are included in the enclosing element.
+ */
+long elementProfilerBegin(RUN *run, LINE_LIST *beamline, long step) {
+  ELEMENT_LIST *eptr;
+  long i, n;
+
+  if (!run->elementProfile || profilerActive)
+    return 0;
+  if (profileFile && strcmp(profileFile, run->elementProfile) != 0)
+    finishElementProfiler();
+  if (!profileFile)
+    cp_str(&profileFile, run->elementProfile);
+  profileInterval = run->elementProfileInterval;
+  profileRunfile = run->runfile;
+  profileLattice = run->lattice;
+
+  /* one slot per element occurrence, in beamline order */
+  for (n = 0, eptr = beamline->elem; eptr; eptr = eptr->succ)
+    n++;
+  if (n > maxProfile)
+    profile = trealloc(profile, sizeof(*profile) * (maxProfile = n));
+  for (i = 0, eptr = beamline->elem; eptr; eptr = eptr->succ, i++)
+    profile[i].eptr = eptr;
+  nProfile = n;
+  resetElementProfileData();
+  profileStep = step;
+  current = NULL;
+  profilerActive = 1;
+  return 1;
+}
+
+void elementProfilerStartElement(ELEMENT_LIST *eptr, long nParticles) {
+  static long hint = 0;
+  long i;
+  if (!profilerActive)
+    return;
+  /* elements are normally visited in order, so the next slot is usually the right one */
+  current = NULL;
+  if (hint < nProfile && profile[hint].eptr == eptr)
+    current = profile + hint;
+  else
+    for (i = 0; i < nProfile; i++)
+      if (profile[i].eptr == eptr) {
+        current = profile + i;
+        break;
+      }
+  if (!current)
+    return;
+  hint = current - profile + 1;
+  current->particlesIn += nParticles;
+  elementStartTime = delapsed_time();
+}
+
+void elementProfilerEndElement(long nParticles) {
+  double dt;
+  if (!profilerActive || !current)
+    return;
+  dt = delapsed_time() - elementStartTime;
+  current->time += dt;
+  current->calls++;
+  current->particlesOut += nParticles;
+  current = NULL;
+}
+
+/* Brackets a collective operation within tracking. The time is charged to the element
+ * being tracked, if any. Nested brackets of the same category are counted once.
+ */
+void elementProfilerStartCollective(long category) {
+  if (!profilerActive || category < 0 || category >= N_PROFILE_CATEGORIES)
+    return;
+  if (collectiveDepth[category]++ == 0)
+    collectiveStartTime[category] = delapsed_time();
+}
+
+void elementProfilerEndCollective(long category) {
+  double dt;
+  if (!profilerActive || category < 0 || category >= N_PROFILE_CATEGORIES || collectiveDepth[category] <= 0)
+    return;
+  if (--collectiveDepth[category] != 0)
+    return;
+  dt = delapsed_time() - collectiveStartTime[category];
+  if (current)
+    current->collectiveTime[category] += dt;
+  else
+    otherCollectiveTime[category] += dt;
+}
+
+void elementProfilerEndPass(long pass) {
+  if (!profilerActive)
+    return;
+  if (firstPass < 0)
+    firstPass = pass;
+  lastPass = pass;
+  if (profileInterval > 0 && (lastPass - firstPass + 1) >= profileInterval)
+    writeElementProfilePage();
+}
+
+void elementProfilerEnd() {
+  long j;
+  if (!profilerActive)
+    return;
+  writeElementProfilePage();
+  for (j = 0; j < N_PROFILE_CATEGORIES; j++)
+    collectiveDepth[j] = 0;
+  current = NULL;
+  profilerActive = 0;
+}
+
+void finishElementProfiler() {
+  if (profileFileOpen) {
+    if (!SDDS_Terminate(&SDDS_profile)) {
+      SDDS_SetError("Problem terminating SDDS output (finishElementProfiler)");
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+    }
+    profileFileOpen = 0;
+  }
+  if (profileFile)
+    free(profileFile);
+  profileFile = NULL;
+}
@@ -499,7 +499,7 @@ double perturbation(double xamplitude, double xcutoff, long xerror_type, long sa
   case UNIFORM_ERRORS:
     return (2 * xamplitude * (random_1_elegant(0) - 0.5));
   case GAUSSIAN_ERRORS:
-    return (gauss_rn_lim(0.0, xamplitude, xcutoff, random_1_elegant));
+    return (gauss_rn_lim_elegant(0.0, xamplitude, xcutoff, random_1_elegant));
   case PLUS_OR_MINUS_ERRORS:
     /* return either -x or x */
     return (xamplitude * (random_1_elegant(0) > 0.5 ? 1.0 : -1.0));
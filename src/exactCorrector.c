@@ -321,7 +321,7 @@ void computeTotalSteeringMultipoleErrors(MULTIPOLE_DATA *systematicMult, double
       bombElegantVA("Error: order mismatch for STEERING_MULTIPOLES and RANDOM_MULTIPOLES for EVKICK %s\n",
                     name);
     totalMult->order[i] = randomMult->order[i];
-    totalMult->KnL[i] = systematicMult->KnL[i] * sysFactor + gauss_rn_lim(0.0, 1.0, 2.0, random_1_elegant) * randomMult->KnL[i] * ranFactor;
-    totalMult->JnL[i] = systematicMult->JnL[i] * sysFactor + gauss_rn_lim(0.0, 1.0, 2.0, random_1_elegant) * randomMult->JnL[i] * ranFactor;
+    totalMult->KnL[i] = systematicMult->KnL[i] * sysFactor + gauss_rn_lim_elegant(0.0, 1.0, 2.0, random_1_elegant) * randomMult->KnL[i] * ranFactor;
+    totalMult->JnL[i] = systematicMult->JnL[i] * sysFactor + gauss_rn_lim_elegant(0.0, 1.0, 2.0, random_1_elegant) * randomMult->JnL[i] * ranFactor;
   }
 }
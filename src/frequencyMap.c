@@ -56,6 +56,11 @@ static SDDS_DEFINITION parameter_definition[N_PARAMETERS] = {
 
 static SDDS_DATASET SDDS_fmap;
 
+typedef struct {
+  double x, y, delta;
+  long ix, iy, idelta;
+} FMAP_GRID_POINT;
+
 void setupFrequencyMap(
   NAMELIST_TEXT *nltext,
   RUN *run,
@@ -127,10 +132,15 @@ long doFrequencyMap(
   double *referenceCoord,
   ERRORVAL *errcon,
   LINE_LIST *beamline) {
-  double firstTune[2], secondTune[2], startingCoord[6], endingCoord[6];
+  double firstTune[2], secondTune[2];
   double firstAmplitude[2], secondAmplitude[2];
   double dx, dy, ddelta, x, y, delta;
   long ix, iy, idelta, ip, turns;
+  FMAP_GRID_POINT *gridPoint;
+  long nPoints, batchSize, nBatch, iPoint0, ib, n2, i2;
+  double **batchStart, **batchEnd, **batchEnd2, **batchTune1, **batchAmp1, **batchTune2, **batchAmp2;
+  short *status1, *status2;
+  long *index2;
   static double **one_part;
   double p;
   long n_part, badPoint;
@@ -211,6 +221,9 @@ long doFrequencyMap(
     turns = control->n_passes;
   else
     turns = control->n_passes / 2;
+  /* Make the list of grid points handled by this processor */
+  gridPoint = tmalloc(sizeof(*gridPoint) * ndelta * nx * ny);
+  nPoints = 0;
   for (idelta = 0; idelta < ndelta; idelta++) {
     delta = delta_min + idelta * ddelta;
     for (ix = 0; ix < nx; ix++) {
@@ -225,117 +238,194 @@ long doFrequencyMap(
         } else {
           y = ymin + iy * dy;
         }
-        memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
 #if USE_MPI
         if (myid == (idelta * nx * ny + ix * ny + iy) % n_processors) /* Partition the job according to particle ID */
 #endif
         {
+          gridPoint[nPoints].x = x;
+          gridPoint[nPoints].y = y;
+          gridPoint[nPoints].delta = delta;
+          gridPoint[nPoints].ix = ix;
+          gridPoint[nPoints].iy = iy;
+          gridPoint[nPoints].idelta = idelta;
+          nPoints++;
+        }
+      }
+    }
+  }
+
+  /* Grid points are tracked together in batches of this size */
+  if ((batchSize = particles_per_batch) <= 0 || batchSize > nPoints)
+    batchSize = nPoints;
+  if (batchSize < 1)
+    batchSize = 1;
+  batchStart = (double **)czarray_2d(sizeof(**batchStart), batchSize, 6);
+  batchEnd = (double **)czarray_2d(sizeof(**batchEnd), batchSize, 6);
+  batchTune1 = (double **)czarray_2d(sizeof(**batchTune1), batchSize, 2);
+  batchAmp1 = (double **)czarray_2d(sizeof(**batchAmp1), batchSize, 2);
+  batchTune2 = (double **)czarray_2d(sizeof(**batchTune2), batchSize, 2);
+  batchAmp2 = (double **)czarray_2d(sizeof(**batchAmp2), batchSize, 2);
+  batchEnd2 = tmalloc(sizeof(*batchEnd2) * batchSize);
+  status1 = tmalloc(sizeof(*status1) * batchSize);
+  status2 = tmalloc(sizeof(*status2) * batchSize);
+  index2 = tmalloc(sizeof(*index2) * batchSize);
+
+  for (iPoint0 = 0; iPoint0 < nPoints; iPoint0 += nBatch) {
+    if ((nBatch = nPoints - iPoint0) > batchSize)
+      nBatch = batchSize;
 #if USE_MPI
-          if (fpd) {
-            fprintf(fpd, "*** Starting tracking for idelta = %ld, ix = %ld, iy = %ld\n", idelta, ix, iy);
-            fflush(fpd);
-          }
+    if (fpd) {
+      fprintf(fpd, "*** Starting tracking for %ld particles, idelta = %ld, ix = %ld, iy = %ld\n", nBatch,
+              gridPoint[iPoint0].idelta, gridPoint[iPoint0].ix, gridPoint[iPoint0].iy);
+      fflush(fpd);
+    }
+#endif
+    for (ib = 0; ib < nBatch; ib++) {
+      memcpy(batchStart[ib], referenceCoord, sizeof(**batchStart) * 6);
+      batchStart[ib][2] += gridPoint[iPoint0 + ib].y;
+      batchStart[ib][0] += gridPoint[iPoint0 + ib].x;
+      batchStart[ib][5] += gridPoint[iPoint0 + ib].delta;
+      batchEnd[ib][4] = 0;
+    }
+    computeTunesFromTrackingMulti(batchTune1, batchAmp1, status1, beamline, run,
+                                  batchStart, nBatch, turns, 0, batchEnd, NULL, NULL, 1,
+                                  CTFT_INCLUDE_X | CTFT_INCLUDE_Y);
+    n2 = 0;
+    for (ib = 0; ib < nBatch; ib++) {
+      if (status1[ib] &&
+          (batchTune1[ib][0] > 1.0 || batchTune1[ib][0] < 0 || batchTune1[ib][1] > 1.0 || batchTune1[ib][1] < 0))
+        status1[ib] = 0;
+      index2[ib] = -1;
+      if (status1[ib]) {
+        index2[ib] = n2;
+        batchEnd2[n2++] = batchEnd[ib];
+      }
+    }
+    if (include_changes && n2) {
+#if USE_MPI
+      if (fpd) {
+        fprintf(fpd, "    Starting tracking for changes\n");
+        fflush(fpd);
+      }
 #endif
-          badPoint = 0;
-          if (!computeTunesFromTracking(firstTune, firstAmplitude,
-                                        beamline->matrix, beamline, run,
-                                        startingCoord, x, y, delta, turns,
-                                        0, endingCoord, NULL, NULL, 1, 1, CTFT_INCLUDE_X | CTFT_INCLUDE_Y) ||
-              firstTune[0] > 1.0 || firstTune[0] < 0 || firstTune[1] > 1.0 || firstTune[1] < 0) {
+      computeTunesFromTrackingMulti(batchTune2, batchAmp2, status2, beamline, run,
+                                    batchEnd2, n2, turns, turns, NULL, NULL, NULL, 1,
+                                    CTFT_INCLUDE_X | CTFT_INCLUDE_Y);
+    }
+
+    for (ib = 0; ib < nBatch; ib++) {
+      x = gridPoint[iPoint0 + ib].x;
+      y = gridPoint[iPoint0 + ib].y;
+      delta = gridPoint[iPoint0 + ib].delta;
+      ix = gridPoint[iPoint0 + ib].ix;
+      iy = gridPoint[iPoint0 + ib].iy;
+      idelta = gridPoint[iPoint0 + ib].idelta;
+      badPoint = 0;
+      if (status1[ib]) {
+        firstTune[0] = batchTune1[ib][0];
+        firstTune[1] = batchTune1[ib][1];
+        firstAmplitude[0] = batchAmp1[ib][0];
+        firstAmplitude[1] = batchAmp1[ib][1];
+      } else {
+        if (verbosity && !USE_MPI)
+          printf("Problem with particle %ld tune determination\n", ip);
+        badPoint = 1;
+        firstTune[0] = firstTune[1] = -1;
+        if (!full_grid_output)
+          continue;
+      }
+      if (!SDDS_SetRowValues(&SDDS_fmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
+                             IC_X, x, IC_Y, y, IC_DELTA, delta,
+                             IC_NUX, firstTune[0],
+                             IC_NUY, firstTune[1],
+                             IC_S, batchEnd[ib][4] / turns,
+                             -1)) {
+        SDDS_SetError("Problem setting SDDS row values (doFrequencyMap)");
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+      }
+      if (include_changes) {
+        secondTune[0] = firstTune[0];
+        secondTune[1] = firstTune[1];
+        secondAmplitude[0] = firstAmplitude[0];
+        secondAmplitude[1] = firstAmplitude[1];
+        diffusion = 0;
+        if (!badPoint) {
+          i2 = index2[ib];
+          if (status2[i2]) {
+            secondTune[0] = batchTune2[i2][0];
+            secondTune[1] = batchTune2[i2][1];
+            secondAmplitude[0] = batchAmp2[i2][0];
+            secondAmplitude[1] = batchAmp2[i2][1];
+          }
+          if (!status2[i2] ||
+              secondTune[0] > 1.0 || secondTune[0] < 0 || secondTune[1] > 1.0 || secondTune[1] < 0) {
             if (verbosity && !USE_MPI)
               printf("Problem with particle %ld tune determination\n", ip);
-            badPoint = 1;
-            firstTune[0] = firstTune[1] = -1;
-            /* firstTune[1] = firstTune[1] = -1; */
-            if (!full_grid_output)
+            if (!full_grid_output) {
+              /* If the particle is lost, it will not show in the frequency map */
+              if (SDDS_fmap.n_rows)
+                SDDS_fmap.n_rows--;
               continue;
-          }
-          if (!SDDS_SetRowValues(&SDDS_fmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
-                                 IC_X, x, IC_Y, y, IC_DELTA, delta,
-                                 IC_NUX, firstTune[0],
-                                 IC_NUY, firstTune[1],
-                                 IC_S, endingCoord[4] / turns,
-                                 -1)) {
-            SDDS_SetError("Problem setting SDDS row values (doFrequencyMap)");
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
-          }
-          if (include_changes) {
-#if USE_MPI
-            if (fpd) {
-              fprintf(fpd, "    Starting tracking for changes\n");
-              fflush(fpd);
             }
-#endif
-            secondTune[0] = firstTune[0];
-            secondTune[1] = firstTune[1];
-            secondAmplitude[0] = firstAmplitude[0];
-            secondAmplitude[1] = firstAmplitude[1];
-            diffusion = 0;
-            if (!badPoint) {
-              memcpy(startingCoord, endingCoord, sizeof(*startingCoord) * 6);
-              if (!computeTunesFromTracking(secondTune, secondAmplitude,
-                                            beamline->matrix, beamline, run,
-                                            startingCoord, 0.0, 0.0, 0.0, turns, turns,
-                                            endingCoord, NULL, NULL, 1, 1,
-                                            CTFT_INCLUDE_X | CTFT_INCLUDE_Y) ||
-                  secondTune[0] > 1.0 || secondTune[0] < 0 || secondTune[1] > 1.0 || secondTune[1] < 0) {
-                if (verbosity && !USE_MPI)
-                  printf("Problem with particle %ld tune determination\n", ip);
-                if (!full_grid_output) {
-                  /* If the particle is lost, it will not show in the frequency map */
-                  if (SDDS_fmap.n_rows)
-                    SDDS_fmap.n_rows--;
-                  continue;
-                }
-              } else
-                diffusion = log10(sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1]));
-            }
-            if (!SDDS_SetRowValues(&SDDS_fmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
-                                   IC_DNUX, fabs(secondTune[0] - firstTune[0]),
-                                   IC_DNUY, fabs(secondTune[1] - firstTune[1]),
-                                   IC_DNU,
-                                   sqrt(sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1])),
-                                   IC_DX, fabs(firstAmplitude[0] - secondAmplitude[0]),
-                                   IC_DY, fabs(firstAmplitude[1] - secondAmplitude[1]),
-                                   IC_DIFFUSION,
-                                   diffusion,
-                                   IC_DIFFUSION_RATE,
-                                   diffusion == 0 ? 0 : diffusion / 2 - log10(turns),
-                                   -1)) {
-              SDDS_SetError("Problem setting SDDS row values (doFrequencyMap)");
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
-            }
-          }
-          ip++;
-          if (verbosity) {
+          } else
+            diffusion = log10(sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1]));
+        }
+        if (!SDDS_SetRowValues(&SDDS_fmap, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, ip,
+                               IC_DNUX, fabs(secondTune[0] - firstTune[0]),
+                               IC_DNUY, fabs(secondTune[1] - firstTune[1]),
+                               IC_DNU,
+                               sqrt(sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1])),
+                               IC_DX, fabs(firstAmplitude[0] - secondAmplitude[0]),
+                               IC_DY, fabs(firstAmplitude[1] - secondAmplitude[1]),
+                               IC_DIFFUSION,
+                               diffusion,
+                               IC_DIFFUSION_RATE,
+                               diffusion == 0 ? 0 : diffusion / 2 - log10(turns),
+                               -1)) {
+          SDDS_SetError("Problem setting SDDS row values (doFrequencyMap)");
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+        }
+      }
+      ip++;
+      if (verbosity) {
 #if USE_MPI
-            if (fpd) {
-              fprintf(fpd, "    Completed particle\n");
-              fflush(fpd);
-            }
-            if (myid == 1) {
-              double newPercentage = 100 * (idelta * nx * ny + ix * ny + iy + 1.0) / (ndelta * nx * ny);
-              if ((newPercentage - oldPercentage) >= 1) {
-                double dt = delapsed_time();
-                printf("About %.1f%% done after %lg s wall time, completion expected in about %lg s\n", newPercentage, dt,
-                       dt / (0.01 * newPercentage + 1e-16) - dt);
-                if (oldPercentage > 0.5 && newPercentage < 0.5 && (newPercentage - oldPercentage) < 3)
-                  printf("Don't you have something more interesting to do besides watching this?\n");
-                oldPercentage = newPercentage;
-                fflush(stdout);
-              }
-            }
-#else
-            printf("Done with particle %ld of %ld\n",
-                   ix * ny * ndelta + iy * ndelta + idelta + 1, nx * ny * ndelta);
+        if (fpd) {
+          fprintf(fpd, "    Completed particle\n");
+          fflush(fpd);
+        }
+        if (myid == 1) {
+          double newPercentage = 100 * (idelta * nx * ny + ix * ny + iy + 1.0) / (ndelta * nx * ny);
+          if ((newPercentage - oldPercentage) >= 1) {
+            double dt = delapsed_time();
+            printf("About %.1f%% done after %lg s wall time, completion expected in about %lg s\n", newPercentage, dt,
+                   dt / (0.01 * newPercentage + 1e-16) - dt);
+            if (oldPercentage > 0.5 && newPercentage < 0.5 && (newPercentage - oldPercentage) < 3)
+              printf("Don't you have something more interesting to do besides watching this?\n");
+            oldPercentage = newPercentage;
             fflush(stdout);
-#endif
           }
         }
+#else
+        printf("Done with particle %ld of %ld\n",
+               ix * ny * ndelta + iy * ndelta + idelta + 1, nx * ny * ndelta);
+        fflush(stdout);
+#endif
       }
     }
   }
 
+  free(gridPoint);
+  free_czarray_2d((void **)batchStart, batchSize, 6);
+  free_czarray_2d((void **)batchEnd, batchSize, 6);
+  free_czarray_2d((void **)batchTune1, batchSize, 2);
+  free_czarray_2d((void **)batchAmp1, batchSize, 2);
+  free_czarray_2d((void **)batchTune2, batchSize, 2);
+  free_czarray_2d((void **)batchAmp2, batchSize, 2);
+  free(batchEnd2);
+  free(status1);
+  free(status2);
+  free(index2);
+
 #if USE_MPI
   if (fpd) {
     fprintf(fpd, "*** Completed work for processor.\n");
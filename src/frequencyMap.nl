@@ -20,5 +20,6 @@
     long include_changes = 0;
     long quadratic_spacing = 0;
     long full_grid_output = 0;
+    long particles_per_batch = 1;
 #end
 
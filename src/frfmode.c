@@ -227,6 +227,7 @@ void track_through_frfmode(
         fflush(stdout);
 #endif
 
+        elementProfilerStartCollective(PROFILE_HISTOGRAM);
         for (ib = 0; ib < rfmode->n_bins; ib++) {
           Ihist[ib] = 0;
           Vbin[ib] = 0;
@@ -259,6 +260,7 @@ void track_through_frfmode(
             firstBin = ib;
           n_binned++;
         }
+        elementProfilerEndCollective(PROFILE_HISTOGRAM);
 #ifdef DEBUG
         printf("Binned %ld particles\n", n_binned);
         fflush(stdout);
@@ -304,6 +306,7 @@ void track_through_frfmode(
     if (isSlave || !notSinglePart) {
       tPrevious = rfmode->last_t;
 
+      elementProfilerStartCollective(PROFILE_WAKE);
       for (ib = firstBin; ib <= lastBin; ib++) {
         t = tmin + (ib + 0.5) * dt; /* middle arrival time for this bin */
         if (!Ihist[ib])
@@ -368,6 +371,7 @@ void track_through_frfmode(
         }
         rfmode->last_t = t;
       }
+      elementProfilerEndCollective(PROFILE_WAKE);
 
       if (rfmode->rigid_until_pass <= pass) {
         /* change particle momentum offsets to reflect voltage in relevant bin */
@@ -389,9 +393,11 @@ void track_through_frfmode(
                                  SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, pass,
                                  "Pass", pass, NULL))
             SDDS_Bomb("Problem writing data to FRFMODE output file");
+          elementProfilerStartCollective(PROFILE_OUTPUT);
           if ((rfmode->flushInterval < 1 || pass % rfmode->flushInterval == 0 || pass == (n_passes - 1)) &&
               !SDDS_UpdatePage(rfmode->SDDSout, 0))
             SDDS_Bomb("Problem writing data to FRFMODE output file");
+          elementProfilerEndCollective(PROFILE_OUTPUT);
 #if USE_MPI
         }
 #endif
@@ -275,6 +275,7 @@ void track_through_ftrfmode(
 #endif
         lastBin = -1;
         firstBin = trfmode->n_bins;
+        elementProfilerStartCollective(PROFILE_HISTOGRAM);
         for (ib = 0; ib < trfmode->n_bins; ib++)
           xsum[ib] = ysum[ib] = count[ib] = 0;
 
@@ -296,6 +297,7 @@ void track_through_ftrfmode(
               firstBin = ib;
           }
         }
+        elementProfilerEndCollective(PROFILE_HISTOGRAM);
       }
 #ifdef DEBUG
       printf("firstBin = %ld, lastBin = %ld\n", firstBin, lastBin);
@@ -360,6 +362,7 @@ void track_through_ftrfmode(
     if (isSlave) {
       double last_t = trfmode->last_t; /* Save it and use it later for different modes */
 
+      elementProfilerStartCollective(PROFILE_WAKE);
       for (ib = firstBin; ib <= lastBin; ib++)
         Vxbin[ib] = Vybin[ib] = Vzbin[ib] = 0;
       for (imode = 0; imode < trfmode->modes; imode++) {
@@ -458,6 +461,7 @@ void track_through_ftrfmode(
           trfmode->last_t = t;
         } /* loop over bins */
       }   /* loop over modes */
+      elementProfilerEndCollective(PROFILE_WAKE);
 
 #ifdef DEBUG
       if (fpdeb) {
@@ -520,9 +524,11 @@ void track_through_ftrfmode(
                              SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE, pass,
                              "Pass", pass, NULL))
         SDDS_Bomb("Problem writing data to FTRFMODE output file");
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if ((trfmode->flushInterval < 1 || pass % trfmode->flushInterval == 0 || pass == (n_passes - 1)) &&
           !SDDS_UpdatePage(trfmode->SDDSout, 0))
         SDDS_Bomb("Problem writing data to FTRFMODE output file");
+      elementProfilerEndCollective(PROFILE_OUTPUT);
     }
 #if USE_MPI
   }
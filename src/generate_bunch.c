@@ -418,14 +418,14 @@ long generate_bunch(
       for (j = 0; j < n_particles; j++)
         randomizedData[j] = particle[j][2 * i];
       randomizeOrder((char *)randomizedData, sizeof(*randomizedData), n_particles, 0,
-                     random_4);
+                     random_4_elegant);
       for (j = 0; j < n_particles; j++)
         particle[j][2 * i] = randomizedData[j];
 
       for (j = 0; j < n_particles; j++)
         randomizedData[j] = particle[j][2 * i + 1];
       randomizeOrder((char *)randomizedData, sizeof(*randomizedData), n_particles, 0,
-                     random_4);
+                     random_4_elegant);
       for (j = 0; j < n_particles; j++)
         particle[j][2 * i + 1] = randomizedData[j];
       free(randomizedData);
@@ -439,7 +439,7 @@ long generate_bunch(
         randomizedData[2 * j + 1] = particle[j][2 * i + 1];
       }
       randomizeOrder((char *)randomizedData, 2 * sizeof(*randomizedData), n_particles, 0,
-                     random_4);
+                     random_4_elegant);
       for (j = 0; j < n_particles; j++) {
         particle[j][2 * i] = randomizedData[2 * j];
         particle[j][2 * i + 1] = randomizedData[2 * j + 1];
@@ -630,8 +630,8 @@ void gaussian_distribution(
   } else {
     for (i_particle = 0; i_particle < n_particles; i_particle++) {
       do {
-        particle[i_particle][0 + offset] = x1 = gauss_rn_lim(0.0, s1, 0.0, random_4);
-        particle[i_particle][1 + offset] = x2 = gauss_rn_lim(0.0, s2, 0.0, random_4);
+        particle[i_particle][0 + offset] = x1 = gauss_rn_lim_elegant(0.0, s1, 0.0, random_4_elegant);
+        particle[i_particle][1 + offset] = x2 = gauss_rn_lim_elegant(0.0, s2, 0.0, random_4_elegant);
         if (limit_invar)
           flag = (sqr(x1) + sqr(beta * x2)) <= limit_invar;
         else
@@ -716,8 +716,8 @@ void uniform_distribution(
         rnd1 -= 0.5;
         rnd2 -= 0.5;
       } else {
-        rnd1 = random_4(1) - .5;
-        rnd2 = random_4(1) - .5;
+        rnd1 = random_4_elegant(1) - .5;
+        rnd2 = random_4_elegant(1) - .5;
       }
     } while (rnd2 * rnd2 + rnd1 * rnd1 > .25);
 #if !SDDS_MPI_IO
@@ -903,8 +903,8 @@ void hard_edge_distribution(
       rnd1 -= 0.5;
       rnd2 -= 0.5;
     } else {
-      rnd1 = random_4(1) - .5;
-      rnd2 = random_4(1) - .5;
+      rnd1 = random_4_elegant(1) - .5;
+      rnd2 = random_4_elegant(1) - .5;
     }
 #if SDDS_MPI_IO
     if ((i_particle >= start_particle) && (i_particle < end_particle)) {
@@ -1254,10 +1254,10 @@ void gaussian_4d_distribution(
   cutoff2 = sqr(cutoff);
   for (i_particle = 0; i_particle < n_particles; i_particle++) {
     do {
-      x1 = gauss_rn_lim(0.0, 1.0, 0.0, random_4);
-      x2 = gauss_rn_lim(0.0, 1.0, 0.0, random_4);
-      x3 = gauss_rn_lim(0.0, 1.0, 0.0, random_4);
-      x4 = gauss_rn_lim(0.0, 1.0, 0.0, random_4);
+      x1 = gauss_rn_lim_elegant(0.0, 1.0, 0.0, random_4_elegant);
+      x2 = gauss_rn_lim_elegant(0.0, 1.0, 0.0, random_4_elegant);
+      x3 = gauss_rn_lim_elegant(0.0, 1.0, 0.0, random_4_elegant);
+      x4 = gauss_rn_lim_elegant(0.0, 1.0, 0.0, random_4_elegant);
       flag = sqr(x1) + sqr(x2) + sqr(x3) + sqr(x4) <= cutoff2;
       if ((!halo && flag) || (halo && !flag))
         break;
@@ -1291,10 +1291,10 @@ void uniform_4d_distribution(
 
   for (i_particle = 0; i_particle < n_particles; i_particle++) {
     do {
-      rnd1 = random_4(1) - .5;
-      rnd2 = random_4(1) - .5;
-      rnd3 = random_4(1) - .5;
-      rnd4 = random_4(1) - .5;
+      rnd1 = random_4_elegant(1) - .5;
+      rnd2 = random_4_elegant(1) - .5;
+      rnd3 = random_4_elegant(1) - .5;
+      rnd4 = random_4_elegant(1) - .5;
     } while (rnd1 * rnd1 + rnd2 * rnd2 + rnd3 * rnd3 + rnd4 * rnd4 > .25);
     particle[i_particle][0 + offset] = max1 * rnd1;
     particle[i_particle][1 + offset] = max2 * rnd2;
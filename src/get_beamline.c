@@ -1036,6 +1036,12 @@ void free_elements(ELEMENT_LIST *elemlist) {
         free_hbookn(ftable->By);
         free_hbookn(ftable->Bz);
       }
+    } else if (eptr->type == T_ZLONGIT) {
+      if (eptr->p_elem)
+        freeWorkArena(&((ZLONGIT *)eptr->p_elem)->workArena);
+    } else if (eptr->type == T_ZTRANSVERSE) {
+      if (eptr->p_elem)
+        freeWorkArena(&((ZTRANSVERSE *)eptr->p_elem)->workArena);
     }
 #ifdef DEBUG
     printf("pointers: p_elem = %x   name = %x   matrix = %x\n",
@@ -1114,6 +1120,9 @@ void free_beamlines(LINE_LIST *beamline) {
       lptr->n_elems = 0;
       lptr->flags = 0;
     }
+    freeConcatSegments(lptr);
+    freeMatrixTrees();
+    freeFilterWorkArena(); /* spectrum buffer shared by the CSR elements */
     if (lptr->succ) {
       lptr = lptr->succ;
       tfree(lptr->pred);
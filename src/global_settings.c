@@ -31,6 +31,8 @@ void processGlobalSettings(NAMELIST_TEXT *nltext) {
   parallel_tracking_based_matrices = parallelTrackingBasedMatrices;
   slope_limit = slopeLimit;
   coord_limit = coordLimit;
+  tracking_threads = trackingThreads;
+  soa_tracking = soaTracking;
 
   set_namelist_processing_flags(0);
   set_print_namelist_flags(0);
@@ -60,6 +62,15 @@ void processGlobalSettings(NAMELIST_TEXT *nltext) {
   parallelTrackingBasedMatrices = parallel_tracking_based_matrices;
   slopeLimit = slope_limit;
   coordLimit = coord_limit;
+  if ((trackingThreads = tracking_threads) < 1)
+    trackingThreads = 1;
+#if !defined(_OPENMP)
+  if (trackingThreads > 1) {
+    printWarning("global_settings: tracking_threads>1 ignored.", "This version of elegant was built without OpenMP support.");
+    trackingThreads = 1;
+  }
+#endif
+  soaTracking = soa_tracking;
 #if SDDS_MPI_IO
   SDDS_MPI_SetWriteKludgeUsleep(usleep_mpi_io_kludge);
   SDDS_MPI_SetFileSync(mpi_io_force_file_sync);
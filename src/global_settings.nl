@@ -32,5 +32,7 @@
      double slope_limit = SLOPE_LIMIT;
      double coord_limit = COORD_LIMIT;
      STRING search_path = NULL;
+     long tracking_threads = 1;
+     short soa_tracking = 0;
 #end
 
@@ -620,7 +620,7 @@ void GWigRadiationKicks(struct gwig *pWig, double *X, double *Bxy, double dl, do
 
   if (pWig->isr) {
     /* Incoherent synchrotron radiation or quantum excitation */
-    dDelta = pWig->isrCoef * dFactor * pow(irho2, 0.75) * sqrt(dl) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+    dDelta = pWig->isrCoef * dFactor * pow(irho2, 0.75) * sqrt(dl) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
     X[4] += dDelta;
     X[1] *= (1 + dDelta);
     X[3] *= (1 + dDelta);
@@ -457,7 +457,7 @@ void track_IBS(double **part0, long np0, ELEMENT_LIST *eptr, double Po,
             if (RNSigma[ihcoord]) {
               /* RNSigmaCheck[ihcoord] = 0; */
               for (ipart = istart; ipart < iend; ipart++) {
-                randomNumber = gauss_rn_lim(0.0, RNSigma[ihcoord], 3.0, random_2);
+                randomNumber = gauss_rn_lim_elegant(0.0, RNSigma[ihcoord], 3.0, random_2_elegant);
                 part[index[ipart]][icoord] += randomNumber;
                 /*
                 RNSigmaCheck[ihcoord] += sqr(randomNumber);
@@ -1241,6 +1241,7 @@ void dump_IBScatter(SDDS_TABLE *SDDS_table, IBSCATTER *IBS, long pass) {
       }
     }
 
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WriteTable(SDDS_table)) {
       SDDS_SetError("Problem writing SDDS table (dump_IBScatter)");
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
@@ -1249,6 +1250,7 @@ void dump_IBScatter(SDDS_TABLE *SDDS_table, IBSCATTER *IBS, long pass) {
     SDDS_UpdatePage(SDDS_table, 0);
     if (!inhibitFileSync)
       SDDS_DoFSync(SDDS_table);
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
   log_exit("dump_IBScatter");
 }
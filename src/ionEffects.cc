@@ -989,9 +989,9 @@ void addIons(IONEFFECTS *ionEffects, long iSpecies, long nToAdd, double qToAdd,
   iNew = ionEffects->nIons[iSpecies];
   ionEffects->nIons[iSpecies] += nToAdd;
   for (; iNew < ionEffects->nIons[iSpecies]; iNew++) {
-    ionEffects->coordinate[iSpecies][iNew][0] = gauss_rn_lim(bunchCentroid[0], bunchSigma[0], 3, random_4); /* initial x position */
+    ionEffects->coordinate[iSpecies][iNew][0] = gauss_rn_lim_elegant(bunchCentroid[0], bunchSigma[0], 3, random_4_elegant); /* initial x position */
     ionEffects->coordinate[iSpecies][iNew][1] = 0;                                                          /* initial x velocity */
-    ionEffects->coordinate[iSpecies][iNew][2] = gauss_rn_lim(bunchCentroid[2], bunchSigma[2], 3, random_4); /* initial y position */
+    ionEffects->coordinate[iSpecies][iNew][2] = gauss_rn_lim_elegant(bunchCentroid[2], bunchSigma[2], 3, random_4_elegant); /* initial y position */
     ionEffects->coordinate[iSpecies][iNew][3] = 0;                                                          /* initial y velocity */
     ionEffects->coordinate[iSpecies][iNew][4] = qToAdd;                                                     /* macroparticle charge */
     if (symmetrize) {
@@ -1408,6 +1408,72 @@ void addIon_point(IONEFFECTS *ionEffects, long iSpecies, double qToAdd, double x
   ionEffects->coordinate[iSpecies][iNew][4] = qToAdd; /* macroparticle charge */
 }
 
+/* Copies the ions and saved fit parameters to or from data, for tracking checkpoints.
+ * Returns the number of values. With data==NULL, only counts the values.
+ */
+long transferIonEffectsState(IONEFFECTS *ionEffects, double *data, short restore) {
+  long n, i, iSpecies, iIon, nIons;
+
+  if (data) {
+    if (restore) {
+      if ((long)data[0] != ionProperties.nSpecies)
+        bombElegantVA((char *)"Checkpoint has %ld ion species, but the ion properties file has %ld\n",
+                      (long)data[0], ionProperties.nSpecies);
+      ionEffects->t = data[1];
+      for (i = 0; i < 2; i++) {
+        ionEffects->xyFitSet[i] = data[2 + i];
+        ionEffects->ionChargeFromFit[i] = data[4 + i];
+      }
+    } else {
+      data[0] = ionProperties.nSpecies;
+      data[1] = ionEffects->t;
+      for (i = 0; i < 2; i++) {
+        data[2 + i] = ionEffects->xyFitSet[i];
+        data[4 + i] = ionEffects->ionChargeFromFit[i];
+      }
+    }
+  }
+  n = 6;
+  for (i = 0; i < 2; i++) {
+    if (data) {
+      if (restore) {
+        memcpy(ionEffects->xyFitParameter2[i], data + n, sizeof(ionEffects->xyFitParameter2[i]));
+        memcpy(ionEffects->xyFitParameter3[i], data + n + 6, sizeof(ionEffects->xyFitParameter3[i]));
+      } else {
+        memcpy(data + n, ionEffects->xyFitParameter2[i], sizeof(ionEffects->xyFitParameter2[i]));
+        memcpy(data + n + 6, ionEffects->xyFitParameter3[i], sizeof(ionEffects->xyFitParameter3[i]));
+      }
+    }
+    n += 6 + 9;
+  }
+  for (iSpecies = 0; iSpecies < ionProperties.nSpecies; iSpecies++) {
+    if (data && restore) {
+      nIons = ionEffects->nIons[iSpecies] = data[n];
+      if (ionEffects->coordinate[iSpecies] == NULL)
+        ionEffects->coordinate[iSpecies] = (double **)czarray_2d(sizeof(**(ionEffects->coordinate[iSpecies])), nIons ? nIons : 1, COORDINATES_PER_ION);
+      else
+        ionEffects->coordinate[iSpecies] = (double **)resize_czarray_2d((void **)ionEffects->coordinate[iSpecies],
+                                                                        sizeof(**(ionEffects->coordinate[iSpecies])),
+                                                                        nIons ? nIons : 1, COORDINATES_PER_ION);
+    } else {
+      nIons = ionEffects->nIons[iSpecies];
+      if (data)
+        data[n] = nIons;
+    }
+    n++;
+    for (iIon = 0; iIon < nIons; iIon++) {
+      if (data) {
+        if (restore)
+          memcpy(ionEffects->coordinate[iSpecies][iIon], data + n, sizeof(double) * COORDINATES_PER_ION);
+        else
+          memcpy(data + n, ionEffects->coordinate[iSpecies][iIon], sizeof(double) * COORDINATES_PER_ION);
+      }
+      n += COORDINATES_PER_ION;
+    }
+  }
+  return n;
+}
+
 #if TURBO_FADDEEVA
 // From http://ab-initio.mit.edu/wiki/index.php/Faddeeva_Package under MIT license
 #include "Faddeeva.hh"
@@ -1759,12 +1825,12 @@ short multipleWhateverFit(double bunchSigma[4], double bunchCentroid[4], double
       /* Randomize step sizes and starting points */
       for (int i = 0; i < 3 * mFunctions; i++) {
         if (myid != 0 && myid != 1) {
-          paramValue[i] *= (1 + (random_2(0) - 0.5) / 5);
+          paramValue[i] *= (1 + (random_2_elegant(0) - 0.5) / 5);
           if (paramValue[i] < lowerLimit[i])
             paramValue[i] = lowerLimit[i];
           if (paramValue[i] > upperLimit[i])
             paramValue[i] = upperLimit[i];
-          paramDelta[i] *= random_2(0) * 9.9 + 0.1;
+          paramDelta[i] *= random_2_elegant(0) * 9.9 + 0.1;
         }
       }
       lastBestResult = DBL_MAX;
@@ -1861,7 +1927,7 @@ short multipleWhateverFit(double bunchSigma[4], double bunchCentroid[4], double
           MPI_Bcast(paramValue, 3 * mFunctions, MPI_DOUBLE, min_location, MPI_COMM_WORLD);
           if (myid != 0) {
             for (int i = 0; i < 3 * mFunctions; i++) {
-              paramValue[i] *= (1 + (random_2(0) - 0.5) / 20);
+              paramValue[i] *= (1 + (random_2_elegant(0) - 0.5) / 20);
               if (paramValue[i] < lowerLimit[i])
                 paramValue[i] = lowerLimit[i];
               if (paramValue[i] > upperLimit[i])
@@ -2593,7 +2659,7 @@ void generateIons(IONEFFECTS *ionEffects, long iPass, long iBunch, long nBunches
             Pmi = beamFact * ionProperties.crossSection[iSpecies] *
                   exp(-sqr(jx) / (2 * sqr(bunchSigma[0])) - sqr(jy) / (2 * sqr(bunchSigma[2])));
 
-            rnd = random_2(0);
+            rnd = random_2_elegant(0);
             if (rnd < Pmi) { //multiple ionization occurs
               double qToAdd, mx, my;
               qToAdd = ionEffects->coordinate[index][jMacro][4];
@@ -2604,11 +2670,11 @@ void generateIons(IONEFFECTS *ionEffects, long iPass, long iBunch, long nBunches
               // Initial kinetic energy
               double vmag, ionMass, vx, vy, rangle, Emi;
               ionMass = 1.672621898e-27 * ionProperties.mass[iSpecies];
-              Emi = fabs(gauss_rn_lim(multiple_ionization_energy_peak, multiple_ionization_energy_rms, 3, random_4));
-              //Emi = fabs(gauss_rn_lim(20, 10, 3, random_4));
+              Emi = fabs(gauss_rn_lim_elegant(multiple_ionization_energy_peak, multiple_ionization_energy_rms, 3, random_4_elegant));
+              //Emi = fabs(gauss_rn_lim_elegant(20, 10, 3, random_4_elegant));
               //Emi = 0;
               vmag = sqrt(2 * Emi * e_mks / ionMass);
-              rangle = random_2(0) * 2 * PI;
+              rangle = random_2_elegant(0) * 2 * PI;
               vx = vmag * cos(rangle);
               vy = vmag * sin(rangle);
               ionEffects->coordinate[iSpecies][ionEffects->nIons[iSpecies] - 1][1] = vx;
@@ -3474,10 +3540,12 @@ void doIonEffectsIonHistogramOutput(IONEFFECTS *ionEffects, long iBunch, long iP
             SDDS_Bomb((char *)"Problem writing ion histogram data");
           }
         }
+        elementProfilerStartCollective(PROFILE_OUTPUT);
         if (!SDDS_WritePage(SDDS_ionHistogramOutput)) {
           SDDS_PrintErrors(stdout, SDDS_VERBOSE_PrintErrors);
           SDDS_Bomb((char *)"Problem writing ion histogram data");
         }
+        elementProfilerEndCollective(PROFILE_OUTPUT);
       }
 #if USE_MPI
     }
@@ -3521,10 +3589,12 @@ void doIonEffectsIonHistogramOutput(IONEFFECTS *ionEffects, long iBunch, long iP
           }
         }
       }
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if (!SDDS_WritePage(SDDS_ion2dHistogramOutput)) {
         SDDS_PrintErrors(stdout, SDDS_VERBOSE_PrintErrors);
         SDDS_Bomb((char *)"Problem writing ion 2d histogram data");
       }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
 #if USE_MPI
     }
 #endif
@@ -3535,6 +3605,7 @@ void flushIonEffectsSummaryOutput(IONEFFECTS *ionEffects) {
 #if USE_MPI
   if (myid == 0) {
 #endif
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if ((beam_output_all_locations || ionEffects == firstIonEffects) && SDDS_beamOutput && !SDDS_WritePage(SDDS_beamOutput)) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       exitElegant(1);
@@ -3544,6 +3615,7 @@ void flushIonEffectsSummaryOutput(IONEFFECTS *ionEffects) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       exitElegant(1);
     }
+    elementProfilerEndCollective(PROFILE_OUTPUT);
     iIonDensityOutput = 0;
 #if USE_MPI
   }
@@ -97,7 +97,7 @@ long trackKickMap(
             deltaFactor = 1 + dp;
             dp -= radCoef * sqr(deltaFactor) * F2 * length * sqrt(1 + sqr(coord[1]) + sqr(coord[3]));
             if (map->isr)
-              dp += isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(length) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+              dp += isrCoef * deltaFactor * pow(F2, 0.75) * sqrt(length) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
             if (sigmaDelta2)
               *sigmaDelta2 += sqr(isrCoef * deltaFactor) * pow(F2, 1.5) * length;
             p = pRef * (1 + dp);
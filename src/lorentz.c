@@ -398,10 +398,12 @@ long lorentz(
     if (field_type == T_BMAPXYZ) {
       BMAPXYZ *bmxyz;
       bmxyz = (BMAPXYZ *)field;
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if (bmxyz->SDDSpo && !SDDS_WritePage(bmxyz->SDDSpo)) {
         SDDS_SetError("Problem writing page in particle output file for BMXYZ");
         SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
       }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
       bmxyz->poRow = 0;
     }
   }
@@ -13,6 +13,8 @@
 #include "fftpackC.h"
 
 void set_up_lrwake(LRWAKE *wakeData, RUN *run, long pass, long particles, CHARGE *charge, long nBunches);
+static void computeResonatorWakes(LRWAKE *wakeData, double *tBunch, double *QBunch, double *xBunch, double *yBunch,
+                                  long nBunches, double **V);
 
 void index_bunch_assignments(double **part, long np, long idSlotsPerBunch, double P0,
                              /* return data: */
@@ -366,83 +368,97 @@ void track_through_lrwake(double **part, long np, LRWAKE *wakeData, double *P0In
       }
     }
 
+    VxBunch = tmalloc(sizeof(*VxBunch) * nBunches);
+    VyBunch = tmalloc(sizeof(*VyBunch) * nBunches);
+    QxBunch = tmalloc(sizeof(*QxBunch) * nBunches);
+    QyBunch = tmalloc(sizeof(*QyBunch) * nBunches);
+    VzBunch = tmalloc(sizeof(*VzBunch) * nBunches);
+    elementProfilerStartCollective(PROFILE_WAKE);
+    if (wakeData->modeState) {
+      /* damped resonators carry the history, so the cost doesn't depend on TURNS_TO_KEEP */
+      double *V[6];
+      V[0] = NULL;
+      V[1] = VxBunch;
+      V[2] = VyBunch;
+      V[3] = VzBunch;
+      V[4] = QxBunch;
+      V[5] = QyBunch;
+      computeResonatorWakes(wakeData, tBunch, QBunch, xBunch, yBunch, nBunches, V);
+    } else {
 #ifdef MPI_DEBUG
-    printf("Moving history data back\n");
-    fflush(stdout);
+      printf("Moving history data back\n");
+      fflush(stdout);
 #endif
 
-    /* Move the existing history data back */
-    memmove(wakeData->tHistory, wakeData->tHistory + nBunches, sizeof(*(wakeData->tHistory)) * (wakeData->nHistory - nBunches));
-    memmove(wakeData->QHistory, wakeData->QHistory + nBunches, sizeof(*(wakeData->QHistory)) * (wakeData->nHistory - nBunches));
-    memmove(wakeData->xHistory, wakeData->xHistory + nBunches, sizeof(*(wakeData->xHistory)) * (wakeData->nHistory - nBunches));
-    memmove(wakeData->yHistory, wakeData->yHistory + nBunches, sizeof(*(wakeData->yHistory)) * (wakeData->nHistory - nBunches));
+      /* Move the existing history data back */
+      memmove(wakeData->tHistory, wakeData->tHistory + nBunches, sizeof(*(wakeData->tHistory)) * (wakeData->nHistory - nBunches));
+      memmove(wakeData->QHistory, wakeData->QHistory + nBunches, sizeof(*(wakeData->QHistory)) * (wakeData->nHistory - nBunches));
+      memmove(wakeData->xHistory, wakeData->xHistory + nBunches, sizeof(*(wakeData->xHistory)) * (wakeData->nHistory - nBunches));
+      memmove(wakeData->yHistory, wakeData->yHistory + nBunches, sizeof(*(wakeData->yHistory)) * (wakeData->nHistory - nBunches));
 
 #ifdef MPI_DEBUG
-    printf("Moving new data into buffer\n");
-    fflush(stdout);
+      printf("Moving new data into buffer\n");
+      fflush(stdout);
 #endif
-    /* Move the new history data into the buffer */
-    memmove(wakeData->tHistory + wakeData->nHistory - nBunches, tBunch, sizeof(*tBunch) * nBunches);
-    memmove(wakeData->QHistory + wakeData->nHistory - nBunches, QBunch, sizeof(*QBunch) * nBunches);
-    memmove(wakeData->xHistory + wakeData->nHistory - nBunches, xBunch, sizeof(*xBunch) * nBunches);
-    memmove(wakeData->yHistory + wakeData->nHistory - nBunches, yBunch, sizeof(*yBunch) * nBunches);
+      /* Move the new history data into the buffer */
+      memmove(wakeData->tHistory + wakeData->nHistory - nBunches, tBunch, sizeof(*tBunch) * nBunches);
+      memmove(wakeData->QHistory + wakeData->nHistory - nBunches, QBunch, sizeof(*QBunch) * nBunches);
+      memmove(wakeData->xHistory + wakeData->nHistory - nBunches, xBunch, sizeof(*xBunch) * nBunches);
+      memmove(wakeData->yHistory + wakeData->nHistory - nBunches, yBunch, sizeof(*yBunch) * nBunches);
 
 #ifdef DEBUG
 #  if DEBUG > 1
-    fprintf(fph, "%ld\n", i_pass);
-    for (ib = 0; ib < wakeData->nHistory; ib++)
-      fprintf(fph, "%ld %e %e\n", ib, wakeData->tHistory[ib], wakeData->QHistory[ib]);
-    fprintf(fph, "\n");
-    fflush(fph);
+      fprintf(fph, "%ld\n", i_pass);
+      for (ib = 0; ib < wakeData->nHistory; ib++)
+        fprintf(fph, "%ld %e %e\n", ib, wakeData->tHistory[ib], wakeData->QHistory[ib]);
+      fprintf(fph, "\n");
+      fflush(fph);
 #  endif
 #endif
 
 #ifdef MPI_DEBUG
-    printf("Computing wake function at each new bunch\n");
-    fflush(stdout);
+      printf("Computing wake function at each new bunch\n");
+      fflush(stdout);
 #endif
-    /* Compute the wake function at each new bunch */
-    VxBunch = tmalloc(sizeof(*VxBunch) * nBunches);
-    VyBunch = tmalloc(sizeof(*VyBunch) * nBunches);
-    QxBunch = tmalloc(sizeof(*QxBunch) * nBunches);
-    QyBunch = tmalloc(sizeof(*QyBunch) * nBunches);
-    VzBunch = tmalloc(sizeof(*VzBunch) * nBunches);
-    for (ib = 0; ib < nBunches; ib++) {
-      long ibh;
-      VxBunch[ib] = VyBunch[ib] = VzBunch[ib] = QxBunch[ib] = QyBunch[ib] = 0;
+      /* Compute the wake function at each new bunch */
+      for (ib = 0; ib < nBunches; ib++) {
+        long ibh;
+        VxBunch[ib] = VyBunch[ib] = VzBunch[ib] = QxBunch[ib] = QyBunch[ib] = 0;
 #ifdef DEBUG
-      printf("bin %ld: summing from %ld to %ld\n", ib, 0L, (wakeData->nHistory - nBunches + ib) - 1);
-#endif
-      for (ibh = 0; ibh < wakeData->nHistory - nBunches + ib; ibh++) {
-        if (wakeData->QHistory[ibh]) {
-          long it;
-          double dt;
-          dt = tBunch[ib] - wakeData->tHistory[ibh];
-          /* interpolate wake functions */
-          it = find_nearby_array_entry(wakeData->W[0], wakeData->wakePoints, dt);
-          /*
+        printf("bin %ld: summing from %ld to %ld\n", ib, 0L, (wakeData->nHistory - nBunches + ib) - 1);
+#endif
+        for (ibh = 0; ibh < wakeData->nHistory - nBunches + ib; ibh++) {
+          if (wakeData->QHistory[ibh]) {
+            long it;
+            double dt;
+            dt = tBunch[ib] - wakeData->tHistory[ibh];
+            /* interpolate wake functions */
+            it = find_nearby_array_entry(wakeData->W[0], wakeData->wakePoints, dt);
+            /*
 #ifdef DEBUG
 	printf("ib=%ld, ibh=%ld, dt=%le, it=%ld\n", ib, ibh, dt, it);
 #endif
 	*/
-          if (wakeData->W[1])
-            VxBunch[ib] += wakeData->xHistory[ibh] * wakeData->xFactor * wakeData->QHistory[ibh] *
-                           linear_interpolation(wakeData->W[1], wakeData->W[0], wakeData->wakePoints, dt, it);
-          if (wakeData->W[2])
-            VyBunch[ib] += wakeData->yHistory[ibh] * wakeData->yFactor * wakeData->QHistory[ibh] *
-                           linear_interpolation(wakeData->W[2], wakeData->W[0], wakeData->wakePoints, dt, it);
-          if (wakeData->W[3])
-            VzBunch[ib] += wakeData->zFactor * wakeData->QHistory[ibh] *
-                           linear_interpolation(wakeData->W[3], wakeData->W[0], wakeData->wakePoints, dt, it);
-          if (wakeData->W[4])
-            QxBunch[ib] += wakeData->qxFactor * wakeData->QHistory[ibh] *
-                           linear_interpolation(wakeData->W[4], wakeData->W[0], wakeData->wakePoints, dt, it);
-          if (wakeData->W[5])
-            QyBunch[ib] += wakeData->qyFactor * wakeData->QHistory[ibh] *
-                           linear_interpolation(wakeData->W[5], wakeData->W[0], wakeData->wakePoints, dt, it);
+            if (wakeData->W[1])
+              VxBunch[ib] += wakeData->xHistory[ibh] * wakeData->xFactor * wakeData->QHistory[ibh] *
+                             linear_interpolation(wakeData->W[1], wakeData->W[0], wakeData->wakePoints, dt, it);
+            if (wakeData->W[2])
+              VyBunch[ib] += wakeData->yHistory[ibh] * wakeData->yFactor * wakeData->QHistory[ibh] *
+                             linear_interpolation(wakeData->W[2], wakeData->W[0], wakeData->wakePoints, dt, it);
+            if (wakeData->W[3])
+              VzBunch[ib] += wakeData->zFactor * wakeData->QHistory[ibh] *
+                             linear_interpolation(wakeData->W[3], wakeData->W[0], wakeData->wakePoints, dt, it);
+            if (wakeData->W[4])
+              QxBunch[ib] += wakeData->qxFactor * wakeData->QHistory[ibh] *
+                             linear_interpolation(wakeData->W[4], wakeData->W[0], wakeData->wakePoints, dt, it);
+            if (wakeData->W[5])
+              QyBunch[ib] += wakeData->qyFactor * wakeData->QHistory[ibh] *
+                             linear_interpolation(wakeData->W[5], wakeData->W[0], wakeData->wakePoints, dt, it);
+          }
         }
       }
     }
+    elementProfilerEndCollective(PROFILE_WAKE);
 
 #ifdef DEBUG
 #  if DEBUG > 1
@@ -509,6 +525,326 @@ static LRWAKE_DATA *storedWake = NULL;
 static long storedWakes = 0;
 static char *expectedUnits[6] = {"s", "V/C/m", "V/C/m", "V/C", "V/C/m", "V/C/m"};
 
+/* Damped resonator representation of the wakes.
+ *
+ * Each wake is written as W(t) = sum over resonators of Re(c*exp(s*t)), with complex s = -alpha + i*omega.
+ * The wake of all prior bunches at the time of a bunch is then a sum over resonators of Re(c*A), where
+ * A = sum over prior bunches of q*exp(s*(t-tb)) is updated from one bunch to the next by multiplying by
+ * exp(s*dt) and adding the new bunch. This replaces the sum over the bunch history.
+ *
+ * The resonators are either fit to the tabulated wakes (RESONATOR_MODES) by Prony's method, or read
+ * from RESONATOR_FILE.
+ */
+
+#define LRWAKE_FIT_SAMPLES 4096
+
+/* Solves min |A x - b| by Householder QR. A is m by n (m>=n), row-major; A and b are overwritten.
+ * Returns 0 if A is rank-deficient.
+ */
+static long solveLeastSquares(double *A, double *b, long m, long n, double *x) {
+  long i, j, k;
+  double norm, alpha, vTv, dot, *v;
+
+  v = tmalloc(sizeof(*v) * m);
+  for (k = 0; k < n; k++) {
+    for (i = k, norm = 0; i < m; i++)
+      norm += sqr(A[i * n + k]);
+    if ((norm = sqrt(norm)) == 0) {
+      free(v);
+      return 0;
+    }
+    alpha = A[k * n + k] > 0 ? -norm : norm;
+    for (i = k; i < m; i++)
+      v[i] = A[i * n + k];
+    v[k] -= alpha;
+    for (i = k, vTv = 0; i < m; i++)
+      vTv += sqr(v[i]);
+    for (j = k; j < n; j++) {
+      for (i = k, dot = 0; i < m; i++)
+        dot += v[i] * A[i * n + j];
+      dot *= 2 / vTv;
+      for (i = k; i < m; i++)
+        A[i * n + j] -= dot * v[i];
+    }
+    for (i = k, dot = 0; i < m; i++)
+      dot += v[i] * b[i];
+    dot *= 2 / vTv;
+    for (i = k; i < m; i++)
+      b[i] -= dot * v[i];
+  }
+  free(v);
+  for (k = n - 1; k >= 0; k--) {
+    for (j = k + 1, dot = b[k]; j < n; j++)
+      dot -= A[k * n + j] * x[j];
+    if (A[k * n + k] == 0)
+      return 0;
+    x[k] = dot / A[k * n + k];
+  }
+  return 1;
+}
+
+/* Finds the roots of z^n + a[0]*z^(n-1) + ... + a[n-1] by the Durand-Kerner iteration */
+static void findPolynomialRoots(double *a, long n, double *zr, double *zi) {
+  long i, j, k, iter;
+  double radius, pr, pi, dr, di, tr, ti, denom, change, maxChange;
+
+  for (i = 0, radius = 0; i < n; i++)
+    if (fabs(a[i]) > radius)
+      radius = fabs(a[i]);
+  radius += 1;
+  /* starting values spread on a circle, off the real axis */
+  for (k = 0; k < n; k++) {
+    zr[k] = radius * cos(PIx2 * k / n + 0.4);
+    zi[k] = radius * sin(PIx2 * k / n + 0.4);
+  }
+  for (iter = 0; iter < 1000; iter++) {
+    maxChange = 0;
+    for (k = 0; k < n; k++) {
+      /* p = polynomial at z[k] by Horner's rule */
+      pr = 1;
+      pi = 0;
+      for (i = 0; i < n; i++) {
+        tr = pr * zr[k] - pi * zi[k] + a[i];
+        pi = pr * zi[k] + pi * zr[k];
+        pr = tr;
+      }
+      /* d = product of z[k]-z[j] over j!=k */
+      dr = 1;
+      di = 0;
+      for (j = 0; j < n; j++) {
+        if (j == k)
+          continue;
+        tr = dr * (zr[k] - zr[j]) - di * (zi[k] - zi[j]);
+        di = dr * (zi[k] - zi[j]) + di * (zr[k] - zr[j]);
+        dr = tr;
+      }
+      if ((denom = sqr(dr) + sqr(di)) == 0)
+        continue;
+      tr = (pr * dr + pi * di) / denom;
+      ti = (pi * dr - pr * di) / denom;
+      zr[k] -= tr;
+      zi[k] -= ti;
+      change = sqrt(sqr(tr) + sqr(ti)) / (sqrt(sqr(zr[k]) + sqr(zi[k])) + 1e-300);
+      if (change > maxChange)
+        maxChange = change;
+    }
+    if (maxChange < 1e-14)
+      break;
+  }
+}
+
+/* Fits W(t) with nModes damped resonators by Prony's method. Returns the number of resonators found
+ * and their data in *modeData.
+ */
+static long fitWakeResonators(double **modeData, long nModes, double *t, double *W, long points,
+                              char *column, char *filename) {
+  long m, p, i, j, k, nRoots, nBasis, it;
+  double tMax, tMin, dt, *y, *A, *b, *a, *zr, *zi, *x, r, *data, sum2, wake2, value, phase, decay;
+  short *oscillates;
+  char buffer[1024];
+
+  find_min_max(&tMin, &tMax, t, points);
+  p = 2 * nModes;
+  if ((m = points) > LRWAKE_FIT_SAMPLES)
+    m = LRWAKE_FIT_SAMPLES;
+  if (m < 2 * p + 1)
+    bombElegantVA("LRWAKE: too few points in %s to fit %ld resonators to %s", filename, nModes, column);
+  dt = (tMax - tMin) / (m - 1);
+  y = tmalloc(sizeof(*y) * m);
+  for (j = 0; j < m; j++) {
+    it = find_nearby_array_entry(t, points, j * dt);
+    y[j] = linear_interpolation(W, t, points, j * dt, it);
+  }
+
+  /* linear prediction coefficients: y[j] + a[0]*y[j-1] + ... + a[p-1]*y[j-p] = 0 */
+  A = tmalloc(sizeof(*A) * (m - p) * p);
+  b = tmalloc(sizeof(*b) * m);
+  a = tmalloc(sizeof(*a) * p);
+  for (i = 0; i < m - p; i++) {
+    for (k = 0; k < p; k++)
+      A[i * p + k] = -y[i + p - 1 - k];
+    b[i] = y[i + p];
+  }
+  if (!solveLeastSquares(A, b, m - p, p, a))
+    bombElegantVA("LRWAKE: unable to fit %ld resonators to %s from %s---try fewer", nModes, column, filename);
+  free(A);
+
+  /* poles are the roots of the prediction polynomial, z = exp(s*dt) */
+  zr = tmalloc(sizeof(*zr) * p);
+  zi = tmalloc(sizeof(*zi) * p);
+  findPolynomialRoots(a, p, zr, zi);
+  data = tmalloc(sizeof(*data) * 4 * p);
+  oscillates = tmalloc(sizeof(*oscillates) * p);
+  nRoots = nBasis = 0;
+  for (k = 0; k < p; k++) {
+    r = sqrt(sqr(zr[k]) + sqr(zi[k]));
+    /* keep one root of each complex-conjugate pair */
+    if (r == 0 || zi[k] < -1e-8 * r)
+      continue;
+    if (r > 1) {
+      snprintf(buffer, 1024, "A resonator fitted to %s from %s grows with time and has been made undamped.", column, filename);
+      printWarning("LRWAKE: growing resonator in fit.", buffer);
+      r = 1;
+    }
+    data[4 * nRoots] = log(r) / dt;
+    if (zi[k] <= 1e-8 * r) {
+      /* real root: exp(sr*t) or (-1)^j exp(sr*t) */
+      data[4 * nRoots + 1] = zr[k] > 0 ? 0 : PI / dt;
+      oscillates[nRoots] = 0;
+      nBasis += 1;
+    } else {
+      data[4 * nRoots + 1] = atan2(zi[k], zr[k]) / dt;
+      oscillates[nRoots] = 1;
+      nBasis += 2;
+    }
+    nRoots++;
+  }
+
+  /* amplitudes: W(t) = sum of exp(sr*t)*(C*cos(si*t) + S*sin(si*t)), so c = C - i*S */
+  A = tmalloc(sizeof(*A) * m * nBasis);
+  x = tmalloc(sizeof(*x) * nBasis);
+  for (j = 0; j < m; j++) {
+    for (k = i = 0; k < nRoots; k++) {
+      decay = exp(data[4 * k] * j * dt);
+      phase = data[4 * k + 1] * j * dt;
+      A[j * nBasis + i++] = decay * cos(phase);
+      if (oscillates[k])
+        A[j * nBasis + i++] = decay * sin(phase);
+    }
+    b[j] = y[j];
+  }
+  if (!solveLeastSquares(A, b, m, nBasis, x))
+    bombElegantVA("LRWAKE: unable to fit %ld resonators to %s from %s---try fewer", nModes, column, filename);
+  for (k = i = 0; k < nRoots; k++) {
+    data[4 * k + 2] = x[i++];
+    data[4 * k + 3] = oscillates[k] ? -x[i++] : 0;
+  }
+
+  /* compare to the tabulated wake */
+  for (j = 0, sum2 = wake2 = 0; j < points; j++) {
+    for (k = 0, value = 0; k < nRoots; k++)
+      value += exp(data[4 * k] * t[j]) *
+               (data[4 * k + 2] * cos(data[4 * k + 1] * t[j]) - data[4 * k + 3] * sin(data[4 * k + 1] * t[j]));
+    sum2 += sqr(value - W[j]);
+    wake2 += sqr(W[j]);
+  }
+  printf("LRWAKE: %ld resonators fitted to %s from %s, rms residual is %.3g of rms wake\n",
+         nRoots, column, filename, wake2 ? sqrt(sum2 / wake2) : 0);
+  fflush(stdout);
+
+  free(A);
+  free(b);
+  free(x);
+  free(y);
+  free(a);
+  free(zr);
+  free(zi);
+  free(oscillates);
+  *modeData = data;
+  return nRoots;
+}
+
+/* Reads damped resonators from RESONATOR_FILE. The wake of each resonator is
+ *   W(t) = W0*exp(-omega*t/(2Q))*cos(omega'*t + phase), omega' = omega*sqrt(1-1/(4*Q^2))
+ * with W0 in the column named by W*COLUMN and phase (default 0) in the column of the same name
+ * with Phase appended.
+ */
+static void readWakeResonators(LRWAKE *wakeData) {
+  SDDS_DATASET SDDSin;
+  double *frequency, *Q, *W0, *phase, omega;
+  long icol, k, rows;
+  char phaseName[1024];
+
+#if SDDS_MPI_IO
+  SDDSin.parallel_io = 0;
+#endif
+  if (!SDDS_InitializeInputFromSearchPath(&SDDSin, wakeData->resonatorFile) || SDDS_ReadPage(&SDDSin) != 1)
+    bombElegantVA("Error: unable to open or read LRWAKE resonator file %s\n", wakeData->resonatorFile);
+  if ((rows = SDDS_RowCount(&SDDSin)) < 1)
+    bombElegantVA("Error: no data in LRWAKE resonator file %s\n", wakeData->resonatorFile);
+  if (!(frequency = SDDS_GetColumnInDoubles(&SDDSin, "Frequency")) || !(Q = SDDS_GetColumnInDoubles(&SDDSin, "Q")))
+    bombElegantVA("Error: LRWAKE resonator file %s needs Frequency and Q columns\n", wakeData->resonatorFile);
+  for (k = 0; k < rows; k++)
+    if (frequency[k] <= 0 || Q[k] <= 0.5)
+      bombElegantVA("Error: LRWAKE resonator file %s needs Frequency>0 and Q>0.5\n", wakeData->resonatorFile);
+  for (icol = 1; icol < 6; icol++) {
+    if (!wakeData->WColumn[icol])
+      continue;
+    if (!(W0 = SDDS_GetColumnInDoubles(&SDDSin, wakeData->WColumn[icol])))
+      bombElegantVA("Error: column %s not found in LRWAKE resonator file %s\n", wakeData->WColumn[icol], wakeData->resonatorFile);
+    snprintf(phaseName, 1024, "%sPhase", wakeData->WColumn[icol]);
+    phase = SDDS_GetColumnIndex(&SDDSin, phaseName) >= 0 ? SDDS_GetColumnInDoubles(&SDDSin, phaseName) : NULL;
+    wakeData->nModes[icol] = rows;
+    wakeData->modeData[icol] = tmalloc(sizeof(**wakeData->modeData) * 4 * rows);
+    for (k = 0; k < rows; k++) {
+      omega = PIx2 * frequency[k];
+      wakeData->modeData[icol][4 * k] = -omega / (2 * Q[k]);
+      wakeData->modeData[icol][4 * k + 1] = omega * sqrt(1 - 1 / (4 * sqr(Q[k])));
+      wakeData->modeData[icol][4 * k + 2] = W0[k] * cos(phase ? phase[k] : 0);
+      wakeData->modeData[icol][4 * k + 3] = W0[k] * sin(phase ? phase[k] : 0);
+    }
+    free(W0);
+    if (phase)
+      free(phase);
+  }
+  free(frequency);
+  free(Q);
+  SDDS_Terminate(&SDDSin);
+}
+
+/* Allocates the resonator sums, unless they were restored from a tracking checkpoint */
+static void setUpResonatorState(LRWAKE *wakeData) {
+  long icol, n;
+  for (icol = 1, n = 1; icol < 6; icol++)
+    n += 2 * wakeData->nModes[icol];
+  if (!wakeData->modeState || wakeData->nModeState != n) {
+    wakeData->nModeState = n;
+    wakeData->modeState = trealloc(wakeData->modeState, sizeof(*wakeData->modeState) * n);
+    memset(wakeData->modeState, 0, sizeof(*wakeData->modeState) * n);
+  }
+}
+
+/* Computes the wakes at each bunch from the damped resonators, and adds the bunches to the sums */
+static void computeResonatorWakes(LRWAKE *wakeData, double *tBunch, double *QBunch, double *xBunch, double *yBunch,
+                                  long nBunches, double **V) {
+  long ib, iw, k;
+  double dt, decay, c, s, ar, ai, weight, sum, *mode, *state, factor[6];
+
+  factor[1] = wakeData->xFactor;
+  factor[2] = wakeData->yFactor;
+  factor[3] = wakeData->zFactor;
+  factor[4] = wakeData->qxFactor;
+  factor[5] = wakeData->qyFactor;
+  for (ib = 0; ib < nBunches; ib++) {
+    for (iw = 1; iw < 6; iw++)
+      V[iw][ib] = 0;
+    if (!QBunch[ib])
+      continue;
+    /* modeState[0] is the time of the last bunch */
+    dt = tBunch[ib] - wakeData->modeState[0];
+    state = wakeData->modeState + 1;
+    for (iw = 1; iw < 6; iw++) {
+      if (!wakeData->nModes[iw])
+        continue;
+      mode = wakeData->modeData[iw];
+      weight = QBunch[ib] * (iw == 1 ? xBunch[ib] : (iw == 2 ? yBunch[ib] : 1));
+      sum = 0;
+      for (k = 0; k < wakeData->nModes[iw]; k++, mode += 4, state += 2) {
+        decay = exp(mode[0] * dt);
+        c = decay * cos(mode[1] * dt);
+        s = decay * sin(mode[1] * dt);
+        ar = state[0] * c - state[1] * s;
+        ai = state[0] * s + state[1] * c;
+        sum += mode[2] * ar - mode[3] * ai;
+        state[0] = ar + weight;
+        state[1] = ai;
+      }
+      V[iw][ib] = factor[iw] * sum;
+    }
+    wakeData->modeState[0] = tBunch[ib];
+  }
+}
+
 void set_up_lrwake(LRWAKE *wakeData, RUN *run, long pass, long particles, CHARGE *charge, long nBunches) {
   SDDS_DATASET SDDSin;
   double tmin, tmax;
@@ -526,19 +862,27 @@ void set_up_lrwake(LRWAKE *wakeData, RUN *run, long pass, long particles, CHARGE
 
   wakeData->initialized = 1;
 
-  if (!wakeData->inputFile || !strlen(wakeData->inputFile))
-    bombElegant("supply inputFile for LRWAKE element", NULL);
-
   for (icol = 0; icol < 6; icol++)
     if (wakeData->WColumn[icol] && !strlen(wakeData->WColumn[icol]))
       wakeData->WColumn[icol] = NULL;
-  if (!wakeData->WColumn[0])
-    bombElegant("supply tColumn for LRWAKE element", NULL);
   if (!wakeData->WColumn[1] && !wakeData->WColumn[2] && !wakeData->WColumn[3])
     bombElegant("supply at least one of WxColumn, WyColumn, or WzColumn for LRWAKE element", NULL);
 
-  for (icol = 0; icol < 6; icol++)
+  for (icol = 0; icol < 6; icol++) {
     wakeData->W[icol] = NULL;
+    wakeData->nModes[icol] = 0;
+  }
+
+  if (wakeData->resonatorFile && strlen(wakeData->resonatorFile)) {
+    readWakeResonators(wakeData);
+    setUpResonatorState(wakeData);
+    return;
+  }
+
+  if (!wakeData->inputFile || !strlen(wakeData->inputFile))
+    bombElegant("supply inputFile for LRWAKE element", NULL);
+  if (!wakeData->WColumn[0])
+    bombElegant("supply tColumn for LRWAKE element", NULL);
 
   for (iw = 0; iw < storedWakes; iw++) {
     if (strcmp(storedWake[iw].filename, wakeData->inputFile) == 0)
@@ -670,14 +1014,27 @@ void set_up_lrwake(LRWAKE *wakeData, RUN *run, long pass, long particles, CHARGE
   }
   wakeData->dt = (tmax - tmin) / (wakeData->wakePoints - 1);
 
-  wakeData->nHistory = wakeData->turnsToKeep * nBunches;
+  if (wakeData->resonatorModes > 0) {
+    for (icol = 1; icol < 6; icol++)
+      if (wakeData->W[icol])
+        wakeData->nModes[icol] = fitWakeResonators(&wakeData->modeData[icol], wakeData->resonatorModes,
+                                                   wakeData->W[0], wakeData->W[icol], wakeData->wakePoints,
+                                                   wakeData->WColumn[icol], wakeData->inputFile);
+    setUpResonatorState(wakeData);
+    return;
+  }
 
-  wakeData->tHistory = tmalloc(sizeof(*(wakeData->tHistory)) * wakeData->nHistory);
-  wakeData->xHistory = tmalloc(sizeof(*(wakeData->xHistory)) * wakeData->nHistory);
-  wakeData->yHistory = tmalloc(sizeof(*(wakeData->yHistory)) * wakeData->nHistory);
-  wakeData->QHistory = tmalloc(sizeof(*(wakeData->QHistory)) * wakeData->nHistory);
-  for (iw = 0; iw < wakeData->nHistory; iw++)
-    wakeData->tHistory[iw] = wakeData->xHistory[iw] = wakeData->yHistory[iw] = wakeData->QHistory[iw] = 0;
+  /* history may already have been restored from a tracking checkpoint */
+  if (!wakeData->tHistory || wakeData->nHistory != wakeData->turnsToKeep * nBunches) {
+    wakeData->nHistory = wakeData->turnsToKeep * nBunches;
+
+    wakeData->tHistory = trealloc(wakeData->tHistory, sizeof(*(wakeData->tHistory)) * wakeData->nHistory);
+    wakeData->xHistory = trealloc(wakeData->xHistory, sizeof(*(wakeData->xHistory)) * wakeData->nHistory);
+    wakeData->yHistory = trealloc(wakeData->yHistory, sizeof(*(wakeData->yHistory)) * wakeData->nHistory);
+    wakeData->QHistory = trealloc(wakeData->QHistory, sizeof(*(wakeData->QHistory)) * wakeData->nHistory);
+    for (iw = 0; iw < wakeData->nHistory; iw++)
+      wakeData->tHistory[iw] = wakeData->xHistory[iw] = wakeData->yHistory[iw] = wakeData->QHistory[iw] = 0;
+  }
 #ifdef DEBUG
   printf("Returing from lrwake setup\n");
 #endif
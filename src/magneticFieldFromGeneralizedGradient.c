@@ -579,7 +579,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
             deltaTemp = delta - radCoef * pCentral * sqr(1.0 + delta) * B2 * ds;
             F = isrCoef * pCentral * sqr(1.0 + delta) * sqrt(ds) * pow(B2, 3. / 4.);
             if (bgg->isr && np != 1)
-              deltaTemp += F * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+              deltaTemp += F * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
             if (sigmaDelta2)
               *sigmaDelta2 += sqr(F);
             px *= (1 + deltaTemp) / (1 + delta);
@@ -617,6 +617,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
 
 #if !USE_MPI
       if (bgg->SDDSpo && np < 1000) {
+        elementProfilerStartCollective(PROFILE_OUTPUT);
         if (!SDDS_SetRowValues(bgg->SDDSpo, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, irow++,
                                bgg->poIndex[0], x + bggData[0]->xCenter,
                                bgg->poIndex[1], px * pCentral,
@@ -634,6 +635,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
           SDDS_SetError("Problem setting particle output data for BGGEXP");
           SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
         }
+        elementProfilerEndCollective(PROFILE_OUTPUT);
       }
 #endif
 
@@ -846,7 +848,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
           deltaTemp = delta - radCoef * pCentral * sqr(1.0 + delta) * B2 * ds;
           F = isrCoef * pCentral * sqr(1.0 + delta) * sqrt(ds) * pow(B2, 3. / 4.);
           if (bgg->isr && np != 1)
-            deltaTemp += F * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+            deltaTemp += F * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
           if (sigmaDelta2)
             *sigmaDelta2 += sqr(F);
           delta = deltaTemp;
@@ -861,6 +863,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
 
 #if !USE_MPI
       if (bgg->SDDSpo && np < 1000) {
+        elementProfilerStartCollective(PROFILE_OUTPUT);
         if (!SDDS_SetRowValues(bgg->SDDSpo, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, irow++,
                                bgg->poIndex[0], x,
                                bgg->poIndex[1], p[0],
@@ -878,6 +881,7 @@ long trackBGGExpansion(double **part, long np, BGGEXP *bgg, double pCentral, dou
           SDDS_SetError("Problem setting particle output data for BGGEXP");
           SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
         }
+        elementProfilerEndCollective(PROFILE_OUTPUT);
       }
 #endif
 
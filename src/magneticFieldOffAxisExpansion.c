@@ -383,7 +383,7 @@ long trackMagneticFieldOffAxisExpansion(double **part, long np, BOFFAXE *boa, do
           deltaTemp = delta - radCoef * pCentral * (1.0 + delta) * B2 * ds;
           F = isrCoef * pCentral * (1.0 + delta) * sqrt(ds) * pow(B2, 3. / 4.);
           if (boa->isr && np != 1)
-            deltaTemp += F * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+            deltaTemp += F * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
           if (sigmaDelta2)
             *sigmaDelta2 += sqr(F);
           delta = deltaTemp;
@@ -421,6 +421,7 @@ long trackMagneticFieldOffAxisExpansion(double **part, long np, BOFFAXE *boa, do
 
 #if !USE_MPI
     if (boa->SDDSpo) {
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if (!SDDS_SetRowValues(boa->SDDSpo, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, irow++,
                              boa->poIndex[0], x,
                              boa->poIndex[1], p[0],
@@ -436,6 +437,7 @@ long trackMagneticFieldOffAxisExpansion(double **part, long np, BOFFAXE *boa, do
         SDDS_SetError("Problem setting particle output data for BGGEXP");
         SDDS_PrintErrors(stderr, SDDS_EXIT_PrintErrors | SDDS_VERBOSE_PrintErrors);
       }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
     }
 #endif
   }
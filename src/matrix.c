@@ -82,6 +82,8 @@ void print_matrices1(FILE *fp, char *string, char *format, VMATRIX *M) {
   log_exit("print_matrices");
 }
 
+static unsigned long matrixSerial = 0;
+
 void initialize_matrices(VMATRIX *M, long order) {
   long i, j, k;
   double *C, **R;
@@ -90,6 +92,7 @@ void initialize_matrices(VMATRIX *M, long order) {
 
   log_entry("initialize_matrices");
   M->eptr = NULL;
+  M->serial = ++matrixSerial;
 
   // Contiguous memory regions will allow strided access and vectorization
   // Actually...maybe not, this ragged array stuff in order 2/3 is not good
@@ -222,7 +225,8 @@ void track_particles(double **final, VMATRIX *M, double **initial,
   double **Qij, *Qijk;
   double *C, **R, ***T, ****Q;
   double *fin, *ini;
-  static double temp[6];
+  double temp[6];
+  long nThreads;
 
 #ifdef HAVE_GPU
 #  ifdef GPU_VERIFY
@@ -256,6 +260,27 @@ void track_particles(double **final, VMATRIX *M, double **initial,
     bombElegant("NULL initial coordinates pointer in track_particles", NULL);
 #endif
 
+  if ((nThreads = particleThreadsToUse(n_part)) > 1) {
+    /* particles are independent here, so each thread maps its own block */
+#if defined(_OPENMP)
+#  pragma omp parallel num_threads(nThreads)
+#endif
+    {
+      long iFirst, iLast;
+      particleThreadRange(n_part, &iFirst, &iLast);
+      if (iLast >= iFirst)
+        track_particles(final + iFirst, M, initial + iFirst, iLast - iFirst + 1);
+    }
+    log_exit("track_particles");
+    return;
+  }
+
+  if (soaTracking && M->order <= 2) {
+    track_particles_soa(final, M, initial, n_part);
+    log_exit("track_particles");
+    return;
+  }
+
   set_matrix_pointers(&C, &R, &T, &Q, M);
 
   // TODO: move all the null checks outside the per-particle loop
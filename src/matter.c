@@ -179,12 +179,12 @@ long track_through_matter(
       }
       if (multipleScattering) {
         /* use the multiple scattering formula */
-        z1 = gauss_rn(0, random_2);
-        z2 = gauss_rn(0, random_2);
+        z1 = gauss_rn_elegant(0, random_2_elegant);
+        z2 = gauss_rn_elegant(0, random_2_elegant);
         coord[0] += (dx = (z1 / SQRT_3 + z2) * L * theta_rms / 2 + L * coord[1]);
         coord[1] += z2 * theta_rms;
-        z1 = gauss_rn(0, random_2);
-        z2 = gauss_rn(0, random_2);
+        z1 = gauss_rn_elegant(0, random_2_elegant);
+        z2 = gauss_rn_elegant(0, random_2_elegant);
         coord[2] += (dy = (z1 / SQRT_3 + z2) * L * theta_rms / 2 + L * coord[3]);
         coord[3] += z2 * theta_rms;
         ds = sqrt(sqr(L) + sqr(dx) + sqr(dy));
@@ -195,15 +195,15 @@ long track_through_matter(
         ds = dgamma = 0;
         /* sections = sections0; */
         for (is = 0; is < sections0 && !isLost; is++) {
-          if (random_2(1) < prob) {
+          if (random_2_elegant(1) < prob) {
             nScatters++;
             /* single-scattering computation */
             /* scatter occurs at location 0<=zs<=L */
-            zs = L1 * random_2(1);
+            zs = L1 * random_2_elegant(1);
             /* pick a value for CDF and get corresponding angle */
-            F = random_2(1);
+            F = random_2_elegant(1);
             theta = sqrt((1 - F) * K2 * SQR_PI / (K2 + F * SQR_PI));
-            phi = random_2(1) * PIx2;
+            phi = random_2_elegant(1) * PIx2;
             dxp = theta * sin(phi);
             dyp = theta * cos(phi);
             /* advance to location of scattering event */
@@ -221,10 +221,10 @@ long track_through_matter(
             coord[2] += coord[3] * L1;
           }
           if (matter->energyDecay || matter->nuclearBremsstrahlung) {
-            if (probBS != 0 && random_2(1) < probBS)
-              gamma -= gamma * solveBremsstrahlungCDF(random_2(1));
-            if (probER != 0 && random_2(1) < probER)
-              gamma -= BS_Y0 / (1 - random_2(1) * (1 - BS_Y0));
+            if (probBS != 0 && random_2_elegant(1) < probBS)
+              gamma -= gamma * solveBremsstrahlungCDF(random_2_elegant(1));
+            if (probER != 0 && random_2_elegant(1) < probER)
+              gamma -= BS_Y0 / (1 - random_2_elegant(1) * (1 - BS_Y0));
             if (gamma <= 1) {
               isLost = 1;
               break;
@@ -243,7 +243,7 @@ long track_through_matter(
           if (matter->energyStraggle) {
             double dgamma1;
             /* very simple-minded estimate: StDev(dE) = Mean(dE)/2 */
-            while ((dgamma1 = dgamma * (1 + 0.5 * gauss_rn(0, random_2))) < 0)
+            while ((dgamma1 = dgamma * (1 + 0.5 * gauss_rn_elegant(0, random_2_elegant))) < 0)
               ;
             dgamma = dgamma1;
           }
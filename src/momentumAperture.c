@@ -107,6 +107,13 @@ void setupMomentumApertureSearch(
     bombElegant("process_elements <= 0", NULL);
 
   nElements = 0;
+  if (output_mode == 3) {
+    if (forbid_resonance_crossing)
+      bombElegant("forbid_resonance_crossing is not supported with output_mode=3", NULL);
+    if (!fiducialize)
+      printWarning("momentum_aperture: output_mode=3 always fiducializes the lattice.",
+                   "All trial particles are tracked together, so the reference momentum profile is taken from a single fiducial particle.");
+  }
   if (output_mode == 2) {
     /* Massively parallel algorithm using acceptance feature */
     if (include_name_pattern && has_wildcards(include_name_pattern))
@@ -240,6 +247,233 @@ void finishMomentumApertureSearch() {
   }
 }
 
+/* Data used by momentumOffsetFunctionBatch() to apply the trial momentum offsets.
+ * Each (element, side) search has a contiguous block of trial particle IDs.
+ */
+static long batchSearches = 0;
+static long *batchFirstTrial = NULL, *batchTrials = NULL;
+static double *batchTrialDelta = NULL;
+static ELEMENT_LIST **batchWedgeElement = NULL;
+
+static void momentumOffsetFunctionBatch(double **coord, long np, long pass, long i_elem, long n_elem, ELEMENT_LIST *eptr, double *pCentral) {
+  long iSearch, ip, id;
+  MALIGN mal;
+
+  if (pass != fireOnPass)
+    return;
+  for (iSearch = 0; iSearch < batchSearches; iSearch++) {
+    if (eptr != batchWedgeElement[iSearch] || !batchTrials[iSearch])
+      continue;
+    memset(&mal, 0, sizeof(mal));
+    mal.dx = x_initial;
+    mal.dy = y_initial;
+    mal.startPID = mal.endPID = -1;
+    for (ip = 0; ip < np; ip++) {
+      id = coord[ip][particleIDIndex];
+      if (id < batchFirstTrial[iSearch] || id >= batchFirstTrial[iSearch] + batchTrials[iSearch])
+        continue;
+      mal.dp = batchTrialDelta[id];
+      offset_beam(coord + ip, 1, &mal, *pCentral);
+    }
+  }
+}
+
+/* Momentum aperture search with output_mode=3.
+ * This follows the same scan-and-split sequence as the element-by-element search, but
+ * in each round all trial deltas for all elements and both sides are tracked as one
+ * ensemble, so the lattice is traversed once per round instead of once per trial.
+ * Returns the number of output rows filled.
+ */
+static long batchedMomentumApertureSearch(RUN *run, VARY *control, LINE_LIST *beamline, double *startingCoord,
+                                          ELEMENT_LIST *elem0,
+                                          char **ElementName, char **ElementType, int32_t *ElementOccurence,
+                                          double *sStart, int32_t **lostOnPass, short **loserFound,
+                                          short **survivorFound, double **deltaSurvived,
+                                          double **xLost, double **yLost, double **sLost, double **deltaWhenLost,
+                                          double **xTuneSurvived, double **yTuneSurvived) {
+  long iElem, nRows, row, side, iSearch, split, nTotal, nLeft, ip, id, iTrial;
+  long *searchRow;
+  short *searchDone;
+  double *deltaStart, *deltaInterval, *deltaLimit, *deltaLost, delta, pCentral;
+  double **coord;
+  long *lostIndex;
+  char s[1000], warningBuffer[1024];
+
+  /* each element handled here gives one output row with two searches */
+  searchRow = tmalloc(sizeof(*searchRow) * 2 * nElements);
+  batchWedgeElement = tmalloc(sizeof(*batchWedgeElement) * 2 * nElements);
+  nRows = 0;
+  for (iElem = 0; iElem < nElements; iElem++) {
+#if USE_MPI
+    if (myid != iElem % n_processors)
+      continue;
+#endif
+    ElementName[nRows] = elementArray[iElem]->name;
+    ElementType[nRows] = entity_name[elementArray[iElem]->type];
+    ElementOccurence[nRows] = elementArray[iElem]->occurence;
+    sStart[nRows] = elementArray[iElem]->end_pos;
+    for (side = 0; side < 2; side++) {
+      searchRow[2 * nRows + side] = nRows;
+      batchWedgeElement[2 * nRows + side] = elementArray[iElem]->succ ? elementArray[iElem]->succ : elem0;
+    }
+    nRows++;
+  }
+  batchSearches = 2 * nRows;
+
+  batchFirstTrial = tmalloc(sizeof(*batchFirstTrial) * batchSearches);
+  batchTrials = tmalloc(sizeof(*batchTrials) * batchSearches);
+  searchDone = tmalloc(sizeof(*searchDone) * batchSearches);
+  deltaStart = tmalloc(sizeof(*deltaStart) * batchSearches);
+  deltaInterval = tmalloc(sizeof(*deltaInterval) * batchSearches);
+  deltaLimit = tmalloc(sizeof(*deltaLimit) * batchSearches);
+  deltaLost = tmalloc(sizeof(*deltaLost) * batchSearches);
+  for (iSearch = 0; iSearch < batchSearches; iSearch++) {
+    row = searchRow[iSearch];
+    side = iSearch % 2;
+    lostOnPass[side][row] = -1;
+    loserFound[side][row] = survivorFound[side][row] = 0;
+    xLost[side][row] = yLost[side][row] = deltaWhenLost[side][row] = sLost[side][row] =
+      deltaSurvived[side][row] = 0;
+    /* tunes aren't computed for batched tracking */
+    xTuneSurvived[side][row] = yTuneSurvived[side][row] = -1;
+    deltaStart[iSearch] = side == 0 ? delta_negative_start : delta_positive_start;
+    deltaLimit[iSearch] = side == 0 ? delta_negative_limit : delta_positive_limit;
+    deltaInterval[iSearch] = (side == 0 ? -1 : 1) * delta_step_size;
+    deltaLost[iSearch] = (side == 0 ? -1 : 1) * DBL_MAX / 2;
+    searchDone[iSearch] = 0;
+  }
+
+  for (split = 0; split <= splits; split++) {
+    /* count trials, generating deltas the same way as the element-by-element search */
+    nTotal = 0;
+    for (iSearch = 0; iSearch < batchSearches; iSearch++) {
+      batchFirstTrial[iSearch] = nTotal;
+      batchTrials[iSearch] = 0;
+      if (searchDone[iSearch])
+        continue;
+      for (delta = deltaStart[iSearch]; fabs(delta) <= fabs(deltaLimit[iSearch]); delta += deltaInterval[iSearch])
+        batchTrials[iSearch]++;
+      nTotal += batchTrials[iSearch];
+    }
+    if (nTotal == 0)
+      break;
+    batchTrialDelta = trealloc(batchTrialDelta, sizeof(*batchTrialDelta) * nTotal);
+    for (iSearch = 0; iSearch < batchSearches; iSearch++) {
+      delta = deltaStart[iSearch];
+      for (iTrial = 0; iTrial < batchTrials[iSearch]; iTrial++, delta += deltaInterval[iSearch])
+        batchTrialDelta[batchFirstTrial[iSearch] + iTrial] = delta;
+    }
+
+    coord = (double **)czarray_2d(sizeof(**coord), nTotal, totalPropertiesPerParticle);
+    for (ip = 0; ip < nTotal; ip++) {
+      if (startingCoord)
+        memcpy(coord[ip], startingCoord, sizeof(**coord) * 6);
+      else
+        memset(coord[ip], 0, sizeof(**coord) * 6);
+      coord[ip][particleIDIndex] = ip;
+    }
+    if (verbosity > 0) {
+      sprintf(s, "Round %ld of %ld: tracking %ld trial particles: ", split + 1, splits + 1, nTotal);
+      report_stats(stdout, s);
+      fflush(stdout);
+    }
+    setTrackingOmniWedgeFunction(momentumOffsetFunctionBatch);
+    pCentral = run->p_central;
+    nLeft = do_tracking(NULL, coord, nTotal, NULL, beamline, &pCentral,
+                        NULL, NULL, NULL, NULL, run, control->i_step,
+                        FIDUCIAL_BEAM_SEEN + FIRST_BEAM_IS_FIDUCIAL + SILENT_RUNNING + (allow_watch_file_output ? 0 : INHIBIT_FILE_OUTPUT),
+                        control->n_passes, 0, NULL, NULL, NULL, NULL, NULL);
+    setTrackingOmniWedgeFunction(NULL);
+
+    /* lost particles are at the top of the array */
+    lostIndex = tmalloc(sizeof(*lostIndex) * nTotal);
+    for (ip = 0; ip < nTotal; ip++)
+      lostIndex[ip] = -1;
+    for (ip = nLeft; ip < nTotal; ip++) {
+      if ((id = coord[ip][particleIDIndex]) < 0 || id >= nTotal)
+        bombElegant("lost-particle accounting error (batchedMomentumApertureSearch)", NULL);
+      lostIndex[id] = ip;
+    }
+
+    for (iSearch = 0; iSearch < batchSearches; iSearch++) {
+      if (searchDone[iSearch])
+        continue;
+      row = searchRow[iSearch];
+      side = iSearch % 2;
+      /* the first loss in order of increasing |delta| ends the scan */
+      for (iTrial = 0; iTrial < batchTrials[iSearch]; iTrial++) {
+        id = batchFirstTrial[iSearch] + iTrial;
+        delta = batchTrialDelta[id];
+        if ((ip = lostIndex[id]) >= 0) {
+          lostOnPass[side][row] = coord[ip][lossPassIndex];
+          xLost[side][row] = coord[ip][0];
+          yLost[side][row] = coord[ip][2];
+          sLost[side][row] = coord[ip][4];
+          deltaLost[iSearch] = delta;
+          deltaWhenLost[side][row] = (coord[ip][5] - pCentral) / pCentral;
+          loserFound[side][row] = 1;
+          break;
+        }
+        deltaSurvived[side][row] = delta;
+        survivorFound[side][row] = 1;
+      }
+      if (split == 0) {
+        if (!survivorFound[side][row]) {
+          if (!soft_failure) {
+            printf("Error: No survivor found for initial scan for  %s #%ld at s=%em\n", ElementName[row], (long)ElementOccurence[row], sStart[row]);
+            exit(1);
+          }
+          snprintf(warningBuffer, 1024, "Element %s#%ld at s=%em.",
+                   ElementName[row], (long)ElementOccurence[row], sStart[row]);
+          printWarning("momentum_aperture: No survivor found for initial scan.", warningBuffer);
+          deltaSurvived[side][row] = 0;
+          survivorFound[side][row] = 1;
+          searchDone[iSearch] = 1;
+        }
+        if (!loserFound[side][row]) {
+          if (!soft_failure) {
+            printf("Error: No loss found for initial scan for  %s #%ld at s=%em\n", ElementName[row], (long)ElementOccurence[row], sStart[row]);
+            bombElegant(NULL, NULL);
+          }
+          loserFound[side][row] = 1;
+          searchDone[iSearch] = 1;
+        }
+      }
+      deltaStart[iSearch] = deltaSurvived[side][row] - steps_back * deltaInterval[iSearch];
+      deltaInterval[iSearch] /= split_step_divisor;
+      deltaStart[iSearch] += deltaInterval[iSearch];
+      deltaLimit[iSearch] = deltaLost[iSearch];
+      if ((deltaStart[iSearch] < 0 && side == 1) || (deltaStart[iSearch] > 0 && side == 0))
+        deltaStart[iSearch] = 0;
+    }
+    free(lostIndex);
+    free_czarray_2d((void **)coord, nTotal, totalPropertiesPerParticle);
+  }
+
+  if (verbosity > 0) {
+    for (row = 0; row < nRows; row++)
+      printf("Energy aperture for %s #%ld at s=%em is %e, %e\n", ElementName[row], (long)ElementOccurence[row], sStart[row],
+             deltaSurvived[0][row], deltaSurvived[1][row]);
+    fflush(stdout);
+  }
+
+  free(searchRow);
+  free(searchDone);
+  free(deltaStart);
+  free(deltaInterval);
+  free(deltaLimit);
+  free(deltaLost);
+  free(batchFirstTrial);
+  free(batchTrials);
+  free(batchWedgeElement);
+  free(batchTrialDelta);
+  batchFirstTrial = batchTrials = NULL;
+  batchWedgeElement = NULL;
+  batchTrialDelta = NULL;
+  batchSearches = 0;
+  return nRows;
+}
+
 long doMomentumApertureSearch(
   RUN *run,
   VARY *control,
@@ -345,21 +579,21 @@ long doMomentumApertureSearch(
   coord = (double **)czarray_2d(sizeof(**coord), 1, totalPropertiesPerParticle);
 
   /* allocate arrays for storing data for negative and positive momentum limits for each element */
-  lostOnPass = (int32_t **)czarray_2d(sizeof(**lostOnPass), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  loserFound = (short **)czarray_2d(sizeof(**loserFound), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  survivorFound = (short **)czarray_2d(sizeof(**survivorFound), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  deltaSurvived = (double **)czarray_2d(sizeof(**deltaSurvived), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  xTuneSurvived = (double **)czarray_2d(sizeof(**xTuneSurvived), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  yTuneSurvived = (double **)czarray_2d(sizeof(**yTuneSurvived), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  xLost = (double **)czarray_2d(sizeof(**xLost), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  yLost = (double **)czarray_2d(sizeof(**yLost), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  deltaWhenLost = (double **)czarray_2d(sizeof(**deltaWhenLost), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  sLost = (double **)czarray_2d(sizeof(**sLost), (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  sStart = (double *)tmalloc(sizeof(*sStart) * (output_mode ? 2 : 1) * nElem);
-  ElementName = (char **)tmalloc(sizeof(*ElementName) * (output_mode ? 2 : 1) * nElem);
-  ElementType = (char **)tmalloc(sizeof(*ElementType) * (output_mode ? 2 : 1) * nElem);
-  ElementOccurence = (int32_t *)tmalloc(sizeof(*ElementOccurence) * (output_mode ? 2 : 1) * nElem);
-  if (output_mode)
+  lostOnPass = (int32_t **)czarray_2d(sizeof(**lostOnPass), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  loserFound = (short **)czarray_2d(sizeof(**loserFound), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  survivorFound = (short **)czarray_2d(sizeof(**survivorFound), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  deltaSurvived = (double **)czarray_2d(sizeof(**deltaSurvived), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  xTuneSurvived = (double **)czarray_2d(sizeof(**xTuneSurvived), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  yTuneSurvived = (double **)czarray_2d(sizeof(**yTuneSurvived), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  xLost = (double **)czarray_2d(sizeof(**xLost), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  yLost = (double **)czarray_2d(sizeof(**yLost), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  deltaWhenLost = (double **)czarray_2d(sizeof(**deltaWhenLost), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  sLost = (double **)czarray_2d(sizeof(**sLost), (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  sStart = (double *)tmalloc(sizeof(*sStart) * (output_mode == 1 ? 2 : 1) * nElem);
+  ElementName = (char **)tmalloc(sizeof(*ElementName) * (output_mode == 1 ? 2 : 1) * nElem);
+  ElementType = (char **)tmalloc(sizeof(*ElementType) * (output_mode == 1 ? 2 : 1) * nElem);
+  ElementOccurence = (int32_t *)tmalloc(sizeof(*ElementOccurence) * (output_mode == 1 ? 2 : 1) * nElem);
+  if (output_mode == 1)
     direction = (short *)tmalloc(sizeof(*direction) * 2 * nElem);
   deltaLimit1[0] = delta_negative_limit;
   deltaLimit1[1] = delta_positive_limit;
@@ -382,7 +616,7 @@ long doMomentumApertureSearch(
 
   beamline->fiducial_flag = 0;
 
-  if (fiducialize || forbid_resonance_crossing) {
+  if (fiducialize || forbid_resonance_crossing || output_mode == 3) {
     long i;
     if (startingCoord)
       memcpy(coord[0], startingCoord, sizeof(double) * 6);
@@ -422,6 +656,16 @@ long doMomentumApertureSearch(
   verbosity = 0;
 #endif
 
+  if (output_mode == 3) {
+    outputRow = batchedMomentumApertureSearch(run, control, beamline, startingCoord, elem0,
+                                              ElementName, ElementType, ElementOccurence, sStart,
+                                              lostOnPass, loserFound, survivorFound, deltaSurvived,
+                                              xLost, yLost, sLost, deltaWhenLost,
+                                              xTuneSurvived, yTuneSurvived) -
+      1;
+    processElements = 0;
+  }
+
   while (elem && processElements > 0) {
 #ifdef DEBUG
     printf("checking element %s#%ld\n", elem->name, elem->occurence);
@@ -689,7 +933,7 @@ long doMomentumApertureSearch(
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
 
-  if ((output_mode == 0 &&
+  if (((output_mode == 0 || output_mode == 3) &&
        (!SDDS_SetColumn(&SDDSma, SDDS_SET_BY_NAME, ElementName, outputRow, "ElementName") ||
         !SDDS_SetColumn(&SDDSma, SDDS_SET_BY_NAME, sStart, outputRow, "s") ||
         !SDDS_SetColumn(&SDDSma, SDDS_SET_BY_NAME, ElementType, outputRow, "ElementType") ||
@@ -743,16 +987,16 @@ long doMomentumApertureSearch(
     SDDS_DoFSync(&SDDSma);
 
   free_czarray_2d((void **)coord, 1, totalPropertiesPerParticle);
-  free_czarray_2d((void **)lostOnPass, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)loserFound, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)survivorFound, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)deltaSurvived, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)xLost, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)yLost, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)deltaWhenLost, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)sLost, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)xTuneSurvived, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
-  free_czarray_2d((void **)yTuneSurvived, (output_mode ? 1 : 2), (output_mode ? 2 : 1) * nElem);
+  free_czarray_2d((void **)lostOnPass, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)loserFound, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)survivorFound, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)deltaSurvived, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)xLost, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)yLost, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)deltaWhenLost, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)sLost, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)xTuneSurvived, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
+  free_czarray_2d((void **)yTuneSurvived, (output_mode == 1 ? 1 : 2), (output_mode == 1 ? 2 : 1) * nElem);
   free_czarray_2d((void **)turnByTurnCoord, 5, control->n_passes);
   turnByTurnCoord = NULL;
 
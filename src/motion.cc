@@ -2399,7 +2399,7 @@ void stochastic_laserModulator(double *q, double tau, double h) {
   if (lsrMdltr->synchRad)
     delta1 -= radCoef * (1 + delta0) * irho2 * h;
   if (lsrMdltr->isr)
-    delta1 += isrCoef * sqr(1 + delta0) * pow(irho2, 0.75) * sqrt(h) * gauss_rn_lim(0.0, 1.0, 3.0, random_2);
+    delta1 += isrCoef * sqr(1 + delta0) * pow(irho2, 0.75) * sqrt(h) * gauss_rn_lim_elegant(0.0, 1.0, 3.0, random_2_elegant);
 
   for (i = 0; i < 3; i++)
     P[i] *= (1 + delta1) / (1 + delta0);
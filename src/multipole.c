@@ -37,6 +37,13 @@ void applyRadialCanonicalMultipoleKicks(double *qx, double *qy,
                                         double *xpow, double *ypow,
                                         long order, double KnL, long skew);
 long evaluateLostWithOpenSides(long code, double dx, double dy, double xsize, double ysize);
+static void integrate_kick_multipole_ordn_batch(double **coord, long n, short *ok,
+                                                double dx, double dy, double xkick, double ykick,
+                                                long *order, double *KnL, short *skew,
+                                                long n_parts, double drift, long integration_order,
+                                                MULTIPOLE_DATA *multData, MULTIPOLE_DATA *edgeMultData,
+                                                MULTIPOLE_DATA *steeringMultData,
+                                                MULT_APERTURE_DATA *apData, double refTilt);
 
 
 long findMaximumOrder(const long order, const long order2,
@@ -680,7 +687,8 @@ long multipole_tracking2(
   short skew[3] = {0, 0, 0};
   double dx, dy, dz; /* offsets of the multipole center */
   long nSlices, n_kicks, integ_order, iOrder;
-  long i_part, i_top;
+  long i_part, i_top, i_lost, nLeft, nThreads, maxOrder;
+  short *lost, batchKicks;
   double *coord;
   double drift;
   double tilt, pitch, yaw, rad_coef, isr_coef, xkick, ykick, dzLoss = 0;
@@ -1010,43 +1018,97 @@ long multipole_tracking2(
 
   if (sigmaDelta2)
     *sigmaDelta2 = 0;
-  for (i_part = 0; i_part <= i_top; i_part++) {
-    if (!(coord = particle[i_part])) {
-      printf("null coordinate pointer for particle %ld (multipole_tracking)", i_part);
-      fflush(stdout);
-      abort();
-    }
-    if (accepted && !accepted[i_part]) {
-      printf("null accepted coordinates pointer for particle %ld (multipole_tracking)", i_part);
-      fflush(stdout);
-      abort();
-    }
 
-    if (!integrate_kick_multipole_ordn(coord, dx, dy, xkick, ykick,
-                                       Po, rad_coef, isr_coef,
-                                       order, KnL, skew,
-                                       nSlices, iSlice, drift, integ_order,
-                                       multData, edgeMultData, steeringMultData,
-                                       &apertureData, &dzLoss, sigmaDelta2,
-                                       elem->type == T_KQUAD ? kquad->radial : 0, tilt)) {
-      swapParticles(particle[i_part], particle[i_top]);
-      if (globalLossCoordOffset > 0) {
-        double X, Y, Z, theta;
-        convertLocalCoordinatesToGlobal(&Z, &X, &Y, &theta, GLOBAL_LOCAL_MODE_DZ, particle[i_top], elem,
-                                        dzLoss, 0, 0);
-        particle[i_top][globalLossCoordOffset + 0] = X;
-        particle[i_top][globalLossCoordOffset + 1] = Z;
-        particle[i_top][globalLossCoordOffset + 2] = theta;
+  /* Random-number draws for ISR and the sigmaDelta2 sum depend on particle order, so
+   * those cases are always tracked on one thread.
+   */
+  lost = NULL;
+  if ((nThreads = particleThreadsToUse(n_part)) > 1 && (isr_coef > 0 || sigmaDelta2))
+    nThreads = 1;
+  /* The batched kick kernel covers whole-element tracking without radiation */
+  batchKicks = soaTracking && iSlice < 0 && !rad_coef && isr_coef <= 0 && !sigmaDelta2 &&
+    !(elem->type == T_KQUAD && kquad->radial);
+  if (nThreads > 1 || batchKicks) {
+    /* fill the expansion coefficient cache before threads read it */
+    maxOrder = findMaximumOrder(order[0], order[1] > order[2] ? order[1] : order[2], edgeMultData, steeringMultData, multData);
+    for (iOrder = 0; iOrder <= maxOrder; iOrder++)
+      expansion_coefficients(iOrder);
+    lost = tmalloc(sizeof(*lost) * n_part);
+  }
+
+#if defined(_OPENMP)
+#  pragma omp parallel num_threads(nThreads) if (nThreads > 1) private(i_part, i_top, coord, dzLoss)
+#endif
+  {
+    long i_first, nBatch;
+    short batchOk[PARTICLE_SOA_TILE];
+    particleThreadRange(n_part, &i_first, &i_top);
+    for (i_part = i_first; i_part <= i_top; i_part++) {
+      if (batchKicks && (i_part - i_first) % PARTICLE_SOA_TILE == 0) {
+        if ((nBatch = i_top - i_part + 1) > PARTICLE_SOA_TILE)
+          nBatch = PARTICLE_SOA_TILE;
+        integrate_kick_multipole_ordn_batch(particle + i_part, nBatch, batchOk, dx, dy, xkick, ykick,
+                                            order, KnL, skew, nSlices, drift, integ_order,
+                                            multData, edgeMultData, steeringMultData,
+                                            &apertureData, tilt);
+      }
+      if (!(coord = particle[i_part])) {
+        printf("null coordinate pointer for particle %ld (multipole_tracking)", i_part);
+        fflush(stdout);
+        abort();
+      }
+      if (accepted && !accepted[i_part]) {
+        printf("null accepted coordinates pointer for particle %ld (multipole_tracking)", i_part);
+        fflush(stdout);
+        abort();
+      }
+      if (lost)
+        lost[i_part] = 0;
+
+      /* particles the batched kernel couldn't finish are redone on the scalar path */
+      if ((!batchKicks || !batchOk[(i_part - i_first) % PARTICLE_SOA_TILE]) &&
+          !integrate_kick_multipole_ordn(coord, dx, dy, xkick, ykick,
+                                         Po, rad_coef, isr_coef,
+                                         order, KnL, skew,
+                                         nSlices, iSlice, drift, integ_order,
+                                         multData, edgeMultData, steeringMultData,
+                                         &apertureData, &dzLoss, sigmaDelta2,
+                                         elem->type == T_KQUAD ? kquad->radial : 0, tilt)) {
+        if (lost) {
+          /* record the loss in place; compactLostParticles() moves it later */
+          lost[i_part] = 1;
+          i_lost = i_part;
+        } else {
+          swapParticles(particle[i_part], particle[i_top]);
+          if (accepted)
+            swapParticles(accepted[i_part], accepted[i_top]);
+          i_lost = i_top;
+        }
+        if (globalLossCoordOffset > 0) {
+          double X, Y, Z, theta;
+          convertLocalCoordinatesToGlobal(&Z, &X, &Y, &theta, GLOBAL_LOCAL_MODE_DZ, particle[i_lost], elem,
+                                          dzLoss, 0, 0);
+          particle[i_lost][globalLossCoordOffset + 0] = X;
+          particle[i_lost][globalLossCoordOffset + 1] = Z;
+          particle[i_lost][globalLossCoordOffset + 2] = theta;
+        }
+        particle[i_lost][4] = z_start + dzLoss;
+        particle[i_lost][5] = Po * (1 + particle[i_lost][5]);
+        if (!lost) {
+          i_top--;
+          i_part--;
+        }
+        continue;
       }
-      if (accepted)
-        swapParticles(accepted[i_part], accepted[i_top]);
-      particle[i_top][4] = z_start + dzLoss;
-      particle[i_top][5] = Po * (1 + particle[i_top][5]);
-      i_top--;
-      i_part--;
-      continue;
     }
+    if (!lost)
+      nLeft = i_top + 1;
   }
+  if (lost) {
+    nLeft = compactLostParticles(particle, accepted, lost, n_part);
+    free(lost);
+  }
+  i_top = nLeft - 1;
   if (sigmaDelta2)
     *sigmaDelta2 /= i_top + 1;
 
@@ -1378,7 +1440,7 @@ int integrate_kick_multipole_ordn(double *coord, double dx, double dy, double xk
         if (rad_coef)
           dp -= rad_coef * deltaFactor * F2 * dsFactor;
         if (isr_coef > 0)
-          dp -= isr_coef * deltaFactor * pow(F2, 0.75) * sqrt(dsISRFactor) * gauss_rn_lim(0.0, 1.0, srGaussianLimit, random_2);
+          dp -= isr_coef * deltaFactor * pow(F2, 0.75) * sqrt(dsISRFactor) * gauss_rn_lim_elegant(0.0, 1.0, srGaussianLimit, random_2_elegant);
         if (sigmaDelta2)
           *sigmaDelta2 += sqr(isr_coef * deltaFactor) * pow(F2, 1.5) * dsISRFactor;
         qx *= (1 + dp);
@@ -1455,6 +1517,291 @@ int integrate_kick_multipole_ordn(double *coord, double dx, double dy, double xk
   return 1;
 }
 
+/* Kick for a block of particles, with the same arithmetic as apply_canonical_multipole_kicks_ret() */
+static void apply_canonical_multipole_kicks_batch(double *restrict qx, double *restrict qy,
+                                                  double **xpow, double **ypow, long n,
+                                                  long order, double KnL, long skew) {
+  double sum_Fx[PARTICLE_SOA_TILE], sum_Fy[PARTICLE_SOA_TILE];
+  double *restrict xp, *restrict yp, *restrict F;
+  double *coef;
+  long i, ip;
+
+  coef = expansion_coefficients(order);
+  for (ip = 0; ip < n; ip++)
+    sum_Fx[ip] = sum_Fy[ip] = 0;
+  for (i = 0; i <= order; i++) {
+    xp = xpow[order - i];
+    yp = ypow[i];
+    F = i & 1 ? sum_Fx : sum_Fy;
+    for (ip = 0; ip < n; ip++)
+      F[ip] += coef[i] * xp[ip] * yp[ip];
+  }
+  if (skew) {
+    for (ip = 0; ip < n; ip++) {
+      qx[ip] -= KnL * sum_Fx[ip];
+      qy[ip] += KnL * -sum_Fy[ip];
+    }
+  } else {
+    for (ip = 0; ip < n; ip++) {
+      qx[ip] -= KnL * sum_Fy[ip];
+      qy[ip] += KnL * sum_Fx[ip];
+    }
+  }
+}
+
+/* Converts momenta to slopes for a block, flagging particles with undefined slopes */
+static void convertMomentaToSlopesBatch(double *restrict xp, double *restrict yp, double *restrict qx, double *restrict qy,
+                                        double *restrict dp, short *restrict ok, long n) {
+  double denom;
+  long ip;
+  if (expandHamiltonian) {
+    for (ip = 0; ip < n; ip++) {
+      xp[ip] = qx[ip] / (1 + dp[ip]);
+      yp[ip] = qy[ip] / (1 + dp[ip]);
+    }
+  } else {
+    for (ip = 0; ip < n; ip++) {
+      denom = sqr(1 + dp[ip]) - sqr(qx[ip]) - sqr(qy[ip]);
+      ok[ip] &= denom > 0;
+      denom = sqrt(denom > 0 ? denom : 1);
+#if TURBO_RECIPROCALS
+      xp[ip] = qx[ip] * (1.0 / denom);
+      yp[ip] = qy[ip] * (1.0 / denom);
+#else
+      xp[ip] = qx[ip] / denom;
+      yp[ip] = qy[ip] / denom;
+#endif
+    }
+  }
+}
+
+static void checkMultipoleLimitsBatch(PARTICLE_SOA *soa, short *ok) {
+  long ip;
+  for (ip = 0; ip < soa->n; ip++) {
+#if defined(IEEE_MATH)
+    if (isnan(soa->coord[0][ip]) || isnan(soa->coord[1][ip]) || isnan(soa->coord[2][ip]) || isnan(soa->coord[3][ip]))
+      ok[ip] = 0;
+#endif
+    if (FABS(soa->coord[0][ip]) > coordLimit || FABS(soa->coord[2][ip]) > coordLimit ||
+        FABS(soa->coord[1][ip]) > slopeLimit || FABS(soa->coord[3][ip]) > slopeLimit)
+      ok[ip] = 0;
+  }
+}
+
+/* Batched version of integrate_kick_multipole_ordn() for whole-element tracking
+ * without radiation. Particles are handled as a structure of arrays so that the
+ * drift-kick sequence vectorizes. The arithmetic for each particle is identical to
+ * the scalar routine. Particles that reach any loss condition are left untouched
+ * with ok[i]=0, and the caller re-tracks them with the scalar routine, which takes
+ * care of loss coordinates and warnings.
+ */
+static void integrate_kick_multipole_ordn_batch(double **coord, long n, short *ok,
+                                                double dx, double dy, double xkick, double ykick,
+                                                long *order, double *KnL, short *skew,
+                                                long n_parts, double drift, long integration_order,
+                                                MULTIPOLE_DATA *multData, MULTIPOLE_DATA *edgeMultData,
+                                                MULTIPOLE_DATA *steeringMultData,
+                                                MULT_APERTURE_DATA *apData, double refTilt) {
+  static double driftFrac2[2] = {
+    0.5, 0.5};
+  static double kickFrac2[2] = {
+    1.0, 0.0};
+  static double driftFrac4[4] = {
+    0.5 / (2 - BETA), (1 - BETA) / (2 - BETA) / 2, (1 - BETA) / (2 - BETA) / 2, 0.5 / (2 - BETA)};
+  static double kickFrac4[4] = {
+    1. / (2 - BETA), -BETA / (2 - BETA), 1 / (2 - BETA), 0};
+  static double driftFrac6[8] = {
+    0.39225680523878,
+    0.5100434119184585,
+    -0.47105338540975655,
+    0.0687531682525181,
+    0.0687531682525181,
+    -0.47105338540975655,
+    0.5100434119184585,
+    0.39225680523878,
+  };
+  static double kickFrac6[8] = {
+    0.784513610477560, 0.235573213359357, -1.17767998417887, 1.3151863206839063,
+    -1.17767998417887, 0.235573213359357, 0.784513610477560, 0};
+  double *driftFrac = NULL, *kickFrac = NULL;
+  long nSubsteps = 0;
+  PARTICLE_SOA soa;
+  double qx[PARTICLE_SOA_TILE], qy[PARTICLE_SOA_TILE], s[PARTICLE_SOA_TILE];
+  double *restrict x, *restrict xp, *restrict y, *restrict yp, *restrict dp;
+  double **xpow, **ypow, *powBuffer;
+  double dsh, KnLp[3];
+  long maxOrder, i_kick, step, iOrder, ip, i;
+
+  switch (integration_order) {
+  case 2:
+    nSubsteps = 2;
+    driftFrac = driftFrac2;
+    kickFrac = kickFrac2;
+    break;
+  case 4:
+    nSubsteps = 4;
+    driftFrac = driftFrac4;
+    kickFrac = kickFrac4;
+    break;
+  case 6:
+    nSubsteps = 8;
+    driftFrac = driftFrac6;
+    kickFrac = kickFrac6;
+    break;
+  default:
+    bombElegantVA("invalid order %ld given for symplectic integrator", integration_order);
+    break;
+  }
+  if (n > PARTICLE_SOA_TILE)
+    bombElegant("too many particles for batched multipole kick (integrate_kick_multipole_ordn_batch)", NULL);
+
+  drift = drift / n_parts;
+  xkick = xkick / n_parts;
+  ykick = ykick / n_parts;
+  for (i = 0; i < 3; i++)
+    KnLp[i] = KnL[i] / n_parts;
+
+  allocateParticleSoA(&soa, n);
+  loadParticleSoA(&soa, coord, n);
+  x = soa.coord[0];
+  xp = soa.coord[1];
+  y = soa.coord[2];
+  yp = soa.coord[3];
+  dp = soa.coord[5];
+
+  maxOrder = findMaximumOrder(order[0], order[1] > order[2] ? order[1] : order[2], edgeMultData, steeringMultData, multData);
+  xpow = tmalloc(sizeof(*xpow) * (maxOrder + 1));
+  ypow = tmalloc(sizeof(*ypow) * (maxOrder + 1));
+  powBuffer = tmalloc(sizeof(*powBuffer) * 2 * (maxOrder + 1) * n);
+  for (i = 0; i <= maxOrder; i++) {
+    xpow[i] = powBuffer + i * n;
+    ypow[i] = powBuffer + (maxOrder + 1 + i) * n;
+  }
+
+  for (ip = 0; ip < n; ip++) {
+    ok[ip] = 1;
+    s[ip] = 0;
+  }
+  checkMultipoleLimitsBatch(&soa, ok);
+
+  /* calculate initial canonical momenta */
+  for (ip = 0; ip < n; ip++)
+    convertSlopesToMomenta(qx + ip, qy + ip, xp[ip], yp[ip], dp[ip]);
+
+#define FILL_POWERS_BATCH()                   \
+  for (ip = 0; ip < n; ip++)                  \
+    xpow[0][ip] = ypow[0][ip] = 1;            \
+  for (i = 1; i <= maxOrder; i++)             \
+    for (ip = 0; ip < n; ip++) {              \
+      xpow[i][ip] = xpow[i - 1][ip] * x[ip];  \
+      ypow[i][ip] = ypow[i - 1][ip] * y[ip];  \
+    }
+
+  if (edgeMultData && edgeMultData->orders) {
+    FILL_POWERS_BATCH();
+    for (i = 0; i < edgeMultData->orders; i++) {
+      apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, edgeMultData->order[i], edgeMultData->KnL[i], 0);
+      apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, edgeMultData->order[i], edgeMultData->JnL[i], 1);
+    }
+  }
+  convertMomentaToSlopesBatch(xp, yp, qx, qy, dp, ok, n);
+
+  for (i_kick = 0; i_kick <= n_parts; i_kick++) {
+    /* aperture and obstruction checks at the start of each kick and at the end */
+    for (ip = 0; ip < n; ip++) {
+      if (ok[ip] &&
+          ((apData && !checkMultAperture(x[ip] + dx, y[ip] + dy, drift * i_kick, apData)) ||
+           insideObstruction_xyz(x[ip], xp[ip], y[ip], yp[ip], coord[ip][particleIDIndex], NULL,
+                                 refTilt, GLOBAL_LOCAL_MODE_SEG, 0.0, i_kick, n_parts)))
+        ok[ip] = 0;
+    }
+    if (i_kick == n_parts)
+      break;
+    for (step = 0; step < nSubsteps; step++) {
+      if (drift) {
+        dsh = drift * driftFrac[step];
+        for (ip = 0; ip < n; ip++) {
+          x[ip] += xp[ip] * dsh;
+          y[ip] += yp[ip] * dsh;
+        }
+        if (expandHamiltonian) {
+          for (ip = 0; ip < n; ip++)
+            s[ip] += dsh * (1 + (sqr(xp[ip]) + sqr(yp[ip])) / 2);
+        } else {
+          for (ip = 0; ip < n; ip++)
+            s[ip] += dsh * sqrt(1 + sqr(xp[ip]) + sqr(yp[ip]));
+        }
+      }
+
+      if (!kickFrac[step])
+        break;
+
+      FILL_POWERS_BATCH();
+
+      for (iOrder = 0; iOrder < 3; iOrder++)
+        if (KnL[iOrder])
+#if TURBO_APPLY_KICKS_FAST >= 2
+          apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, order[iOrder], KnLp[iOrder] * kickFrac[step], skew[iOrder]);
+#else
+          apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, order[iOrder], KnL[iOrder] / n_parts * kickFrac[step], skew[iOrder]);
+#endif
+      if (xkick)
+        apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, 0, -xkick * kickFrac[step], 0);
+      if (ykick)
+        apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, 0, -ykick * kickFrac[step], 1);
+      /* strengths are computed in the same order as in the scalar routine */
+      if (steeringMultData && steeringMultData->orders) {
+        for (i = 0; i < steeringMultData->orders; i++) {
+          if (steeringMultData->KnL[i])
+            apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, steeringMultData->order[i],
+                                                  steeringMultData->KnL[i] * xkick * kickFrac[step], 0);
+          if (steeringMultData->JnL[i])
+            apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, steeringMultData->order[i],
+                                                  steeringMultData->JnL[i] * ykick * kickFrac[step], 1);
+        }
+      }
+      if (multData) {
+        for (i = 0; i < multData->orders; i++) {
+          if (multData->KnL && multData->KnL[i])
+            apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, multData->order[i],
+                                                  multData->KnL[i] * kickFrac[step] / n_parts, 0);
+          if (multData->JnL && multData->JnL[i])
+            apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, multData->order[i],
+                                                  multData->JnL[i] * kickFrac[step] / n_parts, 1);
+        }
+      }
+
+      convertMomentaToSlopesBatch(xp, yp, qx, qy, dp, ok, n);
+    }
+  }
+
+  if (edgeMultData && edgeMultData->orders) {
+    FILL_POWERS_BATCH();
+    for (i = 0; i < edgeMultData->orders; i++) {
+      apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, edgeMultData->order[i], edgeMultData->KnL[i], 0);
+      apply_canonical_multipole_kicks_batch(qx, qy, xpow, ypow, n, edgeMultData->order[i], edgeMultData->JnL[i], 1);
+    }
+  }
+  convertMomentaToSlopesBatch(xp, yp, qx, qy, dp, ok, n);
+#undef FILL_POWERS_BATCH
+
+  checkMultipoleLimitsBatch(&soa, ok);
+  for (ip = 0; ip < n; ip++) {
+    if (!ok[ip])
+      continue;
+    coord[ip][0] = x[ip];
+    coord[ip][1] = xp[ip];
+    coord[ip][2] = y[ip];
+    coord[ip][3] = yp[ip];
+    coord[ip][4] += s[ip];
+  }
+
+  free(powBuffer);
+  free(xpow);
+  free(ypow);
+  freeParticleSoA(&soa);
+}
+
 void applyRadialCanonicalMultipoleKicks(double *qx, double *qy,
                                         double *sum_Fx_return, double *sum_Fy_return,
                                         double *xpow, double *ypow,
@@ -1497,8 +1844,8 @@ void randomizeErrorMultipoleFields(MULTIPOLE_DATA *randomMult) {
   for (i = 0; i < randomMult->orders; i++) {
     nFactorial = dfactorial(randomMult->order[i]);
     rpow = ipow(randomMult->referenceRadius, randomMult->order[i]);
-    rn1 = gauss_rn_lim(0.0, 1.0, 2.0, random_1_elegant);
-    rn2 = gauss_rn_lim(0.0, 1.0, 2.0, random_1_elegant);
+    rn1 = gauss_rn_lim_elegant(0.0, 1.0, 2.0, random_1_elegant);
+    rn2 = gauss_rn_lim_elegant(0.0, 1.0, 2.0, random_1_elegant);
     randomMult->anMod[i] = randomMult->an[i] * nFactorial * rn1 / rpow;
     randomMult->bnMod[i] = randomMult->bn[i] * nFactorial * rn2 / rpow;
   }
@@ -58,7 +58,7 @@ double GetNoiseGroupValue(long groupId) {
     if (groupId == idValue[i]) {
       getTrackingContext(&tContext);
       if (!valueValid[i]) {
-        randomValue[i] = gauss_rn_lim(0.0, 1.0, 2, random_3);
+        randomValue[i] = gauss_rn_lim_elegant(0.0, 1.0, 2, random_3_elegant);
         printf("Noise value for group %ld is %e\n", idValue[i], randomValue[i]);
       }
       printf("Returning noise value %e for %s\n", randomValue[i], tContext.elementName);
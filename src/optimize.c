@@ -46,6 +46,11 @@ static char *optimize_statistic[N_OPTIM_STATS] = {
 static long stopOptimization = 0;
 long checkForOptimRecord(double *value, long values, long *again);
 void storeOptimRecord(double *value, long values, long invalid, double result);
+static void openOptimCache(char *filename, long values);
+static long checkOptimCache(double *value, long values, long *invalid, double *result);
+static void storeOptimCache(double *value, long values, long invalid, double result);
+static void closeOptimCache(void);
+static unsigned long twissComputationsNeeded(OPTIMIZATION_DATA *optimization_data, LINE_LIST *beamline);
 void rpnStoreHigherMatrixElements(VMATRIX *M, long **TijkMem, long **UijklMem, long maxOrder);
 double particleComparisonForOptimization(BEAM *beam, OPTIMIZATION_DATA *optimData, long *invalid);
 
@@ -156,6 +161,39 @@ void do_optimization_setup(OPTIMIZATION_DATA *optimization_data, NAMELIST_TEXT *
   optimization_data->includeSimplex1dScans = include_simplex_1d_scans;
   optimization_data->startFromSimplexVertex1 = start_from_simplex_vertex1;
   optimization_data->rcdsStepFactor = rcds_step_factor;
+  if ((optimization_data->lmDerivativeFactor = lm_derivative_factor) <= 0)
+    bombElegant("lm_derivative_factor <= 0", NULL);
+  optimization_data->restrictTwissComputations = restrict_twiss_computations;
+  if (optimization_data->method == OPTIM_METHOD_LM) {
+    if (optimization_data->mode != OPTIM_MODE_MINIMUM)
+      bombElegant("levenberg-marquardt method requires mode=\"minimize\"", NULL);
+    if (optimization_data->statistic != STATISTIC_SUM_SQR)
+      bombElegant("levenberg-marquardt method requires statistic=\"sum-squares\"", NULL);
+  }
+  optimization_data->evaluationCache = NULL;
+  if (evaluation_cache && strlen(evaluation_cache)) {
+    if (str_in(evaluation_cache, "%s"))
+      optimization_data->evaluationCache = compose_filename(evaluation_cache, run->rootname);
+    else
+      cp_str(&optimization_data->evaluationCache, evaluation_cache);
+  }
+  if ((optimization_data->evaluationCacheQuantum = evaluation_cache_quantum) < 0)
+    bombElegant("evaluation_cache_quantum < 0", NULL);
+  if ((optimization_data->localWorkers = local_workers) < 0)
+    bombElegant("local_workers < 0", NULL);
+  if (optimization_data->localWorkers > 1) {
+#if USE_MPI || !defined(__unix__)
+    printWarning("optimization_setup: local_workers is ignored.", "Concurrent local workers are available only in the serial version on Unix systems.");
+    optimization_data->localWorkers = 0;
+#else
+    if (optimization_data->method != OPTIM_METHOD_SIMPLEX && optimization_data->method != OPTIM_METHOD_1DSCANS &&
+        optimization_data->method != OPTIM_METHOD_RCDS && optimization_data->method != OPTIM_METHOD_POWELL &&
+        optimization_data->method != OPTIM_METHOD_RANSAMPLE && optimization_data->method != OPTIM_METHOD_RANWALK) {
+      printWarning("optimization_setup: local_workers is ignored.", "Concurrent local workers are available for the simplex, 1dscans, rcds, powell, randomsample, and randomwalk methods.");
+      optimization_data->localWorkers = 0;
+    }
+#endif
+  }
   if ((optimization_data->restart_worst_term_factor = restart_worst_term_factor) <= 0)
     bombElegant("restart_worst_term_factor <= 0", NULL);
   if ((optimization_data->restart_worst_terms = restart_worst_terms) <= 0)
@@ -875,6 +913,7 @@ static long final_property_values;
 static double charge;
 static unsigned long optim_func_flags;
 static long force_output;
+static short localOptimizationWorker = 0; /* nonzero in a forked local worker, which writes no files */
 static long doClosedOrbit, doChromCorr, doTuneCorr, doFindAperture, doResponse;
 
 /* structure to keep results of last N optimization function
@@ -888,6 +927,8 @@ typedef struct {
   long usedBefore;
 } OPTIM_RECORD;
 static long optimRecords = 0, nextOptimRecordSlot = 0, balanceTerms = 0, ignoreOptimRecords = 0;
+/* particle comparison and equation value from the last evaluation, for levenberg-marquardt */
+static double lastParticleComparison = -1, lastEquationValue = 0;
 static OPTIM_RECORD optimRecord[MAX_OPTIM_RECORDS];
 static double bestResult = DBL_MAX;
 
@@ -902,6 +943,245 @@ void optimizationInterruptHandler(int signal) {
 }
 #endif
 
+#if !USE_MPI && defined(__unix__)
+#  include <unistd.h>
+#  include <sys/wait.h>
+/* Concurrent local workers (optimization_setup local_workers=N).
+ * Each restart is run by N processes forked from this one, so that each has its own
+ * copy of the beamline and of all tracking and twiss state. Worker 0 is this process
+ * and starts from the unmodified step sizes; the others use randomized step sizes and
+ * random number seeds drawn here before forking, so that each explores a different path.
+ * The other workers send their best result and variable values back through a pipe and
+ * exit, and the best of all workers is kept. Output from the other workers is discarded:
+ * stdout goes to /dev/null, and the log, evaluation cache file, and beam output files are
+ * written only by this process.
+ */
+typedef struct {
+  pid_t pid;
+  int fd;
+} LOCAL_OPTIM_WORKER;
+
+static long startLocalOptimizationWorkers(LOCAL_OPTIM_WORKER *worker, long nWorkers, OPTIM_VARIABLES *variables) {
+  long iWorker, i, seed;
+  double *step;
+  int fd[2];
+
+  step = tmalloc(sizeof(*step) * variables->n_variables);
+  memcpy(step, variables->step, sizeof(*step) * variables->n_variables);
+  fflush(NULL); /* don't let the workers inherit buffered output */
+  for (iWorker = 1; iWorker < nWorkers; iWorker++) {
+    for (i = 0; i < variables->n_variables; i++)
+      variables->step[i] = step[i] * 2 * random_1_elegant(0);
+    seed = 1 + (long)(random_1_elegant(0) * LONG_MAX / 2);
+    if (pipe(fd) != 0 || (worker[iWorker].pid = fork()) < 0)
+      bombElegant("unable to start local optimization worker", NULL);
+    if (worker[iWorker].pid == 0) {
+      close(fd[0]);
+      worker[iWorker].fd = fd[1];
+      if (!freopen("/dev/null", "w", stdout))
+        _exit(1);
+      optimization_data->fp_log = NULL;
+      localOptimizationWorker = 1;
+      n_evaluations_made = 0;
+      random_1_elegant(-seed);
+      tfree(step);
+      return iWorker;
+    }
+    close(fd[1]);
+    worker[iWorker].fd = fd[0];
+  }
+  memcpy(variables->step, step, sizeof(*step) * variables->n_variables);
+  tfree(step);
+  return 0;
+}
+
+static void finishLocalOptimizationWorker(LOCAL_OPTIM_WORKER *worker, double result, OPTIM_VARIABLES *variables) {
+  long n;
+  n = variables->n_variables;
+  if (write(worker->fd, &result, sizeof(result)) != sizeof(result) ||
+      write(worker->fd, &n_evaluations_made, sizeof(n_evaluations_made)) != sizeof(n_evaluations_made) ||
+      write(worker->fd, variables->varied_quan_value, sizeof(double) * n) != sizeof(double) * n)
+    _exit(1);
+  close(worker->fd);
+  _exit(0);
+}
+
+static void collectLocalOptimizationWorkers(LOCAL_OPTIM_WORKER *worker, long nWorkers, double *result, OPTIM_VARIABLES *variables) {
+  long iWorker, n, nEvaluations, iBest;
+  double workerResult, *value;
+  int status;
+
+  n = variables->n_variables;
+  value = tmalloc(sizeof(*value) * n);
+  iBest = 0;
+  for (iWorker = 1; iWorker < nWorkers; iWorker++) {
+    if (read(worker[iWorker].fd, &workerResult, sizeof(workerResult)) == sizeof(workerResult) &&
+        read(worker[iWorker].fd, &nEvaluations, sizeof(nEvaluations)) == sizeof(nEvaluations) &&
+        read(worker[iWorker].fd, value, sizeof(*value) * n) == sizeof(*value) * n) {
+      n_evaluations_made += nEvaluations;
+      if (workerResult < *result) {
+        *result = workerResult;
+        memcpy(variables->varied_quan_value, value, sizeof(*value) * n);
+        iBest = iWorker;
+      }
+    } else
+      printWarning("optimize: local optimization worker failed.", "Its result is ignored.");
+    close(worker[iWorker].fd);
+    waitpid(worker[iWorker].pid, &status, 0);
+  }
+  if (optimization_data->verbose > 1) {
+    printf("Best result %21.15e from local worker %ld of %ld\n", *result, iBest, nWorkers);
+    fflush(stdout);
+  }
+  tfree(value);
+}
+#endif
+
+/* Levenberg-Marquardt minimization with a finite-difference Jacobian
+ * (method=levenberg-marquardt), which requires the sum-squares statistic. The residuals r
+ * are the (weighted) term values, or the equation value if there are no terms, plus the
+ * particle comparison value when matching to a particle file, so the sum of r[i]^2 is the
+ * optimization function. Constraints don't contribute; a trial point that violates one is
+ * invalid and is rejected.
+ * No analytic derivatives are used: the Jacobian is found by forward differences with steps
+ * of lm_derivative_factor times the variable step sizes, so one Jacobian costs one full
+ * evaluation of the optimization function per variable.
+ * Trial steps solve (J'J + lambda*diag(J'J))*dx = -J'r and are accepted only if the
+ * optimization function decreases; lambda is reduced after a success and increased after a
+ * failure. Variables are kept inside their limits.
+ */
+static double lmResiduals(double *x, double *r, long nr, long *invalid) {
+  double y;
+  long i, saveIgnore;
+
+  /* term values are only available after a real evaluation */
+  saveIgnore = ignoreOptimRecords;
+  ignoreOptimRecords = 1;
+  y = optimization_function(x, invalid);
+  ignoreOptimRecords = saveIgnore;
+  if (*invalid)
+    return y;
+  if (!optimization_data->terms)
+    r[0] = lastEquationValue;
+  else {
+    for (i = 0; i < optimization_data->terms; i++)
+      r[i] = optimization_data->termValue[i];
+  }
+  if (optimization_data->nParticlesToMatch)
+    r[nr - 1] = lastParticleComparison;
+  return y;
+}
+
+static long levenbergMarquardtMin(double *yReturn, double *x, double *step, double *lower, double *upper,
+                                  long n, double target, double tolerance, long maxEvaluations,
+                                  double derivativeFactor) {
+  MATRIX *J, *Jt, *A, *Ainv, *g;
+  double *r, *r1, *x1, *dx, y, y1, h, lambda, change;
+  long i, j, k, nr, invalid, nEval, converged, success;
+
+  nr = (optimization_data->terms ? optimization_data->terms : 1) + (optimization_data->nParticlesToMatch ? 1 : 0);
+  r = tmalloc(sizeof(*r) * nr);
+  r1 = tmalloc(sizeof(*r1) * nr);
+  x1 = tmalloc(sizeof(*x1) * n);
+  dx = tmalloc(sizeof(*dx) * n);
+  m_alloc(&J, nr, n);
+  m_alloc(&Jt, n, nr);
+  m_alloc(&A, n, n);
+  m_alloc(&Ainv, n, n);
+  m_alloc(&g, n, 1);
+
+  y = lmResiduals(x, r, nr, &invalid);
+  nEval = 1;
+  if (invalid)
+    bombElegant("levenberg-marquardt optimization: starting point is invalid", NULL);
+  lambda = 1e-3;
+  converged = success = 0;
+  while (nEval < maxEvaluations && !converged && y > target && !optimAbort(0)) {
+    /* Jacobian by one-sided differences, stepping away from the nearer limit */
+    for (j = 0; j < n; j++) {
+      memcpy(x1, x, sizeof(*x) * n);
+      h = derivativeFactor * step[j];
+      if (lower[j] != upper[j] && x[j] + h > upper[j])
+        h = -h;
+      x1[j] = x[j] + h;
+      lmResiduals(x1, r1, nr, &invalid);
+      nEval++;
+      if (invalid) {
+        x1[j] = x[j] - h;
+        lmResiduals(x1, r1, nr, &invalid);
+        nEval++;
+        h = -h;
+      }
+      for (i = 0; i < nr; i++)
+        J->a[i][j] = invalid ? 0 : (r1[i] - r[i]) / h;
+    }
+    m_trans(Jt, J);
+    m_mult(A, Jt, J);
+    for (j = 0; j < n; j++) {
+      g->a[j][0] = 0;
+      for (i = 0; i < nr; i++)
+        g->a[j][0] += J->a[i][j] * r[i];
+    }
+
+    /* try increasingly damped steps until the function decreases */
+    success = 0;
+    while (!success && lambda < 1e16 && nEval < maxEvaluations) {
+      m_mult(Ainv, Jt, J);
+      for (j = 0; j < n; j++)
+        Ainv->a[j][j] += lambda * (A->a[j][j] > 0 ? A->a[j][j] : 1);
+      if (!m_invert(Ainv, Ainv)) {
+        lambda *= 10;
+        continue;
+      }
+      for (j = 0; j < n; j++) {
+        dx[j] = 0;
+        for (k = 0; k < n; k++)
+          dx[j] -= Ainv->a[j][k] * g->a[k][0];
+        x1[j] = x[j] + dx[j];
+        if (lower[j] != upper[j]) {
+          if (x1[j] > upper[j])
+            x1[j] = upper[j];
+          if (x1[j] < lower[j])
+            x1[j] = lower[j];
+        }
+      }
+      y1 = lmResiduals(x1, r1, nr, &invalid);
+      nEval++;
+      if (!invalid && y1 < y) {
+        change = y - y1;
+        memcpy(x, x1, sizeof(*x) * n);
+        memcpy(r, r1, sizeof(*r) * nr);
+        y = y1;
+        lambda = lambda > 1e-12 ? lambda / 10 : lambda;
+        success = 1;
+        if ((tolerance < 0 && change <= -tolerance * fabs(y)) || (tolerance > 0 && change <= tolerance))
+          converged = 1;
+      } else
+        lambda *= 10;
+    }
+    if (!success)
+      break;
+    if (optimization_data->verbose > 1) {
+      printf("Levenberg-Marquardt: result %21.15e after %ld evaluations, lambda=%le\n", y, nEval, lambda);
+      fflush(stdout);
+    }
+  }
+
+  m_free(&J);
+  m_free(&Jt);
+  m_free(&A);
+  m_free(&Ainv);
+  m_free(&g);
+  free(r);
+  free(r1);
+  free(x1);
+  free(dx);
+  *yReturn = y;
+  if (converged || y <= target)
+    return nEval;
+  return -1;
+}
+
 int variableAtLimit(double value, double lower, double upper) {
   double range = upper - lower;
   if (range == 0 || (value - lower) / range < 0.01 || (upper - value) / range < 0.01)
@@ -925,6 +1205,10 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
   OPTIM_CONSTRAINTS *constraints;
   double result, lastResult;
   long i, startsLeft, i_step_saved;
+#if !USE_MPI && defined(__unix__)
+  LOCAL_OPTIM_WORKER *localWorker = NULL;
+  long iLocalWorker = 0;
+#endif
 #if USE_MPI
   long hybrid_simplex_tolerance_counter;
   long n_total_evaluations_made = 0;
@@ -1104,6 +1388,9 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
               NULL, covariables->memory_number[i]);
   }
 
+  if (optimization_data->evaluationCache)
+    openOptimCache(optimization_data->evaluationCache, variables->n_variables);
+
   final_property_values = count_final_properties();
   final_property_value = tmalloc(sizeof(*final_property_value) * final_property_values);
 
@@ -1124,6 +1411,8 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
     cp_str(&optimization_data->UDFname, UDFname);
     optimization_data->UDFcreated = 1;
   }
+  if (optimization_data->restrictTwissComputations)
+    setTwissComputationMask(twissComputationsNeeded(optimization_data, beamline));
 
 #if MPI_DEBUG
   sprintf(sdebug, "debug-%03d.sdds", myid);
@@ -1150,9 +1439,17 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
 #if USE_MPI
   if (optimization_data->method != OPTIM_METHOD_SIMPLEX)
     SDDS_PopulationSetup(population_log, &(optimization_data->popLog), &(optimization_data->variables), &(optimization_data->covariables));
+#endif
+#if !USE_MPI && defined(__unix__)
+  if (optimization_data->localWorkers > 1)
+    localWorker = tmalloc(sizeof(*localWorker) * optimization_data->localWorkers);
 #endif
   while (startsLeft-- && !stopOptimization) {
     lastResult = result;
+#if !USE_MPI && defined(__unix__)
+    if (localWorker)
+      iLocalWorker = startLocalOptimizationWorkers(localWorker, optimization_data->localWorkers, variables);
+#endif
     switch (optimization_data->method) {
     case OPTIM_METHOD_SIMPLEX:
       fputs("Starting simplex optimization.\n", stdout);
@@ -1162,7 +1459,7 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
       if (optimization_data->method == OPTIM_METHOD_HYBSIMPLEX) {
         fputs("Starting hybrid simplex optimization.\n", stdout);
         for (i = 0; i < variables->n_variables; i++)
-          variables->step[i] = (random_2(0) - 0.5) * variables->orig_step[i] * scale_factor;
+          variables->step[i] = (random_2_elegant(0) - 0.5) * variables->orig_step[i] * scale_factor;
         /* Disabling the report from simplexMin routine, as it will print result from the Master only.
 	     We print the best result across all the processors in a higher level routine */
         optimization_report_ptr = NULL;
@@ -1330,6 +1627,26 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
       free(start);
       }
       break;
+    case OPTIM_METHOD_LM:
+      fputs("Starting Levenberg-Marquardt optimization (finite-difference Jacobian).\n", stdout);
+      if (levenbergMarquardtMin(&result, variables->varied_quan_value, variables->step,
+                                variables->lower_limit, variables->upper_limit,
+                                variables->n_variables, optimization_data->target,
+                                optimization_data->tolerance, optimization_data->n_evaluations,
+                                optimization_data->lmDerivativeFactor) < 0) {
+        if (result > optimization_data->tolerance) {
+          if (!optimization_data->soft_failure)
+            bombElegant("optimization unsuccessful--aborting", NULL);
+          else
+            printWarning("optimize: Levenberg-Marquardt optimization unsuccessful.", "Continuing.");
+        } else
+          printWarning("optimize: Maximum number of evaluations reached in Levenberg-Marquardt optimization.", NULL);
+      }
+      if (optimization_data->fp_log && optimization_data->verbose > 1)
+        optimization_report(result, variables->varied_quan_value, optimization_data->n_restarts + 1 - startsLeft, n_evaluations_made, variables->n_variables);
+      if (optimAbort(0) || result < optimization_data->target)
+        stopOptimization = 1;
+      break;
     case OPTIM_METHOD_POWELL:
       fputs("Starting Powell optimization.\n", stdout);
       if (powellMin(&result, variables->varied_quan_value, variables->step,
@@ -1486,6 +1803,14 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
     fflush(stdout);
 #endif
 
+#if !USE_MPI && defined(__unix__)
+    if (localWorker) {
+      if (iLocalWorker)
+        finishLocalOptimizationWorker(localWorker + iLocalWorker, result, variables);
+      collectLocalOptimizationWorkers(localWorker, optimization_data->localWorkers, &result, variables);
+    }
+#endif
+
 #if USE_MPI
     if ((optimization_data->method == OPTIM_METHOD_SWARM) || (optimization_data->method == OPTIM_METHOD_HYBSIMPLEX)) {
       /* The covariables are updated locally after each optimization_function call no matter if a better result 
@@ -1674,6 +1999,7 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
 #endif
 
   /* evaluate once more at the optimimum point to get all parameters right and to get additional output */
+  setTwissComputationMask(TWISS_COMPUTE_ALL);
   optim_func_flags = 0;
   force_output = 1;
   ignoreOptimRecords = 1;                                   /* to force re-evaluation */
@@ -1684,6 +2010,7 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
 
   for (i = 0; i < MAX_OPTIM_RECORDS; i++)
     free(optimRecord[i].variableValue);
+  closeOptimCache();
 
   /* change values in element definitions so that new lattice can be saved */
   change_defined_parameter_values(variables->element, variables->varied_param, variables->varied_type,
@@ -1832,6 +2159,10 @@ void do_optimize(NAMELIST_TEXT *nltext, RUN *run1, VARY *control1, ERRORVAL *err
     free_czarray_2d((void **)optimization_data->coordinatesToMatch, optimization_data->nParticlesToMatch, totalPropertiesPerParticle);
     optimization_data->coordinatesToMatch = NULL;
   }
+#if !USE_MPI && defined(__unix__)
+  if (localWorker)
+    tfree(localWorker);
+#endif
 
   log_exit("do_optimize");
 }
@@ -1896,6 +2227,83 @@ static char *radint_name[14] = {
   "I4",
   "I5",
 };
+
+/* Determine which optional twiss computations (see twiss_output) are needed by the
+ * optimization, by looking for the names of the quantities they provide among the
+ * tokens of the equation, terms, covariable equations, and constraints. Quantities
+ * that are skipped are set to NaN by the twiss code, so a reference that isn't seen
+ * here (e.g., inside a UDF) makes the evaluation invalid rather than using stale values.
+ */
+static void findTwissQuantity(char *token, unsigned long *mask) {
+  long i;
+  if (strncmp(token, "dnux/dA", 7) == 0 || strncmp(token, "dnuy/dA", 7) == 0 ||
+      strncmp(token, "nuxTswa", 7) == 0 || strncmp(token, "nuyTswa", 7) == 0) {
+    *mask |= TWISS_COMPUTE_TSWA;
+    return;
+  }
+  if ((token[0] == 'h' && strlen(token) == 6 && strspn(token + 1, "0123456789") == 5) ||
+      strcmp(token, "dnux/dJx") == 0 || strcmp(token, "dnux/dJy") == 0 || strcmp(token, "dnuy/dJy") == 0) {
+    *mask |= TWISS_COMPUTE_DRIVING;
+    return;
+  }
+  if (strcmp(token, "dnux/dp2") == 0 || strcmp(token, "dnux/dp3") == 0 ||
+      strcmp(token, "dnuy/dp2") == 0 || strcmp(token, "dnuy/dp3") == 0 ||
+      strncmp(token, "nuxChrom", 8) == 0 || strncmp(token, "nuyChrom", 8) == 0) {
+    *mask |= TWISS_COMPUTE_HOCHROM;
+    return;
+  }
+  for (i = 0; i < 14; i++)
+    if (strcmp(token, radint_name[i]) == 0) {
+      *mask |= TWISS_COMPUTE_RADINT;
+      return;
+    }
+  /* rf acceptance values computed by twiss_output from the radiation integrals */
+  if (strcmp(token, "Sz0") == 0 || strcmp(token, "St0") == 0)
+    *mask |= TWISS_COMPUTE_RADINT;
+}
+
+static void findTwissQuantities(char *expression, unsigned long *mask) {
+  char *buffer, *token;
+  if (!expression)
+    return;
+  cp_str(&buffer, expression);
+  for (token = strtok(buffer, " \t\n,"); token; token = strtok(NULL, " \t\n,"))
+    findTwissQuantity(token, mask);
+  free(buffer);
+}
+
+static unsigned long twissComputationsNeeded(OPTIMIZATION_DATA *optimization_data, LINE_LIST *beamline) {
+  unsigned long mask;
+  long i;
+  ELEMENT_LIST *eptr;
+
+  mask = 0;
+  findTwissQuantities(optimization_data->equation, &mask);
+  for (i = 0; i < optimization_data->terms; i++)
+    findTwissQuantities(optimization_data->term[i], &mask);
+  for (i = 0; i < optimization_data->covariables.n_covariables; i++)
+    findTwissQuantities(optimization_data->covariables.equation[i], &mask);
+  for (i = 0; i < optimization_data->constraints.n_constraints; i++)
+    findTwissQuantities(optimization_data->constraints.quantity[i], &mask);
+
+  /* radiation integrals may also be used by SREFFECTS elements and coupled_twiss_output */
+  if (coupledTwissUsesRadiationIntegrals())
+    mask |= TWISS_COMPUTE_RADINT;
+  for (eptr = beamline->elem; eptr && !(mask & TWISS_COMPUTE_RADINT); eptr = eptr->succ)
+    if (eptr->type == T_SREFFECTS)
+      mask |= TWISS_COMPUTE_RADINT;
+
+  if (optimization_data->verbose && optimization_data->fp_log) {
+    fprintf(optimization_data->fp_log, "Twiss computations needed for optimization:%s%s%s%s\n",
+            mask & TWISS_COMPUTE_TSWA ? " tune-shift-with-amplitude" : "",
+            mask & TWISS_COMPUTE_DRIVING ? " driving-terms" : "",
+            mask & TWISS_COMPUTE_HOCHROM ? " higher-order-chromaticity" : "",
+            mask & TWISS_COMPUTE_RADINT ? " radiation-integrals" : "");
+    fflush(optimization_data->fp_log);
+  }
+  return mask;
+}
+
 static long radint_mem[14] = {
   -1,
   -1,
@@ -2125,6 +2533,15 @@ double optimization_function(double *value, long *invalid) {
 #endif
     return optimRecord[iRec].result;
   }
+  if (checkOptimCache(value, variables->n_variables, invalid, &result)) {
+    if (optimization_data->verbose && optimization_data->fp_log)
+      fprintf(optimization_data->fp_log, "Using value %23.15e from evaluation cache\n\n", result);
+    storeOptimRecord(value, variables->n_variables, *invalid, result);
+#if USE_MPI
+    checkTarget(result, *invalid);
+#endif
+    return result;
+  }
 
   /* compute matrices for perturbed elements */
 #if DEBUG
@@ -2756,6 +3173,7 @@ double optimization_function(double *value, long *invalid) {
         }
 
         /* compute and return quantity to be optimized */
+        lastParticleComparison = psum;
         if (optimization_data->terms) {
           long i;
           double sum, min, max, sum2, sumAbs;
@@ -2779,7 +3197,8 @@ double optimization_function(double *value, long *invalid) {
           if (psum >= 0)
             updateOptimizationStatistics(&sum, &sumAbs, &sum2, &min, &max, psum);
           rpn_clear(); /* clear rpn stack */
-          updateOptimizationStatistics(&sum, &sumAbs, &sum2, &min, &max, rpn(optimization_data->UDFname));
+          lastEquationValue = rpn(optimization_data->UDFname);
+          updateOptimizationStatistics(&sum, &sumAbs, &sum2, &min, &max, lastEquationValue);
           result = chooseOptimizationStatistic(sum, sumAbs, sum2, min, max, optimization_data->statistic);
           if (rpn_check_error()) {
             printf("Problem evaluating expression: %s\n", optimization_data->term[i]);
@@ -2791,6 +3210,12 @@ double optimization_function(double *value, long *invalid) {
           exitElegant(1);
         }
         if (isnan(result) || isinf(result)) {
+          static short restrictionWarningGiven = 0;
+          if (isnan(result) && optimization_data->restrictTwissComputations && !restrictionWarningGiven) {
+            printWarning("optimization: equation evaluates to NaN with restrict_twiss_computations=1.",
+                         "Twiss quantities referenced only through UDFs or rpn macros are not computed. Set restrict_twiss_computations=0 if this is the case.");
+            restrictionWarningGiven = 1;
+          }
           *invalid = 1;
         } else {
           /* #if !USE_MPI  The information here is from a processor locally, we print the result across all the processors after an iteration */
@@ -2844,7 +3269,7 @@ double optimization_function(double *value, long *invalid) {
 #if USE_MPI
     if (notSinglePart || enableOutput) /* Disable the beam output (except for simplex) when all the processors track independently */
 #endif
-      if (!*invalid && (force_output || (control->i_step - 2) % output_sparsing_factor == 0)) {
+      if (!*invalid && !localOptimizationWorker && (force_output || (control->i_step - 2) % output_sparsing_factor == 0)) {
         if (center_on_orbit)
           center_beam_on_coords(beam->particle, beam->n_to_track, startingOrbitCoord, center_momentum_also);
         do_track_beam_output(run, control, error, variables, beamline, beam, output, optim_func_flags,
@@ -2874,6 +3299,7 @@ double optimization_function(double *value, long *invalid) {
 #endif
 
   storeOptimRecord(value, variables->n_variables, *invalid, result);
+  storeOptimCache(value, variables->n_variables, *invalid, result);
 
 #if DEBUG
   printf("optimization_function: Returning %le,  invalid=%ld\n", result, *invalid);
@@ -3007,6 +3433,260 @@ void storeOptimRecord(double *value, long values, long invalid, double result) {
     optimRecords = MAX_OPTIM_RECORDS;
 }
 
+/* Persistent evaluation cache (optimization_setup evaluation_cache).
+ * Every evaluation is appended to a binary file as it is made, tagged with a fingerprint
+ * of everything besides the variables that determines the optimization function: the
+ * element parameters other than the variables and covariables, the equation, terms,
+ * weights and constraints, the central momentum, order and passes, and the initial beam.
+ * When an optimization starts, the records with a matching fingerprint are loaded into a
+ * hash table keyed on the variable values, quantized to evaluation_cache_quantum times the
+ * step size (exact values if zero). Records for other fingerprints are left in the file, so
+ * one cache can serve several lattices. Settings in other commands (e.g., twiss_output) are
+ * not part of the fingerprint; use a new cache file if those change.
+ */
+typedef struct {
+  double result;
+  long invalid;
+  double *value;
+} OPTIM_CACHE_RECORD;
+
+static FILE *fpOptimCache = NULL;
+static uint64_t optimCacheFingerprint;
+static OPTIM_CACHE_RECORD *optimCacheRecord = NULL;
+static long optimCacheRecords = 0, optimCacheMaxRecords = 0, optimCacheHits = 0;
+static long *optimCacheSlot = NULL, optimCacheSlots = 0; /* open-addressed table of record indices */
+
+static uint64_t hashOptimBytes(uint64_t hash, void *data, long n) {
+  unsigned char *byte;
+  long i;
+  byte = (unsigned char *)data;
+  for (i = 0; i < n; i++)
+    hash = (hash ^ byte[i]) * 1099511628211ULL;
+  return hash;
+}
+
+static uint64_t hashOptimString(uint64_t hash, char *s) {
+  return s ? hashOptimBytes(hash, s, strlen(s) + 1) : hashOptimBytes(hash, "", 1);
+}
+
+static int64_t quantizeOptimValue(double value, long i) {
+  int64_t key;
+  double quantum;
+  quantum = optimization_data->evaluationCacheQuantum * optimization_data->variables.orig_step[i];
+  if (quantum > 0)
+    return (int64_t)floor(value / quantum + 0.5);
+  if (value == 0)
+    value = 0; /* same key for -0 and +0 */
+  memcpy(&key, &value, sizeof(key));
+  return key;
+}
+
+static uint64_t hashOptimValues(double *value, long values) {
+  uint64_t hash;
+  int64_t key;
+  long i;
+  hash = 14695981039346656037ULL;
+  for (i = 0; i < values; i++) {
+    key = quantizeOptimValue(value[i], i);
+    hash = hashOptimBytes(hash, &key, sizeof(key));
+  }
+  return hash;
+}
+
+static long findOptimCacheSlot(double *value, long values) {
+  long slot, iRecord, i;
+  slot = hashOptimValues(value, values) & (optimCacheSlots - 1);
+  while ((iRecord = optimCacheSlot[slot]) >= 0) {
+    for (i = 0; i < values; i++)
+      if (quantizeOptimValue(value[i], i) != quantizeOptimValue(optimCacheRecord[iRecord].value[i], i))
+        break;
+    if (i == values)
+      break;
+    slot = (slot + 1) & (optimCacheSlots - 1);
+  }
+  return slot;
+}
+
+static void addOptimCacheRecord(double *value, long values, long invalid, double result) {
+  long slot, i;
+  if (2 * (optimCacheRecords + 1) > optimCacheSlots) {
+    /* keep the table at most half full */
+    optimCacheSlots = optimCacheSlots ? 2 * optimCacheSlots : 1024;
+    optimCacheSlot = trealloc(optimCacheSlot, sizeof(*optimCacheSlot) * optimCacheSlots);
+    for (slot = 0; slot < optimCacheSlots; slot++)
+      optimCacheSlot[slot] = -1;
+    for (i = 0; i < optimCacheRecords; i++)
+      optimCacheSlot[findOptimCacheSlot(optimCacheRecord[i].value, values)] = i;
+  }
+  slot = findOptimCacheSlot(value, values);
+  if (optimCacheSlot[slot] >= 0)
+    return;
+  if (optimCacheRecords == optimCacheMaxRecords)
+    optimCacheRecord = trealloc(optimCacheRecord, sizeof(*optimCacheRecord) * (optimCacheMaxRecords += 1024));
+  optimCacheRecord[optimCacheRecords].result = result;
+  optimCacheRecord[optimCacheRecords].invalid = invalid;
+  optimCacheRecord[optimCacheRecords].value = tmalloc(sizeof(double) * values);
+  memcpy(optimCacheRecord[optimCacheRecords].value, value, sizeof(double) * values);
+  optimCacheSlot[slot] = optimCacheRecords++;
+}
+
+static short isOptimizationParameter(char *name, long param) {
+  long i;
+  for (i = 0; i < optimization_data->variables.n_variables; i++)
+    if (optimization_data->variables.varied_param[i] == param && strcmp(optimization_data->variables.element[i], name) == 0)
+      return 1;
+  for (i = 0; i < optimization_data->covariables.n_covariables; i++)
+    if (optimization_data->covariables.varied_param[i] == param && strcmp(optimization_data->covariables.element[i], name) == 0)
+      return 1;
+  return 0;
+}
+
+static uint64_t optimizationFingerprint() {
+  uint64_t hash;
+  ELEMENT_LIST *eptr;
+  PARAMETER *parameter;
+  char *p_elem;
+  long i, j;
+
+  hash = 14695981039346656037ULL;
+  for (eptr = beamline->elem; eptr; eptr = eptr->succ) {
+    hash = hashOptimString(hash, eptr->name);
+    hash = hashOptimBytes(hash, &eptr->type, sizeof(eptr->type));
+    parameter = entity_description[eptr->type].parameter;
+    p_elem = eptr->p_elem;
+    for (j = 0; j < entity_description[eptr->type].n_params; j++) {
+      if (isOptimizationParameter(eptr->name, j))
+        continue;
+      switch (parameter[j].type) {
+      case IS_DOUBLE:
+        hash = hashOptimBytes(hash, p_elem + parameter[j].offset, sizeof(double));
+        break;
+      case IS_LONG:
+        hash = hashOptimBytes(hash, p_elem + parameter[j].offset, sizeof(long));
+        break;
+      case IS_SHORT:
+        hash = hashOptimBytes(hash, p_elem + parameter[j].offset, sizeof(short));
+        break;
+      case IS_STRING:
+        hash = hashOptimString(hash, *(char **)(p_elem + parameter[j].offset));
+        break;
+      default:
+        break;
+      }
+    }
+  }
+  hash = hashOptimString(hash, optimization_data->equation);
+  for (i = 0; i < optimization_data->terms; i++) {
+    hash = hashOptimString(hash, optimization_data->term[i]);
+    hash = hashOptimBytes(hash, optimization_data->usersTermWeight + i, sizeof(double));
+  }
+  for (i = 0; i < optimization_data->constraints.n_constraints; i++) {
+    hash = hashOptimString(hash, optimization_data->constraints.quantity[i]);
+    hash = hashOptimBytes(hash, optimization_data->constraints.lower + i, sizeof(double));
+    hash = hashOptimBytes(hash, optimization_data->constraints.upper + i, sizeof(double));
+  }
+  for (i = 0; i < optimization_data->variables.n_variables; i++)
+    hash = hashOptimString(hash, optimization_data->variables.varied_quan_name[i]);
+  for (i = 0; i < optimization_data->covariables.n_covariables; i++)
+    hash = hashOptimString(hash, optimization_data->covariables.equation[i]);
+  hash = hashOptimBytes(hash, &optimization_data->mode, sizeof(optimization_data->mode));
+  hash = hashOptimBytes(hash, &optimization_data->statistic, sizeof(optimization_data->statistic));
+  hash = hashOptimBytes(hash, &optimization_data->balance_terms, sizeof(optimization_data->balance_terms));
+  hash = hashOptimBytes(hash, &run->p_central, sizeof(run->p_central));
+  hash = hashOptimBytes(hash, &run->default_order, sizeof(run->default_order));
+  hash = hashOptimBytes(hash, &control->n_passes, sizeof(control->n_passes));
+  if (beam && beam->original)
+    for (i = 0; i < beam->n_original; i++)
+      hash = hashOptimBytes(hash, beam->original[i], sizeof(double) * 7);
+  return hash;
+}
+
+static void openOptimCache(char *filename, long values) {
+  uint64_t fingerprint;
+  long nValues, invalid, nRead, nOther;
+  double result, *value;
+  FILE *fp;
+
+  closeOptimCache();
+  optimCacheFingerprint = optimizationFingerprint();
+  nRead = nOther = 0;
+  if ((fp = fopen(filename, "rb"))) {
+    value = NULL;
+    while (fread(&fingerprint, sizeof(fingerprint), 1, fp) == 1 &&
+           fread(&nValues, sizeof(nValues), 1, fp) == 1 && nValues > 0 &&
+           fread(&result, sizeof(result), 1, fp) == 1 &&
+           fread(&invalid, sizeof(invalid), 1, fp) == 1) {
+      value = trealloc(value, sizeof(*value) * nValues);
+      if (fread(value, sizeof(*value), nValues, fp) != (size_t)nValues)
+        break;
+      if (fingerprint == optimCacheFingerprint && nValues == values) {
+        addOptimCacheRecord(value, values, invalid, result);
+        nRead++;
+      } else
+        nOther++;
+    }
+    if (value)
+      tfree(value);
+    fclose(fp);
+  }
+  printf("%ld evaluations loaded from evaluation cache %s (%ld records for other configurations)\n", nRead, filename, nOther);
+  fflush(stdout);
+#if USE_MPI
+  if (myid != 0)
+    return;
+#endif
+  if (!(fpOptimCache = fopen(filename, "ab")))
+    printWarning("optimize: unable to open evaluation cache for writing.", filename);
+}
+
+static long checkOptimCache(double *value, long values, long *invalid, double *result) {
+  long iRecord;
+  if (!optimCacheSlots || ignoreOptimRecords)
+    return 0;
+  if ((iRecord = optimCacheSlot[findOptimCacheSlot(value, values)]) < 0)
+    return 0;
+  *invalid = optimCacheRecord[iRecord].invalid;
+  *result = optimCacheRecord[iRecord].result;
+  optimCacheHits++;
+  return 1;
+}
+
+static void storeOptimCache(double *value, long values, long invalid, double result) {
+  long nRecords;
+  if (!optimization_data->evaluationCache)
+    return;
+  nRecords = optimCacheRecords;
+  addOptimCacheRecord(value, values, invalid, result);
+  if (fpOptimCache && !localOptimizationWorker && optimCacheRecords != nRecords) {
+    fwrite(&optimCacheFingerprint, sizeof(optimCacheFingerprint), 1, fpOptimCache);
+    fwrite(&values, sizeof(values), 1, fpOptimCache);
+    fwrite(&result, sizeof(result), 1, fpOptimCache);
+    fwrite(&invalid, sizeof(invalid), 1, fpOptimCache);
+    fwrite(value, sizeof(*value), values, fpOptimCache);
+    fflush(fpOptimCache);
+  }
+}
+
+static void closeOptimCache() {
+  long i;
+  if (optimCacheHits) {
+    printf("%ld evaluations taken from evaluation cache\n", optimCacheHits);
+    fflush(stdout);
+  }
+  if (fpOptimCache)
+    fclose(fpOptimCache);
+  fpOptimCache = NULL;
+  for (i = 0; i < optimCacheRecords; i++)
+    tfree(optimCacheRecord[i].value);
+  if (optimCacheRecord)
+    tfree(optimCacheRecord);
+  if (optimCacheSlot)
+    tfree(optimCacheSlot);
+  optimCacheRecord = NULL;
+  optimCacheSlot = NULL;
+  optimCacheRecords = optimCacheMaxRecords = optimCacheSlots = optimCacheHits = 0;
+}
+
 void optimization_report(double result, double *value, long pass, long n_evals, long n_dim) {
   OPTIM_VARIABLES *variables;
   /* OPTIM_COVARIABLES *covariables; */
@@ -11,6 +11,7 @@ static char *optimize_mode[N_OPTIM_MODES] = {
 
 static char *optimize_method[N_OPTIM_METHODS] = {
     "simplex", "grid", "sample", "powell", "randomsample", "randomwalk", "genetic", "hybridsimplex", "swarm", "1dscans", "rcds",
+    "levenberg-marquardt",
     } ;
 
       
@@ -63,9 +64,14 @@ static char *crossover_type[N_CROSSOVER_TYPES] = {
     double simplex_pass_range_factor = 1;
     long include_simplex_1d_scans = 1;
     long start_from_simplex_vertex1 = 0;
+    long local_workers = 0;
+    STRING evaluation_cache = NULL;
+    double evaluation_cache_quantum = 0;
     long restart_random_numbers = 0;
     double random_factor = 1.0;		
     double rcds_step_factor = 0.1;
+    double lm_derivative_factor = 0.01;
+    long restrict_twiss_computations = 0;
     long n_iterations = 10000;
     long max_no_change = 1000;
     long population_size = 100;
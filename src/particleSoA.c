@@ -0,0 +1,345 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: particleSoA.c
+ * purpose: structure-of-arrays (SoA) particle blocks for vectorized tracking.
+ *
+ * The beam is stored as one row of totalPropertiesPerParticle doubles per
+ * particle, so loops over particles stride across every property and the
+ * compiler can't vectorize them. Kernels here copy the six coordinates of a
+ * tile of particles into contiguous arrays, track the tile with the particle
+ * index innermost, and copy the coordinates back. The tile is small enough
+ * to stay in L1/L2 cache, so the conversion costs no extra memory traffic.
+ * Other properties (particle ID, bunch index, ...) stay in the rows.
+ *
+ * Enabled with global_settings soa_tracking=1. Results are identical to the
+ * row-wise code, since each particle sees the same sequence of operations.
+ * Polynomial maps (run_setup polynomial_map_order) are always tracked this way.
+ */
+#include "mdb.h"
+#include "track.h"
+
+void allocateParticleSoA(PARTICLE_SOA *soa, long nMax) {
+  long i;
+  soa->n = 0;
+  soa->nMax = nMax;
+  /* one block, so that the arrays are adjacent in memory */
+  soa->coord[0] = tmalloc(sizeof(**soa->coord) * COORDINATES_PER_PARTICLE * nMax);
+  for (i = 1; i < COORDINATES_PER_PARTICLE; i++)
+    soa->coord[i] = soa->coord[0] + i * nMax;
+}
+
+void freeParticleSoA(PARTICLE_SOA *soa) {
+  if (soa->coord[0])
+    free(soa->coord[0]);
+  memset(soa, 0, sizeof(*soa));
+}
+
+void loadParticleSoA(PARTICLE_SOA *soa, double **particle, long n) {
+  long ip, i;
+  if (n > soa->nMax)
+    bombElegant("too many particles for SoA block (loadParticleSoA)", NULL);
+  for (ip = 0; ip < n; ip++)
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+      soa->coord[i][ip] = particle[ip][i];
+  soa->n = n;
+}
+
+void storeParticleSoA(PARTICLE_SOA *soa, double **particle) {
+  long ip, i;
+  for (ip = 0; ip < soa->n; ip++)
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+      particle[ip][i] = soa->coord[i][ip];
+}
+
+/* Applies a first- or second-order matrix to the particles in a block. The
+ * order of operations for each particle is the same as in track_particles()
+ * (for TURBO_FASTMATTRACK<4, which sums in reverse index order).
+ */
+void trackParticleSoAMatrix(PARTICLE_SOA *soa, VMATRIX *M) {
+  double *C, **R, ***T, ****Q;
+  double sum[COORDINATES_PER_PARTICLE][PARTICLE_SOA_TILE], sum1[PARTICLE_SOA_TILE];
+  double *restrict x, *restrict xj, *restrict xk, *restrict out, *restrict s1;
+  double Rij, Tijk;
+  long n0, n, ip, i, j, k;
+
+  set_matrix_pointers(&C, &R, &T, &Q, M);
+  if (M->order > 2 || !C || !R || (M->order == 2 && !T))
+    bombElegant("invalid matrix for SoA tracking (trackParticleSoAMatrix)", NULL);
+
+  s1 = sum1;
+  for (n0 = 0; n0 < soa->n; n0 += PARTICLE_SOA_TILE) {
+    if ((n = soa->n - n0) > PARTICLE_SOA_TILE)
+      n = PARTICLE_SOA_TILE;
+    for (i = 5; i >= 0; i--) {
+      out = sum[i];
+      for (ip = 0; ip < n; ip++)
+        out[ip] = C[i];
+      for (j = 5; j >= 0; j--) {
+        xj = soa->coord[j] + n0;
+        Rij = R[i][j];
+        if (M->order == 1) {
+          for (ip = 0; ip < n; ip++)
+            out[ip] += Rij * xj[ip];
+          continue;
+        }
+        for (ip = 0; ip < n; ip++)
+          s1[ip] = Rij;
+        for (k = j; k >= 0; k--) {
+          xk = soa->coord[k] + n0;
+          Tijk = T[i][j][k];
+          for (ip = 0; ip < n; ip++)
+            s1[ip] += Tijk * xk[ip];
+        }
+#if TURBO_FASTMATTRACK
+        for (ip = 0; ip < n; ip++)
+          out[ip] += s1[ip] * xj[ip];
+#else
+        /* the row-wise code skips zero coordinates, so do the same */
+        for (ip = 0; ip < n; ip++)
+          out[ip] += xj[ip] != 0 ? s1[ip] * xj[ip] : 0;
+#endif
+      }
+    }
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++) {
+      x = soa->coord[i] + n0;
+      out = sum[i];
+      for (ip = 0; ip < n; ip++)
+        x[ip] = out[ip];
+    }
+  }
+}
+
+/* Drop-in replacement for track_particles() for first- and second-order matrices */
+void track_particles_soa(double **final, VMATRIX *M, double **initial, long n_part) {
+  PARTICLE_SOA soa;
+  long ip, n;
+
+  allocateParticleSoA(&soa, PARTICLE_SOA_TILE);
+  for (ip = 0; ip < n_part; ip += n) {
+    if ((n = n_part - ip) > PARTICLE_SOA_TILE)
+      n = PARTICLE_SOA_TILE;
+    loadParticleSoA(&soa, initial + ip, n);
+    trackParticleSoAMatrix(&soa, M);
+    storeParticleSoA(&soa, final + ip);
+  }
+  if (final != initial)
+    for (ip = 0; ip < n_part; ip++)
+      final[ip][particleIDIndex] = initial[ip][particleIDIndex]; /* copy particle ID # */
+  freeParticleSoA(&soa);
+}
+
+#define POLYNOMIAL_MAP_BLOCK 32
+
+/* Evaluates all monomials of the map for n particles with coordinates x[0..5][0..n-1], each
+ * as the product of an earlier monomial and one coordinate. Monomial m for particle ip is
+ * stored in work[m*POLYNOMIAL_MAP_BLOCK+ip].
+ */
+static void evaluatePolynomialMapMonomials(POLYNOMIAL_MAP *map, double **x, long n, double *work) {
+  double *restrict value, *restrict parentValue, *restrict xv;
+  long ip, m;
+
+  for (ip = 0; ip < n; ip++)
+    work[ip] = 1;
+  for (m = 1; m < map->nMonomials; m++) {
+    value = work + m * POLYNOMIAL_MAP_BLOCK;
+    parentValue = work + map->parent[m] * POLYNOMIAL_MAP_BLOCK;
+    xv = x[map->variable[m]];
+    for (ip = 0; ip < n; ip++)
+      value[ip] = parentValue[ip] * xv[ip];
+  }
+}
+
+/* Sums polynomial i of the map for n particles, from monomials evaluated by evaluatePolynomialMapMonomials() */
+static void sumPolynomialMapTerms(POLYNOMIAL_MAP *map, long i, long n, double *work, double *restrict out) {
+  double *restrict value;
+  double coef;
+  long ip, t;
+
+  for (ip = 0; ip < n; ip++)
+    out[ip] = 0;
+  for (t = 0; t < map->nTerms[i]; t++) {
+    coef = map->coef[i][t];
+    value = work + map->monomial[i][t] * POLYNOMIAL_MAP_BLOCK;
+    for (ip = 0; ip < n; ip++)
+      out[ip] += coef * value[ip];
+  }
+}
+
+#define SYMPLECTIC_MAP_ITERATIONS 100
+#define SYMPLECTIC_MAP_TOLERANCE 1e-13
+
+/* Applies a symplectic map (see tpsaSymplecticMap()) to the particles in a block. The new
+ * momenta P are found from p = P + dG/dq(q, P) by Newton's method, then the new coordinates
+ * are Q = q + dG/dP(q, P).
+ */
+static void trackParticleSoASymplecticMap(PARTICLE_SOA *soa, POLYNOMIAL_MAP *map, double *work) {
+  double w[COORDINATES_PER_PARTICLE][POLYNOMIAL_MAP_BLOCK], v[COORDINATES_PER_PARTICLE][POLYNOMIAL_MAP_BLOCK];
+  double p[3][POLYNOMIAL_MAP_BLOCK], g[COORDINATES_PER_PARTICLE][POLYNOMIAL_MAP_BLOCK], H[9][POLYNOMIAL_MAP_BLOCK];
+  double step[3][POLYNOMIAL_MAP_BLOCK], lastResidual[POLYNOMIAL_MAP_BLOCK];
+  double *vp[COORDINATES_PER_PARTICLE], *x[COORDINATES_PER_PARTICLE];
+  double r[3], J[3][3], dP[3], det, factor, error, residual, qx, qy, delta;
+  long n0, n, ip, i, j, k, iter;
+
+  for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+    vp[i] = v[i];
+  for (n0 = 0; n0 < soa->n; n0 += POLYNOMIAL_MAP_BLOCK) {
+    if ((n = soa->n - n0) > POLYNOMIAL_MAP_BLOCK)
+      n = POLYNOMIAL_MAP_BLOCK;
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+      x[i] = soa->coord[i] + n0;
+    /* canonical coordinates (x, qx, y, qy, -s, delta), as convertSlopesToMomenta() */
+    for (ip = 0; ip < n; ip++) {
+      factor = (1 + x[5][ip]) / sqrt(1 + sqr(x[1][ip]) + sqr(x[3][ip]));
+      w[0][ip] = x[0][ip];
+      w[1][ip] = x[1][ip] * factor;
+      w[2][ip] = x[2][ip];
+      w[3][ip] = x[3][ip] * factor;
+      w[4][ip] = -x[4][ip];
+      w[5][ip] = x[5][ip];
+    }
+    /* v = R w, then the momenta in v are replaced by the new momenta, starting from the old ones */
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++) {
+      for (ip = 0; ip < n; ip++)
+        v[i][ip] = 0;
+      for (j = 0; j < COORDINATES_PER_PARTICLE; j++)
+        if (map->R[i][j])
+          for (ip = 0; ip < n; ip++)
+            v[i][ip] += map->R[i][j] * w[j][ip];
+    }
+    for (k = 0; k < 3; k++)
+      for (ip = 0; ip < n; ip++) {
+        p[k][ip] = v[2 * k + 1][ip];
+        step[k][ip] = 0;
+      }
+    for (ip = 0; ip < n; ip++)
+      lastResidual[ip] = DBL_MAX;
+    for (iter = 0; iter < SYMPLECTIC_MAP_ITERATIONS; iter++) {
+      evaluatePolynomialMapMonomials(map, vp, n, work);
+      for (k = 0; k < 3; k++)
+        sumPolynomialMapTerms(map, 2 * k, n, work, g[2 * k]);
+      for (k = 0; k < 9; k++)
+        sumPolynomialMapTerms(map, 6 + k, n, work, H[k]);
+      error = 0;
+      for (ip = 0; ip < n; ip++) {
+        for (k = residual = 0; k < 3; k++) {
+          r[k] = v[2 * k + 1][ip] + g[2 * k][ip] - p[k][ip];
+          residual += fabs(r[k]);
+          for (j = 0; j < 3; j++)
+            J[k][j] = (k == j ? 1 : 0) + H[3 * k + j][ip];
+        }
+        if (!(residual < lastResidual[ip])) {
+          /* the last step made things worse (far from the reference, where the map is poor),
+           * so take half of it back */
+          for (k = 0; k < 3; k++) {
+            step[k][ip] /= 2;
+            v[2 * k + 1][ip] += step[k][ip];
+            if (fabs(step[k][ip]) > error)
+              error = fabs(step[k][ip]);
+          }
+          continue;
+        }
+        lastResidual[ip] = residual;
+        /* solve J dP = r by Cramer's rule */
+        det = J[0][0] * (J[1][1] * J[2][2] - J[1][2] * J[2][1]) - J[0][1] * (J[1][0] * J[2][2] - J[1][2] * J[2][0]) +
+              J[0][2] * (J[1][0] * J[2][1] - J[1][1] * J[2][0]);
+        dP[0] = (r[0] * (J[1][1] * J[2][2] - J[1][2] * J[2][1]) - J[0][1] * (r[1] * J[2][2] - J[1][2] * r[2]) +
+                 J[0][2] * (r[1] * J[2][1] - J[1][1] * r[2])) / det;
+        dP[1] = (J[0][0] * (r[1] * J[2][2] - J[1][2] * r[2]) - r[0] * (J[1][0] * J[2][2] - J[1][2] * J[2][0]) +
+                 J[0][2] * (J[1][0] * r[2] - r[1] * J[2][0])) / det;
+        dP[2] = (J[0][0] * (J[1][1] * r[2] - r[1] * J[2][1]) - J[0][1] * (J[1][0] * r[2] - r[1] * J[2][0]) +
+                 r[0] * (J[1][0] * J[2][1] - J[1][1] * J[2][0])) / det;
+        for (k = 0; k < 3; k++) {
+          v[2 * k + 1][ip] -= (step[k][ip] = dP[k]);
+          if (fabs(dP[k]) > error)
+            error = fabs(dP[k]);
+        }
+      }
+      if (error < SYMPLECTIC_MAP_TOLERANCE)
+        break;
+    }
+    evaluatePolynomialMapMonomials(map, vp, n, work);
+    for (k = 0; k < 3; k++)
+      sumPolynomialMapTerms(map, 2 * k + 1, n, work, g[2 * k + 1]);
+    /* back to (x, xp, y, yp, s, delta), as convertMomentaToSlopes() */
+    for (ip = 0; ip < n; ip++) {
+      x[0][ip] = map->C[0] + v[0][ip] + g[1][ip];
+      x[2][ip] = map->C[2] + v[2][ip] + g[3][ip];
+      x[4][ip] = -(map->C[4] + v[4][ip] + g[5][ip]);
+      qx = map->C[1] + v[1][ip];
+      qy = map->C[3] + v[3][ip];
+      delta = x[5][ip] = map->C[5] + v[5][ip];
+      factor = 1 / sqrt(sqr(1 + delta) - sqr(qx) - sqr(qy));
+      x[1][ip] = qx * factor;
+      x[3][ip] = qy * factor;
+    }
+  }
+}
+
+/* Applies a polynomial map to the particles in a block. All monomials are first evaluated
+ * for POLYNOMIAL_MAP_BLOCK particles at a time, then the coordinates are sums over the
+ * terms. work must have room for map->nMonomials*POLYNOMIAL_MAP_BLOCK values.
+ */
+void trackParticleSoAPolynomialMap(PARTICLE_SOA *soa, POLYNOMIAL_MAP *map, double *work) {
+  double sum[COORDINATES_PER_PARTICLE][POLYNOMIAL_MAP_BLOCK];
+  double *x[COORDINATES_PER_PARTICLE], *restrict out, *restrict xv;
+  long n0, n, ip, i;
+
+  if (map->symplectic) {
+    trackParticleSoASymplecticMap(soa, map, work);
+    return;
+  }
+  for (n0 = 0; n0 < soa->n; n0 += POLYNOMIAL_MAP_BLOCK) {
+    if ((n = soa->n - n0) > POLYNOMIAL_MAP_BLOCK)
+      n = POLYNOMIAL_MAP_BLOCK;
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+      x[i] = soa->coord[i] + n0;
+    evaluatePolynomialMapMonomials(map, x, n, work);
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++)
+      sumPolynomialMapTerms(map, i, n, work, sum[i]);
+    for (i = 0; i < COORDINATES_PER_PARTICLE; i++) {
+      xv = x[i];
+      out = sum[i];
+      for (ip = 0; ip < n; ip++)
+        xv[ip] = out[ip];
+    }
+  }
+}
+
+/* Tracks particles through a polynomial map, in place */
+void trackPolynomialMap(double **coord, POLYNOMIAL_MAP *map, long n_part) {
+  PARTICLE_SOA soa;
+  double *work;
+  long ip, n, nThreads;
+
+  if ((nThreads = particleThreadsToUse(n_part)) > 1) {
+#if defined(_OPENMP)
+#  pragma omp parallel num_threads(nThreads)
+#endif
+    {
+      long iFirst, iLast;
+      particleThreadRange(n_part, &iFirst, &iLast);
+      if (iLast >= iFirst)
+        trackPolynomialMap(coord + iFirst, map, iLast - iFirst + 1);
+    }
+    return;
+  }
+
+  allocateParticleSoA(&soa, PARTICLE_SOA_TILE);
+  work = tmalloc(sizeof(*work) * map->nMonomials * POLYNOMIAL_MAP_BLOCK);
+  for (ip = 0; ip < n_part; ip += n) {
+    if ((n = n_part - ip) > PARTICLE_SOA_TILE)
+      n = PARTICLE_SOA_TILE;
+    loadParticleSoA(&soa, coord + ip, n);
+    trackParticleSoAPolynomialMap(&soa, map, work);
+    storeParticleSoA(&soa, coord + ip);
+  }
+  free(work);
+  freeParticleSoA(&soa);
+}
@@ -0,0 +1,82 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: particleThreads.c
+ * purpose: support for shared-memory (OpenMP) particle-parallel tracking.
+ *
+ * Element trackers that split their particle loop across threads flag lost
+ * particles instead of swapping them to the top of the array as they go.
+ * The array is compacted afterwards by replaying the swap sequence of the
+ * serial loop, so the final particle order is identical to a one-thread run.
+ */
+#include "mdb.h"
+#include "track.h"
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
+
+/* Below this many particles per thread the fork/join overhead dominates */
+#define MIN_PARTICLES_PER_THREAD 256
+
+long particleThreadsToUse(long np) {
+#if defined(_OPENMP)
+  long nThreads;
+  if (trackingThreads <= 1 || omp_in_parallel())
+    return 1;
+  if ((nThreads = np / MIN_PARTICLES_PER_THREAD) > trackingThreads)
+    nThreads = trackingThreads;
+  return nThreads < 1 ? 1 : nThreads;
+#else
+  return 1;
+#endif
+}
+
+/* Returns the contiguous block of particle indices [*iFirst, *iLast] belonging
+ * to the calling thread. Outside of an active parallel region this is the
+ * full range.
+ */
+void particleThreadRange(long np, long *iFirst, long *iLast) {
+#if defined(_OPENMP)
+  long nThreads, iThread, chunk, extra;
+  if ((nThreads = omp_get_num_threads()) > 1) {
+    iThread = omp_get_thread_num();
+    chunk = np / nThreads;
+    extra = np % nThreads;
+    *iFirst = iThread * chunk + (iThread < extra ? iThread : extra);
+    *iLast = *iFirst + chunk + (iThread < extra ? 1 : 0) - 1;
+    return;
+  }
+#endif
+  *iFirst = 0;
+  *iLast = np - 1;
+}
+
+/* Moves flagged particles to the top of the array using the same swap order
+ * as the serial tracking loops (lost particle i is exchanged with the current
+ * top, which is then examined in its place). Returns the number of survivors.
+ */
+long compactLostParticles(double **particle, double **accepted, short *lost, long np) {
+  long ip, itop;
+  short flag;
+
+  itop = np - 1;
+  for (ip = 0; ip <= itop; ip++) {
+    if (!lost[ip])
+      continue;
+    swapParticles(particle[ip], particle[itop]);
+    if (accepted)
+      swapParticles(accepted[ip], accepted[itop]);
+    flag = lost[ip];
+    lost[ip] = lost[itop];
+    lost[itop] = flag;
+    itop--;
+    ip--;
+  }
+  return itop + 1;
+}
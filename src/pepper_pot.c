@@ -46,7 +46,7 @@ long pepper_pot_plate(double **initial, PEPPOT *peppot, long np, double **accept
         break;
     }
     if (i_hole == n_holes) {
-      if (transmission == 0 || random_2(0) > transmission) {
+      if (transmission == 0 || random_2_elegant(0) > transmission) {
         if (itop != ip) {
           swapParticles(initial[ip], initial[itop]);
           if (accepted)
@@ -57,8 +57,8 @@ long pepper_pot_plate(double **initial, PEPPOT *peppot, long np, double **accept
         np--;
       } else if (transmission && peppot->theta_rms) {
         /* particle made it through material--scatter it */
-        scatter = gauss_rn(0, random_2) * peppot->theta_rms;
-        ini[1] += tan(scatter * cos(rotate = random_2(1) * PIx2));
+        scatter = gauss_rn_elegant(0, random_2_elegant) * peppot->theta_rms;
+        ini[1] += tan(scatter * cos(rotate = random_2_elegant(1) * PIx2));
         ini[3] += tan(scatter * sin(rotate));
       }
     }
@@ -80,7 +80,7 @@ long pepper_pot_plate(double **initial, PEPPOT *peppot, long np, double **accept
         break;
     }
     if (i_hole == n_holes) {
-      if (transmission == 0 || random_2(1) > transmission) {
+      if (transmission == 0 || random_2_elegant(1) > transmission) {
         if (itop != ip) {
           swapParticles(initial[ip], initial[itop]);
           if (accepted)
@@ -91,8 +91,8 @@ long pepper_pot_plate(double **initial, PEPPOT *peppot, long np, double **accept
         np--;
       } else if (transmission && peppot->theta_rms) {
         /* particle made it through material--scatter it */
-        scatter = gauss_rn(0, random_2) * peppot->theta_rms;
-        ini[1] += tan(scatter * cos(rotate = random_2(1) * PIx2));
+        scatter = gauss_rn_elegant(0, random_2_elegant) * peppot->theta_rms;
+        ini[1] += tan(scatter * cos(rotate = random_2_elegant(1) * PIx2));
         ini[3] += tan(scatter * sin(rotate));
       }
     }
@@ -36,14 +36,53 @@ void runBinlessRfMode(double **part, long np, RFMODE *rfmode, double Po,
                       CHARGE *charge);
 void fillBerencABMatrices(MATRIX *A, MATRIX *B, RFMODE *rfmode, double dt);
 
+/* Per-mode quantities for the bucket being processed */
+typedef struct {
+  RFMODE *rfmode;
+  char *name;
+  double omega, Q, k, tau, VbImagFactor;
+  double VPrevious, tPrevious, phasePrevious;
+  double V_sum, Vr_sum, Vi_sum, Vg_sum, Vgr_sum, Vgi_sum, Vci_sum, Vcr_sum, Vc_sum, Q_sum;
+  long n_summed, max_hist, n_occupied;
+} RFMODE_BUCKET;
+
+static long startRfModePass(RFMODE *rfmode, long np0, long np_total, long pass, CHARGE *charge);
+static void advanceRfModeFeedback(RFMODE *rfmode, char *element_name, double tmean, long pass);
+static void setRfModeBucketParameters(RFMODE_BUCKET *mode, double tmean, double tmin, double dt, long pass);
+static long addRfModeBinVoltages(RFMODE_BUCKET *mode, long *Ihist, double *Vbin, long firstBin, long lastBin,
+                                 double tmin, double dt, double tmean, long pass);
+static void recordRfModeBucket(RFMODE_BUCKET *mode, long pass, long jBucket, long np, long n_binned);
+static void checkRfModeGroup(RFMODE **rfmode, char **element_name, long nModes);
+
 void track_through_rfmode(
   double **part0, long np0, RFMODE *rfmode, double Po,
   char *element_name, double element_z, long pass, long n_passes,
   CHARGE *charge) {
+  if (rfmode->binless) { /* This can't be done in parallel mode */
+#if USE_MPI
+    printf((char *)"binless in rfmode is not supported in the current parallel version.\n");
+    printf((char *)"Please use serial version.\n");
+    fflush(stdout);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Abort(MPI_COMM_WORLD, T_RFMODE);
+#endif
+    runBinlessRfMode(part0, np0, rfmode, Po, element_name, element_z, pass, n_passes, charge);
+    return;
+  }
+  track_through_rfmode_group(part0, np0, &rfmode, &element_name, 1, Po, element_z, pass, n_passes, charge);
+}
+
+/* Tracks through several RFMODE elements at the same location (e.g., the fundamental and
+ * higher-order modes of a set of cavities). The beam is indexed by bunch and binned once,
+ * the phasors of all modes are advanced from the same histogram, and the summed voltage
+ * is applied in a single pass over the particles. The elements must have the same binning
+ * parameters.
+ */
+void track_through_rfmode_group(
+  double **part0, long np0, RFMODE **rfmodeList, char **element_name, long nModes, double Po,
+  double element_z, long pass, long n_passes, CHARGE *charge) {
   long *Ihist = NULL;  /* array for histogram of particle density */
-  double *Vbin = NULL; /* array for voltage acting on each bin */
-  long max_n_bins = 0;
-  long max_np = 0;
+  double *Vbin = NULL; /* array for summed voltage acting on each bin */
   long *pbin = NULL;       /* array to record which bin each particle is in */
   double *time0 = NULL;    /* array to record arrival time of each particle */
   double *time = NULL;     /* array to record arrival time of each particle */
@@ -51,22 +90,14 @@ void track_through_rfmode(
   long *ibParticle = NULL; /* array to record which bucket each particle is in */
   long **ipBucket = NULL;  /* array to record particle indices in part0 array for all particles in each bucket */
   long *npBucket = NULL;   /* array to record how many particles are in each bucket */
-  long iBucket, nBuckets = 0, np, effectiveBuckets, jBucket, adjusting, outputing;
+  long iBucket, nBuckets = 0, np, effectiveBuckets, jBucket, max_np = 0;
   double tOffset;
-  /*
-    static FILE *fpdeb = NULL;
-    static FILE *fpdeb2 = NULL;
-    */
+  RFMODE *rfmode;
+  RFMODE_BUCKET *mode;
+  long iMode, nActive, kicking;
 
   long ip, ib, lastBin = 0, firstBin = 0, n_binned = 0;
-  double tmin = 0, tmax, last_tmax, tmean, dt = 0;
-  double Vb, V, omega = 0, phase, t, k, damping_factor, tau;
-  double VPrevious, tPrevious, phasePrevious;
-  double V_sum, Vr_sum, Vi_sum, Vg_sum, Vgr_sum, Vgi_sum, Vci_sum, Vcr_sum, Vc_sum;
-  double Q_sum, dgamma;
-  long n_summed, max_hist, n_occupied;
-  double Qrp, VbImagFactor, Q = 0;
-  long deltaPass;
+  double tmin = 0, tmax, last_tmax, tmean, dt = 0, V, dgamma;
   long np_total;
 #if USE_MPI
   long nonEmptyBins = 0;
@@ -74,48 +105,13 @@ void track_through_rfmode(
   long n_binned_global = 0;
 #endif
 
-  /* These are here just to quash apparently spurious compiler warnings about possibly using uninitialzed variables */
-  tOffset = last_tmax = k = tau = V_sum = Vr_sum = Vi_sum = Vg_sum = Vgr_sum = Vgi_sum = Vci_sum = Vcr_sum = Vc_sum = VbImagFactor = tmean = DBL_MAX;
-  n_summed = n_occupied = LONG_MAX;
-
-  /*
-    if (!fpdeb) {
-      fpdeb = fopen("rfmode.sdds", "w");
-      fprintf(fpdeb, "SDDS1\n");
-      fprintf(fpdeb, "&column name=t type=double units=s &end\n");
-      fprintf(fpdeb, "&column name=VI type=double units=V &end\n");
-      fprintf(fpdeb, "&column name=VQ type=double units=V &end\n");
-      fprintf(fpdeb, "&column name=V type=double units=V &end\n");
-      fprintf(fpdeb, "&column name=phase type=double &end\n");
-      fprintf(fpdeb, "&column name=dV type=double units=V &end\n");
-      fprintf(fpdeb, "&column name=dPhase type=double &end\n");
-      fprintf(fpdeb, "&data mode=ascii no_row_counts=1 &end\n");
-    }
-    if (!fpdeb2) {
-      fpdeb2 = fopen("rfmode2.sdds", "w");
-      fprintf(fpdeb2, "SDDS1\n");
-      fprintf(fpdeb2, "&column name=Pass type=long &end\n");
-      fprintf(fpdeb2, "&column name=t type=double units=s &end\n");
-      fprintf(fpdeb2, "&column name=dt type=double units=s &end\n");
-      fprintf(fpdeb2, "&column name=V type=double units=V &end\n");
-      fprintf(fpdeb2, "&column name=phase type=double units=V &end\n");
-      fprintf(fpdeb2, "&column name=VReal type=double units=V &end\n");
-      fprintf(fpdeb2, "&data mode=ascii no_row_counts=1 &end\n");
-    }
-    */
+  checkRfModeGroup(rfmodeList, element_name, nModes);
+  rfmode = rfmodeList[0]; /* binning parameters are taken from the first mode */
 
-  if (rfmode->binless) { /* This can't be done in parallel mode */
-#if USE_MPI
-    printf((char *)"binless in rfmode is not supported in the current parallel version.\n");
-    printf((char *)"Please use serial version.\n");
-    fflush(stdout);
-    MPI_Barrier(MPI_COMM_WORLD);
-    MPI_Abort(MPI_COMM_WORLD, T_RFMODE);
-#endif
-    runBinlessRfMode(part0, np0, rfmode, Po, element_name, element_z, pass, n_passes, charge);
-    return;
-  }
+  /* These are here just to quash apparently spurious compiler warnings about possibly using uninitialzed variables */
+  tOffset = last_tmax = tmean = DBL_MAX;
 
+  np_total = np0;
 #if USE_MPI
   MPI_Allreduce(&np0, &np_total, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
 #  ifdef DEBUG
@@ -125,87 +121,23 @@ void track_through_rfmode(
   }
 #  endif
 #endif
-  if (charge) {
-    rfmode->mp_charge = charge->macroParticleCharge;
-  } else if (pass == 0) {
-    rfmode->mp_charge = 0;
-    if (rfmode->charge < 0)
-      bombElegant((char *)"RFMODE charge parameter should be non-negative. Use change_particle to set particle charge state.", NULL);
-#if (!USE_MPI)
-    if (np0)
-      rfmode->mp_charge = rfmode->charge / np0;
-#else
-    if (notSinglePart) {
-      if (np_total)
-        rfmode->mp_charge = rfmode->charge / np_total;
-    } else {
-      if (np0)
-        rfmode->mp_charge = rfmode->charge / np0;
-    }
-#endif
-  }
-#ifdef DEBUG
-  printf("RFMODE: np0=%ld, charge=%le, mp_charge=%le\n", np0, rfmode->charge, rfmode->mp_charge);
-#endif
-
-  if (rfmode->fileInitialized && pass == 0) {
-#if USE_MPI
-    if (myid == 0) {
-#endif
-      if (rfmode->record && !SDDS_StartPage(rfmode->SDDSrec, rfmode->flush_interval)) {
-        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-        SDDS_Bomb((char *)"problem starting page for RFMODE record file");
-      }
-#if USE_MPI
-    }
-    if (myid == 1) {
-#endif
-      if (rfmode->driveFrequency > 0 && rfmode->feedbackRecordFile && !SDDS_StartPage(rfmode->SDDSfbrec, rfmode->flush_interval)) {
-        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-        SDDS_Bomb((char *)"problem starting page for RFMODE feedback record file");
-      }
-#if USE_MPI
-    }
-#endif
-    rfmode->sample_counter = rfmode->fbSample = 0;
-  }
-
-  if (pass % rfmode->pass_interval)
-    return;
-
-  if (isMaster) {
-    if (rfmode->freq < 1e3 && rfmode->freq)
-      printWarningForTracking((char *)"RFMODE frequency is less than 1kHz.",
-                              (char *)"This may be an error. Consult manual for units.");
-  }
 
-  if (rfmode->mp_charge == 0 && rfmode->voltageSetpoint == 0) {
-#ifdef DEBUG
-    printf("RFMODE: mp_charge=0, returning\n");
-#endif
-    return;
+  mode = (RFMODE_BUCKET *)tmalloc(sizeof(*mode) * nModes);
+  memset(mode, 0, sizeof(*mode) * nModes);
+  for (iMode = nActive = 0; iMode < nModes; iMode++) {
+    if (!startRfModePass(rfmodeList[iMode], np0, np_total, pass, charge))
+      continue;
+    mode[nActive].rfmode = rfmodeList[iMode];
+    mode[nActive].name = element_name[iMode];
+    nActive++;
   }
-  if (rfmode->detuned_until_pass > pass) {
+  if (!nActive) {
+    free(mode);
     return;
   }
 
-  if (!rfmode->initialized)
-    bombElegant((char *)"track_through_rfmode called with uninitialized element", NULL);
-  if (rfmode->Ra)
-    rfmode->RaInternal = rfmode->Ra;
-  else
-    rfmode->RaInternal = 2 * rfmode->Rs;
-
-  if (rfmode->n_bins > max_n_bins) {
-#ifdef DEBUG
-    printf("Allocating Ihist and Vbin to %ld bins, Ihist=%x, Vbin=%x\n", rfmode->n_bins, Ihist, Vbin);
-#endif
-    Ihist = (long *)trealloc(Ihist, sizeof(*Ihist) * (max_n_bins = rfmode->n_bins));
-    Vbin = (double *)trealloc(Vbin, sizeof(*Vbin) * max_n_bins);
-#ifdef DEBUG
-    printf("Allocated Ihist and Vbin to %ld bins, Ihist=%x, Vbin=%x\n", max_n_bins, Ihist, Vbin);
-#endif
-  }
+  Ihist = (long *)tmalloc(sizeof(*Ihist) * rfmode->n_bins);
+  Vbin = (double *)tmalloc(sizeof(*Vbin) * rfmode->n_bins);
 
   if (isSlave || !notSinglePart) {
 #ifdef DEBUG
@@ -220,7 +152,7 @@ void track_through_rfmode(
       if (rfmode->bunchInterval > 0) {
         /* Use pseudo-bunched beam mode---only one bunch is really present */
       } else
-        bombElegantVA((char *)"RFMODE %s has invalid values for bunched_beam_mode (>1) and bunch_interval (<=0)\n", element_name);
+        bombElegantVA((char *)"RFMODE %s has invalid values for bunched_beam_mode (>1) and bunch_interval (<=0)\n", element_name[0]);
     }
   }
 
@@ -346,249 +278,20 @@ void track_through_rfmode(
       }
       last_tmax = tmax;
 
-      if (rfmode->driveFrequency > 0) {
-        /* handle generator voltage, cavity feedback */
-        if (!rfmode->fbRunning) {
-          /* This next statement phases the generator to the first bunch at the desired phase */
-          rfmode->tGenerator = rfmode->fbLastTickTime = tmean - (rfmode->readOffset + 0.5) / rfmode->driveFrequency;
-          rfmode->fbNextTickTime = rfmode->fbLastTickTime + rfmode->updateInterval / rfmode->driveFrequency;
-          rfmode->fbNextTickTimeError = 0;
-          rfmode->fbRunning = 1;
-        }
-        while (tmean > rfmode->fbNextTickTime) {
-          /* Need to advance the generator phasors to the next sample time before handling this bunch */
-          double Vrl, Vil, omegaDrive, omegaRes, dt, Vgr, Vgi, Vbr, Vbi;
-          double IgAmp, IgPhase;
-          double VI, VQ;
-
-#ifdef DEBUG
-          printf("Advancing feedback ticks\n");
-          fflush(stdout);
-#endif
-          /* Update the voltage using the cavity state-space model */
-          m_mult(rfmode->Mt1, rfmode->A, rfmode->Viq);
-          m_mult(rfmode->Mt2, rfmode->B, rfmode->Iiq);
-          m_add(rfmode->Viq, rfmode->Mt1, rfmode->Mt2);
-
-          rfmode->fbLastTickTime = rfmode->fbNextTickTime;
-          rfmode->fbNextTickTime = KahanPlus(rfmode->fbNextTickTime, rfmode->updateInterval / rfmode->driveFrequency, &rfmode->fbNextTickTimeError);
-
-          /** Do feedback **/
-
-          /* Calculate the net voltage and phase at this time */
-          omegaRes = PIx2 * rfmode->freq;
-          omegaDrive = PIx2 * rfmode->driveFrequency;
-          Q = rfmode->Q / (1 + rfmode->beta);
-          tau = 2 * Q / omegaRes;
-          /* - Calculate beam-induced voltage components (real, imag). */
-          dt = rfmode->fbLastTickTime - rfmode->last_t;
-          phase = rfmode->last_phase + omegaRes * dt;
-          damping_factor = exp(-dt / tau);
-#ifdef DEBUG
-          printf("Advancing beamloading from %21.15le to %21.15le, tau = %le, DF=%le\n", rfmode->last_t, rfmode->fbLastTickTime, tau, damping_factor);
-          printf("Before: Vb=%le\n", rfmode->V);
-#endif
-          Vrl = (Vbr = damping_factor * rfmode->V * cos(phase));
-          Vil = (Vbi = damping_factor * rfmode->V * sin(phase));
-          /* - Add generator voltage components (real, imag) */
-          dt = rfmode->fbLastTickTime - rfmode->tGenerator;
-          Vrl += (Vgr = rfmode->Viq->a[0][0] * cos(omegaDrive * dt) - rfmode->Viq->a[1][0] * sin(omegaDrive * dt));
-          Vil += (Vgi = rfmode->Viq->a[0][0] * sin(omegaDrive * dt) + rfmode->Viq->a[1][0] * cos(omegaDrive * dt));
-
-          /* - Compute total voltage amplitude and phase */
-          V = sqrt(Vrl * Vrl + Vil * Vil);
-          rfmode->fbVCavity = V;
-          phase = atan2(Vil, Vrl);
-          VI = cos(omegaDrive * dt) * Vrl + sin(omegaDrive * dt) * Vil;
-          VQ = -sin(omegaDrive * dt) * Vrl + cos(omegaDrive * dt) * Vil;
-
-          /* parametric receiver noise */
-          if (rfmode->nNoise[I_NOISE_ALPHA_V] || rfmode->nNoise[I_NOISE_PHI_V]) {
-            if (rfmode->nNoise[I_NOISE_ALPHA_V]) {
-              /* amplitude */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_ALPHA_V], rfmode->nNoise[I_NOISE_ALPHA_V], rfmode->fbLastTickTime);
-              V *= 1 + linear_interpolation(rfmode->fNoise[I_NOISE_ALPHA_V], rfmode->tNoise[I_NOISE_ALPHA_V], rfmode->nNoise[I_NOISE_ALPHA_V], rfmode->fbLastTickTime, ib);
-            }
-            if (rfmode->nNoise[I_NOISE_PHI_V]) {
-              /* phase */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_PHI_V], rfmode->nNoise[I_NOISE_PHI_V], rfmode->fbLastTickTime);
-              phase += linear_interpolation(rfmode->fNoise[I_NOISE_PHI_V], rfmode->tNoise[I_NOISE_PHI_V], rfmode->nNoise[I_NOISE_PHI_V], rfmode->fbLastTickTime, ib);
-            }
-            Vrl = V * cos(phase);
-            Vil = V * sin(phase);
-            VI = cos(omegaDrive * dt) * Vrl + sin(omegaDrive * dt) * Vil;
-            VQ = -sin(omegaDrive * dt) * Vrl + cos(omegaDrive * dt) * Vil;
-          }
-          /* additive receiver noise */
-          if (rfmode->nNoise[I_NOISE_I_V] || rfmode->nNoise[I_NOISE_Q_V]) {
-            if (rfmode->nNoise[I_NOISE_I_V]) {
-              /* In-phase */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_I_V], rfmode->nNoise[I_NOISE_I_V], rfmode->fbLastTickTime);
-              VI += linear_interpolation(rfmode->fNoise[I_NOISE_I_V], rfmode->tNoise[I_NOISE_I_V], rfmode->nNoise[I_NOISE_I_V], rfmode->fbLastTickTime, ib);
-            }
-            if (rfmode->nNoise[I_NOISE_Q_V]) {
-              /* Quadrature */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_Q_V], rfmode->nNoise[I_NOISE_Q_V], rfmode->fbLastTickTime);
-              VQ += linear_interpolation(rfmode->fNoise[I_NOISE_Q_V], rfmode->tNoise[I_NOISE_Q_V], rfmode->nNoise[I_NOISE_Q_V], rfmode->fbLastTickTime, ib);
-            }
-            Vrl = VI * cos(omegaDrive * dt) - VQ * sin(omegaDrive * dt);
-            Vil = VI * sin(omegaDrive * dt) + VQ * cos(omegaDrive * dt);
-            V = sqrt(Vrl * Vrl + Vil * Vil);
-            phase = atan2(Vil, Vrl);
-          }
-
-          if (rfmode->nAmplitudeFilters) {
-            /* amplitude/phase feedback */
-
-            /* Calculate updated generator amplitude and phase
-                 - Compute errors for voltage amplitude and phase
-                 - Run these through the IIR filters
-                 - Add to nominal generator amplitude and phase
-              */
-
-            IgAmp = sqrt(sqr(rfmode->Ig0->a[0][0]) + sqr(rfmode->Ig0->a[1][0])) + applyIIRFilter(rfmode->amplitudeFilter, rfmode->nAmplitudeFilters,
-                                                                                                 rfmode->lambdaA * (rfmode->voltageSetpoint + rfmode->setpointAdjustment - V));
-            IgPhase = atan2(rfmode->Ig0->a[1][0], rfmode->Ig0->a[0][0]) + applyIIRFilter(rfmode->phaseFilter, rfmode->nPhaseFilters, PI / 180 * rfmode->phaseSetpoint - 3 * PI / 2 - phase);
-
-            if (rfmode->muteGenerator >= 0 && rfmode->muteGenerator <= pass) {
-              if (rfmode->muteGenerator == pass) {
-                printf("Generator muted for RFMODE %s on pass %ld\n", element_name, pass);
-                fflush(stdout);
-              }
-              IgAmp = 0;
-            }
-            IgAmp *= rfmode->generatorFactor;
-
-            /* Calculate updated I/Q components for generator current */
-            rfmode->Iiq->a[0][0] = IgAmp * cos(IgPhase);
-            rfmode->Iiq->a[1][0] = IgAmp * sin(IgPhase);
-          } else {
-            /* I/Q feedback */
-            double VISetpoint, VQSetpoint; /* equivalent in-phase and quadrature setpoints */
-            double phaseg;
-            double dII, dIQ;
-
-            /* convert from V*sin(phi) to V*cos(phi) convention and account for fact that the
-               * feedback is performed in the nominally empty part of each bucket (i.e., 180 degrees before 
-               * the nominal beam phase)
-               */
-            phaseg = PI / 180 * rfmode->phaseSetpoint - 3 * PI / 2;
-            VISetpoint = (rfmode->voltageSetpoint + rfmode->setpointAdjustment) * cos(phaseg);
-            VQSetpoint = (rfmode->voltageSetpoint + rfmode->setpointAdjustment) * sin(phaseg);
-
-            rfmode->Iiq->a[0][0] = rfmode->Ig0->a[0][0] + (dII = applyIIRFilter(rfmode->IFilter, rfmode->nIFilters, rfmode->lambdaA * (VISetpoint - VI)));
-            rfmode->Iiq->a[1][0] = rfmode->Ig0->a[1][0] + (dIQ = applyIIRFilter(rfmode->QFilter, rfmode->nQFilters, rfmode->lambdaA * (VQSetpoint - VQ)));
-
-            if (rfmode->muteGenerator >= 0 && rfmode->muteGenerator <= pass) {
-              if (rfmode->muteGenerator == pass) {
-                printf("Generator muted for RFMODE %s on pass %ld\n", element_name, pass);
-                fflush(stdout);
-              }
-              rfmode->Iiq->a[0][0] = rfmode->Iiq->a[1][0] = 0;
-            }
-
-#ifdef DEBUG
-            printf("dII = %le, dIQ = %le\n", dII, dIQ);
-#endif
-            IgAmp = sqrt(sqr(rfmode->Iiq->a[0][0]) + sqr(rfmode->Iiq->a[1][0]));
-            IgPhase = atan2(rfmode->Iiq->a[1][0], rfmode->Iiq->a[0][0]);
-          }
-
-          /* Parametric generator noise */
-          if (rfmode->nNoise[I_NOISE_ALPHA_GEN] || rfmode->nNoise[I_NOISE_PHI_GEN]) {
-            if (rfmode->nNoise[I_NOISE_ALPHA_GEN]) {
-              /* amplitude */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_ALPHA_GEN], rfmode->nNoise[I_NOISE_ALPHA_GEN], rfmode->fbLastTickTime);
-              IgAmp *= 1 + linear_interpolation(rfmode->fNoise[I_NOISE_ALPHA_GEN], rfmode->tNoise[I_NOISE_ALPHA_GEN], rfmode->nNoise[I_NOISE_ALPHA_GEN], rfmode->fbLastTickTime, ib);
-            }
-            if (rfmode->nNoise[I_NOISE_PHI_GEN]) {
-              /* phase */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_PHI_GEN], rfmode->nNoise[I_NOISE_PHI_GEN], rfmode->fbLastTickTime);
-              IgPhase += linear_interpolation(rfmode->fNoise[I_NOISE_PHI_GEN], rfmode->tNoise[I_NOISE_PHI_GEN], rfmode->nNoise[I_NOISE_PHI_GEN], rfmode->fbLastTickTime, ib);
-            }
-            /* Calculate updated I/Q components for generator current */
-            rfmode->Iiq->a[0][0] = IgAmp * cos(IgPhase);
-            rfmode->Iiq->a[1][0] = IgAmp * sin(IgPhase);
-          }
-          if (rfmode->nNoise[I_NOISE_I_GEN] || rfmode->nNoise[I_NOISE_Q_GEN]) {
-            /* Additive generator noise */
-            if (rfmode->nNoise[I_NOISE_I_GEN]) {
-              /* In-phase */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_I_GEN], rfmode->nNoise[I_NOISE_I_GEN], rfmode->fbLastTickTime);
-              rfmode->Iiq->a[0][0] += linear_interpolation(rfmode->fNoise[I_NOISE_I_GEN], rfmode->tNoise[I_NOISE_I_GEN], rfmode->nNoise[I_NOISE_I_GEN], rfmode->fbLastTickTime, ib);
-            }
-            if (rfmode->nNoise[I_NOISE_Q_GEN]) {
-              /* Quadrature */
-              ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_Q_GEN], rfmode->nNoise[I_NOISE_Q_GEN], rfmode->fbLastTickTime);
-              rfmode->Iiq->a[1][0] += linear_interpolation(rfmode->fNoise[I_NOISE_Q_GEN], rfmode->tNoise[I_NOISE_Q_GEN], rfmode->nNoise[I_NOISE_Q_GEN], rfmode->fbLastTickTime, ib);
-            }
-            IgAmp = sqrt(sqr(rfmode->Iiq->a[0][0]) + sqr(rfmode->Iiq->a[1][0]));
-            IgPhase = atan2(rfmode->Iiq->a[1][0], rfmode->Iiq->a[0][0]);
-          }
-
-          if (rfmode->driveFrequency && rfmode->feedbackRecordFile) {
-#if USE_MPI
-            if (myid == 1) {
-#endif
-              if ((rfmode->fbSample + 1) % rfmode->flush_interval == 0) {
-                if (!SDDS_UpdatePage(rfmode->SDDSfbrec, FLUSH_TABLE)) {
-                  SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-                  SDDS_Bomb((char *)"problem flushing RFMODE feedback record file");
-                }
-              }
-              if (!SDDS_SetRowValues(rfmode->SDDSfbrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
-                                     rfmode->fbSample,
-                                     (char *)"Pass", pass, (char *)"t", rfmode->fbLastTickTime,
-                                     (char *)"fResonance", rfmode->freq,
-                                     (char *)"fDrive", rfmode->driveFrequency,
-                                     (char *)"VbReal", Vbr, (char *)"VbImag", Vbi,
-                                     (char *)"VgReal", Vgr, (char *)"VgImag", Vgi,
-                                     (char *)"VCavity", V, (char *)"PhaseCavity", phase,
-                                     (char *)"IgAmplitude", IgAmp,
-                                     (char *)"IgPhase", IgPhase,
-                                     NULL)) {
-                SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-                SDDS_Bomb((char *)"problem setting values for feedback record file");
-              }
-              /*
-                  if ((rfmode->fbSample%1000==0 || (pass==(n_passes-1) && iBucket==(nBuckets-1)))
-                  && !SDDS_UpdatePage(rfmode->SDDSfbrec, FLUSH_TABLE)) {
-                  SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-                  printf("Warning: problem writing data for RFMODE feedback record file, row %ld\n", rfmode->fbSample);
-                  }
-                */
-              rfmode->fbSample++;
-#if USE_MPI
-            }
-#endif
-          }
-
-          /*
-              if (isnan(rfmode->Iiq->a[0][0]) || isnan(rfmode->Iiq->a[1][0]) || isinf(rfmode->Iiq->a[0][0]) || isinf(rfmode->Iiq->a[1][0])) {
-              printf("V = %le, setpoint = %le\n", V, rfmode->voltageSetpoint);
-              printf("phase = %le, setpoints = %le\n", phase, rfmode->phaseg);
-              printf("Viq = %le, %le\n", rfmode->Viq->a[0][0], rfmode->Viq->a[1][0]);
-              printf("Iiq = %le, %le\n", rfmode->Iiq->a[0][0], rfmode->Iiq->a[1][0]);
-              exit(1);
-              }
-            */
-#ifdef DEBUG
-          printf("After tick: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15le s, tNext=%21.15le\n",
-                 sqrt(Vbr * Vbr + Vbi * Vbi), Vbr, Vbi, atan2(Vbi, Vbr), rfmode->fbLastTickTime, rfmode->fbNextTickTime);
-#endif
-        } /* end while loop for feedback ticks */
-      }
+      for (iMode = 0; iMode < nActive; iMode++)
+        advanceRfModeFeedback(mode[iMode].rfmode, mode[iMode].name, tmean, pass);
 
+      dt = (tmax - tmin) / rfmode->n_bins;
       if (isSlave) {
 #ifdef DEBUG
         printf("tmin = %21.15le, tmax = %21.15le, tmean = %21.15le\n", tmin, tmax, tmean);
         fflush(stdout);
 #endif
 
+        elementProfilerStartCollective(PROFILE_HISTOGRAM);
         for (ib = 0; ib < rfmode->n_bins; ib++)
           Ihist[ib] = 0;
 
-        dt = (tmax - tmin) / rfmode->n_bins;
         n_binned = lastBin = 0;
         firstBin = rfmode->n_bins;
 #if USE_MPI
@@ -617,63 +320,11 @@ void track_through_rfmode(
             firstBin = ib;
           n_binned++;
         }
-#if USE_MPI && MPI_DEBUG
-        /*
-	  printf("Histogram Ihist has %ld  particles, %ld binned particles, firstBin=%ld, lastBin=%ld\n",
-		 np, n_binned, firstBin, lastBin);
-	  for (ib=firstBin; ib<=lastBin; ib++) 
-	    printf("Ihist[%ld] = %ld\n", ib, Ihist[ib]);
-	  */
-#endif
-        V_sum = Vr_sum = Vi_sum = Q_sum = Vg_sum = Vgr_sum = Vgi_sum = Vci_sum = Vcr_sum = Vc_sum = 0;
-        n_summed = max_hist = n_occupied = 0;
-
-        /* find frequency and Q at this time */
-        omega = PIx2 * rfmode->freq;
-        if (rfmode->nFreq) {
-          double omegaFactor;
-          ib = find_nearby_array_entry(rfmode->tFreq, rfmode->nFreq, tmean);
-          omega *= (omegaFactor = linear_interpolation(rfmode->fFreq, rfmode->tFreq, rfmode->nFreq, tmean, ib));
-          /* keeps stored energy constant for constant R/Q */
-          rfmode->V *= sqrt(omegaFactor);
-        }
-        Q = rfmode->Q / (1 + rfmode->beta);
-        if (rfmode->nQ) {
-          ib = find_nearby_array_entry(rfmode->tQ, rfmode->nQ, tmean);
-          Q *= linear_interpolation(rfmode->fQ, rfmode->tQ, rfmode->nQ, tmean, ib);
-        }
-      }
-#if (!USE_MPI)
-      if (Q < 0.5) {
-        printf((char *)"The effective Q<=0.5 for RFMODE.  Use the ZLONGIT element.\n");
-        fflush(stdout);
-        exitElegant(1);
-      }
-#else
-      if (myid == 1) { /* Let the first slave processor write the output */
-        if (Q < 0.5) {
-          dup2(fdStdout, fileno(stdout));
-          printf((char *)"The effective Q<=0.5 for RFMODE.  Use the ZLONGIT element.\n");
-          fflush(stdout);
-          freopen("/dev/null", "w", stdout);
-          MPI_Abort(MPI_COMM_WORLD, T_RFMODE);
-        }
-      }
-#endif
-      tau = 2 * Q / omega;
-      k = omega / 4 * (rfmode->RaInternal) / rfmode->Q;
-      if ((deltaPass = (pass - rfmode->detuned_until_pass)) <= (rfmode->rampPasses - 1))
-        k *= (deltaPass + 1.0) / rfmode->rampPasses;
-
-      /* These adjustments per Zotter and Kheifets, 3.2.4 */
-      Qrp = sqrt(Q * Q - 0.25);
-      VbImagFactor = 1 / (2 * Qrp);
-      omega *= Qrp / Q;
-
-      if (rfmode->single_pass) {
-        rfmode->V = rfmode->last_phase = 0;
-        rfmode->last_t = tmin + 0.5 * dt;
+        elementProfilerEndCollective(PROFILE_HISTOGRAM);
       }
+
+      for (iMode = 0; iMode < nActive; iMode++)
+        setRfModeBucketParameters(mode + iMode, tmean, tmin, dt, pass);
     }
 
 #if USE_MPI
@@ -776,110 +427,28 @@ void track_through_rfmode(
 #endif
 
     if (isSlave || !notSinglePart) {
-      /* These values are fixed and can be used to compute the effect on the beam of
-         * the "long-range" fields (previous turns) only
-         */
-      VPrevious = rfmode->V;
-      tPrevious = rfmode->last_t;
-      phasePrevious = rfmode->last_phase;
-#ifdef DEBUG
-      printf("VPrevious = %le, tPrevious = %le, phasePrevious = %le, firstBin = %ld, lastBin = %ld\n",
-             VPrevious, tPrevious, phasePrevious, firstBin, lastBin);
-#endif
-
-      if (rfmode->driveFrequency > 0) {
-        /* compute generator voltage I and Q envelopes at bunch center */
-        fillBerencABMatrices(rfmode->At, rfmode->Bt, rfmode, tmean - rfmode->fbLastTickTime);
-        m_mult(rfmode->Mt1, rfmode->At, rfmode->Viq);
-        m_mult(rfmode->Mt2, rfmode->Bt, rfmode->Iiq);
-        m_add(rfmode->Mt3, rfmode->Mt1, rfmode->Mt2);
-      }
-
-      for (ib = firstBin; ib <= lastBin; ib++) {
-        t = tmin + (ib + 0.5) * dt; /* middle arrival time for this bin */
-        if (!Ihist[ib] && !rfmode->interpolate)
-          continue;
-        if (Ihist[ib] > max_hist)
-          max_hist = Ihist[ib];
-        if (Ihist[ib])
-          n_occupied++;
-
-          /* advance cavity to this time */
-#ifdef DEBUG
-        printf("Advancing beamloading from %21.15le to %21.15le, dt=%le, tau=%le, last_phase=%le\n",
-               rfmode->last_t, t, t - rfmode->last_t, tau, rfmode->last_phase);
-        printf("Before: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les\n",
-               rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t);
-#endif
-        phase = rfmode->last_phase + omega * (t - rfmode->last_t);
-        damping_factor = exp(-(t - rfmode->last_t) / tau);
-        rfmode->last_t = t;
-        rfmode->last_phase = phase;
-        rfmode->V = V = rfmode->V * damping_factor;
-        rfmode->Vr = V * cos(phase);
-        rfmode->Vi = V * sin(phase);
-#ifdef DEBUG
-        printf("After: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les, tau=%le, DF=%le\n",
-               rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t, tau, damping_factor);
-#endif
-
-        /* compute beam-induced voltage for this bin */
-        Vb = 2 * k * rfmode->mp_charge * particleRelSign * rfmode->pass_interval * Ihist[ib];
-        if (rfmode->long_range_only)
-          Vbin[ib] = VPrevious * (damping_factor = exp(-(t - tPrevious) / tau)) * cos(phasePrevious + omega * (t - tPrevious));
-        else
-          Vbin[ib] = rfmode->Vr - Vb / 2;
-
-        if (rfmode->driveFrequency > 0) {
-          /* add generator-induced voltage */
-          double Vr, Vi, dt;
-          dt = t - rfmode->tGenerator;
-          Vg_sum += Ihist[ib] * sqrt(sqr(rfmode->Mt3->a[0][0]) + sqr(rfmode->Mt3->a[1][0]));
-          Vr = rfmode->Mt3->a[0][0] * cos(PIx2 * rfmode->driveFrequency * dt) - rfmode->Mt3->a[1][0] * sin(PIx2 * rfmode->driveFrequency * dt);
-          Vi = rfmode->Mt3->a[0][0] * sin(PIx2 * rfmode->driveFrequency * dt) + rfmode->Mt3->a[1][0] * cos(PIx2 * rfmode->driveFrequency * dt);
-          Vbin[ib] += Vr;
-          Vgi_sum += Ihist[ib] * Vi;
-          Vgr_sum += Ihist[ib] * Vr;
-          Vcr_sum += Ihist[ib] * (Vr + rfmode->Vr - Vb / 2);
-          Vci_sum += Ihist[ib] * (Vi + rfmode->Vi - Vb * VbImagFactor / 2);
-          Vc_sum += Ihist[ib] * sqrt(sqr(Vr + rfmode->Vr - Vb / 2) + sqr(Vi + rfmode->Vi - Vb * VbImagFactor / 2));
-          /* fprintf(fpdeb2, "%ld %21.15le %21.15le %le %le %le\n", pass, t, dt, sqrt(Vi*Vi+Vr*Vr), atan2(Vi, Vr), Vr); */
-        }
-
-        /* add slice contribution to beam-induced voltage */
-        rfmode->Vr -= Vb;
-        rfmode->Vi -= Vb * VbImagFactor;
-        rfmode->last_phase = atan2(rfmode->Vi, rfmode->Vr);
-        rfmode->V = sqrt(sqr(rfmode->Vr) + sqr(rfmode->Vi));
-#ifdef DEBUG
-        printf("BL+: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les, tau=%le, DF=%le\n",
-               rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t, tau, damping_factor);
-#endif
-
-        V_sum += Ihist[ib] * rfmode->V;
-        Vr_sum += Ihist[ib] * rfmode->Vr;
-        Vi_sum += Ihist[ib] * rfmode->Vi;
-        Q_sum += Ihist[ib] * rfmode->mp_charge * particleRelSign;
-        n_summed += Ihist[ib];
-      }
-      /*
-        fprintf(fpdeb, "\n");
-        fflush(fpdeb);
-        */
+      for (ib = firstBin; ib <= lastBin; ib++)
+        Vbin[ib] = 0;
+      kicking = 0;
+      elementProfilerStartCollective(PROFILE_WAKE);
+      for (iMode = 0; iMode < nActive; iMode++)
+        kicking += addRfModeBinVoltages(mode + iMode, Ihist, Vbin, firstBin, lastBin, tmin, dt, tmean, pass);
+      elementProfilerEndCollective(PROFILE_WAKE);
 #ifdef DEBUG
       printf("Computed voltage values in bins\n");
       fflush(stdout);
 #endif
 
-      if (rfmode->rigid_until_pass <= pass) {
+      if (kicking) {
         double dt1;
         /* change particle momentum offsets to reflect voltage in relevant bin */
         /* also recompute slopes for new momentum to conserve transverse momentum */
         for (ip = 0; ip < np; ip++) {
+          if ((ib = pbin[ip]) < 0)
+            continue;
           /* compute voltage seen by this particle */
           if (rfmode->interpolate) {
             long ib1, ib2;
-            ib = pbin[ip];
             dt1 = time[ip] + tOffset - (tmin + dt * (ib + 0.5));
             if (dt1 < 0) {
               ib1 = ib - 1;
@@ -899,9 +468,9 @@ void track_through_rfmode(
             dt1 = time[ip] + tOffset - (tmin + dt * (ib1 + 0.5));
             V = Vbin[ib1] + (Vbin[ib2] - Vbin[ib1]) / dt * dt1;
           } else {
-            V = Vbin[pbin[ip]];
+            V = Vbin[ib];
           }
-          dgamma = rfmode->n_cavities * V / (1e6 * particleMassMV * particleRelSign);
+          dgamma = V / (1e6 * particleMassMV * particleRelSign);
           if (iBucket == jBucket)
             add_to_particle_energy(part[ip], time[ip], Po, dgamma);
         }
@@ -918,127 +487,8 @@ void track_through_rfmode(
       }
     }
 
-    adjusting = (rfmode->adjustmentFraction > 0 && pass >= rfmode->adjustmentStart && pass <= rfmode->adjustmentEnd &&
-                 rfmode->adjustmentInterval > 0 && pass % rfmode->adjustmentInterval == 0 && jBucket == 0);
-    if (adjusting && pass == rfmode->adjustmentStart)
-      rfmode->setpointAdjustment = 0;
-    outputing = (rfmode->record && (pass % rfmode->sample_interval) == 0);
-    if (outputing || adjusting) {
-#if USE_MPI
-#  define SR_BUFLEN 17
-      double sendBuffer[SR_BUFLEN], receiveBuffer[SR_BUFLEN];
-#endif
-
-#if USE_MPI
-      if (myid == 0)
-#endif
-        if (outputing) {
-          if (!SDDS_UpdatePage(rfmode->SDDSrec, FLUSH_TABLE)) {
-            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-            SDDS_Bomb((char *)"problem flushing RFMODE record file");
-          }
-        }
-
-      np_total = np; /* Used by serial version */
-#if (USE_MPI)
-      /* Sum data across all cores */
-      if (myid == 0) {
-        memset(sendBuffer, 0, sizeof(sendBuffer[0]) * SR_BUFLEN);
-      } else {
-        sendBuffer[0] = n_binned;
-        sendBuffer[1] = rfmode->V;
-        sendBuffer[2] = rfmode->last_phase;
-        sendBuffer[3] = rfmode->last_t;
-        sendBuffer[4] = V_sum;
-        sendBuffer[5] = Vr_sum;
-        sendBuffer[6] = Vi_sum;
-        sendBuffer[7] = np;
-        sendBuffer[8] = Vgr_sum;
-        sendBuffer[9] = Vgi_sum;
-        sendBuffer[10] = Vcr_sum;
-        sendBuffer[11] = Vci_sum;
-        sendBuffer[12] = n_occupied;
-        sendBuffer[13] = n_summed;
-        sendBuffer[14] = Vg_sum;
-        sendBuffer[15] = rfmode->fbVCavity;
-        sendBuffer[16] = Vc_sum;
-      }
-      if (adjusting) {
-        MPI_Allreduce(sendBuffer, receiveBuffer, SR_BUFLEN, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-      } else
-        MPI_Reduce(sendBuffer, receiveBuffer, SR_BUFLEN, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
-      if (adjusting || (myid == 0)) {
-        n_binned = receiveBuffer[0];
-        if (myid == 0) {
-          rfmode->fbVCavity = receiveBuffer[15] / (n_processors - 1);
-          rfmode->V = receiveBuffer[1] / (n_processors - 1);
-          rfmode->last_phase = receiveBuffer[2] / (n_processors - 1);
-          rfmode->last_t = receiveBuffer[3] / (n_processors - 1);
-        }
-        V_sum = receiveBuffer[4];
-        Vr_sum = receiveBuffer[5];
-        Vi_sum = receiveBuffer[6];
-        np_total = receiveBuffer[7];
-        Vgr_sum = receiveBuffer[8];
-        Vgi_sum = receiveBuffer[9];
-        Vcr_sum = receiveBuffer[10];
-        Vci_sum = receiveBuffer[11];
-        Vc_sum = receiveBuffer[16];
-        n_occupied = receiveBuffer[12];
-        n_summed = receiveBuffer[13];
-        Vg_sum = receiveBuffer[14];
-      }
-      if (myid == 0) {
-#endif
-#ifdef DEBUG
-        printf("Writing record file\n");
-        fflush(stdout);
-#endif
-        if (!SDDS_SetRowValues(rfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
-                               rfmode->sample_counter++,
-                               (char *)"Bunch", jBucket, (char *)"Pass", pass, (char *)"NumberOccupied", n_occupied,
-                               (char *)"FractionBinned", np_total ? (1.0 * n_binned) / np_total : 0.0,
-                               (char *)"VPostBeam", rfmode->V,
-                               (char *)"PhasePostBeam", rfmode->last_phase,
-                               (char *)"tPostBeam", rfmode->last_t,
-                               (char *)"V", n_summed ? V_sum / n_summed : 0.0,
-                               (char *)"VReal", n_summed ? Vr_sum / n_summed : 0.0,
-                               (char *)"Phase", n_summed ? atan2(Vi_sum / n_summed, Vr_sum / n_summed) : 0.0,
-                               (char *)"Charge", rfmode->mp_charge * np_total,
-                               NULL) ||
-            (rfmode->driveFrequency > 0 &&
-             !SDDS_SetRowValues(rfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
-                                rfmode->sample_counter - 1,
-                                (char *)"VGenerator", n_summed ? Vg_sum / n_summed : 0.0,
-                                (char *)"PhaseGenerator", n_summed ? atan2(Vgi_sum / n_summed, Vgr_sum / n_summed) : 0.0,
-                                (char *)"VCavity", n_summed ? Vc_sum / n_summed : 0.0,
-                                (char *)"PhaseCavity", n_summed ? atan2(Vci_sum / n_summed, Vcr_sum / n_summed) : 0.0,
-                                NULL))) {
-          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-          printWarningForTracking((char *)"Problem setting up data for RFMODE record file", NULL);
-        }
-        /*
-            if (rfmode->sample_counter%100==0 && !SDDS_UpdatePage(rfmode->SDDSrec, 0)) {
-              SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-              printf("Warning: problem writing data for RFMODE record file, row %ld\n", rfmode->sample_counter);
-            }
-            */
-#ifdef DEBUG
-        printf("Done writing record file\n");
-        fflush(stdout);
-#endif
-#if USE_MPI
-      }
-#endif
-      if (adjusting) {
-        /* adjust the voltage setpoint to get the voltage we really want */
-        double VcEffective;
-        VcEffective = n_summed ? Vc_sum / n_summed : 0.0;
-        rfmode->setpointAdjustment += (rfmode->voltageSetpoint - VcEffective) * rfmode->adjustmentFraction;
-        printf("Voltage setpoint adjustment changed to %le V on pass %ld\n", rfmode->setpointAdjustment, pass);
-        fflush(stdout);
-      }
-    }
+    for (iMode = 0; iMode < nActive; iMode++)
+      recordRfModeBucket(mode + iMode, pass, jBucket, np, n_binned);
 
 #if USE_MPI
 #  ifdef DEBUG
@@ -1065,20 +515,23 @@ void track_through_rfmode(
   fflush(stdout);
 #endif
 
-  if (rfmode->record) {
-
+  for (iMode = 0; iMode < nActive; iMode++) {
+    if (mode[iMode].rfmode->record) {
 #if USE_MPI
-    if (myid == 0) {
+      if (myid == 0) {
 #endif
-      if (pass == n_passes - 1) {
-        if (!SDDS_UpdatePage(rfmode->SDDSrec, FLUSH_TABLE)) {
-          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
-          SDDS_Bomb((char *)"problem writing data for RFMODE record file");
+        if (pass == n_passes - 1) {
+          elementProfilerStartCollective(PROFILE_OUTPUT);
+          if (!SDDS_UpdatePage(mode[iMode].rfmode->SDDSrec, FLUSH_TABLE)) {
+            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+            SDDS_Bomb((char *)"problem writing data for RFMODE record file");
+          }
+          elementProfilerEndCollective(PROFILE_OUTPUT);
         }
-      }
 #if USE_MPI
-    }
+      }
 #endif
+    }
   }
 
 #ifdef DEBUG
@@ -1086,6 +539,7 @@ void track_through_rfmode(
   fflush(stdout);
 #endif
 
+  free(mode);
   if (Ihist)
     free(Ihist);
   if (Vbin)
@@ -1100,6 +554,640 @@ void track_through_rfmode(
     free_bunch_index_memory(time0, ibParticle, ipBucket, npBucket, nBuckets);
 }
 
+static void checkRfModeGroup(RFMODE **rfmode, char **element_name, long nModes) {
+  long i;
+  for (i = 1; i < nModes; i++) {
+    if (rfmode[i]->binless || rfmode[0]->binless)
+      bombElegantVA((char *)"RFMODE %s: BINLESS mode can't be used for elements in a GROUP\n", element_name[rfmode[0]->binless ? 0 : i]);
+    if (rfmode[i]->n_bins != rfmode[0]->n_bins || rfmode[i]->bin_size != rfmode[0]->bin_size ||
+        rfmode[i]->interpolate != rfmode[0]->interpolate || rfmode[i]->pass_interval != rfmode[0]->pass_interval ||
+        rfmode[i]->bunchedBeamMode != rfmode[0]->bunchedBeamMode || rfmode[i]->bunchInterval != rfmode[0]->bunchInterval ||
+        rfmode[i]->allowUnbinnedParticles != rfmode[0]->allowUnbinnedParticles)
+      bombElegantVA((char *)"RFMODE elements %s and %s are in GROUP %s but have different N_BINS, BIN_SIZE, INTERPOLATE, PASS_INTERVAL, BUNCHED_BEAM_MODE, BUNCH_INTERVAL, or ALLOW_UNBINNED_PARTICLES values\n",
+                    element_name[0], element_name[i], rfmode[0]->group);
+  }
+}
+
+/* Per-pass setup of one mode. Returns 0 if the mode does nothing on this pass. */
+static long startRfModePass(RFMODE *rfmode, long np0, long np_total, long pass, CHARGE *charge) {
+  if (charge) {
+    rfmode->mp_charge = charge->macroParticleCharge;
+  } else if (pass == 0) {
+    rfmode->mp_charge = 0;
+    if (rfmode->charge < 0)
+      bombElegant((char *)"RFMODE charge parameter should be non-negative. Use change_particle to set particle charge state.", NULL);
+#if (!USE_MPI)
+    if (np0)
+      rfmode->mp_charge = rfmode->charge / np0;
+#else
+    if (notSinglePart) {
+      if (np_total)
+        rfmode->mp_charge = rfmode->charge / np_total;
+    } else {
+      if (np0)
+        rfmode->mp_charge = rfmode->charge / np0;
+    }
+#endif
+  }
+#ifdef DEBUG
+  printf("RFMODE: np0=%ld, charge=%le, mp_charge=%le\n", np0, rfmode->charge, rfmode->mp_charge);
+#endif
+
+  if (rfmode->fileInitialized && pass == 0) {
+#if USE_MPI
+    if (myid == 0) {
+#endif
+      if (rfmode->record && !SDDS_StartPage(rfmode->SDDSrec, rfmode->flush_interval)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        SDDS_Bomb((char *)"problem starting page for RFMODE record file");
+      }
+#if USE_MPI
+    }
+    if (myid == 1) {
+#endif
+      if (rfmode->driveFrequency > 0 && rfmode->feedbackRecordFile && !SDDS_StartPage(rfmode->SDDSfbrec, rfmode->flush_interval)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        SDDS_Bomb((char *)"problem starting page for RFMODE feedback record file");
+      }
+#if USE_MPI
+    }
+#endif
+    rfmode->sample_counter = rfmode->fbSample = 0;
+  }
+
+  if (pass % rfmode->pass_interval)
+    return 0;
+
+  if (isMaster) {
+    if (rfmode->freq < 1e3 && rfmode->freq)
+      printWarningForTracking((char *)"RFMODE frequency is less than 1kHz.",
+                              (char *)"This may be an error. Consult manual for units.");
+  }
+
+  if (rfmode->mp_charge == 0 && rfmode->voltageSetpoint == 0) {
+#ifdef DEBUG
+    printf("RFMODE: mp_charge=0, returning\n");
+#endif
+    return 0;
+  }
+  if (rfmode->detuned_until_pass > pass) {
+    return 0;
+  }
+
+  if (!rfmode->initialized)
+    bombElegant((char *)"track_through_rfmode called with uninitialized element", NULL);
+  if (rfmode->Ra)
+    rfmode->RaInternal = rfmode->Ra;
+  else
+    rfmode->RaInternal = 2 * rfmode->Rs;
+  return 1;
+}
+
+/* Advances the generator and feedback system up to the arrival of the bunch with mean time tmean */
+static void advanceRfModeFeedback(RFMODE *rfmode, char *element_name, double tmean, long pass) {
+  long ib;
+  double V, phase, Q, tau, damping_factor;
+
+  if (rfmode->driveFrequency <= 0)
+    return;
+
+  /* handle generator voltage, cavity feedback */
+  if (!rfmode->fbRunning) {
+    /* This next statement phases the generator to the first bunch at the desired phase */
+    rfmode->tGenerator = rfmode->fbLastTickTime = tmean - (rfmode->readOffset + 0.5) / rfmode->driveFrequency;
+    rfmode->fbNextTickTime = rfmode->fbLastTickTime + rfmode->updateInterval / rfmode->driveFrequency;
+    rfmode->fbNextTickTimeError = 0;
+    rfmode->fbRunning = 1;
+  }
+  while (tmean > rfmode->fbNextTickTime) {
+    /* Need to advance the generator phasors to the next sample time before handling this bunch */
+    double Vrl, Vil, omegaDrive, omegaRes, dt, Vgr, Vgi, Vbr, Vbi;
+    double IgAmp, IgPhase;
+    double VI, VQ;
+
+#ifdef DEBUG
+    printf("Advancing feedback ticks\n");
+    fflush(stdout);
+#endif
+    /* Update the voltage using the cavity state-space model */
+    m_mult(rfmode->Mt1, rfmode->A, rfmode->Viq);
+    m_mult(rfmode->Mt2, rfmode->B, rfmode->Iiq);
+    m_add(rfmode->Viq, rfmode->Mt1, rfmode->Mt2);
+
+    rfmode->fbLastTickTime = rfmode->fbNextTickTime;
+    rfmode->fbNextTickTime = KahanPlus(rfmode->fbNextTickTime, rfmode->updateInterval / rfmode->driveFrequency, &rfmode->fbNextTickTimeError);
+
+    /** Do feedback **/
+
+    /* Calculate the net voltage and phase at this time */
+    omegaRes = PIx2 * rfmode->freq;
+    omegaDrive = PIx2 * rfmode->driveFrequency;
+    Q = rfmode->Q / (1 + rfmode->beta);
+    tau = 2 * Q / omegaRes;
+    /* - Calculate beam-induced voltage components (real, imag). */
+    dt = rfmode->fbLastTickTime - rfmode->last_t;
+    phase = rfmode->last_phase + omegaRes * dt;
+    damping_factor = exp(-dt / tau);
+#ifdef DEBUG
+    printf("Advancing beamloading from %21.15le to %21.15le, tau = %le, DF=%le\n", rfmode->last_t, rfmode->fbLastTickTime, tau, damping_factor);
+    printf("Before: Vb=%le\n", rfmode->V);
+#endif
+    Vrl = (Vbr = damping_factor * rfmode->V * cos(phase));
+    Vil = (Vbi = damping_factor * rfmode->V * sin(phase));
+    /* - Add generator voltage components (real, imag) */
+    dt = rfmode->fbLastTickTime - rfmode->tGenerator;
+    Vrl += (Vgr = rfmode->Viq->a[0][0] * cos(omegaDrive * dt) - rfmode->Viq->a[1][0] * sin(omegaDrive * dt));
+    Vil += (Vgi = rfmode->Viq->a[0][0] * sin(omegaDrive * dt) + rfmode->Viq->a[1][0] * cos(omegaDrive * dt));
+
+    /* - Compute total voltage amplitude and phase */
+    V = sqrt(Vrl * Vrl + Vil * Vil);
+    rfmode->fbVCavity = V;
+    phase = atan2(Vil, Vrl);
+    VI = cos(omegaDrive * dt) * Vrl + sin(omegaDrive * dt) * Vil;
+    VQ = -sin(omegaDrive * dt) * Vrl + cos(omegaDrive * dt) * Vil;
+
+    /* parametric receiver noise */
+    if (rfmode->nNoise[I_NOISE_ALPHA_V] || rfmode->nNoise[I_NOISE_PHI_V]) {
+      if (rfmode->nNoise[I_NOISE_ALPHA_V]) {
+        /* amplitude */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_ALPHA_V], rfmode->nNoise[I_NOISE_ALPHA_V], rfmode->fbLastTickTime);
+        V *= 1 + linear_interpolation(rfmode->fNoise[I_NOISE_ALPHA_V], rfmode->tNoise[I_NOISE_ALPHA_V], rfmode->nNoise[I_NOISE_ALPHA_V], rfmode->fbLastTickTime, ib);
+      }
+      if (rfmode->nNoise[I_NOISE_PHI_V]) {
+        /* phase */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_PHI_V], rfmode->nNoise[I_NOISE_PHI_V], rfmode->fbLastTickTime);
+        phase += linear_interpolation(rfmode->fNoise[I_NOISE_PHI_V], rfmode->tNoise[I_NOISE_PHI_V], rfmode->nNoise[I_NOISE_PHI_V], rfmode->fbLastTickTime, ib);
+      }
+      Vrl = V * cos(phase);
+      Vil = V * sin(phase);
+      VI = cos(omegaDrive * dt) * Vrl + sin(omegaDrive * dt) * Vil;
+      VQ = -sin(omegaDrive * dt) * Vrl + cos(omegaDrive * dt) * Vil;
+    }
+    /* additive receiver noise */
+    if (rfmode->nNoise[I_NOISE_I_V] || rfmode->nNoise[I_NOISE_Q_V]) {
+      if (rfmode->nNoise[I_NOISE_I_V]) {
+        /* In-phase */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_I_V], rfmode->nNoise[I_NOISE_I_V], rfmode->fbLastTickTime);
+        VI += linear_interpolation(rfmode->fNoise[I_NOISE_I_V], rfmode->tNoise[I_NOISE_I_V], rfmode->nNoise[I_NOISE_I_V], rfmode->fbLastTickTime, ib);
+      }
+      if (rfmode->nNoise[I_NOISE_Q_V]) {
+        /* Quadrature */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_Q_V], rfmode->nNoise[I_NOISE_Q_V], rfmode->fbLastTickTime);
+        VQ += linear_interpolation(rfmode->fNoise[I_NOISE_Q_V], rfmode->tNoise[I_NOISE_Q_V], rfmode->nNoise[I_NOISE_Q_V], rfmode->fbLastTickTime, ib);
+      }
+      Vrl = VI * cos(omegaDrive * dt) - VQ * sin(omegaDrive * dt);
+      Vil = VI * sin(omegaDrive * dt) + VQ * cos(omegaDrive * dt);
+      V = sqrt(Vrl * Vrl + Vil * Vil);
+      phase = atan2(Vil, Vrl);
+    }
+
+    if (rfmode->nAmplitudeFilters) {
+      /* amplitude/phase feedback */
+
+      /* Calculate updated generator amplitude and phase
+           - Compute errors for voltage amplitude and phase
+           - Run these through the IIR filters
+           - Add to nominal generator amplitude and phase
+        */
+
+      IgAmp = sqrt(sqr(rfmode->Ig0->a[0][0]) + sqr(rfmode->Ig0->a[1][0])) + applyIIRFilter(rfmode->amplitudeFilter, rfmode->nAmplitudeFilters,
+                                                                                           rfmode->lambdaA * (rfmode->voltageSetpoint + rfmode->setpointAdjustment - V));
+      IgPhase = atan2(rfmode->Ig0->a[1][0], rfmode->Ig0->a[0][0]) + applyIIRFilter(rfmode->phaseFilter, rfmode->nPhaseFilters, PI / 180 * rfmode->phaseSetpoint - 3 * PI / 2 - phase);
+
+      if (rfmode->muteGenerator >= 0 && rfmode->muteGenerator <= pass) {
+        if (rfmode->muteGenerator == pass) {
+          printf("Generator muted for RFMODE %s on pass %ld\n", element_name, pass);
+          fflush(stdout);
+        }
+        IgAmp = 0;
+      }
+      IgAmp *= rfmode->generatorFactor;
+
+      /* Calculate updated I/Q components for generator current */
+      rfmode->Iiq->a[0][0] = IgAmp * cos(IgPhase);
+      rfmode->Iiq->a[1][0] = IgAmp * sin(IgPhase);
+    } else {
+      /* I/Q feedback */
+      double VISetpoint, VQSetpoint; /* equivalent in-phase and quadrature setpoints */
+      double phaseg;
+      double dII, dIQ;
+
+      /* convert from V*sin(phi) to V*cos(phi) convention and account for fact that the
+         * feedback is performed in the nominally empty part of each bucket (i.e., 180 degrees before 
+         * the nominal beam phase)
+         */
+      phaseg = PI / 180 * rfmode->phaseSetpoint - 3 * PI / 2;
+      VISetpoint = (rfmode->voltageSetpoint + rfmode->setpointAdjustment) * cos(phaseg);
+      VQSetpoint = (rfmode->voltageSetpoint + rfmode->setpointAdjustment) * sin(phaseg);
+
+      rfmode->Iiq->a[0][0] = rfmode->Ig0->a[0][0] + (dII = applyIIRFilter(rfmode->IFilter, rfmode->nIFilters, rfmode->lambdaA * (VISetpoint - VI)));
+      rfmode->Iiq->a[1][0] = rfmode->Ig0->a[1][0] + (dIQ = applyIIRFilter(rfmode->QFilter, rfmode->nQFilters, rfmode->lambdaA * (VQSetpoint - VQ)));
+
+      if (rfmode->muteGenerator >= 0 && rfmode->muteGenerator <= pass) {
+        if (rfmode->muteGenerator == pass) {
+          printf("Generator muted for RFMODE %s on pass %ld\n", element_name, pass);
+          fflush(stdout);
+        }
+        rfmode->Iiq->a[0][0] = rfmode->Iiq->a[1][0] = 0;
+      }
+
+#ifdef DEBUG
+      printf("dII = %le, dIQ = %le\n", dII, dIQ);
+#endif
+      IgAmp = sqrt(sqr(rfmode->Iiq->a[0][0]) + sqr(rfmode->Iiq->a[1][0]));
+      IgPhase = atan2(rfmode->Iiq->a[1][0], rfmode->Iiq->a[0][0]);
+    }
+
+    /* Parametric generator noise */
+    if (rfmode->nNoise[I_NOISE_ALPHA_GEN] || rfmode->nNoise[I_NOISE_PHI_GEN]) {
+      if (rfmode->nNoise[I_NOISE_ALPHA_GEN]) {
+        /* amplitude */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_ALPHA_GEN], rfmode->nNoise[I_NOISE_ALPHA_GEN], rfmode->fbLastTickTime);
+        IgAmp *= 1 + linear_interpolation(rfmode->fNoise[I_NOISE_ALPHA_GEN], rfmode->tNoise[I_NOISE_ALPHA_GEN], rfmode->nNoise[I_NOISE_ALPHA_GEN], rfmode->fbLastTickTime, ib);
+      }
+      if (rfmode->nNoise[I_NOISE_PHI_GEN]) {
+        /* phase */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_PHI_GEN], rfmode->nNoise[I_NOISE_PHI_GEN], rfmode->fbLastTickTime);
+        IgPhase += linear_interpolation(rfmode->fNoise[I_NOISE_PHI_GEN], rfmode->tNoise[I_NOISE_PHI_GEN], rfmode->nNoise[I_NOISE_PHI_GEN], rfmode->fbLastTickTime, ib);
+      }
+      /* Calculate updated I/Q components for generator current */
+      rfmode->Iiq->a[0][0] = IgAmp * cos(IgPhase);
+      rfmode->Iiq->a[1][0] = IgAmp * sin(IgPhase);
+    }
+    if (rfmode->nNoise[I_NOISE_I_GEN] || rfmode->nNoise[I_NOISE_Q_GEN]) {
+      /* Additive generator noise */
+      if (rfmode->nNoise[I_NOISE_I_GEN]) {
+        /* In-phase */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_I_GEN], rfmode->nNoise[I_NOISE_I_GEN], rfmode->fbLastTickTime);
+        rfmode->Iiq->a[0][0] += linear_interpolation(rfmode->fNoise[I_NOISE_I_GEN], rfmode->tNoise[I_NOISE_I_GEN], rfmode->nNoise[I_NOISE_I_GEN], rfmode->fbLastTickTime, ib);
+      }
+      if (rfmode->nNoise[I_NOISE_Q_GEN]) {
+        /* Quadrature */
+        ib = find_nearby_array_entry(rfmode->tNoise[I_NOISE_Q_GEN], rfmode->nNoise[I_NOISE_Q_GEN], rfmode->fbLastTickTime);
+        rfmode->Iiq->a[1][0] += linear_interpolation(rfmode->fNoise[I_NOISE_Q_GEN], rfmode->tNoise[I_NOISE_Q_GEN], rfmode->nNoise[I_NOISE_Q_GEN], rfmode->fbLastTickTime, ib);
+      }
+      IgAmp = sqrt(sqr(rfmode->Iiq->a[0][0]) + sqr(rfmode->Iiq->a[1][0]));
+      IgPhase = atan2(rfmode->Iiq->a[1][0], rfmode->Iiq->a[0][0]);
+    }
+
+    if (rfmode->driveFrequency && rfmode->feedbackRecordFile) {
+#if USE_MPI
+      if (myid == 1) {
+#endif
+        if ((rfmode->fbSample + 1) % rfmode->flush_interval == 0) {
+          elementProfilerStartCollective(PROFILE_OUTPUT);
+          if (!SDDS_UpdatePage(rfmode->SDDSfbrec, FLUSH_TABLE)) {
+            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+            SDDS_Bomb((char *)"problem flushing RFMODE feedback record file");
+          }
+          elementProfilerEndCollective(PROFILE_OUTPUT);
+        }
+        if (!SDDS_SetRowValues(rfmode->SDDSfbrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
+                               rfmode->fbSample,
+                               (char *)"Pass", pass, (char *)"t", rfmode->fbLastTickTime,
+                               (char *)"fResonance", rfmode->freq,
+                               (char *)"fDrive", rfmode->driveFrequency,
+                               (char *)"VbReal", Vbr, (char *)"VbImag", Vbi,
+                               (char *)"VgReal", Vgr, (char *)"VgImag", Vgi,
+                               (char *)"VCavity", V, (char *)"PhaseCavity", phase,
+                               (char *)"IgAmplitude", IgAmp,
+                               (char *)"IgPhase", IgPhase,
+                               NULL)) {
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          SDDS_Bomb((char *)"problem setting values for feedback record file");
+        }
+        /*
+            if ((rfmode->fbSample%1000==0 || (pass==(n_passes-1) && iBucket==(nBuckets-1)))
+            && !SDDS_UpdatePage(rfmode->SDDSfbrec, FLUSH_TABLE)) {
+            SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+            printf("Warning: problem writing data for RFMODE feedback record file, row %ld\n", rfmode->fbSample);
+            }
+          */
+        rfmode->fbSample++;
+#if USE_MPI
+      }
+#endif
+    }
+
+    /*
+        if (isnan(rfmode->Iiq->a[0][0]) || isnan(rfmode->Iiq->a[1][0]) || isinf(rfmode->Iiq->a[0][0]) || isinf(rfmode->Iiq->a[1][0])) {
+        printf("V = %le, setpoint = %le\n", V, rfmode->voltageSetpoint);
+        printf("phase = %le, setpoints = %le\n", phase, rfmode->phaseg);
+        printf("Viq = %le, %le\n", rfmode->Viq->a[0][0], rfmode->Viq->a[1][0]);
+        printf("Iiq = %le, %le\n", rfmode->Iiq->a[0][0], rfmode->Iiq->a[1][0]);
+        exit(1);
+        }
+      */
+#ifdef DEBUG
+    printf("After tick: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15le s, tNext=%21.15le\n",
+           sqrt(Vbr * Vbr + Vbi * Vbi), Vbr, Vbi, atan2(Vbi, Vbr), rfmode->fbLastTickTime, rfmode->fbNextTickTime);
+#endif
+  } /* end while loop for feedback ticks */
+}
+
+/* Finds the frequency, Q, and related quantities of one mode for the bucket with mean time tmean */
+static void setRfModeBucketParameters(RFMODE_BUCKET *mode, double tmean, double tmin, double dt, long pass) {
+  RFMODE *rfmode = mode->rfmode;
+  long ib, deltaPass;
+  double Qrp;
+
+  mode->V_sum = mode->Vr_sum = mode->Vi_sum = mode->Q_sum = mode->Vg_sum = mode->Vgr_sum = mode->Vgi_sum = mode->Vci_sum = mode->Vcr_sum = mode->Vc_sum = 0;
+  mode->n_summed = mode->max_hist = mode->n_occupied = 0;
+  mode->omega = mode->Q = 0;
+
+  if (isSlave) {
+    /* find frequency and Q at this time */
+    mode->omega = PIx2 * rfmode->freq;
+    if (rfmode->nFreq) {
+      double omegaFactor;
+      ib = find_nearby_array_entry(rfmode->tFreq, rfmode->nFreq, tmean);
+      mode->omega *= (omegaFactor = linear_interpolation(rfmode->fFreq, rfmode->tFreq, rfmode->nFreq, tmean, ib));
+      /* keeps stored energy constant for constant R/Q */
+      rfmode->V *= sqrt(omegaFactor);
+    }
+    mode->Q = rfmode->Q / (1 + rfmode->beta);
+    if (rfmode->nQ) {
+      ib = find_nearby_array_entry(rfmode->tQ, rfmode->nQ, tmean);
+      mode->Q *= linear_interpolation(rfmode->fQ, rfmode->tQ, rfmode->nQ, tmean, ib);
+    }
+  }
+#if (!USE_MPI)
+  if (mode->Q < 0.5) {
+    printf((char *)"The effective Q<=0.5 for RFMODE.  Use the ZLONGIT element.\n");
+    fflush(stdout);
+    exitElegant(1);
+  }
+#else
+  if (myid == 1) { /* Let the first slave processor write the output */
+    if (mode->Q < 0.5) {
+      dup2(fdStdout, fileno(stdout));
+      printf((char *)"The effective Q<=0.5 for RFMODE.  Use the ZLONGIT element.\n");
+      fflush(stdout);
+      freopen("/dev/null", "w", stdout);
+      MPI_Abort(MPI_COMM_WORLD, T_RFMODE);
+    }
+  }
+#endif
+  mode->tau = 2 * mode->Q / mode->omega;
+  mode->k = mode->omega / 4 * (rfmode->RaInternal) / rfmode->Q;
+  if ((deltaPass = (pass - rfmode->detuned_until_pass)) <= (rfmode->rampPasses - 1))
+    mode->k *= (deltaPass + 1.0) / rfmode->rampPasses;
+
+  /* These adjustments per Zotter and Kheifets, 3.2.4 */
+  Qrp = sqrt(mode->Q * mode->Q - 0.25);
+  mode->VbImagFactor = 1 / (2 * Qrp);
+  mode->omega *= Qrp / mode->Q;
+
+  if (rfmode->single_pass) {
+    rfmode->V = rfmode->last_phase = 0;
+    rfmode->last_t = tmin + 0.5 * dt;
+  }
+}
+
+/* Advances one mode through the bins of the current bucket, adding the voltage it produces in
+ * each bin (times the number of cavities) to Vbin. Returns 0 if the mode doesn't yet affect the beam.
+ */
+static long addRfModeBinVoltages(RFMODE_BUCKET *mode, long *Ihist, double *Vbin, long firstBin, long lastBin,
+                                 double tmin, double dt, double tmean, long pass) {
+  RFMODE *rfmode = mode->rfmode;
+  long ib, kicking;
+  double t, V, Vb, Vbin1, phase, damping_factor;
+
+  /* These values are fixed and can be used to compute the effect on the beam of
+   * the "long-range" fields (previous turns) only
+   */
+  mode->VPrevious = rfmode->V;
+  mode->tPrevious = rfmode->last_t;
+  mode->phasePrevious = rfmode->last_phase;
+#ifdef DEBUG
+  printf("VPrevious = %le, tPrevious = %le, phasePrevious = %le, firstBin = %ld, lastBin = %ld\n",
+         mode->VPrevious, mode->tPrevious, mode->phasePrevious, firstBin, lastBin);
+#endif
+
+  if (rfmode->driveFrequency > 0) {
+    /* compute generator voltage I and Q envelopes at bunch center */
+    fillBerencABMatrices(rfmode->At, rfmode->Bt, rfmode, tmean - rfmode->fbLastTickTime);
+    m_mult(rfmode->Mt1, rfmode->At, rfmode->Viq);
+    m_mult(rfmode->Mt2, rfmode->Bt, rfmode->Iiq);
+    m_add(rfmode->Mt3, rfmode->Mt1, rfmode->Mt2);
+  }
+
+  kicking = rfmode->rigid_until_pass <= pass;
+  for (ib = firstBin; ib <= lastBin; ib++) {
+    t = tmin + (ib + 0.5) * dt; /* middle arrival time for this bin */
+    if (!Ihist[ib] && !rfmode->interpolate)
+      continue;
+    if (Ihist[ib] > mode->max_hist)
+      mode->max_hist = Ihist[ib];
+    if (Ihist[ib])
+      mode->n_occupied++;
+
+      /* advance cavity to this time */
+#ifdef DEBUG
+    printf("Advancing beamloading from %21.15le to %21.15le, dt=%le, tau=%le, last_phase=%le\n",
+           rfmode->last_t, t, t - rfmode->last_t, mode->tau, rfmode->last_phase);
+    printf("Before: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les\n",
+           rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t);
+#endif
+    phase = rfmode->last_phase + mode->omega * (t - rfmode->last_t);
+    damping_factor = exp(-(t - rfmode->last_t) / mode->tau);
+    rfmode->last_t = t;
+    rfmode->last_phase = phase;
+    rfmode->V = V = rfmode->V * damping_factor;
+    rfmode->Vr = V * cos(phase);
+    rfmode->Vi = V * sin(phase);
+#ifdef DEBUG
+    printf("After: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les, tau=%le, DF=%le\n",
+           rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t, mode->tau, damping_factor);
+#endif
+
+    /* compute beam-induced voltage for this bin */
+    Vb = 2 * mode->k * rfmode->mp_charge * particleRelSign * rfmode->pass_interval * Ihist[ib];
+    if (rfmode->long_range_only)
+      Vbin1 = mode->VPrevious * (damping_factor = exp(-(t - mode->tPrevious) / mode->tau)) * cos(mode->phasePrevious + mode->omega * (t - mode->tPrevious));
+    else
+      Vbin1 = rfmode->Vr - Vb / 2;
+
+    if (rfmode->driveFrequency > 0) {
+      /* add generator-induced voltage */
+      double Vr, Vi, dt;
+      dt = t - rfmode->tGenerator;
+      mode->Vg_sum += Ihist[ib] * sqrt(sqr(rfmode->Mt3->a[0][0]) + sqr(rfmode->Mt3->a[1][0]));
+      Vr = rfmode->Mt3->a[0][0] * cos(PIx2 * rfmode->driveFrequency * dt) - rfmode->Mt3->a[1][0] * sin(PIx2 * rfmode->driveFrequency * dt);
+      Vi = rfmode->Mt3->a[0][0] * sin(PIx2 * rfmode->driveFrequency * dt) + rfmode->Mt3->a[1][0] * cos(PIx2 * rfmode->driveFrequency * dt);
+      Vbin1 += Vr;
+      mode->Vgi_sum += Ihist[ib] * Vi;
+      mode->Vgr_sum += Ihist[ib] * Vr;
+      mode->Vcr_sum += Ihist[ib] * (Vr + rfmode->Vr - Vb / 2);
+      mode->Vci_sum += Ihist[ib] * (Vi + rfmode->Vi - Vb * mode->VbImagFactor / 2);
+      mode->Vc_sum += Ihist[ib] * sqrt(sqr(Vr + rfmode->Vr - Vb / 2) + sqr(Vi + rfmode->Vi - Vb * mode->VbImagFactor / 2));
+    }
+    if (kicking)
+      Vbin[ib] += rfmode->n_cavities * Vbin1;
+
+    /* add slice contribution to beam-induced voltage */
+    rfmode->Vr -= Vb;
+    rfmode->Vi -= Vb * mode->VbImagFactor;
+    rfmode->last_phase = atan2(rfmode->Vi, rfmode->Vr);
+    rfmode->V = sqrt(sqr(rfmode->Vr) + sqr(rfmode->Vi));
+#ifdef DEBUG
+    printf("BL+: Vb = %le V, Vbr = %le, Vbi = %le, phase = %21.15le, t=%21.15les, tau=%le, DF=%le\n",
+           rfmode->V, rfmode->Vr, rfmode->Vi, fmod(rfmode->last_phase, PIx2), rfmode->last_t, mode->tau, damping_factor);
+#endif
+
+    mode->V_sum += Ihist[ib] * rfmode->V;
+    mode->Vr_sum += Ihist[ib] * rfmode->Vr;
+    mode->Vi_sum += Ihist[ib] * rfmode->Vi;
+    mode->Q_sum += Ihist[ib] * rfmode->mp_charge * particleRelSign;
+    mode->n_summed += Ihist[ib];
+  }
+  return kicking;
+}
+
+/* Writes the record file row for one mode and bucket, and adjusts the voltage setpoint if requested */
+static void recordRfModeBucket(RFMODE_BUCKET *mode, long pass, long jBucket, long np, long n_binned) {
+  RFMODE *rfmode = mode->rfmode;
+  long adjusting, outputing, np_total, n_summed, n_occupied;
+  double V_sum, Vr_sum, Vi_sum, Vg_sum, Vgr_sum, Vgi_sum, Vci_sum, Vcr_sum, Vc_sum;
+
+  adjusting = (rfmode->adjustmentFraction > 0 && pass >= rfmode->adjustmentStart && pass <= rfmode->adjustmentEnd &&
+               rfmode->adjustmentInterval > 0 && pass % rfmode->adjustmentInterval == 0 && jBucket == 0);
+  if (adjusting && pass == rfmode->adjustmentStart)
+    rfmode->setpointAdjustment = 0;
+  outputing = (rfmode->record && (pass % rfmode->sample_interval) == 0);
+  if (!outputing && !adjusting)
+    return;
+
+  V_sum = mode->V_sum;
+  Vr_sum = mode->Vr_sum;
+  Vi_sum = mode->Vi_sum;
+  Vg_sum = mode->Vg_sum;
+  Vgr_sum = mode->Vgr_sum;
+  Vgi_sum = mode->Vgi_sum;
+  Vci_sum = mode->Vci_sum;
+  Vcr_sum = mode->Vcr_sum;
+  Vc_sum = mode->Vc_sum;
+  n_summed = mode->n_summed;
+  n_occupied = mode->n_occupied;
+
+#if USE_MPI
+#  define SR_BUFLEN 17
+  double sendBuffer[SR_BUFLEN], receiveBuffer[SR_BUFLEN];
+#endif
+
+#if USE_MPI
+  if (myid == 0)
+#endif
+    if (outputing) {
+      elementProfilerStartCollective(PROFILE_OUTPUT);
+      if (!SDDS_UpdatePage(rfmode->SDDSrec, FLUSH_TABLE)) {
+        SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+        SDDS_Bomb((char *)"problem flushing RFMODE record file");
+      }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
+    }
+
+  np_total = np; /* Used by serial version */
+#if (USE_MPI)
+  /* Sum data across all cores */
+  if (myid == 0) {
+    memset(sendBuffer, 0, sizeof(sendBuffer[0]) * SR_BUFLEN);
+  } else {
+    sendBuffer[0] = n_binned;
+    sendBuffer[1] = rfmode->V;
+    sendBuffer[2] = rfmode->last_phase;
+    sendBuffer[3] = rfmode->last_t;
+    sendBuffer[4] = V_sum;
+    sendBuffer[5] = Vr_sum;
+    sendBuffer[6] = Vi_sum;
+    sendBuffer[7] = np;
+    sendBuffer[8] = Vgr_sum;
+    sendBuffer[9] = Vgi_sum;
+    sendBuffer[10] = Vcr_sum;
+    sendBuffer[11] = Vci_sum;
+    sendBuffer[12] = n_occupied;
+    sendBuffer[13] = n_summed;
+    sendBuffer[14] = Vg_sum;
+    sendBuffer[15] = rfmode->fbVCavity;
+    sendBuffer[16] = Vc_sum;
+  }
+  if (adjusting) {
+    MPI_Allreduce(sendBuffer, receiveBuffer, SR_BUFLEN, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  } else
+    MPI_Reduce(sendBuffer, receiveBuffer, SR_BUFLEN, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (adjusting || (myid == 0)) {
+    n_binned = receiveBuffer[0];
+    if (myid == 0) {
+      rfmode->fbVCavity = receiveBuffer[15] / (n_processors - 1);
+      rfmode->V = receiveBuffer[1] / (n_processors - 1);
+      rfmode->last_phase = receiveBuffer[2] / (n_processors - 1);
+      rfmode->last_t = receiveBuffer[3] / (n_processors - 1);
+    }
+    V_sum = receiveBuffer[4];
+    Vr_sum = receiveBuffer[5];
+    Vi_sum = receiveBuffer[6];
+    np_total = receiveBuffer[7];
+    Vgr_sum = receiveBuffer[8];
+    Vgi_sum = receiveBuffer[9];
+    Vcr_sum = receiveBuffer[10];
+    Vci_sum = receiveBuffer[11];
+    Vc_sum = receiveBuffer[16];
+    n_occupied = receiveBuffer[12];
+    n_summed = receiveBuffer[13];
+    Vg_sum = receiveBuffer[14];
+  }
+  if (myid == 0) {
+#endif
+#ifdef DEBUG
+    printf("Writing record file\n");
+    fflush(stdout);
+#endif
+    if (!SDDS_SetRowValues(rfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
+                           rfmode->sample_counter++,
+                           (char *)"Bunch", jBucket, (char *)"Pass", pass, (char *)"NumberOccupied", n_occupied,
+                           (char *)"FractionBinned", np_total ? (1.0 * n_binned) / np_total : 0.0,
+                           (char *)"VPostBeam", rfmode->V,
+                           (char *)"PhasePostBeam", rfmode->last_phase,
+                           (char *)"tPostBeam", rfmode->last_t,
+                           (char *)"V", n_summed ? V_sum / n_summed : 0.0,
+                           (char *)"VReal", n_summed ? Vr_sum / n_summed : 0.0,
+                           (char *)"Phase", n_summed ? atan2(Vi_sum / n_summed, Vr_sum / n_summed) : 0.0,
+                           (char *)"Charge", rfmode->mp_charge * np_total,
+                           NULL) ||
+        (rfmode->driveFrequency > 0 &&
+         !SDDS_SetRowValues(rfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
+                            rfmode->sample_counter - 1,
+                            (char *)"VGenerator", n_summed ? Vg_sum / n_summed : 0.0,
+                            (char *)"PhaseGenerator", n_summed ? atan2(Vgi_sum / n_summed, Vgr_sum / n_summed) : 0.0,
+                            (char *)"VCavity", n_summed ? Vc_sum / n_summed : 0.0,
+                            (char *)"PhaseCavity", n_summed ? atan2(Vci_sum / n_summed, Vcr_sum / n_summed) : 0.0,
+                            NULL))) {
+      SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+      printWarningForTracking((char *)"Problem setting up data for RFMODE record file", NULL);
+    }
+    /*
+        if (rfmode->sample_counter%100==0 && !SDDS_UpdatePage(rfmode->SDDSrec, 0)) {
+          SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
+          printf("Warning: problem writing data for RFMODE record file, row %ld\n", rfmode->sample_counter);
+        }
+        */
+#ifdef DEBUG
+    printf("Done writing record file\n");
+    fflush(stdout);
+#endif
+#if USE_MPI
+  }
+#endif
+  if (adjusting) {
+    /* adjust the voltage setpoint to get the voltage we really want */
+    double VcEffective;
+    VcEffective = n_summed ? Vc_sum / n_summed : 0.0;
+    rfmode->setpointAdjustment += (rfmode->voltageSetpoint - VcEffective) * rfmode->adjustmentFraction;
+    printf("Voltage setpoint adjustment changed to %le V on pass %ld\n", rfmode->setpointAdjustment, pass);
+    fflush(stdout);
+  }
+}
+
 void set_up_rfmode(RFMODE *rfmode, char *element_name, double element_z, long n_passes,
                    RUN *run, long n_particles,
                    double Po, double total_length) {
@@ -1455,7 +1543,7 @@ void runBinlessRfMode(
       tmean += tData[ip].t;
     }
   }
-  qsort(tData, np, sizeof(*tData), compTimeData);
+  sortTimeData(tData, np, &rfmode->timeOrder, &rfmode->nTimeOrder);
 
 #if USE_MPI
   if (notSinglePart) {
@@ -1553,6 +1641,7 @@ void runBinlessRfMode(
       SDDS_Bomb((char *)"problem starting page for RFMODE record file");
     }
     if ((pass % rfmode->sample_interval) == 0) {
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if (!SDDS_SetRowValues(rfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
                              (pass / rfmode->sample_interval),
                              (char *)"Pass", pass, (char *)"NumberOccupied", n_occupied,
@@ -1567,6 +1656,7 @@ void runBinlessRfMode(
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         SDDS_Bomb((char *)"problem setting up data for RFMODE record file");
       }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
     }
     if (pass == n_passes - 1) {
       free(rfmode->SDDSrec);
@@ -37,7 +37,7 @@ long sample_particles(double **initial, SAMPLE *samp, long np, double **accepted
     }
   } else if (samp->fraction != 1) {
     for (ip = 0; ip < np; ip++) {
-      if (random_2(1) > samp->fraction) {
+      if (random_2_elegant(1) > samp->fraction) {
         swapParticles(initial[ip], initial[itop]);
         if (accepted)
           swapParticles(accepted[ip], accepted[itop]);
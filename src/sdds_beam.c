@@ -336,7 +336,7 @@ long new_sdds_beam(
             fflush(stdout);
             exitElegant(1);
           }
-          if (sample_fraction != 1 && random_4(1) > sample_fraction)
+          if (sample_fraction != 1 && random_4_elegant(1) > sample_fraction)
             continue;
           pti = beam->original[i];
           pz = pti[ISC_PZ];
@@ -349,7 +349,7 @@ long new_sdds_beam(
           r = pti[ISC_R];
           path = (t_offset + pti[ISC_T]) * c_mks * (beta = p / gamma);
           delta = (p - p_central) / p_central;
-          theta = PIx2 * random_4(1);
+          theta = PIx2 * random_4_elegant(1);
           for (j = 0; j < n_particles_per_ring; j++, i_store++) {
             sin_theta = sin(theta);
             cos_theta = cos(theta);
@@ -406,7 +406,7 @@ long new_sdds_beam(
         if (!beam->particle)
           bombElegant("beam->particle array is NULL (new_sdds_beam)", NULL);
         for (i = i_store = 0; i < beam->n_original; i_store++, i += sample_interval) {
-          if (sample_fraction != 1 && random_4(1) > sample_fraction) {
+          if (sample_fraction != 1 && random_4_elegant(1) > sample_fraction) {
             i_store--;
             continue;
           }
@@ -781,7 +781,7 @@ void dump_watch_particles(WATCH *watch, long step, long pass, double **particle,
       if (!((watch->startPID < 0 && watch->endPID < 0) || (particle[i][6] >= watch->startPID && particle[i][6] <= watch->endPID)))
         continue;
       count++;
-      if (watch->fraction == 1 || random_2(0) < watch->fraction) {
+      if (watch->fraction == 1 || random_2_elegant(0) < watch->fraction) {
         if (watch->xData &&
             !SDDS_SetRowValues(watch->SDDS_table, SDDS_SET_BY_INDEX | SDDS_PASS_BY_VALUE, row,
                                watch->xIndex[0], particle[i][0],
@@ -852,6 +852,7 @@ void dump_watch_particles(WATCH *watch, long step, long pass, double **particle,
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
 #if SDDS_MPI_IO
   if ((watch->useDisconnect) && (!SDDS_ReconnectFile(watch->SDDS_table)))
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
@@ -868,6 +869,7 @@ void dump_watch_particles(WATCH *watch, long step, long pass, double **particle,
     }
   if (!inhibitFileSync)
     SDDS_DoFSync(watch->SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
   if ((watch->useDisconnect) && (!SDDS_DisconnectFile(watch->SDDS_table)))
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   if (!SDDS_ShortenTable(watch->SDDS_table, 1)) {
@@ -1170,6 +1172,7 @@ void dump_watch_parameters(WATCH *watch, long step, long pass, long n_passes, do
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
 
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (sample == (n_passes - 1) / watch->interval) {
       if (watch->flushInterval > 0) {
         if (sample != watch->flushSample && !SDDS_UpdatePage(watch->SDDS_table, 0)) {
@@ -1188,6 +1191,7 @@ void dump_watch_parameters(WATCH *watch, long step, long pass, long n_passes, do
       }
       watch->flushSample = sample;
     }
+    elementProfilerEndCollective(PROFILE_OUTPUT);
 #ifdef USE_MPE
     MPE_Log_event(event1a, 0, "start watch"); /* record time spent on I/O operations */
 #endif
@@ -1283,12 +1287,14 @@ void dump_watch_FFT(WATCH *watch, long step, long pass, long n_passes, double **
       SDDS_SetError("Problem setting parameter values for SDDS table (dump_watch_FFT)");
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WriteTable(watch->SDDS_table)) {
       SDDS_SetError("Problem writing data to SDDS file (dump_watch_FFT)");
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
     if (!inhibitFileSync)
       SDDS_DoFSync(watch->SDDS_table);
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
   log_exit("dump_watch_FFT");
 }
@@ -1421,6 +1427,7 @@ void dump_particle_histogram(HISTOGRAM *histogram, long step, long pass, double
   }
 
   t0 = pass * length * sqrt(Po * Po + 1) / (c_mks * (Po + 1e-32));
+  elementProfilerStartCollective(PROFILE_HISTOGRAM);
   for (icoord = 0; icoord < 7; icoord++) {
     upper = -(lower = DBL_MAX);
     if (histogram->columnIndex[icoord][0] == -1)
@@ -1507,6 +1514,7 @@ void dump_particle_histogram(HISTOGRAM *histogram, long step, long pass, double
       }
     }
   }
+  elementProfilerEndCollective(PROFILE_HISTOGRAM);
 
 #if SDDS_MPI_IO
   if (isMaster && nChosen_total)
@@ -1520,12 +1528,14 @@ void dump_particle_histogram(HISTOGRAM *histogram, long step, long pass, double
       SDDS_SetError("Problem setting SDDS parameters (dump_particle_histogram)");
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WriteTable(histogram->SDDS_table)) {
       SDDS_SetError("Problem writing SDDS table (dump_particle_histogram)");
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
     }
     if (!inhibitFileSync)
       SDDS_DoFSync(histogram->SDDS_table);
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
   histogram->count++;
 }
@@ -1600,6 +1610,7 @@ void dump_phase_space(SDDS_TABLE *SDDS_table, double **particle, long particles,
     SDDS_SetError("Problem setting SDDS parameters (dump_phase_space)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
+  elementProfilerStartCollective(PROFILE_OUTPUT);
 #if SDDS_MPI_IO
   if ((notSinglePart && !SDDS_MPI_WriteTable(SDDS_table)) || (!notSinglePart && !SDDS_WriteTable(SDDS_table)) || !SDDS_ShortenTable(SDDS_table, 1))
 #else
@@ -1611,6 +1622,7 @@ void dump_phase_space(SDDS_TABLE *SDDS_table, double **particle, long particles,
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 
   log_exit("dump_phase_space");
 }
@@ -1744,6 +1756,7 @@ void dump_lost_particles(SDDS_TABLE *SDDS_table, double *sLimit, double **partic
     SDDS_SetError("Problem setting SDDS parameters (dump_lost_particles)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
+  elementProfilerStartCollective(PROFILE_OUTPUT);
 #if SDDS_MPI_IO
   if (!SDDS_MPI_WriteTable(SDDS_table))
 #else
@@ -1755,6 +1768,7 @@ void dump_lost_particles(SDDS_TABLE *SDDS_table, double *sLimit, double **partic
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 
   log_exit("dump_lost_particles");
 #if USE_MPI && MPI_DEBUG
@@ -1882,12 +1896,14 @@ void dump_centroid(SDDS_TABLE *SDDS_table, BEAM_SUMS *sums, LINE_LIST *beamline,
       eptr = beamline->elem;
   }
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_WriteTable(SDDS_table)) {
     SDDS_SetError("Unable to write centroid data (dump_centroid)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
   if (!SDDS_EraseData(SDDS_table)) {
     SDDS_SetError("Unable to erase centroid data (dump_centroid)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
@@ -2055,12 +2071,14 @@ void dump_sigma(SDDS_TABLE *SDDS_table, BEAM_SUMS *sums, LINE_LIST *beamline, lo
       eptr = beamline->elem;
   }
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_WriteTable(SDDS_table)) {
     SDDS_SetError("Unable to write sigma data (dump_sigma 12)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
   if (!SDDS_EraseData(SDDS_table)) {
     SDDS_SetError("Unable to erase sigma data (dump_sigma 13)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
@@ -2145,6 +2163,7 @@ void dump_scattered_particles(SDDS_TABLE *SDDS_table, double **particle,
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
 
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_WriteTable(SDDS_table)) {
     SDDS_SetError("Problem writing SDDS table (dump_scattered_particles)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
@@ -2152,6 +2171,7 @@ void dump_scattered_particles(SDDS_TABLE *SDDS_table, double **particle,
 
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
   log_exit("dump_scattered_particles");
 }
 
@@ -2290,12 +2310,14 @@ void dump_scattered_loss_particles(SDDS_TABLE *SDDS_table, double **particleLos,
     SDDS_SetError("Problem setting SDDS parameters (dump_scattered_loss_particles)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_WriteTable(SDDS_table)) {
     SDDS_SetError("Problem writing SDDS table (dump_scattered_loss_particles)");
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
   }
   if (!inhibitFileSync)
     SDDS_DoFSync(SDDS_table);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 
 #ifdef DEBUG
   printf("Returning from dump_scattered_loss_particles\n");
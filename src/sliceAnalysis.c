@@ -541,8 +541,10 @@ void performSliceAnalysisOutput(SLICE_OUTPUT *sliceOutput, double **particle, lo
     rpn_store(sliceOutput->Ct[slice], NULL, sliceOutput->CtMemNum[slice]);
   }
   sliceOutput->rows += 1;
+  elementProfilerStartCollective(PROFILE_OUTPUT);
   if (!SDDS_UpdatePage(SDDSout, FLUSH_TABLE))
     SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
+  elementProfilerEndCollective(PROFILE_OUTPUT);
 }
 
 void performSliceAnalysis(SLICE_OUTPUT *sliceOutput, double **particle, long particles,
@@ -0,0 +1,347 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: stepWorkers.c
+ * purpose: run the steps of run_control (error seeds, varied values) on several
+ *          local processes, with output identical to a sequential run.
+ *
+ * With run_control n_step_workers=N>1, startStepWorkers() forks N-1 copies of the
+ * process just before the step loop, so each worker has its own copy of the beamline
+ * and of all other state. Every worker executes vary_beamline() for every step, which
+ * is cheap and keeps errors and varied values identical in all workers, but only
+ * worker (step mod N) does the rest of the step (correction, twiss, tracking, output).
+ * Since vary_beamline() reseeds all random number generators from the step number
+ * (see reseedStepRandomNumbers()), a step's results don't depend on which worker ran it.
+ *
+ * Output files are merged as follows. Each worker points the descriptor of every
+ * regular file open for writing at a private temporary file. At the start of the
+ * next step, commitStepWorkerOutput() waits until all earlier steps have been written,
+ * then appends the temporary files to the real files and truncates them. Workers share
+ * the file offsets of the real files (which were opened before forking), so pages
+ * appear in step order exactly as in a sequential run. Output from steps a worker
+ * doesn't own is discarded.
+ *
+ * Limitations: steps must be independent (e.g., corrector settings carried from one
+ * step to the next are not seen by other workers), files must be opened before the
+ * step loop, and compressed files or files updated in place (e.g., watch points with
+ * flush_interval) are not supported. Only worker 0 (the original process) writes to
+ * the terminal. vary_setup() insists that rf phase references are reset for every step,
+ * and startStepWorkers() refuses beamlines with elements that open output files during
+ * tracking (WATCH, HISTOGRAM, RFMODE records, etc.) and a fiducial first beam, since
+ * each worker would otherwise do these things on its own.
+ *
+ * If any worker exits before the end of the step loop or is killed, the others abort
+ * rather than wait for its steps.
+ */
+#include "mdb.h"
+#include "track.h"
+
+#if !USE_MPI && defined(__unix__)
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/wait.h>
+
+#  define STEP_WORKER_MAX_FD 65536
+
+typedef struct {
+  int fd;      /* descriptor used by the program */
+  int savedFd; /* duplicate of the real file's descriptor */
+  int tempFd;  /* private temporary file now behind fd */
+} REDIRECTED_FILE;
+
+/* shared[0] is the next step to be written, shared[1] is set if a worker failed, and
+ * shared[2+i] is set when worker i has stopped normally */
+#  define SHARED_NEXT_STEP 0
+#  define SHARED_FAILED 1
+#  define SHARED_STOPPED(i) (2 + (i))
+
+static long nWorkers = 0, workerIndex = 0;
+static long sequence = -1, committedSequence = -1, sequenceOwned = 0;
+static pid_t *workerPid = NULL;
+static short *workerReaped = NULL;
+static volatile long *shared = NULL;
+static REDIRECTED_FILE *redirected = NULL;
+static long nRedirected = 0;
+
+static void redirectOutputFiles(void) {
+  long i, maxFd, nCandidates;
+  int fd, flags, *candidate;
+  struct stat statbuf;
+  FILE *fp;
+
+  if ((maxFd = sysconf(_SC_OPEN_MAX)) <= 0 || maxFd > STEP_WORKER_MAX_FD)
+    maxFd = STEP_WORKER_MAX_FD;
+  /* find the candidates first, since creating the temporary files opens new descriptors */
+  candidate = tmalloc(sizeof(*candidate) * maxFd);
+  nCandidates = 0;
+  for (fd = 3; fd < maxFd; fd++) {
+    if ((flags = fcntl(fd, F_GETFL)) < 0 || (flags & O_ACCMODE) == O_RDONLY)
+      continue;
+    if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode))
+      continue;
+    candidate[nCandidates++] = fd;
+  }
+  redirected = tmalloc(sizeof(*redirected) * (nCandidates + 1));
+  nRedirected = 0;
+  for (i = 0; i < nCandidates; i++) {
+    if (!(fp = tmpfile()))
+      bombElegant("step workers: unable to create temporary file", NULL);
+    redirected[nRedirected].fd = candidate[i];
+    redirected[nRedirected].tempFd = fileno(fp);
+    if ((redirected[nRedirected].savedFd = dup(candidate[i])) < 0 ||
+        dup2(redirected[nRedirected].tempFd, candidate[i]) < 0)
+      bombElegant("step workers: unable to redirect output file", NULL);
+    nRedirected++;
+  }
+  free(candidate);
+}
+
+static void restoreOutputFiles(void) {
+  long i;
+  for (i = 0; i < nRedirected; i++) {
+    dup2(redirected[i].savedFd, redirected[i].fd);
+    close(redirected[i].savedFd);
+    close(redirected[i].tempFd);
+  }
+  if (redirected)
+    free(redirected);
+  redirected = NULL;
+  nRedirected = 0;
+}
+
+/* append (if keep is non-zero) and then discard the contents of the temporary files */
+static void transferOutput(long keep) {
+  long i;
+  ssize_t nRead, nWritten, offset;
+  char buffer[65536];
+
+  for (i = 0; i < nRedirected; i++) {
+    if (keep) {
+      lseek(redirected[i].tempFd, 0, SEEK_SET);
+      while ((nRead = read(redirected[i].tempFd, buffer, sizeof(buffer))) > 0) {
+        for (offset = 0; offset < nRead; offset += nWritten)
+          if ((nWritten = write(redirected[i].savedFd, buffer + offset, nRead - offset)) <= 0)
+            bombElegant("step workers: unable to write output file", NULL);
+      }
+    }
+    if (ftruncate(redirected[i].tempFd, 0) != 0)
+      bombElegant("step workers: unable to truncate temporary file", NULL);
+    lseek(redirected[i].tempFd, 0, SEEK_SET);
+  }
+}
+
+/* installed with atexit() in every worker: leaving the step loop other than through
+ * finishStepWorkers() (e.g., from bombElegant()) is a failure */
+static void stepWorkerExit(void) {
+  if (shared && !shared[SHARED_STOPPED(workerIndex)])
+    shared[SHARED_FAILED] = 1;
+}
+
+/* Returns non-zero if a worker has failed. Worker 0 reaps the others as they exit, and
+ * the others check that worker 0 is still their parent. */
+static long checkWorkers(void) {
+  long i;
+  int status;
+
+  if (workerIndex == 0) {
+    for (i = 1; i < nWorkers; i++) {
+      if (workerReaped[i] || waitpid(workerPid[i], &status, WNOHANG) != workerPid[i])
+        continue;
+      workerReaped[i] = 1;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !shared[SHARED_STOPPED(i)])
+        shared[SHARED_FAILED] = 1;
+    }
+  } else if (getppid() != workerPid[0])
+    shared[SHARED_FAILED] = 1;
+  return shared[SHARED_FAILED];
+}
+
+static void waitForTurn(long step) {
+  long next;
+  while ((next = shared[SHARED_NEXT_STEP]) < step) {
+    if (checkWorkers())
+      bombElegant("step workers: another worker failed", NULL);
+    /* steps of a worker that has stopped (e.g., at the end of an input beam file) are skipped */
+    if (shared[SHARED_STOPPED(next % nWorkers)])
+      __sync_bool_compare_and_swap(shared + SHARED_NEXT_STEP, next, next + 1);
+    else
+      usleep(1000);
+  }
+}
+
+/* names of string parameters that give files written during tracking */
+static char *trackingOutputParameter[] = {
+  "RECORD", "FEEDBACK_RECORD", "OUTPUT_FILE", "PARTICLE_OUTPUT_FILE", "PHOTON_OUTPUT_FILE",
+  "FIELD_OUTPUT", "SALDIN54_OUTPUT", "STUPAKOV_OUTPUT", "FILE1D", "FILE2DH", "FILE2DV",
+  "FILE2DL", "FILE4D", "FILE6D", NULL};
+
+/* Returns the name of a parameter of the element that gives an output file opened during
+ * tracking, or NULL if there is none. */
+static char *findTrackingOutputFile(ELEMENT_LIST *eptr) {
+  long i, j;
+  PARAMETER *parameter;
+  char *value;
+
+  parameter = entity_description[eptr->type].parameter;
+  for (i = 0; i < entity_description[eptr->type].n_params; i++) {
+    if (strcmp(parameter[i].name, "DISABLE") == 0 &&
+        ((parameter[i].type == IS_SHORT && *(short *)(eptr->p_elem + parameter[i].offset)) ||
+         (parameter[i].type == IS_LONG && *(long *)(eptr->p_elem + parameter[i].offset))))
+      return NULL;
+  }
+  for (i = 0; i < entity_description[eptr->type].n_params; i++) {
+    if (parameter[i].type != IS_STRING ||
+        !(value = *(char **)(eptr->p_elem + parameter[i].offset)) || !strlen(value))
+      continue;
+    if (strcmp(parameter[i].name, "FILENAME") == 0) {
+      switch (eptr->type) {
+      case T_WATCH:
+      case T_HISTOGRAM:
+      case T_SLICE_POINT:
+      case T_IBSCATTER:
+        return parameter[i].name;
+      default:
+        continue;
+      }
+    }
+    for (j = 0; trackingOutputParameter[j]; j++)
+      if (strcmp(parameter[i].name, trackingOutputParameter[j]) == 0)
+        return parameter[i].name;
+  }
+  return NULL;
+}
+
+void startStepWorkers(VARY *control, LINE_LIST *beamline, long firstBeamIsFiducial) {
+  static short exitHookInstalled = 0;
+  ELEMENT_LIST *eptr;
+  char *name;
+  long i;
+  pid_t pid;
+
+  sequence = committedSequence = -1;
+  sequenceOwned = 0;
+  if (control->stepWorkers < 2) {
+    nWorkers = 0;
+    return;
+  }
+  /* Files opened after forking would be created by every worker, and each worker would
+   * take its first beam as the fiducial beam. */
+  for (eptr = beamline->elem; eptr; eptr = eptr->succ) {
+    if ((name = findTrackingOutputFile(eptr)))
+      bombElegantVA("n_step_workers>1 can't be used with element %s, which writes to a file (%s) during tracking\n",
+                    eptr->name, name);
+  }
+  if (firstBeamIsFiducial)
+    bombElegant("n_step_workers>1 can't be used with first_is_fiducial=1", NULL);
+  nWorkers = control->stepWorkers;
+  workerIndex = 0;
+  fflush(NULL);
+  if ((shared = mmap(NULL, sizeof(*shared) * SHARED_STOPPED(nWorkers), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+    bombElegant("step workers: unable to create shared memory", NULL);
+  for (i = 0; i < SHARED_STOPPED(nWorkers); i++)
+    shared[i] = 0;
+  workerPid = tmalloc(sizeof(*workerPid) * nWorkers);
+  workerReaped = tmalloc(sizeof(*workerReaped) * nWorkers);
+  for (i = 0; i < nWorkers; i++)
+    workerReaped[i] = 0;
+  workerPid[0] = getpid();
+  if (!exitHookInstalled) {
+    atexit(stepWorkerExit);
+    exitHookInstalled = 1;
+  }
+  printf("Running steps on %ld local workers\n", nWorkers);
+  fflush(stdout);
+  for (i = 1; i < nWorkers; i++) {
+    if ((pid = fork()) < 0)
+      bombElegant("step workers: fork failed", NULL);
+    if (pid == 0) {
+      workerIndex = i;
+      if (!freopen("/dev/null", "w", stdout))
+        bombElegant("step workers: unable to redirect output", NULL);
+      break;
+    }
+    workerPid[i] = pid;
+  }
+  redirectOutputFiles();
+}
+
+/* called at the top of the step loop; returns non-zero if this worker should do the step */
+long stepWorkerOwnsStep() {
+  if (nWorkers < 2)
+    return 1;
+  sequence++;
+  return sequenceOwned = (sequence % nWorkers == workerIndex);
+}
+
+/* called when the next step begins (or the loop ends) to write out the output of the last one */
+void commitStepWorkerOutput() {
+  if (nWorkers < 2 || sequence < 0 || sequence == committedSequence)
+    return;
+  fflush(NULL);
+  if (checkWorkers())
+    bombElegant("step workers: another worker failed", NULL);
+  if (sequenceOwned) {
+    waitForTurn(sequence);
+    transferOutput(1);
+    __sync_bool_compare_and_swap(shared + SHARED_NEXT_STEP, sequence, sequence + 1);
+  } else
+    transferOutput(0);
+  committedSequence = sequence;
+}
+
+void finishStepWorkers() {
+  long i, nRunning;
+
+  if (nWorkers < 2)
+    return;
+  commitStepWorkerOutput();
+  shared[SHARED_STOPPED(workerIndex)] = 1;
+  if (workerIndex != 0) {
+    fflush(NULL);
+    _exit(0);
+  }
+  /* poll rather than block, so that a failure aborts workers waiting for the failed one's steps */
+  do {
+    checkWorkers();
+    for (i = 1, nRunning = 0; i < nWorkers; i++)
+      nRunning += !workerReaped[i];
+    if (nRunning)
+      usleep(1000);
+  } while (nRunning);
+  if (shared[SHARED_FAILED])
+    bombElegant("step workers: a worker process failed, so output from its steps is missing", NULL);
+  restoreOutputFiles();
+  munmap((void *)shared, sizeof(*shared) * SHARED_STOPPED(nWorkers));
+  shared = NULL;
+  free(workerPid);
+  free(workerReaped);
+  workerPid = NULL;
+  workerReaped = NULL;
+  nWorkers = 0;
+}
+
+#else
+
+void startStepWorkers(VARY *control, LINE_LIST *beamline, long firstBeamIsFiducial) {
+}
+
+long stepWorkerOwnsStep() {
+  return 1;
+}
+
+void commitStepWorkerOutput() {
+}
+
+void finishStepWorkers() {
+}
+
+#endif
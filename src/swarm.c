@@ -92,8 +92,8 @@ long swarmMin(
           gsl_matrix_set(coord_matrix, i, j, xGuess[j]);
         else {
           double value;
-          /* gsl_matrix_set (coord_matrix, i, j, xGuess[j]+xDiff*(random_2(0)-0.5)); */
-          value = xGuess[j] + stepSize[i] * (2 * random_2(0) - 1);
+          /* gsl_matrix_set (coord_matrix, i, j, xGuess[j]+xDiff*(random_2_elegant(0)-0.5)); */
+          value = xGuess[j] + stepSize[i] * (2 * random_2_elegant(0) - 1);
           if (value < xLow)
             value = xLow;
           if (value > xHigh)
@@ -109,7 +109,7 @@ long swarmMin(
     gsl_matrix_memcpy(tmp_coord_matrix, local_best_coord);
     gsl_matrix_sub(tmp_coord_matrix, coord_matrix);
     for (i = 0; i < local_populations; i++) {
-      local_rand = random_2(0) * phi_p;
+      local_rand = random_2_elegant(0) * phi_p;
       for (j = 0; j < dimensions; j++)
         gsl_matrix_set(tmp_coord_matrix, i, j, local_rand * gsl_matrix_get(tmp_coord_matrix, i, j));
     }
@@ -122,7 +122,7 @@ long swarmMin(
     gsl_matrix_sub(global_best_coord, coord_matrix);
     /* multiply this difference by a random value chosen for each particle */
     for (i = 0; i < local_populations; i++) {
-      local_rand = random_2(0) * phi_g;
+      local_rand = random_2_elegant(0) * phi_g;
       for (j = 0; j < dimensions; j++)
         gsl_matrix_set(global_best_coord, i, j, local_rand * gsl_matrix_get(global_best_coord, i, j));
     }
@@ -89,6 +89,7 @@ void transverseFeedbackPickup(TFBPICKUP *tfbp, double **part0, long np0, long pa
       tfbp->filterOutput[i] = 0;
     }
     tfbp->pass0 = pass;
+    restoreCheckpointElementState(tfbp);
   }
 
   for (iBucket = 0; iBucket < nBuckets; iBucket++) {
@@ -150,7 +151,7 @@ void transverseFeedbackPickup(TFBPICKUP *tfbp, double **part0, long np0, long pa
 
     if (tfbp->rmsNoise) {
       double dposition;
-      dposition = gauss_rn_lim(0.0, tfbp->rmsNoise, 2, random_3);
+      dposition = gauss_rn_lim_elegant(0.0, tfbp->rmsNoise, 2, random_3_elegant);
 #if USE_MPI
       MPI_Bcast(&dposition, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 #endif
@@ -319,6 +320,7 @@ void transverseFeedbackDriver(TFBDRIVER *tfbd, double **part0, long np0, LINE_LI
       tfbd->driverSignal[iBucket] = (double *)calloc((tfbd->delay + 1 + TFB_FILTER_LENGTH), sizeof(**tfbd->driverSignal));
     }
     tfbd->pass0 = pass;
+    restoreCheckpointElementState(tfbd);
   }
 
   if (tfbd->nBunches != tfbd->pickup->nBunches)
@@ -523,10 +525,12 @@ void transverseFeedbackDriver(TFBDRIVER *tfbd, double **part0, long np0, LINE_LI
           printf("Flushing output file\n");
           fflush(stdout);
 #endif
+          elementProfilerStartCollective(PROFILE_OUTPUT);
           if (!SDDS_UpdatePage(tfbd->SDDSout, FLUSH_TABLE)) {
             SDDS_PrintErrors(stdout, SDDS_VERBOSE_PrintErrors);
             SDDS_Bomb((char *)"problem flushing data for TFBDRIVER output file");
           }
+          elementProfilerEndCollective(PROFILE_OUTPUT);
           tfbd->dataWritten = 1;
         }
 #ifdef DEBUG
@@ -513,7 +513,7 @@ void TouschekDistribution(RUN *run, VARY *control, LINE_LIST *beamline) {
         for (j = 0; j < 11; j++) {
           ran1[j] = random_1_elegant(1);
         }
-        randomizeOrder((char *)ran1, sizeof(ran1[0]), 11, 0, random_4);
+        randomizeOrder((char *)ran1, sizeof(ran1[0]), 11, 0, random_4_elegant);
 
         total_event++;
         if (!tsSpec->distIn)
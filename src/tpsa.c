@@ -0,0 +1,1059 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: tpsa.c
+ * purpose: truncated power series algebra (TPSA) and one-turn maps of arbitrary order.
+ *
+ * A truncated power series in the six phase-space coordinates is stored as the array of
+ * its coefficients, one per monomial, with the monomials ordered by total degree. The
+ * coordinates are propagated through the beamline as power series, which gives the
+ * Taylor map to the requested order in one pass:
+ *   DRIF, EDRIFT           exact drift
+ *   KQUAD, KSEXT, KOCT     the kick-drift symplectic integrator of multipole.c, with the
+ *                          same integration order and number of slices
+ * Other elements (and the above elements with misalignments, tilts, steering, error
+ * multipoles, etc.) are applied using their transport matrices, so the map is exact only
+ * to the order of those matrices for them.
+ *
+ * makePolynomialMap() stores the map of a run of elements in the compact form tracked by
+ * trackPolynomialMap() (see particleSoA.c), for concatenated tracking with run_setup
+ * polynomial_map_order. Unless symplectify_polynomial_map=0, the truncated map is made
+ * symplectic with a generating function (see tpsaSymplecticMap()), so it can be used for
+ * long-term tracking. A map order above the order of the matrices used for any element
+ * in the run is rejected, since the map would not be accurate to that order.
+ *
+ * computeTpsaChromaticities() extracts the chromaticities to any order from the map,
+ * by solving for the off-momentum fixed point and expanding the traces of the linear
+ * transverse matrices about it in powers of delta. This replaces the fit to traces
+ * of matrices concatenated for several values of delta. Since the chromaticity of order n
+ * needs the map to order n+1, the order is reduced if any element (e.g., CSBEND) is
+ * included using a matrix of lower order.
+ */
+#include "mdb.h"
+#include "track.h"
+#include "chromDefs.h"
+
+/* Monomials of up to this many coefficients are supported; the product table is TPSA_MAX_MONOMIALS^2 */
+#define TPSA_MAX_MONOMIALS 2000
+#define TPSA_VARIABLES 6
+#define TPSA_MAX_MULTIPOLE_ORDER 3
+
+typedef struct {
+  long nv, order, nm;     /* variables, maximum order, number of monomials */
+  short *exponent;        /* exponent[nv*i+j] is the power of variable j in monomial i */
+  long *degree;           /* total degree of each monomial */
+  long *firstOfDegree;    /* index of the first monomial of each degree, with firstOfDegree[order+1]=nm */
+  unsigned long *key;     /* exponents as digits in base order+1, increasing within each degree */
+  unsigned long *power;   /* (order+1)^j */
+  long *unit;             /* index of the monomial for each variable */
+  int *product;           /* product[nm*i+j] is the index of the product of monomials i and j, or -1 */
+  long *parent, *parentVariable; /* monomial i is monomial parent[i] times variable parentVariable[i] */
+  double *work;
+} TPSA_DESCRIPTOR;
+
+static TPSA_DESCRIPTOR tpsa;
+
+/* Returns the index of the monomial with the given key and degree, or -1 */
+static long findMonomial(unsigned long key, long degree) {
+  long lo, hi, mid;
+  lo = tpsa.firstOfDegree[degree];
+  hi = tpsa.firstOfDegree[degree + 1] - 1;
+  while (lo <= hi) {
+    mid = (lo + hi) / 2;
+    if (tpsa.key[mid] == key)
+      return mid;
+    if (tpsa.key[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid - 1;
+  }
+  return -1;
+}
+
+static void freeTpsaDescriptor() {
+  if (tpsa.nm) {
+    free(tpsa.exponent);
+    free(tpsa.degree);
+    free(tpsa.firstOfDegree);
+    free(tpsa.key);
+    free(tpsa.power);
+    free(tpsa.unit);
+    free(tpsa.product);
+    free(tpsa.parent);
+    free(tpsa.parentVariable);
+    free(tpsa.work);
+  }
+  tpsa.nm = tpsa.nv = tpsa.order = 0;
+}
+
+/* Sets up the monomial tables for nv variables and the given order */
+static void initializeTpsa(long nv, long order) {
+  long i, j, d, nm, *count;
+  unsigned long key, nKeys, rest;
+
+  if (tpsa.nm && tpsa.nv == nv && tpsa.order == order)
+    return;
+  freeTpsaDescriptor();
+
+  /* number of monomials is (nv+order)!/(nv! order!) */
+  for (i = 1, nm = 1; i <= nv; i++)
+    nm = nm * (order + i) / i;
+  if (order < 1 || nm > TPSA_MAX_MONOMIALS)
+    bombElegantVA("TPSA order %ld is not supported for %ld variables", order, nv);
+
+  tpsa.nv = nv;
+  tpsa.order = order;
+  tpsa.nm = nm;
+  tpsa.exponent = tmalloc(sizeof(*tpsa.exponent) * nm * nv);
+  tpsa.degree = tmalloc(sizeof(*tpsa.degree) * nm);
+  tpsa.firstOfDegree = tmalloc(sizeof(*tpsa.firstOfDegree) * (order + 2));
+  tpsa.key = tmalloc(sizeof(*tpsa.key) * nm);
+  tpsa.power = tmalloc(sizeof(*tpsa.power) * nv);
+  tpsa.unit = tmalloc(sizeof(*tpsa.unit) * nv);
+  tpsa.parent = tmalloc(sizeof(*tpsa.parent) * nm);
+  tpsa.parentVariable = tmalloc(sizeof(*tpsa.parentVariable) * nm);
+  tpsa.work = tmalloc(sizeof(*tpsa.work) * nm);
+
+  /* The key of a monomial is its exponent vector as a number in base order+1. Keys add
+   * under multiplication (within the order), so products are found by searching for the
+   * sum of the keys. Monomials are sorted by degree, then by key.
+   */
+  for (j = 0; j < nv; j++)
+    tpsa.power[j] = j ? tpsa.power[j - 1] * (order + 1) : 1;
+  nKeys = tpsa.power[nv - 1] * (order + 1);
+  count = tmalloc(sizeof(*count) * (order + 2));
+  for (d = 0; d <= order + 1; d++)
+    count[d] = 0;
+  for (key = 0; key < nKeys; key++) {
+    for (j = d = 0, rest = key; j < nv; j++, rest /= order + 1)
+      d += rest % (order + 1);
+    if (d <= order)
+      count[d + 1]++;
+  }
+  tpsa.firstOfDegree[0] = 0;
+  for (d = 0; d <= order; d++)
+    tpsa.firstOfDegree[d + 1] = tpsa.firstOfDegree[d] + count[d + 1];
+  for (d = 0; d <= order; d++)
+    count[d] = tpsa.firstOfDegree[d];
+  for (key = 0; key < nKeys; key++) {
+    for (j = d = 0, rest = key; j < nv; j++, rest /= order + 1)
+      d += rest % (order + 1);
+    if (d > order)
+      continue;
+    i = count[d]++;
+    tpsa.key[i] = key;
+    tpsa.degree[i] = d;
+    for (j = 0, rest = key; j < nv; j++, rest /= order + 1)
+      tpsa.exponent[nv * i + j] = rest % (order + 1);
+  }
+  free(count);
+
+  for (j = 0; j < nv; j++)
+    tpsa.unit[j] = findMonomial(tpsa.power[j], 1);
+  tpsa.product = tmalloc(sizeof(*tpsa.product) * nm * nm);
+  for (i = 0; i < nm; i++)
+    for (j = 0; j < nm; j++)
+      tpsa.product[nm * i + j] = tpsa.degree[i] + tpsa.degree[j] > order ? -1 : findMonomial(tpsa.key[i] + tpsa.key[j], tpsa.degree[i] + tpsa.degree[j]);
+  tpsa.parent[0] = tpsa.parentVariable[0] = -1;
+  for (i = 1; i < nm; i++) {
+    for (j = 0; j < nv; j++)
+      if (tpsa.exponent[nv * i + j])
+        break;
+    tpsa.parentVariable[i] = j;
+    tpsa.parent[i] = findMonomial(tpsa.key[i] - tpsa.power[j], tpsa.degree[i] - 1);
+  }
+}
+
+static double *tpsaNew() {
+  return calloc(tpsa.nm, sizeof(double));
+}
+
+static void tpsaConstant(double *a, double value) {
+  memset(a, 0, sizeof(*a) * tpsa.nm);
+  a[0] = value;
+}
+
+static void tpsaVariable(double *a, double value, long iv) {
+  tpsaConstant(a, value);
+  a[tpsa.unit[iv]] = 1;
+}
+
+static void tpsaCopy(double *target, double *source) {
+  memcpy(target, source, sizeof(*target) * tpsa.nm);
+}
+
+/* r = a + f*b; r may be a or b */
+static void tpsaAddScaled(double *r, double *a, double f, double *b) {
+  long i;
+  for (i = 0; i < tpsa.nm; i++)
+    r[i] = a[i] + f * b[i];
+}
+
+static void tpsaScale(double *r, double *a, double f) {
+  long i;
+  for (i = 0; i < tpsa.nm; i++)
+    r[i] = f * a[i];
+}
+
+/* r = a*b; r may be a or b */
+static void tpsaMultiply(double *r, double *a, double *b) {
+  long i, j, jLimit, nm;
+  int *product;
+  double *work, ai;
+
+  nm = tpsa.nm;
+  work = tpsa.work;
+  memset(work, 0, sizeof(*work) * nm);
+  for (i = 0; i < nm; i++) {
+    if (!(ai = a[i]))
+      continue;
+    product = tpsa.product + nm * i;
+    jLimit = tpsa.firstOfDegree[tpsa.order - tpsa.degree[i] + 1];
+    for (j = 0; j < jLimit; j++)
+      work[product[j]] += ai * b[j];
+  }
+  memcpy(r, work, sizeof(*r) * nm);
+}
+
+/* Evaluates f(a) for a function given by its Taylor coefficients c[k]=f^(k)(a0)/k! about
+ * the constant part a0 of a, by Horner's rule in the nilpotent part; r may be a.
+ */
+static void tpsaApplySeries(double *r, double *a, double *c) {
+  double *g, *sum;
+  long k;
+  g = tpsaNew();
+  sum = tpsaNew();
+  tpsaCopy(g, a);
+  g[0] = 0;
+  tpsaConstant(sum, c[tpsa.order]);
+  for (k = tpsa.order - 1; k >= 0; k--) {
+    tpsaMultiply(sum, sum, g);
+    sum[0] += c[k];
+  }
+  tpsaCopy(r, sum);
+  free(g);
+  free(sum);
+}
+
+static void tpsaReciprocal(double *r, double *a) {
+  double c[TPSA_MAX_ORDER + 1];
+  long k;
+  if (a[0] == 0)
+    bombElegant("TPSA reciprocal of series with zero constant term", NULL);
+  c[0] = 1 / a[0];
+  for (k = 1; k <= tpsa.order; k++)
+    c[k] = -c[k - 1] / a[0];
+  tpsaApplySeries(r, a, c);
+}
+
+static void tpsaSqrt(double *r, double *a) {
+  double c[TPSA_MAX_ORDER + 1];
+  long k;
+  if (a[0] <= 0)
+    bombElegant("TPSA square root of series with non-positive constant term", NULL);
+  c[0] = sqrt(a[0]);
+  for (k = 1; k <= tpsa.order; k++)
+    c[k] = c[k - 1] * (1.5 - k) / (k * a[0]);
+  tpsaApplySeries(r, a, c);
+}
+
+static void tpsaSinCos(double *sinA, double *cosA, double *a) {
+  double cs[TPSA_MAX_ORDER + 1], cc[TPSA_MAX_ORDER + 1], s0, c0, factorial;
+  long k;
+  s0 = sin(a[0]);
+  c0 = cos(a[0]);
+  for (k = 0, factorial = 1; k <= tpsa.order; k++) {
+    if (k)
+      factorial *= k;
+    /* k-th derivatives of sin and cos cycle with period 4 */
+    switch (k % 4) {
+    case 0:
+      cs[k] = s0;
+      cc[k] = c0;
+      break;
+    case 1:
+      cs[k] = c0;
+      cc[k] = -s0;
+      break;
+    case 2:
+      cs[k] = -s0;
+      cc[k] = -c0;
+      break;
+    default:
+      cs[k] = -c0;
+      cc[k] = s0;
+      break;
+    }
+    cs[k] /= factorial;
+    cc[k] /= factorial;
+  }
+  tpsaApplySeries(cosA, a, cc);
+  tpsaApplySeries(sinA, a, cs);
+}
+
+/* r = d(a)/d(variable iv); r may not be a */
+static void tpsaDerivative(double *r, double *a, long iv) {
+  long j, p, nm;
+  nm = tpsa.nm;
+  memset(r, 0, sizeof(*r) * nm);
+  for (j = 0; j < tpsa.firstOfDegree[tpsa.order]; j++) {
+    p = tpsa.product[nm * j + tpsa.unit[iv]];
+    r[j] = a[p] * tpsa.exponent[tpsa.nv * p + iv];
+  }
+}
+
+/* r[k] = map[k](arg[0], ..., arg[nv-1]) for k=0..nMap-1 */
+static void tpsaCompose(double **r, double **map, long nMap, double **arg) {
+  double **value, **result;
+  long i, k;
+
+  value = tmalloc(sizeof(*value) * tpsa.nm);
+  result = tmalloc(sizeof(*result) * nMap);
+  for (k = 0; k < nMap; k++) {
+    result[k] = tpsaNew();
+    tpsaConstant(result[k], map[k][0]);
+  }
+  value[0] = NULL;
+  for (i = 1; i < tpsa.nm; i++) {
+    value[i] = tpsaNew();
+    if (tpsa.parent[i] == 0)
+      tpsaCopy(value[i], arg[tpsa.parentVariable[i]]);
+    else
+      tpsaMultiply(value[i], value[tpsa.parent[i]], arg[tpsa.parentVariable[i]]);
+    for (k = 0; k < nMap; k++)
+      if (map[k][i])
+        tpsaAddScaled(result[k], result[k], map[k][i], value[i]);
+  }
+  for (i = 1; i < tpsa.nm; i++)
+    free(value[i]);
+  for (k = 0; k < nMap; k++) {
+    tpsaCopy(r[k], result[k]);
+    free(result[k]);
+  }
+  free(value);
+  free(result);
+}
+
+/* Applies a transport matrix (up to third order) to the coordinates */
+static void tpsaApplyMatrix(double **z, VMATRIX *M, short excludeS0) {
+  double *zz[6][6], *out[6], *term, s0;
+  long i, j, k, l;
+
+  s0 = z[4][0];
+  if (excludeS0)
+    z[4][0] = 0;
+  term = tpsaNew();
+  for (j = 0; j < 6; j++)
+    for (k = 0; k <= j; k++) {
+      zz[j][k] = NULL;
+      if (M->order >= 2) {
+        zz[j][k] = tpsaNew();
+        tpsaMultiply(zz[j][k], z[j], z[k]);
+      }
+    }
+  for (i = 0; i < 6; i++) {
+    out[i] = tpsaNew();
+    out[i][0] = M->C[i];
+    for (j = 0; j < 6; j++)
+      if (M->R[i][j])
+        tpsaAddScaled(out[i], out[i], M->R[i][j], z[j]);
+    if (M->order >= 2) {
+      for (j = 0; j < 6; j++)
+        for (k = 0; k <= j; k++)
+          if (M->T[i][j][k])
+            tpsaAddScaled(out[i], out[i], M->T[i][j][k], zz[j][k]);
+    }
+    if (M->order >= 3) {
+      for (j = 0; j < 6; j++)
+        for (k = 0; k <= j; k++)
+          for (l = 0; l <= k; l++)
+            if (M->Q[i][j][k][l]) {
+              tpsaMultiply(term, zz[j][k], z[l]);
+              tpsaAddScaled(out[i], out[i], M->Q[i][j][k][l], term);
+            }
+    }
+  }
+  if (excludeS0)
+    z[4][0] = s0;
+  for (i = 0; i < 6; i++) {
+    /* as in concat_matrices() with CONCAT_EXCLUDE_S0, the path length offset passes through */
+    if (i == 4 && excludeS0)
+      out[i][0] += s0;
+    tpsaCopy(z[i], out[i]);
+    free(out[i]);
+  }
+  for (j = 0; j < 6; j++)
+    for (k = 0; k <= j; k++)
+      if (zz[j][k])
+        free(zz[j][k]);
+  free(term);
+}
+
+static void tpsaExactDrift(double **z, double length) {
+  double *t1, *t2;
+  t1 = tpsaNew();
+  t2 = tpsaNew();
+  tpsaAddScaled(z[0], z[0], length, z[1]);
+  tpsaAddScaled(z[2], z[2], length, z[3]);
+  tpsaMultiply(t1, z[1], z[1]);
+  tpsaMultiply(t2, z[3], z[3]);
+  tpsaAddScaled(t1, t1, 1, t2);
+  t1[0] += 1;
+  tpsaSqrt(t2, t1);
+  tpsaAddScaled(z[4], z[4], length, t2);
+  free(t1);
+  free(t2);
+}
+
+/* (qx, qy) <-> (xp, yp) as convertSlopesToMomenta() and convertMomentaToSlopes() */
+static void tpsaSlopesToMomenta(double *qx, double *qy, double *xp, double *yp, double *delta) {
+  double *t1, *t2;
+  t1 = tpsaNew();
+  t2 = tpsaNew();
+  tpsaMultiply(t1, xp, xp);
+  tpsaMultiply(t2, yp, yp);
+  tpsaAddScaled(t1, t1, 1, t2);
+  t1[0] += 1;
+  tpsaSqrt(t2, t1);
+  tpsaReciprocal(t1, t2);
+  tpsaCopy(t2, delta);
+  t2[0] += 1;
+  tpsaMultiply(t1, t1, t2); /* (1+delta)/sqrt(1+xp^2+yp^2) */
+  tpsaMultiply(qx, xp, t1);
+  tpsaMultiply(qy, yp, t1);
+  free(t1);
+  free(t2);
+}
+
+static void tpsaMomentaToSlopes(double *xp, double *yp, double *qx, double *qy, double *delta) {
+  double *t1, *t2;
+  t1 = tpsaNew();
+  t2 = tpsaNew();
+  tpsaCopy(t1, delta);
+  t1[0] += 1;
+  tpsaMultiply(t1, t1, t1);
+  tpsaMultiply(t2, qx, qx);
+  tpsaAddScaled(t1, t1, -1, t2);
+  tpsaMultiply(t2, qy, qy);
+  tpsaAddScaled(t1, t1, -1, t2);
+  if (t1[0] <= 0)
+    bombElegant("TPSA map: undefined slopes in kick multipole", NULL);
+  tpsaSqrt(t2, t1);
+  tpsaReciprocal(t1, t2);
+  tpsaMultiply(xp, qx, t1);
+  tpsaMultiply(yp, qy, t1);
+  free(t1);
+  free(t2);
+}
+
+/* Canonical multipole kick, as apply_canonical_multipole_kicks() */
+static void tpsaMultipoleKick(double *qx, double *qy, double **xpow, double **ypow, long order, double KnL, short skew) {
+  double *sumFx, *sumFy, *term, coef, factorial[TPSA_MAX_MULTIPOLE_ORDER + 1];
+  long i;
+
+  sumFx = tpsaNew();
+  sumFy = tpsaNew();
+  term = tpsaNew();
+  for (i = 0, factorial[0] = 1; i <= order; i++)
+    if (i)
+      factorial[i] = factorial[i - 1] * i;
+  for (i = 0; i <= order; i++) {
+    /* coefficients of (x+iy)^n/n!, as expansion_coefficients() */
+    coef = ((i / 2) % 2 ? -1.0 : 1.0) / (factorial[i] * factorial[order - i]);
+    tpsaMultiply(term, xpow[order - i], ypow[i]);
+    tpsaAddScaled(i % 2 ? sumFx : sumFy, i % 2 ? sumFx : sumFy, coef, term);
+  }
+  if (skew) {
+    tpsaAddScaled(qx, qx, -KnL, sumFx);
+    tpsaAddScaled(qy, qy, -KnL, sumFy);
+  } else {
+    tpsaAddScaled(qx, qx, -KnL, sumFy);
+    tpsaAddScaled(qy, qy, KnL, sumFx);
+  }
+  free(sumFx);
+  free(sumFy);
+  free(term);
+}
+
+typedef struct {
+  double length, KnL[3];
+  long order[3], nTerms, nSlices, integrationOrder;
+  short skew[3];
+} TPSA_MULTIPOLE;
+
+static short noMultipoleFiles(char *s1, char *s2, char *s3, char *s4) {
+  return !(s1 && strlen(s1)) && !(s2 && strlen(s2)) && !(s3 && strlen(s3)) && !(s4 && strlen(s4));
+}
+
+/* Returns non-zero if the element can be integrated as power series, filling in *mp */
+static long getTpsaMultipole(TPSA_MULTIPOLE *mp, ELEMENT_LIST *eptr) {
+  KQUAD *kquad;
+  KSEXT *ksext;
+  KOCT *koct;
+  long nKicks;
+
+  mp->nTerms = 1;
+  mp->skew[0] = mp->skew[1] = mp->skew[2] = 0;
+  switch (eptr->type) {
+  case T_KQUAD:
+    kquad = (KQUAD *)eptr->p_elem;
+    if (kquad->tilt || kquad->dx || kquad->dy || kquad->dz || kquad->pitch || kquad->yaw || kquad->bore ||
+        kquad->xkick || kquad->ykick || kquad->synch_rad || kquad->expandHamiltonian || kquad->lEffective > 0 ||
+        kquad->edge1_effects > 0 || kquad->edge2_effects > 0 || kquad->radial ||
+        !noMultipoleFiles(kquad->systematic_multipoles, kquad->edge_multipoles, kquad->random_multipoles,
+                          kquad->steering_multipoles))
+      return 0;
+    mp->length = kquad->length;
+    mp->order[0] = 1;
+    mp->KnL[0] = kquad->k1 * kquad->length * (1 + kquad->fse);
+    nKicks = kquad->n_kicks;
+    mp->nSlices = kquad->nSlices;
+    mp->integrationOrder = kquad->integration_order;
+    break;
+  case T_KSEXT:
+    ksext = (KSEXT *)eptr->p_elem;
+    if (ksext->tilt || ksext->dx || ksext->dy || ksext->dz || ksext->pitch || ksext->yaw || ksext->bore ||
+        ksext->xkick || ksext->ykick || ksext->synch_rad || ksext->expandHamiltonian ||
+        !noMultipoleFiles(ksext->systematic_multipoles, ksext->edge_multipoles, ksext->random_multipoles,
+                          ksext->steering_multipoles))
+      return 0;
+    mp->length = ksext->length;
+    mp->order[0] = 2;
+    mp->KnL[0] = ksext->k2 * ksext->length * (1 + ksext->fse);
+    if (ksext->k1) {
+      mp->order[mp->nTerms] = 1;
+      mp->KnL[mp->nTerms++] = ksext->k1 * ksext->length;
+    }
+    if (ksext->j1) {
+      mp->order[mp->nTerms] = 1;
+      mp->skew[mp->nTerms] = 1;
+      mp->KnL[mp->nTerms++] = ksext->j1 * ksext->length;
+    }
+    nKicks = ksext->n_kicks;
+    mp->nSlices = ksext->nSlices;
+    mp->integrationOrder = ksext->integration_order;
+    break;
+  case T_KOCT:
+    koct = (KOCT *)eptr->p_elem;
+    if (koct->tilt || koct->dx || koct->dy || koct->dz || koct->pitch || koct->yaw || koct->bore ||
+        koct->synch_rad || koct->expandHamiltonian ||
+        !noMultipoleFiles(koct->systematic_multipoles, koct->random_multipoles, NULL, NULL))
+      return 0;
+    mp->length = koct->length;
+    mp->order[0] = 3;
+    mp->KnL[0] = koct->k3 * koct->length * (1 + koct->fse);
+    nKicks = koct->n_kicks;
+    mp->nSlices = koct->nSlices;
+    mp->integrationOrder = koct->integration_order;
+    break;
+  default:
+    return 0;
+  }
+  if (mp->integrationOrder != 2 && mp->integrationOrder != 4 && mp->integrationOrder != 6)
+    return 0;
+  /* as in multipole_tracking2() */
+  if (nKicks <= 0) {
+    if (mp->nSlices <= 0)
+      return 0;
+  } else {
+    if (mp->integrationOrder > 2) {
+      if ((mp->nSlices = ceil(nKicks / (1.0 * mp->integrationOrder))) < 1)
+        mp->nSlices = 1;
+    } else
+      mp->nSlices = nKicks;
+  }
+  return 1;
+}
+
+#define BETA 1.25992104989487316477
+
+/* Integrates through a kick multipole, as integrate_kick_multipole_ordn() */
+static void tpsaIntegrateMultipole(double **z, TPSA_MULTIPOLE *mp) {
+  static double driftFrac2[2] = {0.5, 0.5};
+  static double kickFrac2[2] = {1.0, 0.0};
+  static double driftFrac4[4] = {
+    0.5 / (2 - BETA), (1 - BETA) / (2 - BETA) / 2, (1 - BETA) / (2 - BETA) / 2, 0.5 / (2 - BETA)};
+  static double kickFrac4[4] = {1. / (2 - BETA), -BETA / (2 - BETA), 1 / (2 - BETA), 0};
+  static double driftFrac6[8] = {
+    0.39225680523878, 0.5100434119184585, -0.47105338540975655, 0.0687531682525181,
+    0.0687531682525181, -0.47105338540975655, 0.5100434119184585, 0.39225680523878};
+  static double kickFrac6[8] = {
+    0.784513610477560, 0.235573213359357, -1.17767998417887, 1.3151863206839063,
+    -1.17767998417887, 0.235573213359357, 0.784513610477560, 0};
+  double *driftFrac, *kickFrac, drift, dsh;
+  double *qx, *qy, *xpow[TPSA_MAX_MULTIPOLE_ORDER + 1], *ypow[TPSA_MAX_MULTIPOLE_ORDER + 1], *t1, *t2;
+  long nSubsteps, iSlice, step, i, maxOrder;
+
+  switch (mp->integrationOrder) {
+  case 2:
+    nSubsteps = 2;
+    driftFrac = driftFrac2;
+    kickFrac = kickFrac2;
+    break;
+  case 4:
+    nSubsteps = 4;
+    driftFrac = driftFrac4;
+    kickFrac = kickFrac4;
+    break;
+  default:
+    nSubsteps = 8;
+    driftFrac = driftFrac6;
+    kickFrac = kickFrac6;
+    break;
+  }
+  for (i = maxOrder = 0; i < mp->nTerms; i++)
+    if (mp->order[i] > maxOrder)
+      maxOrder = mp->order[i];
+
+  qx = tpsaNew();
+  qy = tpsaNew();
+  t1 = tpsaNew();
+  t2 = tpsaNew();
+  for (i = 0; i <= maxOrder; i++) {
+    xpow[i] = tpsaNew();
+    ypow[i] = tpsaNew();
+  }
+  drift = mp->length / mp->nSlices;
+  tpsaSlopesToMomenta(qx, qy, z[1], z[3], z[5]);
+  for (iSlice = 0; iSlice < mp->nSlices; iSlice++) {
+    for (step = 0; step < nSubsteps; step++) {
+      if (drift) {
+        dsh = drift * driftFrac[step];
+        tpsaAddScaled(z[0], z[0], dsh, z[1]);
+        tpsaAddScaled(z[2], z[2], dsh, z[3]);
+        tpsaMultiply(t1, z[1], z[1]);
+        tpsaMultiply(t2, z[3], z[3]);
+        tpsaAddScaled(t1, t1, 1, t2);
+        t1[0] += 1;
+        tpsaSqrt(t2, t1);
+        tpsaAddScaled(z[4], z[4], dsh, t2);
+      }
+      if (!kickFrac[step])
+        break;
+      tpsaConstant(xpow[0], 1);
+      tpsaConstant(ypow[0], 1);
+      for (i = 1; i <= maxOrder; i++) {
+        tpsaMultiply(xpow[i], xpow[i - 1], z[0]);
+        tpsaMultiply(ypow[i], ypow[i - 1], z[2]);
+      }
+      for (i = 0; i < mp->nTerms; i++)
+        if (mp->KnL[i])
+          tpsaMultipoleKick(qx, qy, xpow, ypow, mp->order[i], mp->KnL[i] / mp->nSlices * kickFrac[step], mp->skew[i]);
+      tpsaMomentaToSlopes(z[1], z[3], qx, qy, z[5]);
+    }
+  }
+  free(qx);
+  free(qy);
+  free(t1);
+  free(t2);
+  for (i = 0; i <= maxOrder; i++) {
+    free(xpow[i]);
+    free(ypow[i]);
+  }
+}
+
+/* Returns the matrix used for an element that isn't integrated as power series */
+static VMATRIX *tpsaElementMatrix(ELEMENT_LIST *eptr, RUN *run) {
+  double Pref_input;
+  /* as in accumulate_matrices() */
+  Pref_input = eptr->pred ? eptr->pred->Pref_output : eptr->Pref_input;
+  if (!eptr->matrix || Pref_input != eptr->Pref_input)
+    compute_matrix(eptr, run, NULL);
+  return eptr->matrix;
+}
+
+/* Propagates the power series z[0..5] through nElements elements (all if nElements<0) */
+static void tpsaTrackBeamline(double **z, ELEMENT_LIST *elem, long nElements, RUN *run) {
+  ELEMENT_LIST *eptr;
+  TPSA_MULTIPOLE mp;
+  VMATRIX *M;
+
+  for (eptr = elem; eptr && nElements--; eptr = eptr->succ) {
+    switch (eptr->type) {
+    case T_DRIF:
+      tpsaExactDrift(z, ((DRIFT *)eptr->p_elem)->length);
+      continue;
+    case T_EDRIFT:
+      tpsaExactDrift(z, ((EDRIFT *)eptr->p_elem)->length);
+      continue;
+    default:
+      if (getTpsaMultipole(&mp, eptr)) {
+        tpsaIntegrateMultipole(z, &mp);
+        continue;
+      }
+      break;
+    }
+    if ((M = tpsaElementMatrix(eptr, run)))
+      tpsaApplyMatrix(z, M, entity_description[eptr->type].flags & HAS_RF_MATRIX ? 1 : 0);
+  }
+}
+
+/* Returns the lowest order of the matrices used by tpsaTrackBeamline() for elements of
+ * nonzero length, or TPSA_MAX_ORDER if there are none. The map is exact only to this
+ * order. *limiting is set to the first element with a matrix of that order.
+ */
+static long tpsaMatrixOrderLimit(ELEMENT_LIST *elem, long nElements, RUN *run, ELEMENT_LIST **limiting) {
+  ELEMENT_LIST *eptr;
+  TPSA_MULTIPOLE mp;
+  VMATRIX *M;
+  long limit;
+
+  limit = TPSA_MAX_ORDER;
+  *limiting = NULL;
+  for (eptr = elem; eptr && nElements--; eptr = eptr->succ) {
+    if (eptr->type == T_DRIF || eptr->type == T_EDRIFT || getTpsaMultipole(&mp, eptr))
+      continue;
+    if (!(entity_description[eptr->type].flags & HAS_LENGTH) || ((DRIFT *)eptr->p_elem)->length == 0)
+      continue;
+    if ((M = tpsaElementMatrix(eptr, run)) && M->order < limit) {
+      limit = M->order;
+      *limiting = eptr;
+    }
+  }
+  return limit;
+}
+
+/* Makes the map of the power series z[0..5] symplectic.
+ *
+ * In canonical coordinates u=(x, qx, y, qy, -s, delta), the map is written as
+ * M(u) = C + N(R u), with C and R its constant and linear parts, so that N is the identity
+ * plus terms of order two and higher. N is then replaced by the map given by the mixed-variable
+ * generating function F(q, P) = q.P + G(q, P), where q=(x, y, -s) are the old coordinates and
+ * P=(qx, qy, delta) the new momenta:
+ *   p = P + dG/dq,  Q = q + dG/dP.
+ * This map is symplectic for any G. G is found from the truncated N by inverting P(q, p) for
+ * p(q, P), and integrating the resulting dG along rays from the origin. If N is symplectic to
+ * the order of the map, G reproduces it to that order, so the new map differs from the Taylor
+ * map only in higher orders.
+ *
+ * poly[0..5] are set to dG/dv[i], with v=(x, qx, y, qy, -s, delta) in the order of u, holding
+ * the new momenta in place of the old ones; poly[6+3*k+j] is d^2G/dq[k]dP[j], for solving the
+ * first relation for P.
+ */
+static void tpsaSymplecticMap(double **poly, double C[6], double R[6][6], double **z) {
+  double *var[6], *arg[6], *Mc[6], *N[6], *f[6], *t1, *t2, coef, factor;
+  MATRIX *A, *Ainv;
+  long i, j, k, m, d, iter, target;
+
+  for (i = 0; i < 6; i++) {
+    var[i] = tpsaNew();
+    tpsaVariable(var[i], 0, i);
+    arg[i] = tpsaNew();
+    Mc[i] = tpsaNew();
+    N[i] = tpsaNew();
+    f[i] = tpsaNew();
+  }
+  t1 = tpsaNew();
+  t2 = tpsaNew();
+
+  /* map in canonical coordinates */
+  tpsaCopy(arg[0], var[0]);
+  tpsaCopy(arg[2], var[2]);
+  tpsaScale(arg[4], var[4], -1);
+  tpsaCopy(arg[5], var[5]);
+  tpsaMomentaToSlopes(arg[1], arg[3], var[1], var[3], var[5]);
+  tpsaCompose(Mc, z, 6, arg);
+  tpsaSlopesToMomenta(t1, t2, Mc[1], Mc[3], Mc[5]);
+  tpsaCopy(Mc[1], t1);
+  tpsaCopy(Mc[3], t2);
+  tpsaScale(Mc[4], Mc[4], -1);
+
+  /* N(u) = M(R^-1 u) - C */
+  m_alloc(&A, 6, 6);
+  m_alloc(&Ainv, 6, 6);
+  for (i = 0; i < 6; i++) {
+    C[i] = Mc[i][0];
+    for (j = 0; j < 6; j++)
+      A->a[i][j] = R[i][j] = Mc[i][tpsa.unit[j]];
+  }
+  if (!m_invert(Ainv, A))
+    bombElegant("polynomial map: linear part of the map is singular", NULL);
+  for (i = 0; i < 6; i++) {
+    tpsaConstant(arg[i], 0);
+    for (j = 0; j < 6; j++)
+      tpsaAddScaled(arg[i], arg[i], Ainv->a[i][j], var[j]);
+  }
+  tpsaCompose(N, Mc, 6, arg);
+  for (i = 0; i < 6; i++)
+    N[i][0] = 0;
+
+  /* old momenta as functions of (q, P), by iterating p <- p + P - P(q, p), which gains
+   * at least one order per iteration
+   */
+  for (i = 0; i < 6; i++)
+    tpsaCopy(arg[i], var[i]);
+  for (iter = 0; iter <= tpsa.order; iter++) {
+    tpsaCompose(Mc, N, 6, arg);
+    for (k = 0; k < 3; k++) {
+      tpsaAddScaled(arg[2 * k + 1], arg[2 * k + 1], 1, var[2 * k + 1]);
+      tpsaAddScaled(arg[2 * k + 1], arg[2 * k + 1], -1, Mc[2 * k + 1]);
+    }
+  }
+  tpsaCompose(Mc, N, 6, arg);
+  /* f = (dG/dq, dG/dP) as given by the truncated map: p-P and Q-q */
+  for (k = 0; k < 3; k++) {
+    tpsaAddScaled(f[2 * k], arg[2 * k + 1], -1, var[2 * k + 1]);
+    tpsaAddScaled(f[2 * k + 1], Mc[2 * k], -1, var[2 * k]);
+  }
+
+  /* G(v) = sum over i of the integral of f[i](t v) v[i] dt from 0 to 1. A term c v^m of f[i]
+   * gives c v^m v[i]/(d+1) in G, with d the degree of m, and poly[j] = dG/dv[j] gets
+   * c m[j] v^(m-e[j]+e[i])/(d+1), and c v^m/(d+1) if i==j.
+   */
+  for (j = 0; j < 6; j++)
+    tpsaConstant(poly[j], 0);
+  for (i = 0; i < 6; i++) {
+    for (m = 1; m < tpsa.nm; m++) {
+      if (!(coef = f[i][m]))
+        continue;
+      d = tpsa.degree[m];
+      factor = coef / (d + 1);
+      poly[i][m] += factor;
+      for (j = 0; j < 6; j++) {
+        if (!tpsa.exponent[tpsa.nv * m + j])
+          continue;
+        target = findMonomial(tpsa.key[m] - tpsa.power[j] + tpsa.power[i], d);
+        poly[j][target] += factor * tpsa.exponent[tpsa.nv * m + j];
+      }
+    }
+  }
+  for (k = 0; k < 3; k++)
+    for (j = 0; j < 3; j++)
+      tpsaDerivative(poly[6 + 3 * k + j], poly[2 * k], 2 * j + 1);
+
+  for (i = 0; i < 6; i++) {
+    free(var[i]);
+    free(arg[i]);
+    free(Mc[i]);
+    free(N[i]);
+    free(f[i]);
+  }
+  free(t1);
+  free(t2);
+  m_free(&A);
+  m_free(&Ainv);
+}
+
+/* Returns the map of nElements elements starting with first, to the given order, as
+ * polynomials about the reference trajectory, made symplectic if run_setup
+ * symplectify_polynomial_map is nonzero. Only the monomials needed to evaluate the
+ * nonzero terms are kept.
+ */
+POLYNOMIAL_MAP *makePolynomialMap(ELEMENT_LIST *first, long nElements, long order, RUN *run) {
+  POLYNOMIAL_MAP *map;
+  ELEMENT_LIST *limiting;
+  double *z[6], *poly[POLYNOMIAL_MAP_MAX_POLYNOMIALS];
+  long i, m, n, nPoly, *newIndex;
+  short *needed;
+
+  if (order < 1 || order > TPSA_MAX_ORDER)
+    bombElegantVA("polynomial map order must be between 1 and %d", TPSA_MAX_ORDER);
+  if (tpsaMatrixOrderLimit(first, nElements, run, &limiting) < order)
+    bombElegantVA("polynomial_map_order=%ld, but %s (%s) is included in the map using a matrix of order %ld. Reduce polynomial_map_order or use a kick element (e.g., KQUAD) or drift.\n",
+                  order, limiting->name, entity_name[limiting->type], limiting->matrix->order);
+  initializeTpsa(TPSA_VARIABLES, order);
+  for (i = 0; i < 6; i++) {
+    z[i] = tpsaNew();
+    tpsaVariable(z[i], 0, i);
+  }
+  tpsaTrackBeamline(z, first, nElements, run);
+
+  map = tmalloc(sizeof(*map));
+  map->order = order;
+  if ((map->symplectic = run->symplectifyPolynomialMap ? 1 : 0)) {
+    nPoly = POLYNOMIAL_MAP_MAX_POLYNOMIALS;
+    for (i = 0; i < nPoly; i++)
+      poly[i] = tpsaNew();
+    tpsaSymplecticMap(poly, map->C, map->R, z);
+  } else {
+    nPoly = 6;
+    for (i = 0; i < nPoly; i++)
+      poly[i] = z[i];
+  }
+  map->nPolynomials = nPoly;
+
+  /* mark the monomials with nonzero coefficients and their ancestors */
+  needed = tmalloc(sizeof(*needed) * tpsa.nm);
+  newIndex = tmalloc(sizeof(*newIndex) * tpsa.nm);
+  memset(needed, 0, sizeof(*needed) * tpsa.nm);
+  needed[0] = 1;
+  for (m = tpsa.nm - 1; m > 0; m--) {
+    for (i = 0; i < nPoly && !needed[m]; i++)
+      needed[m] = poly[i][m] != 0;
+    if (needed[m])
+      needed[tpsa.parent[m]] = 1;
+  }
+
+  map->parent = tmalloc(sizeof(*map->parent) * tpsa.nm);
+  map->variable = tmalloc(sizeof(*map->variable) * tpsa.nm);
+  for (m = n = 0; m < tpsa.nm; m++) {
+    if (!needed[m])
+      continue;
+    newIndex[m] = n;
+    map->parent[n] = m ? newIndex[tpsa.parent[m]] : -1;
+    map->variable[n] = m ? tpsa.parentVariable[m] : -1;
+    n++;
+  }
+  map->nMonomials = n;
+  for (i = 0; i < nPoly; i++) {
+    map->monomial[i] = tmalloc(sizeof(*map->monomial[i]) * n);
+    map->coef[i] = tmalloc(sizeof(*map->coef[i]) * n);
+    map->nTerms[i] = 0;
+    for (m = 0; m < tpsa.nm; m++) {
+      if (!poly[i][m])
+        continue;
+      map->monomial[i][map->nTerms[i]] = newIndex[m];
+      map->coef[i][map->nTerms[i]++] = poly[i][m];
+    }
+  }
+  if (map->symplectic)
+    for (i = 0; i < nPoly; i++)
+      free(poly[i]);
+  for (i = 0; i < 6; i++)
+    free(z[i]);
+  free(needed);
+  free(newIndex);
+  return map;
+}
+
+void freePolynomialMap(POLYNOMIAL_MAP *map) {
+  long i;
+  if (!map)
+    return;
+  free(map->parent);
+  free(map->variable);
+  for (i = 0; i < map->nPolynomials; i++) {
+    free(map->monomial[i]);
+    free(map->coef[i]);
+  }
+  free(map);
+}
+
+/* Computes the chromaticities of orders 1 through chromOrder, chrom[plane][k-1] = d^k nu/d delta^k,
+ * from the one-turn map about the closed orbit clorb (may be NULL). tune[] are the on-momentum
+ * tunes, used to select the branch. chromOrder is reduced, with a warning, to one less than the
+ * lowest order of the element matrices used for the map. Returns the order computed, which is 0
+ * if the matrices are all first order.
+ */
+long computeTpsaChromaticities(double chrom[2][TPSA_MAX_ORDER], long chromOrder, double *tune,
+                               LINE_LIST *beamline, double *clorb, RUN *run) {
+  double *z[6], *F[4], *dF[4][4], *fixed[4], *arg[6], *residual[4], *J[4][4], *phi, *sinPhi, *cosPhi, *t1;
+  double **R4inv, factorial;
+  MATRIX *A, *Ainv;
+  ELEMENT_LIST *limiting;
+  long i, j, k, iter, plane, limit;
+  char warningText[1024];
+
+  if (chromOrder < 1 || chromOrder >= TPSA_MAX_ORDER)
+    bombElegantVA("TPSA chromaticity order must be between 1 and %d", TPSA_MAX_ORDER - 1);
+  if ((limit = tpsaMatrixOrderLimit(beamline->elem_twiss, -1, run, &limiting)) <= chromOrder) {
+    snprintf(warningText, 1024, "%s (%s) is included using a matrix of order %ld, so chromaticities are computed only to order %ld.",
+             limiting->name, entity_name[limiting->type], limit, limit - 1);
+    printWarning("TPSA chromaticity order reduced.", warningText);
+    if ((chromOrder = limit - 1) < 1)
+      return 0;
+  }
+
+  /* the map must be one order higher than the chromaticity, since the traces are derivatives */
+  initializeTpsa(TPSA_VARIABLES, chromOrder + 1);
+  for (i = 0; i < 6; i++) {
+    z[i] = tpsaNew();
+    tpsaVariable(z[i], clorb ? clorb[i] : 0, i);
+  }
+  /* as in computeHigherOrderChromaticities(), only the momentum deviation is relative to the closed orbit */
+  z[5][0] = 0;
+  tpsaTrackBeamline(z, beamline->elem_twiss, -1, run);
+
+  /* F(z) = M(clorb+z) - clorb for the transverse coordinates, and its derivatives */
+  for (i = 0; i < 4; i++) {
+    F[i] = z[i];
+    F[i][0] -= clorb ? clorb[i] : 0;
+    for (j = 0; j < 4; j++) {
+      dF[i][j] = tpsaNew();
+      tpsaDerivative(dF[i][j], F[i], j);
+    }
+  }
+
+  /* Solve for the off-momentum fixed point as power series in delta, by iterating
+   * x <- x + (1-R)^-1 (F(x, delta) - x), which gains at least one order per iteration.
+   */
+  m_alloc(&A, 4, 4);
+  m_alloc(&Ainv, 4, 4);
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      A->a[i][j] = (i == j ? 1 : 0) - dF[i][j][0];
+  if (!m_invert(Ainv, A))
+    bombElegant("TPSA chromaticity: one-turn matrix is singular", NULL);
+  R4inv = Ainv->a;
+  for (i = 0; i < 6; i++) {
+    arg[i] = tpsaNew();
+    if (i == 5)
+      tpsaVariable(arg[i], 0, 5);
+  }
+  for (i = 0; i < 4; i++) {
+    fixed[i] = arg[i];
+    residual[i] = tpsaNew();
+  }
+  for (iter = 0; iter <= tpsa.order + 1; iter++) {
+    tpsaCompose(residual, F, 4, arg);
+    for (i = 0; i < 4; i++)
+      tpsaAddScaled(residual[i], residual[i], -1, fixed[i]);
+    for (i = 0; i < 4; i++)
+      for (j = 0; j < 4; j++)
+        tpsaAddScaled(fixed[i], fixed[i], R4inv[i][j], residual[j]);
+  }
+
+  /* linear transverse matrix about the fixed point, as power series in delta */
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      J[i][j] = tpsaNew();
+  for (i = 0; i < 4; i++)
+    tpsaCompose(J[i], dF[i], 4, arg);
+
+  /* solve cos(phi) = trace/2 for phi(delta) by Newton's method in the series */
+  phi = tpsaNew();
+  sinPhi = tpsaNew();
+  cosPhi = tpsaNew();
+  t1 = tpsaNew();
+  for (plane = 0; plane < 2; plane++) {
+    tpsaConstant(phi, PIx2 * tune[plane]);
+    for (iter = 0; iter <= tpsa.order + 1; iter++) {
+      tpsaSinCos(sinPhi, cosPhi, phi);
+      /* t1 = cos(phi) - trace/2 */
+      tpsaAddScaled(t1, cosPhi, -0.5, J[2 * plane][2 * plane]);
+      tpsaAddScaled(t1, t1, -0.5, J[2 * plane + 1][2 * plane + 1]);
+      tpsaReciprocal(sinPhi, sinPhi);
+      tpsaMultiply(t1, t1, sinPhi);
+      tpsaAddScaled(phi, phi, 1, t1);
+    }
+    for (k = 1, factorial = 1; k <= chromOrder; k++) {
+      factorial *= k;
+      chrom[plane][k - 1] = phi[findMonomial(k * tpsa.power[5], k)] * factorial / PIx2;
+    }
+  }
+
+  for (i = 0; i < 6; i++) {
+    free(z[i]);
+    free(arg[i]);
+  }
+  for (i = 0; i < 4; i++) {
+    free(residual[i]);
+    for (j = 0; j < 4; j++) {
+      free(dF[i][j]);
+      free(J[i][j]);
+    }
+  }
+  free(phi);
+  free(sinPhi);
+  free(cosPhi);
+  free(t1);
+  m_free(&A);
+  m_free(&Ainv);
+  return chromOrder;
+}
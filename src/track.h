@@ -120,6 +120,8 @@ extern long warningCountLimit;
 extern short misalignmentMethod, trackingMatrixCleanUp;
 extern double slopeLimit, coordLimit, sStart;
 extern char *searchPath;
+extern long trackingThreads;
+extern short soaTracking;
 
 /* flag used to identify which processor is allowed to write to a file */
 extern long writePermitted;
@@ -218,8 +220,29 @@ typedef struct {
     long order;
     /* These are needed by radiation calculations */
     struct element_list *eptr;  /* address of element structure, if any */
+    unsigned long serial;       /* set anew by initialize_matrices(), used to detect changed matrices */
     } VMATRIX;
 
+/* Map of arbitrary order stored as polynomials in the six coordinates (see tpsa.c).
+ * Monomial 0 is 1, and monomial i>0 is monomial parent[i] times coordinate variable[i],
+ * with parent[i]<i, so all monomials are evaluated with one multiplication each.
+ * For a symplectic map, the polynomials are the gradient and part of the Hessian of a
+ * generating function, and the map is z -> C + N(R z) in canonical coordinates, with
+ * N given implicitly by the generating function.
+ */
+#define POLYNOMIAL_MAP_MAX_POLYNOMIALS 15
+typedef struct {
+    long order, nMonomials;
+    long *parent;
+    short *variable;
+    long nPolynomials;
+    long nTerms[POLYNOMIAL_MAP_MAX_POLYNOMIALS];    /* number of nonzero coefficients for each polynomial */
+    long *monomial[POLYNOMIAL_MAP_MAX_POLYNOMIALS]; /* monomial index of each term */
+    double *coef[POLYNOMIAL_MAP_MAX_POLYNOMIALS];
+    short symplectic;
+    double C[6], R[6][6];
+    } POLYNOMIAL_MAP;
+
 /* structure for general multipole kicks */
 
 typedef struct {
@@ -334,6 +357,7 @@ typedef struct element_list {
     VMATRIX *matrix;      /* pure matrix of this element */
     VMATRIX *savedMatrix; /* saved matrix of this element */
     VMATRIX *accumMatrix; /* accumulated matrix to the end of this element */
+    POLYNOMIAL_MAP *polyMap; /* for concatenated elements with run_setup polynomial_map_order>0 */
     TWISS *twiss;         /* computed from the above matrices */
     VMATRIX *Mld;         /* linear damping matrix (on-orbit, with trajectory ) */
     SIGMA_MATRIX *sigmaMatrix;
@@ -433,6 +457,18 @@ typedef struct {
   double (*f11010)[3];
 } S_DRIVING_TERMS;
 
+/* concatenated matrix for a run of consecutive matrix elements (see concat_beamline.c) */
+typedef struct {
+    ELEMENT_LIST *first;         /* first member element */
+    long nMembers, order;
+    uint64_t hash;               /* hash of the member matrices */
+    double *coef;                /* coefficients of the member matrices, compared if the hash matches */
+    long nCoef;
+    VMATRIX *matrix;
+    long polyMapOrder;
+    POLYNOMIAL_MAP *polyMap;     /* if polyMapOrder>0 */
+    } CONCAT_SEGMENT;
+
 /* Node structure for linked-list of beamline definitions: */
 #define N_TSWA 3
 typedef struct line_list {
@@ -440,6 +476,8 @@ typedef struct line_list {
     char *definition;
     ELEMENT_LIST *elem;     /* linked list of elements that make up this beamline */
     long n_elems, ncat_elems;
+    CONCAT_SEGMENT *concatSegment;  /* cached segments of the concatenated beamline */
+    long nConcatSegments;
     ELEMENT_LIST *ecat;     /* linked list of concatenated elements that are equivalent to the beamline */
     long i_recirc;                /* refers to element index in elem list */
     ELEMENT_LIST *elem_recirc;    /* pointer to element in elem list */
@@ -578,6 +616,7 @@ typedef struct {
     char *stepDoneSemaphore;       /* optional filename for semaphore to create when step is done */
     double semaphoreCheckInterval; /* in seconds */
     short restartFiles;            /* if non-zero, certain files are restarted for each step */
+    long stepWorkers;              /* if non-zero, steps are seeded individually and run by this many processes */
     } VARY;
 void check_VARY_structure(VARY *_control, char *caller);
 
@@ -685,7 +724,8 @@ typedef struct {
 #define OPTIM_METHOD_SWARM      8
 #define OPTIM_METHOD_1DSCANS    9
 #define OPTIM_METHOD_RCDS      10
-#define N_OPTIM_METHODS        11
+#define OPTIM_METHOD_LM        11
+#define N_OPTIM_METHODS        12
 
 
   /* The definitions of PGA_CROSSOVER_ONEPT, PGA_CROSSOVER_TWOPT, PGA_CROSSOVER_UNIFORM can be found at pgapack.h */
@@ -715,7 +755,12 @@ typedef struct {
     long matrix_order, *TijkMem, *UijklMem;
     double simplexDivisor, simplexPassRangeFactor;
     double random_factor, rcdsStepFactor;
+    double lmDerivativeFactor;    /* finite-difference step for levenberg-marquardt, as a fraction of the step size */
+    long restrictTwissComputations; /* skip optional twiss computations not referenced by the terms */
     long includeSimplex1dScans, startFromSimplexVertex1;
+    long localWorkers;            /* number of concurrent forked worker processes per restart (serial version only) */
+    char *evaluationCache;        /* file of stored evaluations, reused across runs */
+    double evaluationCacheQuantum; /* variable values within this fraction of the step size are the same point */
     /* For parallel optimization only */
     long n_iterations;            /* The maximal number of iterations allowed */
     long max_no_change;           /* The number of iterations to stop when no change in the best solution found */
@@ -861,11 +906,19 @@ typedef struct {
     double lossLimit[2]; /* loss recording only between these limits */
     char *runfile, *lattice, *acceptance, *centroid, *bpmCentroid, *sigma, 
       *final, *output, *rootname, *losses, *tuneFile;
+    char *elementProfile;        /* per-element profiling output */
+    long elementProfileInterval; /* passes per profile page, 0 for one page per tracking run */
+    long concatAccuracyGuard;    /* if nonzero, don't concatenate nonlinear multipoles */
+    long matrixTree;             /* if nonzero, full_matrix() keeps a tree of partial products */
+    long polynomialMapOrder;     /* if nonzero, concatenated segments are tracked with polynomial maps of this order */
+    long symplectifyPolynomialMap; /* if nonzero, the polynomial maps are made symplectic */
     APERTURE_DATA apertureData;
     MODULATION_DATA modulationData;
     RAMP_DATA rampData;
     OUTPUT_FILES outputFiles;
     char *trackingInterruptFile;
+    char *checkpointFile, *restartFile; /* tracking checkpoint output and input */
+    long checkpointInterval;            /* passes between checkpoints */
     time_t trackingInterruptFileMtime;
     long n_passes_fiducial;      /* if >0, the number of times to go through for the fiducial particle */
 #if USE_MPI
@@ -1138,7 +1191,7 @@ extern char *entity_text[N_TYPES];
 #define N_STRAY_PARAMS 7
 #define N_CSBEND_PARAMS 84+14
 #define N_MATTER_PARAMS 21
-#define N_RFMODE_PARAMS 57
+#define N_RFMODE_PARAMS 58
 #define N_TRFMODE_PARAMS 25
 #define N_TWMTA_PARAMS 17
 #define N_ZLONGIT_PARAMS 30
@@ -1148,8 +1201,8 @@ extern char *entity_text[N_TYPES];
 #define N_IBSCATTER_PARAMS 13
 #define N_FMULT_PARAMS 13
 #define N_BMAPXY_PARAMS 7
-#define N_WAKE_PARAMS 17
-#define N_TRWAKE_PARAMS 25
+#define N_WAKE_PARAMS 18
+#define N_TRWAKE_PARAMS 26
 #define N_TUBEND_PARAMS 6
 #define N_CHARGE_PARAMS 3
 #define N_PFILTER_PARAMS 6
@@ -1193,7 +1246,7 @@ extern char *entity_text[N_TYPES];
 #define N_APPLE_PARAMS 25
 #define N_MRFDF_PARAMS 27
 #define N_CORGPIPE_PARAMS 15
-#define N_LRWAKE_PARAMS 15
+#define N_LRWAKE_PARAMS 17
 #define N_EHCOR_PARAMS 16
 #define N_EVCOR_PARAMS 16
 #define N_EHVCOR_PARAMS 18
@@ -2711,6 +2764,7 @@ typedef struct {
     char *feedbackRecordFile;
     long muteGenerator;        /* if non-zero, generator output is muted */
     double generatorFactor;
+    char *group;               /* consecutive elements with the same group name share one binning of the beam */
   /** char *noiseAlphaGen, *noisePhiGen; */
 #define I_NOISE_ALPHA_GEN 0
 #define I_NOISE_PHI_GEN 1
@@ -2768,6 +2822,8 @@ typedef struct {
     SDDS_DATASET *SDDSfbrec;  /* seen by  feedback system */
     long fbSample;           /* row in the output record */
     long fileInitialized;
+    long *timeOrder, nTimeOrder; /* particle order on the last pass, used to speed up sorting in binless mode */
+    short groupTracked;        /* set when the element has been tracked along with the first element of its group */
     } RFMODE;
 
 /* names and storage structure for RF-mode-from-file physical parameters */
@@ -2842,6 +2898,7 @@ typedef struct {
     double last_yphase;        /* phase at t=last_t */
     SDDS_DATASET *SDDSrec;
     long fileInitialized;
+    long *timeOrder, nTimeOrder; /* particle order on the last pass, used to speed up sorting in binless mode */
     } TRFMODE;
 
 
@@ -2885,6 +2942,13 @@ typedef struct {
     long *xModeIndex, *yModeIndex;
     } FTRFMODE;
 
+/* persistent scratch buffers for collective elements (see workArena.c) */
+typedef struct {
+    long nBuffers;
+    void **buffer;
+    long *size;                /* bytes allocated for each buffer */
+    } WORK_ARENA;
+
 /* names and storage structure for longitudinal impedance physical parameters */
 extern PARAMETER zlongit_param[N_ZLONGIT_PARAMS];
 
@@ -2913,6 +2977,7 @@ typedef struct {
     /* for internal use: */
     long initialized;          /* indicates that files are loaded */
     double *Z;                 /* n_Z (Re Z, Im Z) pairs */
+    WORK_ARENA *workArena;     /* histogram, spectrum, and particle buffers */
     /* variables for SDDS output of wakes */
     SDDS_TABLE *SDDS_wake;
     long SDDS_wake_initialized;
@@ -2950,6 +3015,7 @@ typedef struct {
     long allowLongBeam;       /* If nonozero, then long bunches don't cause abort */
     /* for internal use */
     double *Z[2];             /* Z (Re Z, Im Z) pairs for each plane */
+    WORK_ARENA *workArena;    /* histogram, spectrum, and particle buffers */
     long initialized;
     double macroParticleCharge;
     /* variables for SDDS output of wakes */
@@ -2957,6 +3023,19 @@ typedef struct {
     long SDDS_wake_initialized;
     } ZTRANSVERSE;
 
+/* convolution methods for WAKE and TRWAKE */
+#define WAKE_CONVOLUTION_DIRECT 0
+#define WAKE_CONVOLUTION_FFT 1
+#define WAKE_CONVOLUTION_OVERLAP_ADD 2
+#define N_WAKE_CONVOLUTION_MODES 3
+
+/* spectrum of a wake function, zero-padded to nFFT points, kept for FFT convolution */
+typedef struct {
+  long nFFT, wakePoints;     /* FFT length and number of wake points included */
+  double *W;                 /* wake function the spectrum was computed from */
+  double *data;              /* nFFT+2 values, (Re, Im) pairs */
+} WAKE_SPECTRUM;
+
 /* names and storage structure for longitudinal wake physical parameters */
 extern PARAMETER wake_param[N_WAKE_PARAMS];
 
@@ -2972,10 +3051,13 @@ typedef struct {
     long bunchedBeamMode;          /* If nonzero, then do calculations bunch-by-bunch */
     long startBunch, endBunch;
     long acausalAllowed;
+    char *convolution;         /* "direct", "fft", or "overlap-add" */
     /* for internal use: */
     long initialized;          /* indicates that files are loaded */
     long wakePoints, isCopy, i0;
     double *W, *t, macroParticleCharge, dt;
+    long convolutionMode;
+    WAKE_SPECTRUM spectrum;
   } WAKE;
 
 /* names and storage structure for longitudinal corrugated-pipe wake physical parameters */
@@ -2999,6 +3081,8 @@ typedef struct {
   double factor;             /* factor to multiply by (e.g., number of cells) */
   double xFactor, yFactor, zFactor, qxFactor, qyFactor;
   long turnsToKeep, rampPasses;
+  long resonatorModes;       /* if >0, fit each wake with this many damped resonators */
+  char *resonatorFile;       /* file giving damped resonators instead of tabulated wakes */
   /* for internal use: */
   long initialized;          /* indicates that files are loaded */
   long nBuckets;
@@ -3009,6 +3093,11 @@ typedef struct {
   /* bucket history data---centroids of prior buckets */
   long nHistory; /* number of historical buckets */
   double *tHistory, *QHistory, *xHistory, *yHistory;
+  /* damped resonator representation of the wakes, W(t) = sum of Re(c*exp(s*t)) */
+  long nModes[6];            /* number of resonators for Wx, Wy, Wz, Qx, Qy */
+  double *modeData[6];       /* Re(s), Im(s), Re(c), Im(c) for each resonator */
+  long nModeState;
+  double *modeState;         /* time of the last bunch, then the sums over prior bunches for each resonator */
   } LRWAKE;
 
 /* names and storage structure for transverse wake physical parameters */
@@ -3029,10 +3118,13 @@ typedef struct {
     long bunchedBeamMode;          /* If nonzero, then do calculations bunch-by-bunch */
     long startBunch, endBunch;
     long acausalAllowed;
+    char *convolution;         /* "direct", "fft", or "overlap-add" */
     /* for internal use: */
     long initialized;          /* indicates that files are loaded */
     long wakePoints, isCopy, i0;
     double *W[2], *t, macroParticleCharge, dt;
+    long convolutionMode;
+    WAKE_SPECTRUM spectrum[2];
   } TRWAKE;
 
 /* names and storage structure for RF cavity with wake physical parameters */
@@ -3921,6 +4013,7 @@ extern void setup_bunched_beam_moments(BEAM *beam,NAMELIST_TEXT *nltext, RUN *ru
                                        VARY *control, ERRORVAL *errcon, OPTIM_VARIABLES *optim, OUTPUT_FILES *output,
                                        LINE_LIST *beamline, long n_elements, long save_original);
 extern long new_bunched_beam(BEAM *beam, RUN *run, VARY *control, OUTPUT_FILES *output, long flags);
+long bunchedBeamFirstIsFiducial(void);
 extern long run_bunched_beam(RUN *run, VARY *control, ERRORVAL *errcon, OPTIM_VARIABLES *optim, 
                              LINE_LIST *beamline, long n_elements,
                              BEAM *beam, OUTPUT_FILES *output, long flags);
@@ -3994,6 +4087,7 @@ void setupSliceAnalysis(NAMELIST_TEXT *nltext, RUN *run,
 extern VMATRIX *full_matrix(ELEMENT_LIST *elem, RUN *run, long order);
 extern VMATRIX *append_full_matrix(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order);
 extern VMATRIX *accumulate_matrices(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order, long full_matrix_only);
+extern void freeMatrixTrees(void);
 extern void checkMatrices(char *label, ELEMENT_LIST *elem);
 extern long fill_in_matrices(ELEMENT_LIST *elem, RUN *run);
 extern VMATRIX *accumulateRadiationMatrices(ELEMENT_LIST *elem, RUN *run, VMATRIX *M0, long order, long radiation, long nSlices, long sliceEtilted);
@@ -4039,6 +4133,7 @@ extern VMATRIX *rf_cavity_matrix(double length, double voltage, double frequency
 extern void copy_matrices1(VMATRIX *M1,  VMATRIX *M0);
 extern void free_elements1(ELEMENT_LIST *elemlist);
 extern void concatenate_beamline(LINE_LIST *beamline, RUN *run);
+extern void freeConcatSegments(LINE_LIST *beamline);
  
 /* prototypes for concat_mat.c: */
 extern void concat_matrices(VMATRIX *M2, VMATRIX *M1, VMATRIX *M0, unsigned long mode);
@@ -4080,6 +4175,28 @@ extern void recordLostParticles(BEAM *beam, double **coord, long nLeft, long nLo
 extern void resetElementTiming();
 extern void reportElementTiming();
 
+/* prototypes for elementProfiler.c */
+#define PROFILE_MPI 0
+#define PROFILE_WAKE 1
+#define PROFILE_HISTOGRAM 2
+#define PROFILE_OUTPUT 3
+#define N_PROFILE_CATEGORIES 4
+long elementProfilerBegin(RUN *run, LINE_LIST *beamline, long step);
+void elementProfilerStartElement(ELEMENT_LIST *eptr, long nParticles);
+void elementProfilerEndElement(long nParticles);
+void elementProfilerStartCollective(long category);
+void elementProfilerEndCollective(long category);
+void elementProfilerEndPass(long pass);
+void elementProfilerEnd();
+void finishElementProfiler();
+
+/* prototypes for checkpoint.c */
+void writeTrackingCheckpoint(RUN *run, LINE_LIST *beamline, double **coord, long nToTrack, long nMaximum,
+                             long nLost, double Po, long pass, long step);
+long readTrackingCheckpoint(RUN *run, LINE_LIST *beamline, double **coord, long nCapacity, long *nToTrack,
+                            long *nMaximum, long *nLost, double *Po, long step);
+void restoreCheckpointElementState(void *p_elem);
+
 extern void setTrackingContext(char *name, long occurence, long type, char *rootname, ELEMENT_LIST *eptr);
 extern void getTrackingContext(TRACKING_CONTEXT *trackingContext);
 extern TRACKING_CONTEXT trackingContext;
@@ -4213,6 +4330,12 @@ void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_co
                               double beta_y, double alpha_y, double eta_y, double etap_y,
                               unsigned long *unstable);
 void update_twiss_parameters(RUN *run, LINE_LIST *beamline, unsigned long *unstable);
+#define TWISS_COMPUTE_TSWA    0x0001UL
+#define TWISS_COMPUTE_DRIVING 0x0002UL
+#define TWISS_COMPUTE_HOCHROM 0x0004UL
+#define TWISS_COMPUTE_RADINT  0x0008UL
+#define TWISS_COMPUTE_ALL     0x000fUL
+unsigned long setTwissComputationMask(unsigned long mask);
 void compute_twiss_statistics(LINE_LIST *beamline, TWISS *twiss_ave, TWISS *twiss_min, TWISS *twiss_max);
 void compute_twiss_percentiles(LINE_LIST *beamline, TWISS *twiss_p99, TWISS *twiss_p98, TWISS *twiss_p96);
 void dump_twiss_parameters(LINE_LIST *beamline, long n_elem, 
@@ -4241,6 +4364,11 @@ long computeTunesFromTracking(double *tune, double *amp, VMATRIX *M, LINE_LIST *
 			      double xAmplitude, double yAmplitude, double deltaOffset, long turns, long turnOffset,
                               double *endingCoord, double *lowerLimit, double *upperLimit,
 			      long allowLosses, long nPeriods, unsigned long flags);
+long computeTunesFromTrackingMulti(double **tune, double **amp, short *status,
+                                   LINE_LIST *beamline, RUN *run, double **startingCoord, long nParticles,
+                                   long turns, long turnOffset, double **endingCoord,
+                                   double *tuneLowerLimit, double *tuneUpperLimit,
+                                   long nPeriods, unsigned long flags);
 double adjustTuneHalfPlane(double frequency, double phase0, double phase1);
 int lsf2dPolyUnweighted(double *x[2], double *y, long points, int32_t *order[2],
                         long nOrders, double *coef, double *chi, double *condition, 
@@ -4599,6 +4727,12 @@ extern void track_through_multipole_deflector(double **final, MRFDF *rf_param, d
 extern void vary_setup(VARY *_control, NAMELIST_TEXT *nltext, RUN *run, LINE_LIST *beamline);
 extern void add_varied_element(VARY *_control, NAMELIST_TEXT *nltext, RUN *run, LINE_LIST *beamline);
 extern long vary_beamline(VARY *_control, ERRORVAL *errcon, RUN *run, LINE_LIST *beamline);
+
+/* prototypes for routines in stepWorkers.c */
+void startStepWorkers(VARY *control, LINE_LIST *beamline, long firstBeamIsFiducial);
+long stepWorkerOwnsStep(void);
+void commitStepWorkerOutput(void);
+void finishStepWorkers(void);
 extern long perturb_beamline(VARY *_control, ERRORVAL *errcon, RUN *run, LINE_LIST *beamline);
 extern ELEMENT_LIST *find_element(char *elem_name,  ELEMENT_LIST **context, ELEMENT_LIST *elem);
 extern ELEMENT_LIST *find_element_hash(char *elem_name, long occurence,  ELEMENT_LIST **context,  ELEMENT_LIST *elem);
@@ -4727,6 +4861,8 @@ long track_through_matter(double **part, long np, long iPass, MATTER *matter, do
 
 void track_through_rfmode(double **part, long np, RFMODE *rfmode, double Po,
     char *element_name, double element_z, long pass, long n_passes, CHARGE *charge);
+void track_through_rfmode_group(double **part, long np, RFMODE **rfmode, char **element_name, long nModes, double Po,
+    double element_z, long pass, long n_passes, CHARGE *charge);
 void set_up_rfmode(RFMODE *rfmode, char *element_name, double element_z, long n_passes, RUN *run, long n_particles,
                    double Po, double Lo);
 
@@ -4737,6 +4873,8 @@ void set_up_trfmode(TRFMODE *trfmode, char *element_name, double element_z,
 void track_through_zlongit(double **part, long np, ZLONGIT *zlongit, double Po, RUN *run, long i_pass,
                            CHARGE *charge);
 void applyLowPassFilterToImpedance(double *Z, long nfreq, double cutoff0, double cutoff1);
+void *getWorkBuffer(WORK_ARENA **arena, long index, long size);
+void freeWorkArena(WORK_ARENA **arena);
 void track_through_lscdrift(double **part, long np, LSCDRIFT *lscdrift, double Po, CHARGE *charge);
 long checkPointSpacing(double *x, long n, double tolerance);
 void track_through_ztransverse(double **part, long np, ZTRANSVERSE *ztransverse, 
@@ -4747,6 +4885,12 @@ void optimizeBinSettingsForImpedance(double timeSpan, double freq, double Q,
 void convolveArrays(double *output, long outputs, 
                     double *a1, long n1,
                     double *a2, long n2, long di2);
+void convolveOccupiedBins(double *output, long n, double *a1, double *a2, long n2, long di2,
+                          long *pbin, long np);
+long parseWakeConvolutionMode(char *mode, char *elementType);
+void setUpWakeSpectrum(WAKE_SPECTRUM *spectrum, double *W, long n, long n2, long di2, long mode);
+void convolveWithWakeSpectrum(double *output, long n, double *a1, double *W, long n2, long di2,
+                              long mode, WAKE_SPECTRUM *spectrum);
 void applyLongitudinalWakeKicks(double **part, double *time, long *pbin, long np, double Po,
                                 double *Vtime, long nb, double tmin, double dt,
                                 long interpolate);
@@ -4807,6 +4951,7 @@ long reset_driftCSR();
 long applyLowPassFilter(double *histogram, long bins, double start, double end);
 long applyLHPassFilters(double *histogram, long bins, double startHP, double endHP,
 			double startLP, double endLP, long clipNegative);
+void freeFilterWorkArena();
 
 long track_through_ccbend(double **particle, long n_part, ELEMENT_LIST *eptr, CCBEND *ccbend, double Po,
                           double **accepted, double z_start, double *sigmaDelta2, char *rootname,
@@ -5058,6 +5203,33 @@ double GetNoiseGroupValue(long groupId);
 /* from elegant.c */
 void swapParticles(double *p1, double *p2);
 
+/* prototypes for particleThreads.c */
+long particleThreadsToUse(long np);
+void particleThreadRange(long np, long *iFirst, long *iLast);
+long compactLostParticles(double **particle, double **accepted, short *lost, long np);
+
+/* prototypes for particleSoA.c */
+/* Structure-of-arrays copy of the coordinates of a block of particles, for kernels
+ * that loop over particles innermost so the compiler can vectorize them.
+ */
+typedef struct {
+  long n, nMax;
+  double *coord[COORDINATES_PER_PARTICLE];
+} PARTICLE_SOA;
+#define PARTICLE_SOA_TILE 256
+void allocateParticleSoA(PARTICLE_SOA *soa, long nMax);
+void freeParticleSoA(PARTICLE_SOA *soa);
+void loadParticleSoA(PARTICLE_SOA *soa, double **particle, long n);
+void storeParticleSoA(PARTICLE_SOA *soa, double **particle);
+void trackParticleSoAMatrix(PARTICLE_SOA *soa, VMATRIX *M);
+void track_particles_soa(double **final, VMATRIX *M, double **initial, long n_part);
+void trackParticleSoAPolynomialMap(PARTICLE_SOA *soa, POLYNOMIAL_MAP *map, double *work);
+void trackPolynomialMap(double **coord, POLYNOMIAL_MAP *map, long n_part);
+
+/* prototypes for tpsa.c */
+POLYNOMIAL_MAP *makePolynomialMap(ELEMENT_LIST *first, long nElements, long order, RUN *run);
+void freePolynomialMap(POLYNOMIAL_MAP *map);
+
 /* prototypes for momentumAperture.c */
 void setupMomentumApertureSearch(NAMELIST_TEXT *nltext, RUN *run, VARY *control);
 void finishMomentumApertureSearch();
@@ -5068,6 +5240,11 @@ void gatherLostParticles(double ***lostParticles, long *nLost, double **coord, l
 
 /* prototypes for drand_oag.c */
 double random_1_elegant(long iseed);
+double random_2_elegant(long iseed);
+double random_3_elegant(long iseed);
+double random_4_elegant(long iseed);
+double gauss_rn_elegant(long iseed, double (*urandom)(long iseed1));
+double gauss_rn_lim_elegant(double mean, double sigma, double limit_in_sigmas, double (*urandom)(long iseed));
 
 #if SDDS_MPI_IO
 /* prototypes for media_oag.c */
@@ -5081,6 +5258,16 @@ long approximate_percentiles_p(double *position, double *percent, long positions
 #define RESTART_RN_BEAMGEN  0x0008
 #define RESTART_RN_ALL      (RESTART_RN_BEAMLINE|RESTART_RN_SCATTER|RESTART_RN_BPMNOISE|RESTART_RN_BEAMGEN)
 void seedElegantRandomNumbers(long seed, unsigned long restart);
+#define N_ELEGANT_RANDOM_GENERATORS 4
+typedef struct {
+  long initialized[N_ELEGANT_RANDOM_GENERATORS];
+  long seed[N_ELEGANT_RANDOM_GENERATORS][4];
+  long gaussianSaved;
+  double gaussianSavedValue;
+} ELEGANT_RANDOM_STATE;
+void getElegantRandomNumberState(ELEGANT_RANDOM_STATE *state);
+void setElegantRandomNumberState(ELEGANT_RANDOM_STATE *state);
+void reseedStepRandomNumbers(long step);
 
 /* compute long sum with Kahan's algorithm */
 double Kahan (long length, double a[], double *error);
@@ -5095,6 +5282,7 @@ typedef struct {
   long ip;
 } TIMEDATA;
 extern int compTimeData(const void *tv1, const void *tv2);
+extern void sortTimeData(TIMEDATA *tData, long np, long **order, long *nOrder);
 
 #define MAX_BUCKETS 16384
 int comp_BucketNumbers(const void *coord1, const void *coord2);
@@ -5129,6 +5317,7 @@ extern long sigmaIndex3[6][6];
 void setup_coupled_twiss_output(NAMELIST_TEXT *nltext, RUN *run, LINE_LIST *beamline, long *do_coupled_twiss_output,
                                 long default_order);
 int run_coupled_twiss_output(RUN *run, LINE_LIST *beamline, double *starting_coord);
+long coupledTwissUsesRadiationIntegrals();
 void finish_coupled_twiss_output();
 void SortEigenvalues (double *WR, double *WI, double *VR, int matDim, int eigenModesNumber, int verbosity);
 
@@ -5146,6 +5335,7 @@ void histogram_sums(long nonEmptyBins, long firstBin, long *lastBin, long *his);
 extern void setupIonEffects(NAMELIST_TEXT *nltext, VARY *control, RUN *run);
 extern void completeIonEffectsSetup(RUN *run, LINE_LIST *beamline);
 extern void trackWithIonEffects(double **part0, long np0, IONEFFECTS *ionEffects, double Po, long iPass, long nPasses, CHARGE *charge);
+extern long transferIonEffectsState(IONEFFECTS *ionEffects, double *data, short restore);
 extern void evaluateVoltageFromLorentzian(double *Eperp, double a, double b, double x, double y);
 extern void gaussianBeamKick(double *coord, double *center, double *sigma, long fromBeam, double kick[2], double charge, 
 		      double ionMass, double ionCharge);
@@ -51,6 +51,8 @@ short mpiAbort = 0;
 double slopeLimit = SLOPE_LIMIT;
 double coordLimit = COORD_LIMIT;
 char *searchPath = NULL;
+long trackingThreads = 1;
+short soaTracking = 0;
 double sStart = 0;
 
 long trajectoryTracking = 0;
@@ -2192,6 +2194,7 @@ PARAMETER rfmode_param[N_RFMODE_PARAMS] = {
   {"NOISE_Q_GEN", "", IS_STRING, PARAM_XY_WAVEFORM, (long)((char *)&rfmode_example.noiseData[I_NOISE_Q_GEN]), NULL, 0.0, 0, "<filename>=<x>+<y> specifying nq(t) for quadrature generator noise."},
   {"NOISE_I_V", "", IS_STRING, PARAM_XY_WAVEFORM, (long)((char *)&rfmode_example.noiseData[I_NOISE_I_V]), NULL, 0.0, 0, "<filename>=<x>+<y> specifying ei(t) for in-phase voltage noise."},
   {"NOISE_Q_V", "", IS_STRING, PARAM_XY_WAVEFORM, (long)((char *)&rfmode_example.noiseData[I_NOISE_Q_V]), NULL, 0.0, 0, "<filename>=<x>+<y> specifying eq(t) for quadrature voltage noise."},
+  {"GROUP", "", IS_STRING, 0, (long)((char *)&rfmode_example.group), NULL, 0.0, 0, "If given, consecutive RFMODE elements with the same group name bin the beam once and apply their summed voltage in one kick. The elements must have the same binning parameters."},
 };
 
 FRFMODE frfmode_example;
@@ -2430,6 +2433,7 @@ PARAMETER wake_param[N_WAKE_PARAMS] = {
   {"START_BUNCH", "", IS_LONG, 0, (long)((char *)&wake_example.startBunch), NULL, 0.0, -1, "In bunched beam mode, if non-negative, starting bunch number for computations"},
   {"END_BUNCH", "", IS_LONG, 0, (long)((char *)&wake_example.endBunch), NULL, 0.0, -1, "In bunched beam mode, if non-negative, ending bunch number for computations"},
   {"ACAUSAL_ALLOWED", "", IS_LONG, 0, (long)((char *)&wake_example.acausalAllowed), NULL, 0.0, 0, "If non-zero, then an acausal wake is allowed."},
+  {"CONVOLUTION", "", IS_STRING, 0, (long)((char *)&wake_example.convolution), "direct", 0.0, 0, "Method for convolving the current histogram with the wake: \"direct\" (sum over occupied bins), \"fft\", or \"overlap-add\" (FFT in blocks, for histograms much longer than the wake)."},
 };
 
 CORGPIPE corgpipe_example;
@@ -2470,6 +2474,8 @@ PARAMETER lrwake_param[N_LRWAKE_PARAMS] = {
   {"QYFACTOR", "", IS_DOUBLE, 0, (long)((char *)&lrwake_example.qyFactor), NULL, 1.0, 0, "factor by which to multiply vertical quadrupole wake"},
   {"TURNS_TO_KEEP", "", IS_LONG, 0, (long)((char *)&lrwake_example.turnsToKeep), NULL, 0.0, 128, "number of turns of data to retain"},
   {"RAMP_PASSES", "", IS_LONG, 0, (long)((char *)&lrwake_example.rampPasses), NULL, 0.0, 0, "Number of passes over which to linearly ramp up the wake to full strength."},
+  {"RESONATOR_MODES", "", IS_LONG, 0, (long)((char *)&lrwake_example.resonatorModes), NULL, 0.0, 0, "If positive, each wake is fit with this many damped resonators, which are evaluated recursively instead of summing over the bunch history."},
+  {"RESONATOR_FILE", "", IS_STRING, 0, (long)((char *)&lrwake_example.resonatorFile), NULL, 0.0, 0, "File giving damped resonators instead of INPUTFILE, with columns Frequency (Hz), Q, and the amplitude of each wake in the columns named by WXCOLUMN etc., plus optional phase columns with names ending in Phase."},
 };
 
 TRWAKE trwake_example;
@@ -2500,6 +2506,7 @@ PARAMETER trwake_param[N_TRWAKE_PARAMS] = {
   {"START_BUNCH", "", IS_LONG, 0, (long)((char *)&trwake_example.startBunch), NULL, 0.0, -1, "In bunched beam mode, if non-negative, starting bunch number for computations"},
   {"END_BUNCH", "", IS_LONG, 0, (long)((char *)&trwake_example.endBunch), NULL, 0.0, -1, "In bunched beam mode, if non-negative, ending bunch number for computations"},
   {"ACAUSAL_ALLOWED", "", IS_LONG, 0, (long)((char *)&trwake_example.acausalAllowed), NULL, 0.0, 0, "If non-zero, then an acausal wake is allowed."},
+  {"CONVOLUTION", "", IS_STRING, 0, (long)((char *)&trwake_example.convolution), "direct", 0.0, 0, "Method for convolving the current histogram with the wake: \"direct\" (sum over occupied bins), \"fft\", or \"overlap-add\" (FFT in blocks, for histograms much longer than the wake)."},
 };
 
 CHARGE charge_example;
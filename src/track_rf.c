@@ -89,7 +89,7 @@ void track_through_rf_deflector(
 
   voltFactor *= (1 + rf_param->fse);
 
-  voltFactor *= (gauss_rn_lim(1.0, rf_param->voltageNoise, 2, random_3) +
+  voltFactor *= (gauss_rn_lim_elegant(1.0, rf_param->voltageNoise, 2, random_3_elegant) +
                  (rf_param->voltageNoiseGroup
                     ? rf_param->groupVoltageNoise * GetNoiseGroupValue(rf_param->voltageNoiseGroup)
                     : 0));
@@ -101,7 +101,7 @@ void track_through_rf_deflector(
 
   t_first = rf_param->t_first_particle;
   length = rf_param->length / n_kicks;
-  Ephase = (rf_param->phase + gauss_rn_lim(0.0, rf_param->phaseNoise, 2, random_3) + (rf_param->phaseNoiseGroup ? rf_param->groupPhaseNoise * GetNoiseGroupValue(rf_param->phaseNoiseGroup) : 0)) * PI / 180.0 + omega * (rf_param->time_offset - t_first);
+  Ephase = (rf_param->phase + gauss_rn_lim_elegant(0.0, rf_param->phaseNoise, 2, random_3_elegant) + (rf_param->phaseNoiseGroup ? rf_param->groupPhaseNoise * GetNoiseGroupValue(rf_param->phaseNoiseGroup) : 0)) * PI / 180.0 + omega * (rf_param->time_offset - t_first);
 #ifdef DEBUG
   fprintf(stdout, "t_first = %21.15e s, Ephase = %21.15e deg\n", t_first, Ephase * 180 / PI);
 #endif
@@ -255,7 +255,7 @@ void track_through_rftm110_deflector(
 
   /* using 2*volt in expressions gives us theta=V/E */
   voltTimes2 *= 2 * rf_param->voltage / (1e6 * particleMassMV * particleRelSign) *
-                (gauss_rn_lim(1.0, rf_param->voltageNoise, 2, random_3) +
+                (gauss_rn_lim_elegant(1.0, rf_param->voltageNoise, 2, random_3_elegant) +
                  (rf_param->voltageNoiseGroup
                     ? rf_param->groupVoltageNoise * GetNoiseGroupValue(rf_param->voltageNoiseGroup)
                     : 0));
@@ -263,7 +263,7 @@ void track_through_rftm110_deflector(
   omega = 2 * PI * rf_param->frequency;
   k = omega / c_mks;
   t_first = rf_param->t_first_particle;
-  phase0 = (rf_param->phase + gauss_rn_lim(0.0, rf_param->phaseNoise, 2, random_3) + (rf_param->phaseNoiseGroup ? rf_param->groupPhaseNoise * GetNoiseGroupValue(rf_param->phaseNoiseGroup) : 0)) * PI / 180.0 - omega * t_first;
+  phase0 = (rf_param->phase + gauss_rn_lim_elegant(0.0, rf_param->phaseNoise, 2, random_3_elegant) + (rf_param->phaseNoiseGroup ? rf_param->groupPhaseNoise * GetNoiseGroupValue(rf_param->phaseNoiseGroup) : 0)) * PI / 180.0 - omega * t_first;
 
   if (isSlave || !notSinglePart) {
     if (rf_param->tilt)
@@ -275,6 +275,7 @@ void track_through_trfmode(
     firstBin = trfmode->n_bins;
 
     if (isSlave) {
+      elementProfilerStartCollective(PROFILE_HISTOGRAM);
       for (ib = 0; ib < trfmode->n_bins; ib++)
         xsum[ib] = ysum[ib] = count[ib] = 0;
       if (np == -1) {
@@ -299,6 +300,7 @@ void track_through_trfmode(
           firstBin = ib;
         n_binned++;
       }
+      elementProfilerEndCollective(PROFILE_HISTOGRAM);
     }
 
 #if USE_MPI
@@ -352,6 +354,7 @@ void track_through_trfmode(
 #if USE_MPI
     if (isSlave) {
 #endif
+      elementProfilerStartCollective(PROFILE_WAKE);
       for (ib = firstBin; ib <= lastBin; ib++) {
         if (!trfmode->interpolate && count[ib] == 0)
           continue;
@@ -430,6 +433,7 @@ void track_through_trfmode(
           trfmode->Vy = sqrt(sqr(trfmode->Vyr) + sqr(trfmode->Vyi));
         }
       }
+      elementProfilerEndCollective(PROFILE_WAKE);
 
 #if DEBUG
       fprintf(fpdeb, "%ld\n%ld\n%ld\n%ld\n\"Pass %ld  Bucket %ld\"\n%ld\n",
@@ -505,6 +509,7 @@ void track_through_trfmode(
     if (myid == 1) { /* first slave will do output */
 #endif
       printf("Setting TRFMODE record data for pass=%ld\n", pass);
+      elementProfilerStartCollective(PROFILE_OUTPUT);
       if ((pass % trfmode->sample_interval) == 0 &&
           (!SDDS_SetRowValues(trfmode->SDDSrec, SDDS_SET_BY_NAME | SDDS_PASS_BY_VALUE,
                               (pass / trfmode->sample_interval),
@@ -517,6 +522,7 @@ void track_through_trfmode(
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
         SDDS_Bomb((char *)"problem setting up data for TRFMODE record file");
       }
+      elementProfilerEndCollective(PROFILE_OUTPUT);
       /*
       if (pass==n_passes-1 && !SDDS_Terminate(trfmode->SDDSrec)) {
         SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
@@ -707,7 +713,7 @@ void runBinlessTrfMode(
     tData[ip].t = part[ip][4] * sqrt(sqr(P) + 1) / (c_mks * P);
     tData[ip].ip = ip;
   }
-  qsort(tData, np, sizeof(*tData), compTimeData);
+  sortTimeData(tData, np, &trfmode->timeOrder, &trfmode->nTimeOrder);
 
   /* These adjustments per Zotter and Kheifets, 3.2.4, 3.3.2 */
   k *= Q / Qrp;
@@ -851,10 +857,12 @@ void runBinlessTrfMode(
         SDDS_Bomb("problem setting up TRFMODE record data (2)");
       }
     }
+    elementProfilerStartCollective(PROFILE_OUTPUT);
     if (!SDDS_WritePage(trfmode->SDDSrec)) {
       SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors);
       SDDS_Bomb("problem writing TRFMODE record data");
     }
+    elementProfilerEndCollective(PROFILE_OUTPUT);
   }
 
 #if defined(MINIMIZE_MEMORY)
@@ -875,3 +883,46 @@ int compTimeData(const void *tv1, const void *tv2) {
     return 1;
   return 0;
 }
+
+/* Give up on repairing the previous order if the insertion sort needs more than this many moves per particle */
+#define TIME_SORT_MAX_MOVES 8
+
+/* Sorts tData[0..np-1] into time order. On entry, tData[ip] holds the time of particle ip.
+ * Bunches arrive in nearly the same order on every pass, so when the number of particles
+ * hasn't changed the order found on the last pass (kept in *order) is applied first and
+ * then repaired by insertion sort, which takes O(N) time for nearly-ordered data.
+ * If the repair turns out to be expensive, qsort is used instead.
+ */
+void sortTimeData(TIMEDATA *tData, long np, long **order, long *nOrder) {
+  static TIMEDATA *buffer = NULL;
+  static long maxBuffer = 0;
+  long i, j, nMoves;
+  TIMEDATA td;
+
+  if (*nOrder == np && np > 1) {
+    if (np > maxBuffer)
+      buffer = trealloc(buffer, sizeof(*buffer) * (maxBuffer = np));
+    for (i = 0; i < np; i++)
+      buffer[i] = tData[(*order)[i]];
+    memcpy(tData, buffer, sizeof(*tData) * np);
+    nMoves = 0;
+    for (i = 1; i < np; i++) {
+      if (!(tData[i].t < tData[i - 1].t))
+        continue;
+      td = tData[i];
+      for (j = i; j > 0 && tData[j - 1].t > td.t; j--)
+        tData[j] = tData[j - 1];
+      tData[j] = td;
+      if ((nMoves += i - j) > TIME_SORT_MAX_MOVES * np)
+        break;
+    }
+    if (i < np)
+      qsort(tData, np, sizeof(*tData), compTimeData);
+  } else
+    qsort(tData, np, sizeof(*tData), compTimeData);
+
+  if (*nOrder != np)
+    *order = trealloc(*order, sizeof(**order) * ((*nOrder = np) + 1));
+  for (i = 0; i < np; i++)
+    (*order)[i] = tData[i].ip;
+}
@@ -229,9 +229,12 @@ void track_through_trwake(double **part0, long np0, TRWAKE *wakeData, double Po,
              arguments are later times.
              */
           Vtime[nb] = 0;
-          convolveArrays(Vtime, nb,
-                         posItime[plane], nb,
-                         wakeData->W[plane], wakeData->wakePoints, wakeData->i0);
+          if (wakeData->convolutionMode == WAKE_CONVOLUTION_DIRECT)
+            convolveOccupiedBins(Vtime, nb, posItime[plane], wakeData->W[plane], wakeData->wakePoints, wakeData->i0,
+                                 pbin, np);
+          else
+            convolveWithWakeSpectrum(Vtime, nb, posItime[plane], wakeData->W[plane], wakeData->wakePoints, wakeData->i0,
+                                     wakeData->convolutionMode, &wakeData->spectrum[plane]);
 
           for (ib = 0; ib < nb; ib++)
             Vtime[ib] *= factor;
@@ -514,6 +517,11 @@ void set_up_trwake(TRWAKE *wakeData, RUN *run, long pass, long particles, CHARGE
       }
     }
   }
+
+  wakeData->convolutionMode = parseWakeConvolutionMode(wakeData->convolution, "TRWAKE");
+  for (iw = 0; iw < 2; iw++)
+    setUpWakeSpectrum(&wakeData->spectrum[iw], wakeData->W[iw], wakeData->n_bins, wakeData->wakePoints, wakeData->i0,
+                      wakeData->convolutionMode);
 }
 
 void computeTimeCoordinatesOnly(double *time, double Po, double **part, long np) {
@@ -611,6 +619,7 @@ long binTransverseTimeDistribution(double **posItime, double *pz, long *pbin, do
                                    double *time, double **part, double Po, long np,
                                    double dx, double dy, long xPower, long yPower) {
   long ip, ib, n_binned;
+  elementProfilerStartCollective(PROFILE_HISTOGRAM);
   for (ib = 0; ib < nb; ib++)
     posItime[0][ib] = posItime[1][ib] = 0;
   for (ip = n_binned = 0; ip < np; ip++) {
@@ -637,6 +646,7 @@ long binTransverseTimeDistribution(double **posItime, double *pz, long *pbin, do
     pz[ip] = Po * (1 + part[ip][5]) / sqrt(1 + sqr(part[ip][1]) + sqr(part[ip][3]));
     n_binned++;
   }
+  elementProfilerEndCollective(PROFILE_HISTOGRAM);
   return n_binned;
 }
 
@@ -457,26 +457,162 @@ long setupTuneFootprint(
 static XY_TF_DATA *allXyTfData = NULL;
 static DELTA_TF_DATA *allDeltaTfData = NULL;
 
+/* Computes tunes (and diffusion rates, if requested) for n starting offsets from the
+ * reference coordinates. Particles are tracked together in batches of particles_per_batch.
+ * If separatePlanes is nonzero, the x and y tunes come from separate runs with only the
+ * corresponding transverse offset applied. lost[i] is set if the tunes couldn't be found.
+ */
+static void computeFootprintTunes(double **nu, double *diffusionRate, short *lost,
+                                  double *xOffset, double *yOffset, double *deltaOffset, long n,
+                                  short separatePlanes, double *referenceCoord,
+                                  LINE_LIST *beamline, RUN *run, long turns) {
+  long batchSize, nBatch, i0, ib, i, nTrack, nTrack2;
+  short plane, *status;
+  unsigned long ctftFlags;
+  double **start, **end, **end2, **tune, **firstTune, **secondTune;
+  long *index, *index2;
+
+  if (n <= 0)
+    return;
+  if ((batchSize = particles_per_batch) <= 0 || batchSize > n)
+    batchSize = n;
+  start = (double **)czarray_2d(sizeof(**start), batchSize, 6);
+  end = (double **)czarray_2d(sizeof(**end), batchSize, 6);
+  tune = (double **)czarray_2d(sizeof(**tune), batchSize, 2);
+  firstTune = (double **)czarray_2d(sizeof(**firstTune), batchSize, 2);
+  secondTune = (double **)czarray_2d(sizeof(**secondTune), batchSize, 2);
+  end2 = tmalloc(sizeof(*end2) * batchSize);
+  status = tmalloc(sizeof(*status) * batchSize);
+  index = tmalloc(sizeof(*index) * batchSize);
+  index2 = tmalloc(sizeof(*index2) * batchSize);
+
+  for (i0 = 0; i0 < n; i0 += nBatch) {
+    if ((nBatch = n - i0) > batchSize)
+      nBatch = batchSize;
+    for (ib = 0; ib < nBatch; ib++)
+      lost[i0 + ib] = 0;
+    plane = separatePlanes ? 2 : 1;
+    while (plane--) {
+      ctftFlags = CTFT_INCLUDE_X | CTFT_INCLUDE_Y;
+      if (separatePlanes)
+        ctftFlags = plane == 0 ? CTFT_INCLUDE_X : CTFT_INCLUDE_Y;
+      nTrack = 0;
+      for (ib = 0; ib < nBatch; ib++) {
+        if (lost[i0 + ib])
+          continue;
+        memcpy(start[nTrack], referenceCoord, sizeof(**start) * 6);
+        if (ctftFlags & CTFT_INCLUDE_Y)
+          start[nTrack][2] += yOffset[i0 + ib];
+        if (ctftFlags & CTFT_INCLUDE_X)
+          start[nTrack][0] += xOffset[i0 + ib];
+        start[nTrack][5] += deltaOffset[i0 + ib];
+        index[nTrack++] = ib;
+      }
+      if (!nTrack)
+        break;
+      computeTunesFromTrackingMulti(tune, NULL, status, beamline, run, start, nTrack, turns, 0,
+                                    end, NULL, NULL, 1, ctftFlags);
+      nTrack2 = 0;
+      for (i = 0; i < nTrack; i++) {
+        ib = index[i];
+        if (!status[i] ||
+            (ctftFlags & CTFT_INCLUDE_X && (tune[i][0] > 1.0 || tune[i][0] < 0)) ||
+            (ctftFlags & CTFT_INCLUDE_Y && (tune[i][1] > 1.0 || tune[i][1] < 0))) {
+          lost[i0 + ib] = 1;
+          continue;
+        }
+        if (ctftFlags & CTFT_INCLUDE_X)
+          firstTune[ib][0] = tune[i][0];
+        if (ctftFlags & CTFT_INCLUDE_Y)
+          firstTune[ib][1] = tune[i][1];
+        end2[nTrack2] = end[i];
+        index2[nTrack2++] = ib;
+      }
+      if (!compute_diffusion || !nTrack2)
+        continue;
+      computeTunesFromTrackingMulti(tune, NULL, status, beamline, run, end2, nTrack2, turns, turns,
+                                    NULL, NULL, NULL, 1, ctftFlags);
+      for (i = 0; i < nTrack2; i++) {
+        ib = index2[i];
+        if (!status[i] ||
+            (ctftFlags & CTFT_INCLUDE_X && (tune[i][0] > 1.0 || tune[i][0] < 0)) ||
+            (ctftFlags & CTFT_INCLUDE_Y && (tune[i][1] > 1.0 || tune[i][1] < 0))) {
+          lost[i0 + ib] = 1;
+          continue;
+        }
+        if (ctftFlags & CTFT_INCLUDE_X)
+          secondTune[ib][0] = tune[i][0];
+        if (ctftFlags & CTFT_INCLUDE_Y)
+          secondTune[ib][1] = tune[i][1];
+      }
+    }
+    for (ib = 0; ib < nBatch; ib++) {
+      if (lost[i0 + ib])
+        continue;
+      nu[i0 + ib][0] = firstTune[ib][0];
+      nu[i0 + ib][1] = firstTune[ib][1];
+      if (compute_diffusion)
+        diffusionRate[i0 + ib] =
+          log10((sqr(secondTune[ib][0] - firstTune[ib][0]) + sqr(secondTune[ib][1] - firstTune[ib][1])) / turns);
+      else
+        diffusionRate[i0 + ib] = -DBL_MAX;
+    }
+  }
+
+  free_czarray_2d((void **)start, batchSize, 6);
+  free_czarray_2d((void **)end, batchSize, 6);
+  free_czarray_2d((void **)tune, batchSize, 2);
+  free_czarray_2d((void **)firstTune, batchSize, 2);
+  free_czarray_2d((void **)secondTune, batchSize, 2);
+  free(end2);
+  free(status);
+  free(index);
+  free(index2);
+}
+
+/* Energy offset for point idelta of the energy scan */
+static double tuneFootprintDelta(long idelta, double ddelta) {
+  if (!quadratic_spacing)
+    return delta_min + idelta * ddelta;
+  if (idelta < (ndelta - 1.) / 2)
+    return -((delta_max - delta_min) * sqrt(fabs((idelta - (ndelta - 1) / 2.) / ((ndelta - 1) / 2.))) + delta_min);
+  return ((delta_max - delta_min) * sqrt(fabs((idelta - (ndelta - 1) / 2.) / ((ndelta - 1) / 2.))) + delta_min);
+}
+
+/* Transverse offsets for point (ix, iy) of the x, y scan */
+static void tuneFootprintXY(long ix, long iy, double dx, double dy, double *x, double *y) {
+  if (quadratic_spacing) {
+    if (ix < nx / 2)
+      *x = -((xmax - xmin) * sqrt(fabs((ix - (nx - 1) / 2.) / ((nx - 1) / 2.))) + xmin);
+    else
+      *x = ((xmax - xmin) * sqrt(fabs((ix - (nx - 1) / 2.) / ((nx - 1) / 2.))) + xmin);
+    *y = (ymax - ymin) * sqrt(iy / (ny - 1.)) + ymin;
+  } else {
+    *x = xmin + ix * dx;
+    *y = ymin + iy * dy;
+  }
+}
+
 long doTuneFootprint(
   RUN *run,
   VARY *control,
   double *referenceCoord,
   LINE_LIST *beamline,
   TUNE_FOOTPRINTS *tfReturn) {
-  double firstTune[2], secondTune[2], startingCoord[6], endingCoord[6];
-  double firstAmplitude[2], secondAmplitude[2];
   double dx, dy, ddelta, x, y, delta;
   long ix, iy, ixy, idelta, turns;
+  long nScan, iScan;
+  double *scanX, *scanY, *scanDelta, **scanNu, *scanDiffusionRate;
+  short *scanLost;
   long my_ixy, my_idelta;
   static double **one_part;
   double p;
-  long n_part, lost;
+  long n_part;
   XY_TF_DATA *xyTfData;
   DELTA_TF_DATA *deltaTfData;
   long my_nxy, my_ndelta;
   double chromTuneRange[2], chromDeltaRange[2], xyTuneRange[2], xyPositionRange[2], diffusionRateMax, xyArea;
   double nuxLimit[2], nuyLimit[2], chrom1[2];
-  unsigned long ctftFlags;
 
 #ifdef DEBUG
   FILE *fpdebug = NULL;
@@ -567,24 +703,40 @@ long doTuneFootprint(
 
   turns = control->n_passes / 2;
 
+  /* Tunes for all scan points handled by this processor are computed up front, so that
+   * the particles can be tracked together
+   */
+  nScan = MAX(ndelta, nx * ny);
+  scanX = tmalloc(sizeof(*scanX) * nScan);
+  scanY = tmalloc(sizeof(*scanY) * nScan);
+  scanDelta = tmalloc(sizeof(*scanDelta) * nScan);
+  scanDiffusionRate = tmalloc(sizeof(*scanDiffusionRate) * nScan);
+  scanLost = tmalloc(sizeof(*scanLost) * nScan);
+  scanNu = (double **)czarray_2d(sizeof(**scanNu), nScan, 2);
+
   if (ndelta) {
-    short plane;
     x = x_for_delta;
     y = y_for_delta;
     if (ndelta > 1)
       ddelta = (delta_max - delta_min) / (ndelta - 1);
     else
       ddelta = 0;
-    for (idelta = my_idelta = 0; idelta < ndelta; idelta++) {
-      deltaTfData[my_idelta].used = 0;
-      if (!quadratic_spacing)
-        delta = delta_min + idelta * ddelta;
-      else {
-        if (idelta < (ndelta - 1.) / 2)
-          delta = -((delta_max - delta_min) * sqrt(fabs((idelta - (ndelta - 1) / 2.) / ((ndelta - 1) / 2.))) + delta_min);
-        else
-          delta = ((delta_max - delta_min) * sqrt(fabs((idelta - (ndelta - 1) / 2.) / ((ndelta - 1) / 2.))) + delta_min);
+    for (idelta = nScan = 0; idelta < ndelta; idelta++) {
+#if USE_MPI
+      if (myid == idelta % n_processors)
+#endif
+      {
+        scanX[nScan] = x;
+        scanY[nScan] = y;
+        scanDelta[nScan] = tuneFootprintDelta(idelta, ddelta);
+        nScan++;
       }
+    }
+    computeFootprintTunes(scanNu, scanDiffusionRate, scanLost, scanX, scanY, scanDelta, nScan,
+                          separate_xy_for_delta ? 1 : 0, referenceCoord, beamline, run, turns);
+    for (idelta = my_idelta = iScan = 0; idelta < ndelta; idelta++) {
+      deltaTfData[my_idelta].used = 0;
+      delta = tuneFootprintDelta(idelta, ddelta);
 #if USE_MPI
       if (myid == idelta % n_processors) {
         /* Partition the job according to particle ID */
@@ -595,58 +747,24 @@ long doTuneFootprint(
 #endif
             printf("computing tune for delta = %le\n", delta);
         }
-        lost = 0;
-        plane = separate_xy_for_delta ? 2 : 1;
-        while (!lost && plane--) {
-          memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
-          /* First perform delta scan */
-          ctftFlags = CTFT_INCLUDE_X | CTFT_INCLUDE_Y;
-          if (separate_xy_for_delta) {
-            if (plane == 0)
-              ctftFlags = CTFT_INCLUDE_X;
-            else
-              ctftFlags = CTFT_INCLUDE_Y;
-          }
-          if (!computeTunesFromTracking(firstTune, firstAmplitude,
-                                        beamline->matrix, beamline, run,
-                                        startingCoord, x, y, delta, turns, 0,
-                                        endingCoord, NULL, NULL, 1, 1, ctftFlags) ||
-              (ctftFlags & CTFT_INCLUDE_X && (firstTune[0] > 1.0 || firstTune[0] < 0)) ||
-              (ctftFlags & CTFT_INCLUDE_Y && (firstTune[1] > 1.0 || firstTune[1] < 0))) {
-            lost = 1;
-          } else if (compute_diffusion) {
-            memcpy(startingCoord, endingCoord, sizeof(*startingCoord) * 6);
-            if (!computeTunesFromTracking(secondTune, secondAmplitude,
-                                          beamline->matrix, beamline, run,
-                                          startingCoord, 0.0, 0.0, 0.0, turns, turns,
-                                          endingCoord, NULL, NULL, 1, 1, ctftFlags) ||
-                (ctftFlags & CTFT_INCLUDE_X && (secondTune[0] > 1.0 || secondTune[0] < 0)) ||
-                (ctftFlags & CTFT_INCLUDE_Y && (secondTune[1] > 1.0 || secondTune[1] < 0))) {
-              lost = 1;
-            }
-          }
 #if USE_MPI
-          if (my_idelta >= my_ndelta) {
-            fprintf(stderr, "delta index too large on processor %d\n", myid);
-            exit(1);
-          }
-#endif
-          deltaTfData[my_idelta].idelta = idelta;
-          deltaTfData[my_idelta].delta = delta;
-          deltaTfData[my_idelta].used = 1;
+        if (my_idelta >= my_ndelta) {
+          fprintf(stderr, "delta index too large on processor %d\n", myid);
+          exit(1);
         }
-        if (lost) {
+#endif
+        deltaTfData[my_idelta].idelta = idelta;
+        deltaTfData[my_idelta].delta = delta;
+        deltaTfData[my_idelta].used = 1;
+        if (scanLost[iScan]) {
           deltaTfData[my_idelta].nu[0] = deltaTfData[my_idelta].nu[1] = -2;
           deltaTfData[my_idelta].diffusionRate = DBL_MAX;
         } else {
-          deltaTfData[my_idelta].nu[0] = firstTune[0];
-          deltaTfData[my_idelta].nu[1] = firstTune[1];
-          if (compute_diffusion)
-            deltaTfData[my_idelta].diffusionRate =
-              log10((sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1])) / turns);
-          else
-            deltaTfData[my_idelta].diffusionRate = -DBL_MAX;
+          deltaTfData[my_idelta].nu[0] = scanNu[iScan][0];
+          deltaTfData[my_idelta].nu[1] = scanNu[iScan][1];
+          deltaTfData[my_idelta].diffusionRate = scanDiffusionRate[iScan];
         }
+        iScan++;
         my_idelta++;
         if (verbosity >= 2) {
 #if USE_MPI
@@ -747,71 +865,52 @@ long doTuneFootprint(
 
   if (nx != 0 && ny != 0) {
     dx = dy = delta = 0;
-    ctftFlags = CTFT_INCLUDE_X | CTFT_INCLUDE_Y;
     if (!quadratic_spacing) {
       if (nx > 1)
         dx = (xmax - xmin) / (nx - 1);
       if (ny > 1)
         dy = (ymax - ymin) / (ny - 1);
     }
-    my_ixy = 0;
+    for (ix = nScan = 0; ix < nx; ix++) {
+      for (iy = 0; iy < ny; iy++) {
+#if USE_MPI
+        if (myid == (ix * ny + iy) % n_processors)
+#endif
+        {
+          tuneFootprintXY(ix, iy, dx, dy, &scanX[nScan], &scanY[nScan]);
+          scanDelta[nScan] = delta;
+          nScan++;
+        }
+      }
+    }
+    computeFootprintTunes(scanNu, scanDiffusionRate, scanLost, scanX, scanY, scanDelta, nScan,
+                          0, referenceCoord, beamline, run, turns);
+    my_ixy = iScan = 0;
 #if USE_MPI
     oldPercentage = 0;
 #endif
     for (ix = 0; ix < nx; ix++) {
-      if (quadratic_spacing) {
-        if (ix < nx / 2)
-          x = -((xmax - xmin) * sqrt(fabs((ix - (nx - 1) / 2.) / ((nx - 1) / 2.))) + xmin);
-        else
-          x = ((xmax - xmin) * sqrt(fabs((ix - (nx - 1) / 2.) / ((nx - 1) / 2.))) + xmin);
-      } else {
-        x = xmin + ix * dx;
-      }
       for (iy = 0; iy < ny; iy++) {
-        if (quadratic_spacing) {
-          y = (ymax - ymin) * sqrt(iy / (ny - 1.)) + ymin;
-        } else {
-          y = ymin + iy * dy;
-        }
+        tuneFootprintXY(ix, iy, dx, dy, &x, &y);
         xyTfData[my_ixy].used = 0;
-        memcpy(startingCoord, referenceCoord, sizeof(*startingCoord) * 6);
 #if USE_MPI
         if (myid == (ix * ny + iy) % n_processors) /* Partition the job according to particle ID */
 #endif
         {
-          lost = 0;
-          if (!computeTunesFromTracking(firstTune, firstAmplitude,
-                                        beamline->matrix, beamline, run,
-                                        startingCoord, x, y, delta, turns, 0,
-                                        endingCoord, NULL, NULL, 1, 1, ctftFlags) ||
-              firstTune[0] > 1.0 || firstTune[0] < 0 || firstTune[1] > 1.0 || firstTune[1] < 0) {
-            lost = 1;
-          } else if (compute_diffusion) {
-            memcpy(startingCoord, endingCoord, sizeof(*startingCoord) * 6);
-            if (!computeTunesFromTracking(secondTune, secondAmplitude,
-                                          beamline->matrix, beamline, run,
-                                          startingCoord, 0.0, 0.0, 0.0, turns, turns,
-                                          endingCoord, NULL, NULL, 1, 1, ctftFlags) ||
-                secondTune[0] > 1.0 || secondTune[0] < 0 || secondTune[1] > 1.0 || secondTune[1] < 0) {
-              lost = 1;
-            }
-          }
           xyTfData[my_ixy].ix = ix;
           xyTfData[my_ixy].iy = iy;
           xyTfData[my_ixy].position[0] = x;
           xyTfData[my_ixy].position[1] = y;
           xyTfData[my_ixy].used = 1;
-          if (lost) {
+          if (scanLost[iScan]) {
             xyTfData[my_ixy].nu[0] = xyTfData[my_ixy].nu[1] = -2;
             xyTfData[my_ixy].diffusionRate = DBL_MAX;
           } else {
-            xyTfData[my_ixy].nu[0] = firstTune[0];
-            xyTfData[my_ixy].nu[1] = firstTune[1];
-            if (compute_diffusion)
-              xyTfData[my_ixy].diffusionRate = log10((sqr(secondTune[0] - firstTune[0]) + sqr(secondTune[1] - firstTune[1])) / turns);
-            else
-              xyTfData[my_ixy].diffusionRate = -DBL_MAX;
+            xyTfData[my_ixy].nu[0] = scanNu[iScan][0];
+            xyTfData[my_ixy].nu[1] = scanNu[iScan][1];
+            xyTfData[my_ixy].diffusionRate = scanDiffusionRate[iScan];
           }
+          iScan++;
           my_ixy++;
 
           if (verbosity >= 2) {
@@ -942,6 +1041,12 @@ long doTuneFootprint(
   if (deltaTfData && deltaTfData != allDeltaTfData)
     free(deltaTfData);
   deltaTfData = NULL;
+  free(scanX);
+  free(scanY);
+  free(scanDelta);
+  free(scanDiffusionRate);
+  free(scanLost);
+  free_czarray_2d((void **)scanNu, MAX(ndelta, nx * ny), 2);
 
   if (run->showElementTiming)
     reportElementTiming();
@@ -28,5 +28,6 @@
     long filtered_output = 1;
     long ignore_half_integer = 0;
     long chromaticity_fit_order = 5;
+    long particles_per_batch = 1;
 #end
 
@@ -30,6 +30,9 @@
 #include "fftpackC.h"
 #include "twiss.h"
 #include <stddef.h>
+#if defined(_OPENMP)
+#  include <omp.h>
+#endif
 #ifndef M_PI
 #  define M_PI 3.14159265358979323846
 #endif
@@ -76,6 +79,51 @@ static SDDS_DATASET SDDSTswaTunes;
 static long linearChromaticTrackingInitialized = 0;
 void setLinearChromaticTrackingValues(LINE_LIST *beamline);
 
+/* Optional quantities that update_twiss_parameters() actually computes, if requested
+ * by twiss_output. During optimization, those not referenced by the optimization terms
+ * are turned off (see optimization_setup restrict_twiss_computations).
+ */
+static unsigned long twissComputationMask = TWISS_COMPUTE_ALL;
+
+unsigned long setTwissComputationMask(unsigned long mask) {
+  unsigned long oldMask;
+  oldMask = twissComputationMask;
+  twissComputationMask = mask;
+  return oldMask;
+}
+
+/* Sets the quantities skipped because of the mask to NaN, so that anything that still uses
+ * them (e.g., through a UDF that the optimizer's scan of the terms doesn't see) gets an
+ * invalid result rather than a stale value from an earlier evaluation.
+ */
+static void invalidateMaskedTwissQuantities(LINE_LIST *beamline, unsigned long skipped) {
+  long i, j;
+  double *data;
+  if (skipped & TWISS_COMPUTE_TSWA) {
+    for (i = 0; i < N_TSWA; i++)
+      for (j = 0; j < N_TSWA; j++)
+        beamline->dnux_dA[i][j] = beamline->dnuy_dA[i][j] = NAN;
+    beamline->nuxTswaExtrema[0] = beamline->nuxTswaExtrema[1] = NAN;
+    beamline->nuyTswaExtrema[0] = beamline->nuyTswaExtrema[1] = NAN;
+  }
+  if (skipped & TWISS_COMPUTE_DRIVING) {
+    /* DRIVING_TERMS holds only doubles */
+    data = (double *)&(beamline->drivingTerms);
+    for (i = 0; i < (long)(sizeof(beamline->drivingTerms) / sizeof(double)); i++)
+      data[i] = NAN;
+  }
+  if (skipped & TWISS_COMPUTE_HOCHROM)
+    beamline->chrom2[0] = beamline->chrom2[1] = beamline->chrom3[0] = beamline->chrom3[1] = NAN;
+  if (skipped & TWISS_COMPUTE_RADINT) {
+    for (i = 0; i < 6; i++)
+      beamline->radIntegrals.RI[i] = NAN;
+    beamline->radIntegrals.Jx = beamline->radIntegrals.Jy = beamline->radIntegrals.Jdelta = NAN;
+    beamline->radIntegrals.taux = beamline->radIntegrals.tauy = beamline->radIntegrals.taudelta = NAN;
+    beamline->radIntegrals.ex0 = beamline->radIntegrals.sigmadelta = NAN;
+    beamline->radIntegrals.Uo = beamline->radIntegrals.Pref = NAN;
+  }
+}
+
 double effectiveEllipticalAperture(double a, double b, double x, double y);
 
 SDDS_TABLE SDDS_SDrivingTerms;
@@ -1689,6 +1737,8 @@ void setup_twiss_output(NAMELIST_TEXT *nltext, RUN *run, LINE_LIST *beamline, lo
   *do_twiss_output = output_at_each_step;
   if (higher_order_chromaticity && !matched)
     bombElegant((char *)"higher order chromaticity calculations available only for a matched (periodic) beamline", NULL);
+  if (tpsa_chromaticity_order && (tpsa_chromaticity_order < 2 || tpsa_chromaticity_order >= TPSA_MAX_ORDER))
+    bombElegantVA((char *)"tpsa_chromaticity_order must be 0 or between 2 and %d", TPSA_MAX_ORDER - 1);
 
   if (reference_file && matched)
     bombElegant((char *)"reference_file and matched=1 are incompatible", NULL);
@@ -2063,6 +2113,26 @@ long run_twiss_output(RUN *run, LINE_LIST *beamline, double *starting_coord, lon
   return 1;
 }
 
+/* Computes chrom2 and chrom3 either from the TPSA one-turn map or by fitting the traces of
+ * matrices concatenated for several momentum offsets.
+ */
+static void computeTwissHigherOrderChromaticities(LINE_LIST *beamline, double *starting_coord, RUN *run) {
+  double chrom[2][TPSA_MAX_ORDER];
+  long i, order;
+
+  if (tpsa_chromaticity_order) {
+    order = computeTpsaChromaticities(chrom, tpsa_chromaticity_order, beamline->tune, beamline, starting_coord, run);
+    for (i = 0; i < 2; i++) {
+      beamline->chrom2[i] = order >= 2 ? chrom[i][1] : 0;
+      beamline->chrom3[i] = order >= 3 ? chrom[i][2] : 0;
+    }
+  } else
+    computeHigherOrderChromaticities(beamline, starting_coord, run, twissConcatOrder,
+                                     higher_order_chromaticity_range /
+                                       (higher_order_chromaticity_points - 1),
+                                     higher_order_chromaticity_points, quick_higher_order_chromaticity);
+}
+
 void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_coord,
                               long periodic,
                               long radiation_integrals_inner_scope,
@@ -2246,11 +2316,12 @@ void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_co
                             beamline->elast->twiss, M);
       beamline->chromaticity[0] = chromx;
       beamline->chromaticity[1] = chromy;
-      if (twissConcatOrder > 1 && higher_order_chromaticity)
-        computeHigherOrderChromaticities(beamline, starting_coord, run, twissConcatOrder,
-                                         higher_order_chromaticity_range /
-                                           (higher_order_chromaticity_points - 1),
-                                         higher_order_chromaticity_points, quick_higher_order_chromaticity);
+      if (twissConcatOrder > 1 && higher_order_chromaticity) {
+        if (twissComputationMask & TWISS_COMPUTE_HOCHROM || linearChromaticTrackingInitialized)
+          computeTwissHigherOrderChromaticities(beamline, starting_coord, run);
+        else
+          invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_HOCHROM);
+      }
       beamline->chromaticity[0] *= n_periods;
       beamline->chromaticity[1] *= n_periods;
       beamline->chrom2[0] *= n_periods;
@@ -2258,13 +2329,21 @@ void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_co
       beamline->chrom2[1] *= n_periods;
       beamline->chrom3[1] *= n_periods;
       computeChromaticTuneLimits(beamline);
-      if (doTuneShiftWithAmplitude)
-        computeTuneShiftWithAmplitude(beamline->dnux_dA, beamline->dnuy_dA,
-                                      beamline->nuxTswaExtrema, beamline->nuyTswaExtrema,
-                                      beamline->twiss0, beamline->tune, M, beamline, run,
-                                      starting_coord, n_periods);
-      if (compute_driving_terms)
-        computeDrivingTerms(&(beamline->drivingTerms), beamline->elem_twiss, beamline->twiss0, beamline->tune, n_periods);
+      if (doTuneShiftWithAmplitude) {
+        if (twissComputationMask & TWISS_COMPUTE_TSWA)
+          computeTuneShiftWithAmplitude(beamline->dnux_dA, beamline->dnuy_dA,
+                                        beamline->nuxTswaExtrema, beamline->nuyTswaExtrema,
+                                        beamline->twiss0, beamline->tune, M, beamline, run,
+                                        starting_coord, n_periods);
+        else
+          invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_TSWA);
+      }
+      if (compute_driving_terms) {
+        if (twissComputationMask & TWISS_COMPUTE_DRIVING)
+          computeDrivingTerms(&(beamline->drivingTerms), beamline->elem_twiss, beamline->twiss0, beamline->tune, n_periods);
+        else
+          invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_DRIVING);
+      }
       if (s_dependent_driving_terms_file)
         computeSDrivingTerms(beamline);
     }
@@ -2294,11 +2373,12 @@ void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_co
                             beamline->elast->twiss, M);
       beamline->chromaticity[0] = chromx;
       beamline->chromaticity[1] = chromy;
-      if (twissConcatOrder > 1 && higher_order_chromaticity)
-        computeHigherOrderChromaticities(beamline, starting_coord, run, twissConcatOrder,
-                                         higher_order_chromaticity_range /
-                                           (higher_order_chromaticity_points - 1),
-                                         higher_order_chromaticity_points, quick_higher_order_chromaticity);
+      if (twissConcatOrder > 1 && higher_order_chromaticity) {
+        if (twissComputationMask & TWISS_COMPUTE_HOCHROM || linearChromaticTrackingInitialized)
+          computeTwissHigherOrderChromaticities(beamline, starting_coord, run);
+        else
+          invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_HOCHROM);
+      }
       beamline->chromaticity[0] *= n_periods;
       beamline->chromaticity[1] *= n_periods;
       beamline->chrom2[0] *= n_periods;
@@ -2306,11 +2386,15 @@ void compute_twiss_parameters(RUN *run, LINE_LIST *beamline, double *starting_co
       beamline->chrom2[1] *= n_periods;
       beamline->chrom3[1] *= n_periods;
       computeChromaticTuneLimits(beamline);
-      if (doTuneShiftWithAmplitude)
-        computeTuneShiftWithAmplitude(beamline->dnux_dA, beamline->dnuy_dA,
-                                      beamline->nuxTswaExtrema, beamline->nuyTswaExtrema,
-                                      beamline->twiss0, beamline->tune, M, beamline, run,
-                                      starting_coord, n_periods);
+      if (doTuneShiftWithAmplitude) {
+        if (twissComputationMask & TWISS_COMPUTE_TSWA)
+          computeTuneShiftWithAmplitude(beamline->dnux_dA, beamline->dnuy_dA,
+                                        beamline->nuxTswaExtrema, beamline->nuyTswaExtrema,
+                                        beamline->twiss0, beamline->tune, M, beamline, run,
+                                        starting_coord, n_periods);
+        else
+          invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_TSWA);
+      }
 #ifdef DEBUG
       printf((char *)"chomaticities: %e, %e\n", chromx, chromy);
       fflush(stdout);
@@ -2403,9 +2487,11 @@ void update_twiss_parameters(RUN *run, LINE_LIST *beamline, unsigned long *unsta
   } else {
     compute_twiss_parameters(run, beamline,
                              beamline->closed_orbit ? beamline->closed_orbit->centroid : NULL, matched,
-                             radiation_integrals,
+                             radiation_integrals && twissComputationMask & TWISS_COMPUTE_RADINT,
                              beta_x, alpha_x, eta_x, etap_x, beta_y, alpha_y, eta_y, etap_y,
                              &unstable0);
+    if (radiation_integrals && !(twissComputationMask & TWISS_COMPUTE_RADINT))
+      invalidateMaskedTwissQuantities(beamline, TWISS_COMPUTE_RADINT);
   }
   if (unstable)
     *unstable = unstable0;
@@ -4057,6 +4143,110 @@ long computeTunesFromTracking(double *tune, double *amp, VMATRIX *M, LINE_LIST *
   return 1;
 }
 
+/* Multi-particle version of computeTunesFromTracking().  All particles are tracked
+ * together turn-by-turn, so the cost of each pass through the lattice is shared, then
+ * NAFF is performed on each particle's stored turn-by-turn data.  startingCoord[ip] gives
+ * the full starting coordinates for particle ip.  On return, status[ip] is 1 if tunes
+ * were found for particle ip and 0 if it was lost or NAFF failed.  Losses are always
+ * allowed.  Returns the number of particles with good tunes.
+ */
+long computeTunesFromTrackingMulti(double **tune, double **amp, short *status,
+                                   LINE_LIST *beamline, RUN *run, double **startingCoord, long nParticles,
+                                   long turns, long turnOffset, double **endingCoord,
+                                   double *tuneLowerLimit, double *tuneUpperLimit,
+                                   long nPeriods, unsigned long flags) {
+  double **coord, *tbt, *data, dummy, p, lower, upper;
+  double frequency[4], amplitude[4], phase[4];
+  long ip, id, i, j, plane, nLeft, nGood;
+  static const char *naffWarning[4] = {
+    "NAFF failed for tune analysis from tracking (x).\n",
+    "NAFF failed for tune analysis from tracking (xp).\n",
+    "NAFF failed for tune analysis from tracking (y).\n",
+    "NAFF failed for tune analysis from tracking (yp).\n"};
+
+  if (nParticles <= 0)
+    return 0;
+  coord = (double **)czarray_2d(sizeof(**coord), nParticles, totalPropertiesPerParticle);
+  /* turn-by-turn x, xp, y, yp for each particle, stored contiguously for NAFF */
+  tbt = (double *)tmalloc(sizeof(*tbt) * 4 * turns * nParticles);
+  for (ip = 0; ip < nParticles; ip++) {
+    memcpy(coord[ip], startingCoord[ip], 6 * sizeof(**coord));
+    coord[ip][particleIDIndex] = ip + 1;
+    status[ip] = 1;
+    for (j = 0; j < 4; j++)
+      tbt[(4 * ip + j) * turns] = coord[ip][j];
+  }
+
+  p = run->p_central;
+  nLeft = nParticles;
+  for (i = 1; i < turns && nLeft > 0; i++) {
+    nLeft = do_tracking(NULL, coord, nLeft, NULL, beamline, &p, (double **)NULL,
+                        (BEAM_SUMS **)NULL, (long *)NULL,
+                        (TRAJECTORY *)NULL, run, 0,
+                        TEST_PARTICLES + TEST_PARTICLE_LOSSES + TIME_DEPENDENCE_OFF,
+                        nPeriods, i - 1 + turnOffset, NULL, NULL, NULL, NULL, NULL);
+    for (ip = 0; ip < nLeft; ip++) {
+      if (isnan(coord[ip][0]) || isnan(coord[ip][1]) ||
+          isnan(coord[ip][2]) || isnan(coord[ip][3]) ||
+          isnan(coord[ip][4]) || isnan(coord[ip][5])) {
+        /* treat as lost: move to the top so it isn't tracked further */
+        swapParticles(coord[ip], coord[nLeft - 1]);
+        nLeft--;
+        ip--;
+        continue;
+      }
+      id = (long)coord[ip][particleIDIndex] - 1;
+      for (j = 0; j < 4; j++)
+        tbt[(4 * id + j) * turns + i] = coord[ip][j];
+    }
+  }
+  for (ip = nLeft; ip < nParticles; ip++)
+    status[(long)coord[ip][particleIDIndex] - 1] = 0;
+  if (endingCoord) {
+    for (ip = 0; ip < nLeft; ip++)
+      memcpy(endingCoord[(long)coord[ip][particleIDIndex] - 1], coord[ip], 6 * sizeof(**coord));
+  }
+
+  nGood = 0;
+  for (ip = 0; ip < nParticles; ip++) {
+    if (!status[ip])
+      continue;
+    for (j = 0; j < 4; j++) {
+      plane = j / 2;
+      if (!(flags & (plane == 0 ? CTFT_INCLUDE_X : CTFT_INCLUDE_Y)))
+        continue;
+      lower = tuneLowerLimit ? (tuneLowerLimit[plane] > 0.5 ? 1 - tuneLowerLimit[plane] : tuneLowerLimit[plane]) : 0;
+      upper = tuneUpperLimit ? (tuneUpperLimit[plane] > 0.5 ? 1 - tuneUpperLimit[plane] : tuneUpperLimit[plane]) : 0;
+      data = tbt + (4 * ip + j) * turns;
+      if (PerformNAFF(&frequency[j], &amplitude[j], &phase[j],
+                      &dummy, 0.0, 1.0, data, turns,
+                      NAFF_MAX_FREQUENCIES | NAFF_FREQ_CYCLE_LIMIT | NAFF_FREQ_ACCURACY_LIMIT,
+                      0.0, 1, 200, 1e-12, lower, upper) != 1) {
+        printWarning((char *)naffWarning[j], NULL);
+        status[ip] = 0;
+        break;
+      }
+    }
+    if (!status[ip])
+      continue;
+    if (flags & CTFT_INCLUDE_X)
+      tune[ip][0] = adjustTuneHalfPlane(frequency[0], phase[0], phase[1]);
+    if (flags & CTFT_INCLUDE_Y)
+      tune[ip][1] = adjustTuneHalfPlane(frequency[2], phase[2], phase[3]);
+    if (amp) {
+      if (flags & CTFT_INCLUDE_X)
+        amp[ip][0] = amplitude[0];
+      if (flags & CTFT_INCLUDE_Y)
+        amp[ip][1] = amplitude[2];
+    }
+    nGood++;
+  }
+
+  free(tbt);
+  free_czarray_2d((void **)coord, nParticles, totalPropertiesPerParticle);
+  return nGood;
+}
+
 double adjustTuneHalfPlane(double frequency, double phase0, double phase1) {
   if (fabs(phase0 - phase1) > PI) {
     if (phase0 < phase1)
@@ -4530,8 +4720,312 @@ typedef struct {
   double phix, phiy;
   std::complex<double> px[5], py[5]; /* px[j]=(exp(i*phix))^j j>0 */
   double b2L, b3L, s;
+  char *name;
 } ELEMDATA;
 
+/* Second-order detuning and driving terms from pairs of sextupoles (C. X. Wang
+ * AOP-TN-2009-020). These double sums are bilinear in the sextupole strengths, so they are
+ * accumulated per pair of sextupole families (elements with the same name and strength)
+ * with the strengths factored out. If the optics at the sextupoles is unchanged on the next
+ * call, as when only sextupoles are varied, the family sums are simply re-weighted with the
+ * new strengths, which is O(families^2) instead of O(sextupoles^2).
+ */
+typedef struct {
+  double dnux_dJx, dnux_dJy, dnuy_dJy;
+  std::complex<double> h22000, h31000, h11110, h11200, h40000, h20020, h20110, h20200;
+  std::complex<double> h00220, h00310, h00400;
+} SEXT_PAIR_SUM;
+
+typedef struct {
+  long nS, nF;           /* number of sextupoles and of families */
+  short valid, byFamily; /* if byFamily is zero, strengths are not factored out (too many families) */
+  double tune[2];
+  double *s, *betax, *betay, *phix, *phiy, *b3L; /* values at each sextupole for the cached sums */
+  long *family;                                  /* family of each sextupole */
+  char **familyName;
+  double *familyB3L;
+  SEXT_PAIR_SUM *familySum; /* nF x nF sums without the strengths */
+  long maxS, maxF;
+} SEXT_PAIR_CACHE;
+
+#define SEXT_PAIR_MAX_FAMILIES 256
+#define SEXT_PAIRS_MIN_PER_THREAD 32
+
+static SEXT_PAIR_CACHE sextPairCache;
+
+static void addSextPairSum(SEXT_PAIR_SUM *sum, SEXT_PAIR_SUM *term, double weight) {
+  sum->dnux_dJx += weight * term->dnux_dJx;
+  sum->dnux_dJy += weight * term->dnux_dJy;
+  sum->dnuy_dJy += weight * term->dnuy_dJy;
+  sum->h22000 += weight * term->h22000;
+  sum->h31000 += weight * term->h31000;
+  sum->h11110 += weight * term->h11110;
+  sum->h11200 += weight * term->h11200;
+  sum->h40000 += weight * term->h40000;
+  sum->h20020 += weight * term->h20020;
+  sum->h20110 += weight * term->h20110;
+  sum->h20200 += weight * term->h20200;
+  sum->h00220 += weight * term->h00220;
+  sum->h00310 += weight * term->h00310;
+  sum->h00400 += weight * term->h00400;
+}
+
+static void clearSextPairSums(SEXT_PAIR_SUM *sum, long n) {
+  long i;
+  for (i = 0; i < n; i++) {
+    sum[i].dnux_dJx = sum[i].dnux_dJy = sum[i].dnuy_dJy = 0;
+    sum[i].h22000 = sum[i].h31000 = sum[i].h11110 = sum[i].h11200 = sum[i].h40000 = 0;
+    sum[i].h20020 = sum[i].h20110 = sum[i].h20200 = sum[i].h00220 = sum[i].h00310 = sum[i].h00400 = 0;
+  }
+}
+
+/* Returns non-zero if the cached family sums apply to the sextupoles in ed[], in which case
+ * the present family strengths are left in familyB3L[].
+ */
+static long sextPairCacheMatches(ELEMDATA *ed, long nE, double *tune) {
+  SEXT_PAIR_CACHE *c = &sextPairCache;
+  long iE, k, f;
+  short *seen;
+
+  if (!c->valid || c->tune[0] != tune[0] || c->tune[1] != tune[1])
+    return 0;
+  seen = (short *)tmalloc(sizeof(*seen) * (c->nF + 1));
+  for (f = 0; f < c->nF; f++)
+    seen[f] = 0;
+  for (iE = k = 0; iE < nE; iE++) {
+    if (!ed[iE].b3L)
+      continue;
+    if (k == c->nS || ed[iE].s != c->s[k] || ed[iE].betax != c->betax[k] || ed[iE].betay != c->betay[k] ||
+        ed[iE].phix != c->phix[k] || ed[iE].phiy != c->phiy[k])
+      break;
+    f = c->family[k];
+    if (!c->byFamily) {
+      if (ed[iE].b3L != c->b3L[k])
+        break;
+    } else {
+      if (strcmp(ed[iE].name, c->familyName[f]) != 0)
+        break;
+      if (!seen[f]) {
+        c->familyB3L[f] = ed[iE].b3L;
+        seen[f] = 1;
+      } else if (ed[iE].b3L != c->familyB3L[f])
+        break;
+    }
+    k++;
+  }
+  free(seen);
+  return iE == nE && k == c->nS;
+}
+
+/* Sums over all ordered pairs of sextupoles, with each pair's terms multiplied by the weights of
+ * the two sextupoles and added to the sum for their pair of families.
+ */
+static void accumulateSextPairSums(SEXT_PAIR_SUM *familySum, long nF, long *family, double *weight,
+                                   double *s, double *betax, double *betay, double *phix, double *phiy,
+                                   std::complex<double> *px1, std::complex<double> *px3, std::complex<double> *py2,
+                                   long nS, long iFirst, long iLast, double *tune) {
+  std::complex<double> ii, cx1, cx3, cp, cm, ex, ey2, c, t1;
+  std::complex<double> pxij, pyij;
+  double sx1, sx3, sp, sm, C1, C3, Cp, Cm, rbxij, termSign, nux, nuy;
+  SEXT_PAIR_SUM *sum;
+  long i, j;
+
+  nux = tune[0];
+  nuy = tune[1];
+  ii = std::complex<double>(0, 1);
+  /* cos(|dphix| - PI*nux) = Re(exp(i*|dphix|)*cx1), etc. */
+  cx1 = exp(-ii * (PI * nux));
+  cx3 = exp(-ii * (3 * PI * nux));
+  cp = exp(-ii * (PI * (nux + 2 * nuy)));
+  cm = exp(-ii * (PI * (nux - 2 * nuy)));
+  sx1 = sin(PI * nux);
+  sx3 = sin(3 * PI * nux);
+  sp = sin(PI * (nux + 2 * nuy));
+  sm = sin(PI * (nux - 2 * nuy));
+
+  for (i = iFirst; i <= iLast; i++) {
+    for (j = 0; j < nS; j++) {
+      sum = familySum + family[i] * nF + family[j];
+      /* exp(i*|phix_i-phix_j|) and exp(2i*|phiy_i-phiy_j|) from the phase factors */
+      pxij = px1[i] * conj(px1[j]);
+      pyij = py2[i] * conj(py2[j]);
+      ex = phix[i] >= phix[j] ? pxij : conj(pxij);
+      ey2 = phiy[i] >= phiy[j] ? pyij : conj(pyij);
+      C1 = (ex * cx1).real() / sx1;
+      C3 = (ex * ex * ex * cx3).real() / sx3;
+      Cp = (ex * ey2 * cp).real() / sp;
+      Cm = (ex * conj(ey2) * cm).real() / sm;
+      rbxij = weight[i] * weight[j] * sqrt(betax[i] * betax[j]);
+      sum->dnux_dJx += rbxij / (-16 * PI) * betax[i] * betax[j] * (3 * C1 + C3);
+      sum->dnux_dJy += rbxij / (8 * PI) * betay[i] * (2 * betax[j] * C1 - betay[j] * Cp + betay[j] * Cm);
+      sum->dnuy_dJy += rbxij / (-16 * PI) * betay[i] * betay[j] * (4 * C1 + Cp + Cm);
+      if (s[i] == s[j])
+        continue;
+      termSign = SIGN(s[i] - s[j]);
+      /* geometric terms */
+      c = termSign * ii * rbxij;
+      t1 = conj(pxij); /* exp(-i*(phix_i-phix_j)) */
+      sum->h22000 += (1. / 64) * c * betax[i] * betax[j] * (px3[i] * conj(px3[j]) + 3. * pxij);
+      sum->h31000 += (1. / 32) * c * betax[i] * betax[j] * px3[i] * conj(px1[j]);
+      sum->h11110 += (1. / 16) * c * betay[i] * (betax[j] * (t1 - pxij) + betay[j] * pyij * (pxij + t1));
+      sum->h11200 += (1. / 32) * c * betay[i] * py2[i] * (betax[j] * (t1 - pxij) + 2. * betay[j] * (pxij + t1));
+      sum->h40000 += (1. / 64) * c * betax[i] * betax[j] * px3[i] * px1[j];
+      sum->h20020 += (1. / 64) * c * betay[i] *
+                     (betax[j] * conj(px1[i] * py2[i]) * px3[j] - (betax[j] + 4 * betay[j]) * px1[i] * px1[j] * conj(py2[i]));
+      sum->h20110 += (1. / 32) * c * betay[i] *
+                     (betax[j] * (conj(px1[i]) * px3[j] - px1[i] * px1[j]) + 2. * betay[j] * px1[i] * px1[j] * pyij);
+      sum->h20200 += (1. / 64) * c * betay[i] *
+                     (betax[j] * conj(px1[i]) * px3[j] * py2[i] - (betax[j] - 4 * betay[j]) * px1[i] * px1[j] * py2[i]);
+      sum->h00220 += (1. / 64) * c * betay[i] * betay[j] *
+                     (pxij * pyij + 4. * pxij - conj(px1[i] * py2[j]) * px1[j] * py2[i]);
+      sum->h00310 += (1. / 32) * c * betay[i] * betay[j] * py2[i] * (pxij - t1);
+      sum->h00400 += (1. / 64) * c * betay[i] * betay[j] * pxij * py2[i] * py2[j];
+    }
+  }
+}
+
+static void rebuildSextPairCache(ELEMDATA *ed, long nE, double *tune) {
+  SEXT_PAIR_CACHE *c = &sextPairCache;
+  std::complex<double> *px1, *px3, *py2;
+  double *weight;
+  SEXT_PAIR_SUM *threadSum;
+  long iE, k, f, nS, nThreads, sumSize;
+
+  for (f = 0; f < c->nF; f++)
+    if (c->familyName && c->familyName[f])
+      free(c->familyName[f]);
+  c->valid = 0;
+  for (iE = nS = 0; iE < nE; iE++)
+    if (ed[iE].b3L)
+      nS++;
+  if (nS > c->maxS) {
+    c->maxS = nS;
+    c->s = (double *)trealloc(c->s, sizeof(*c->s) * nS);
+    c->betax = (double *)trealloc(c->betax, sizeof(*c->betax) * nS);
+    c->betay = (double *)trealloc(c->betay, sizeof(*c->betay) * nS);
+    c->phix = (double *)trealloc(c->phix, sizeof(*c->phix) * nS);
+    c->phiy = (double *)trealloc(c->phiy, sizeof(*c->phiy) * nS);
+    c->b3L = (double *)trealloc(c->b3L, sizeof(*c->b3L) * nS);
+    c->family = (long *)trealloc(c->family, sizeof(*c->family) * nS);
+  }
+  if (!c->familyName) {
+    c->familyName = (char **)tmalloc(sizeof(*c->familyName) * SEXT_PAIR_MAX_FAMILIES);
+    c->familyB3L = (double *)tmalloc(sizeof(*c->familyB3L) * SEXT_PAIR_MAX_FAMILIES);
+  }
+  c->nS = nS;
+  c->nF = 0;
+  c->byFamily = 1;
+  for (iE = k = 0; iE < nE; iE++) {
+    if (!ed[iE].b3L)
+      continue;
+    c->s[k] = ed[iE].s;
+    c->betax[k] = ed[iE].betax;
+    c->betay[k] = ed[iE].betay;
+    c->phix[k] = ed[iE].phix;
+    c->phiy[k] = ed[iE].phiy;
+    c->b3L[k] = ed[iE].b3L;
+    if (c->byFamily) {
+      for (f = 0; f < c->nF; f++)
+        if (c->familyB3L[f] == ed[iE].b3L && strcmp(c->familyName[f], ed[iE].name) == 0)
+          break;
+      if (f == c->nF) {
+        if (c->nF == SEXT_PAIR_MAX_FAMILIES)
+          c->byFamily = 0;
+        else {
+          cp_str(&c->familyName[f], ed[iE].name);
+          c->familyB3L[f] = ed[iE].b3L;
+          c->nF++;
+        }
+      }
+      c->family[k] = f;
+    }
+    k++;
+  }
+  if (!c->byFamily) {
+    /* too many families: sum with the strengths included, which can't be reused for new strengths */
+    for (f = 0; f < c->nF; f++)
+      free(c->familyName[f]);
+    c->nF = 1;
+    c->familyName[0] = NULL;
+    c->familyB3L[0] = 1;
+    for (k = 0; k < nS; k++)
+      c->family[k] = 0;
+  }
+
+  weight = (double *)tmalloc(sizeof(*weight) * (nS + 1));
+  px1 = (std::complex<double> *)tmalloc(sizeof(*px1) * (nS + 1));
+  px3 = (std::complex<double> *)tmalloc(sizeof(*px3) * (nS + 1));
+  py2 = (std::complex<double> *)tmalloc(sizeof(*py2) * (nS + 1));
+  for (iE = k = 0; iE < nE; iE++) {
+    if (!ed[iE].b3L)
+      continue;
+    weight[k] = c->byFamily ? 1 : ed[iE].b3L;
+    px1[k] = ed[iE].px[1];
+    px3[k] = ed[iE].px[3];
+    py2[k] = ed[iE].py[2];
+    k++;
+  }
+
+  sumSize = c->nF * c->nF;
+  if (sumSize > c->maxF) {
+    c->maxF = sumSize;
+    c->familySum = (SEXT_PAIR_SUM *)trealloc(c->familySum, sizeof(*c->familySum) * sumSize);
+  }
+  clearSextPairSums(c->familySum, sumSize);
+
+  nThreads = 1;
+#if defined(_OPENMP)
+  if (trackingThreads > 1 && !omp_in_parallel() && (nThreads = nS / SEXT_PAIRS_MIN_PER_THREAD) > trackingThreads)
+    nThreads = trackingThreads;
+  if (nThreads < 1)
+    nThreads = 1;
+#endif
+  if (nThreads == 1)
+    accumulateSextPairSums(c->familySum, c->nF, c->family, weight, c->s, c->betax, c->betay, c->phix, c->phiy,
+                           px1, px3, py2, nS, 0, nS - 1, tune);
+  else {
+    /* each thread sums a contiguous block of rows; the blocks are added in order afterwards */
+    threadSum = (SEXT_PAIR_SUM *)tmalloc(sizeof(*threadSum) * sumSize * nThreads);
+    clearSextPairSums(threadSum, sumSize * nThreads);
+#if defined(_OPENMP)
+#  pragma omp parallel num_threads(nThreads)
+#endif
+    {
+      long iFirst, iLast, iThread = 0;
+#if defined(_OPENMP)
+      iThread = omp_get_thread_num();
+#endif
+      particleThreadRange(nS, &iFirst, &iLast);
+      accumulateSextPairSums(threadSum + sumSize * iThread, c->nF, c->family, weight,
+                             c->s, c->betax, c->betay, c->phix, c->phiy, px1, px3, py2, nS, iFirst, iLast, tune);
+    }
+    for (k = 0; k < nThreads; k++)
+      for (f = 0; f < sumSize; f++)
+        addSextPairSum(c->familySum + f, threadSum + sumSize * k + f, 1);
+    free(threadSum);
+  }
+
+  free(weight);
+  free(px1);
+  free(px3);
+  free(py2);
+  c->tune[0] = tune[0];
+  c->tune[1] = tune[1];
+  c->valid = 1;
+}
+
+/* Adds the sextupole-pair contributions to the second-order terms to *total */
+static void computeSextupolePairTerms(SEXT_PAIR_SUM *total, ELEMDATA *ed, long nE, double *tune) {
+  SEXT_PAIR_CACHE *c = &sextPairCache;
+  long f, g;
+
+  if (!sextPairCacheMatches(ed, nE, tune))
+    rebuildSextPairCache(ed, nE, tune);
+  for (f = 0; f < c->nF; f++)
+    for (g = 0; g < c->nF; g++)
+      addSextPairSum(total, c->familySum + f * c->nF + g, c->familyB3L[f] * c->familyB3L[g]);
+}
+
 void computeSDrivingTerms(LINE_LIST *beamline) {
 
   /* Skew quadrupole */
@@ -4764,16 +5258,14 @@ void computeDrivingTerms(DRIVING_TERMS *d, ELEMENT_LIST *elem, TWISS *twiss0, do
   std::complex<double> h21000, h30000, h10110, h10020, h10200;
   std::complex<double> h22000, h11110, h00220, h31000, h40000;
   std::complex<double> h20110, h11200, h20020, h20200, h00310, h00400;
-  std::complex<double> t1, t2, t3, t4;
   std::complex<double> ii;
   std::complex<double> periodicFactor[9][9];
 #define PF(i, j) (periodicFactor[4 + i][4 + j])
-  double betax1, betay1, phix1, phiy1, etax1, termSign;
-  double b2L, a2L, b3L, b4L, nux, nuy;
+  double betax1, betay1, phix1, phiy1, etax1;
+  double b2L, a2L, b3L, b4L;
   ELEMENT_LIST *eptr1;
-  double two = 2, three = 3, four = 4;
   ELEMDATA *ed = NULL;
-  long nE = 0, iE, jE, i, j;
+  long nE = 0, maxE = 0, i, j;
   //double sqrt8, sqrt2;
   double tilt;
 
@@ -4870,8 +5362,10 @@ void computeDrivingTerms(DRIVING_TERMS *d, ELEMENT_LIST *elem, TWISS *twiss0, do
         phiy1 = (eptr1->twiss->phiy + twiss0->phiy) / 2;
       }
 
-      ed = (ELEMDATA *)SDDS_Realloc(ed, sizeof(*ed) * (nE + 1));
+      if (nE == maxE)
+        ed = (ELEMDATA *)SDDS_Realloc(ed, sizeof(*ed) * (maxE += 100));
       ed[nE].s = eptr1->end_pos;
+      ed[nE].name = eptr1->name;
       ed[nE].b2L = b2L;
       ed[nE].b3L = b3L;
       ed[nE].betax = betax1;
@@ -4995,70 +5489,23 @@ void computeDrivingTerms(DRIVING_TERMS *d, ELEMENT_LIST *elem, TWISS *twiss0, do
     if (nPeriods != 1)
       bombElegant("Computating of higher-order driving terms not available when n_periods!=1", NULL);
 
-    nux = tune[0];
-    nuy = tune[1];
-    for (iE = 0; iE < nE; iE++) {
-      if (ed[iE].b3L) {
-        for (jE = 0; jE < nE; jE++) {
-          if (ed[jE].b3L) {
-            d->dnux_dJx += ed[iE].b3L * ed[jE].b3L / (-16 * PI) * pow(ed[iE].betax * ed[jE].betax, 1.5) *
-                           (3 * cos(fabs(ed[iE].phix - ed[jE].phix) - PI * nux) / sin(PI * nux) + cos(fabs(3 * (ed[iE].phix - ed[jE].phix)) - 3 * PI * nux) / sin(3 * PI * nux));
-            d->dnux_dJy += ed[iE].b3L * ed[jE].b3L / (8 * PI) * sqrt(ed[iE].betax * ed[jE].betax) * ed[iE].betay *
-                           (2 * ed[jE].betax * cos(fabs(ed[iE].phix - ed[jE].phix) - PI * nux) / sin(PI * nux) - ed[jE].betay * cos(fabs(ed[iE].phix - ed[jE].phix) + 2 * fabs(ed[iE].phiy - ed[jE].phiy) - PI * (nux + 2 * nuy)) / sin(PI * (nux + 2 * nuy)) + ed[jE].betay * cos(fabs(ed[iE].phix - ed[jE].phix) - 2 * fabs(ed[iE].phiy - ed[jE].phiy) - PI * (nux - 2 * nuy)) / sin(PI * (nux - 2 * nuy)));
-            d->dnuy_dJy += ed[iE].b3L * ed[jE].b3L / (-16 * PI) * sqrt(ed[iE].betax * ed[jE].betax) * ed[iE].betay * ed[jE].betay *
-                           (4 * cos(fabs(ed[iE].phix - ed[jE].phix) - PI * nux) / sin(PI * nux) + cos(fabs(ed[iE].phix - ed[jE].phix) + 2 * fabs(ed[iE].phiy - ed[jE].phiy) - PI * (nux + 2 * nuy)) / sin(PI * (nux + 2 * nuy)) + cos(fabs(ed[iE].phix - ed[jE].phix) - 2 * fabs(ed[iE].phiy - ed[jE].phiy) - PI * (nux - 2 * nuy)) / sin(PI * (nux - 2 * nuy)));
-            termSign = SIGN(ed[iE].s - ed[jE].s);
-            if (termSign) {
-              /* geometric terms */
-              h22000 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betax * ed[jE].betax *
-                        (ed[iE].px[3] * conj(ed[jE].px[3]) + three * ed[iE].px[1] * conj(ed[jE].px[1]));
-              h31000 += (1. / 32) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betax * ed[jE].betax *
-                        ed[iE].px[3] * conj(ed[jE].px[1]);
-              t1 = conj(ed[iE].px[1]) * ed[jE].px[1];
-              t2 = ed[iE].px[1] * conj(ed[jE].px[1]);
-              h11110 += (1. / 16) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay *
-                        (ed[jE].betax * (t1 - conj(t1)) +
-                         ed[jE].betay * ed[iE].py[2] * conj(ed[jE].py[2]) * (conj(t1) + t1));
-              t1 = exp(-ii * (ed[iE].phix - ed[jE].phix));
-              t2 = conj(t1);
-              h11200 += (1. / 32) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay * exp(ii * (2 * ed[iE].phiy)) *
-                        (ed[jE].betax * (t1 - t2) +
-                         two * ed[jE].betay * (t2 + t1));
-              h40000 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betax * ed[jE].betax *
-                        ed[iE].px[3] * ed[jE].px[1];
-              h20020 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay *
-                        (ed[jE].betax * conj(ed[iE].px[1] * ed[iE].py[2]) * ed[jE].px[3] - (ed[jE].betax + four * ed[jE].betay) * ed[iE].px[1] * ed[jE].px[1] * conj(ed[iE].py[2]));
-              h20110 += (1. / 32) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay *
-                        (ed[jE].betax * (conj(ed[iE].px[1]) * ed[jE].px[3] -
-                                         ed[iE].px[1] * ed[jE].px[1]) +
-                         two * ed[jE].betay * ed[iE].px[1] * ed[jE].px[1] * ed[iE].py[2] * conj(ed[jE].py[2]));
-              h20200 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay *
-                        (ed[jE].betax *
-                           conj(ed[iE].px[1]) * ed[jE].px[3] * ed[iE].py[2] -
-                         (ed[jE].betax - four * ed[jE].betay) *
-                           ed[iE].px[1] * ed[jE].px[1] * ed[iE].py[2]);
-              h00220 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay * ed[jE].betay *
-                        (ed[iE].px[1] * ed[iE].py[2] * conj(ed[jE].px[1] * ed[jE].py[2]) + four * ed[iE].px[1] * conj(ed[jE].px[1]) - conj(ed[iE].px[1] * ed[jE].py[2]) * ed[jE].px[1] * ed[iE].py[2]);
-              h00310 += (1. / 32) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay * ed[jE].betay * ed[iE].py[2] *
-                        (ed[iE].px[1] * conj(ed[jE].px[1]) - conj(ed[iE].px[1]) * ed[jE].px[1]);
-              h00400 += (1. / 64) * termSign * ii * ed[iE].b3L * ed[jE].b3L *
-                        ed[iE].rbetax * ed[jE].rbetax * ed[iE].betay * ed[jE].betay *
-                        ed[iE].px[1] * conj(ed[jE].px[1]) * ed[iE].py[2] * ed[jE].py[2];
-            }
-          }
-        }
-      }
-    }
+    SEXT_PAIR_SUM pairSum;
+    clearSextPairSums(&pairSum, 1);
+    computeSextupolePairTerms(&pairSum, ed, nE, tune);
+    d->dnux_dJx += pairSum.dnux_dJx;
+    d->dnux_dJy += pairSum.dnux_dJy;
+    d->dnuy_dJy += pairSum.dnuy_dJy;
+    h22000 += pairSum.h22000;
+    h31000 += pairSum.h31000;
+    h11110 += pairSum.h11110;
+    h11200 += pairSum.h11200;
+    h40000 += pairSum.h40000;
+    h20020 += pairSum.h20020;
+    h20110 += pairSum.h20110;
+    h20200 += pairSum.h20200;
+    h00220 += pairSum.h00220;
+    h00310 += pairSum.h00310;
+    h00400 += pairSum.h00400;
   }
 
   d->h22000[0] = std::abs<double>(h22000);
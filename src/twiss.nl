@@ -68,6 +68,7 @@
     long higher_order_chromaticity_points = 5;
     double higher_order_chromaticity_range = 4e-4;
     long quick_higher_order_chromaticity = 0;
+    long tpsa_chromaticity_order = 0;
     double chromatic_tune_spread_half_range = 0;
     long cavities_are_drifts_if_matched = 1;
     long compute_driving_terms = 0;
@@ -184,9 +184,9 @@ long trackUndulatorKickMap(
           if (radCoef)
             coord[5] -= radCoef * I2 * deltaFactor;
           if (isrCoef)
-            coord[5] += isrCoef * sqrtI3 * deltaFactor * gauss_rn_lim(0.0, 1.0, 3.0, random_2);
+            coord[5] += isrCoef * sqrtI3 * deltaFactor * gauss_rn_lim_elegant(0.0, 1.0, 3.0, random_2_elegant);
           if (sxpCoef && sqrtBeta)
-            coord[1] += sxpCoef * sqrtI5 * (1 + delta) / sqrtBeta * gauss_rn_lim(0.0, 1.0, 3.0, random_2);
+            coord[1] += sxpCoef * sqrtI5 * (1 + delta) / sqrtBeta * gauss_rn_lim_elegant(0.0, 1.0, 3.0, random_2_elegant);
         }
       }
     }
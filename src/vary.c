@@ -72,6 +72,27 @@ void vary_setup(VARY *_control, NAMELIST_TEXT *nltext, RUN *run, LINE_LIST *beam
   _control->stepDoneSemaphore = compose_filename(step_done_semaphore, run->rootname);
   _control->semaphoreCheckInterval = semaphore_check_interval;
   _control->restartFiles = restart_files;
+  if ((_control->stepWorkers = n_step_workers) < 0)
+    bombElegant("n_step_workers < 0", NULL);
+  if (_control->stepWorkers > 1) {
+#if USE_MPI || !defined(__unix__)
+    printWarning("run_control: n_step_workers>1 is not supported in this version.", "Steps will be run sequentially.");
+    _control->stepWorkers = 1;
+#else
+    if (restart_files || (wait_for_step_semaphore && strlen(wait_for_step_semaphore)) ||
+        (step_done_semaphore && strlen(step_done_semaphore)))
+      bombElegant("n_step_workers>1 is incompatible with restart_files and step semaphores", NULL);
+    /* each worker establishes its own phase references on the first step it runs, so these
+     * must not carry over from one step to the next */
+    if (!reset_rf_for_each_step || bunch_frequency || first_is_fiducial)
+      bombElegant("n_step_workers>1 requires reset_rf_for_each_step=1, bunch_frequency=0, and first_is_fiducial=0", NULL);
+#endif
+  }
+  /* unless symplectified, the polynomial maps are truncated Taylor maps, so errors
+   * accumulate from pass to pass */
+  if (run->polynomialMapOrder && !run->symplectifyPolynomialMap && n_passes > 100)
+    printWarning("run_control: polynomial_map_order is used with symplectify_polynomial_map=0 and n_passes>100.",
+                 "The truncated maps are not symplectic, so results of long-term tracking (e.g., damping or growth of amplitudes) may be unphysical.");
   if (first_is_fiducial)
     _control->fiducial_flag = FIRST_BEAM_IS_FIDUCIAL |
                               (restrict_fiducialization ? RESTRICT_FIDUCIALIZATION : 0);
@@ -302,7 +323,10 @@ long vary_beamline(VARY *_control, ERRORVAL *errcon, RUN *run, LINE_LIST *beamli
   /* printf("Reseting special elements in preparation for new step.\n"); */
   reset_special_elements(beamline, _control->reset_rf_each_step ? RESET_INCLUDE_ALL : RESET_INCLUDE_RANDOM | RESET_INCLUDE_NIELEM);
 
-  if (_control->reset_scattering_seed)
+  if (_control->stepWorkers) {
+    commitStepWorkerOutput();
+    reseedStepRandomNumbers(_control->i_step);
+  } else if (_control->reset_scattering_seed)
     seedElegantRandomNumbers(0, RESTART_RN_SCATTER);
 
   do_perturbations = step_incremented = 0;
@@ -20,6 +20,7 @@
     STRING step_done_semaphore = NULL;
     double semaphore_check_interval = 1.0;
     long restart_files = 0;
+    long n_step_workers = 0;
 #end
 
 #namelist vary_element static
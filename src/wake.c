@@ -252,9 +252,11 @@ void track_through_wake(double **part0, long np0, WAKE *wakeData, double *PoInpu
          */
       if (isSlave || !notSinglePart) {
         Vtime[nb] = 0;
-        convolveArrays(Vtime, nb,
-                       Itime, nb,
-                       wakeData->W, wakeData->wakePoints, wakeData->i0);
+        if (wakeData->convolutionMode == WAKE_CONVOLUTION_DIRECT)
+          convolveOccupiedBins(Vtime, nb, Itime, wakeData->W, wakeData->wakePoints, wakeData->i0, pbin, np);
+        else
+          convolveWithWakeSpectrum(Vtime, nb, Itime, wakeData->W, wakeData->wakePoints, wakeData->i0,
+                                   wakeData->convolutionMode, &wakeData->spectrum);
 
         factor = wakeData->macroParticleCharge * particleRelSign * wakeData->factor * rampFactor;
         for (ib = 0; ib < nb; ib++)
@@ -475,30 +477,17 @@ void set_up_wake(WAKE *wakeData, RUN *run, long pass, long particles, CHARGE *ch
       }
     }
   }
-}
 
-void convolveArrays(double *output, long outputs,
-                    double *a1, long n1,
-                    double *a2, long n2, long di2) {
-  long ib, ib1, ib2, di;
-  for (ib = 0; ib < outputs; ib++) {
-    output[ib] = 0;
-    ib2 = ib + di2;
-    ib1 = di = 0;
-    if (ib2 >= n2) {
-      di = ib2 - n2 + 1;
-      ib1 += di;
-      ib2 -= di;
-    }
-    for (; ib1 < n1 && ib2 >= 0; ib1++, ib2--)
-      output[ib] += a1[ib1] * a2[ib2];
-  }
+  wakeData->convolutionMode = parseWakeConvolutionMode(wakeData->convolution, "WAKE");
+  setUpWakeSpectrum(&wakeData->spectrum, wakeData->W, wakeData->n_bins, wakeData->wakePoints, wakeData->i0,
+                    wakeData->convolutionMode);
 }
 
 long binTimeDistribution(double *Itime, long *pbin, double tmin,
                          double dt, long nb, double *time, double **part, double Po, long np) {
   long ib, ip, n_binned;
 
+  elementProfilerStartCollective(PROFILE_HISTOGRAM);
   for (ib = 0; ib < nb; ib++)
     Itime[ib] = 0;
 
@@ -514,6 +503,7 @@ long binTimeDistribution(double *Itime, long *pbin, double tmin,
     pbin[ip] = ib;
     n_binned++;
   }
+  elementProfilerEndCollective(PROFILE_HISTOGRAM);
   return n_binned;
 }
 
@@ -629,6 +619,7 @@ void track_through_corgpipe(double **part, long np, CORGPIPE *corgpipe, double *
   wakeData.change_p0 = corgpipe->change_p0;
   wakeData.allowLongBeam = corgpipe->allowLongBeam;
   wakeData.acausalAllowed = wakeData.i0 = 0;
+  wakeData.convolutionMode = WAKE_CONVOLUTION_DIRECT;
   wakeData.rampPasses = corgpipe->rampPasses;
   wakeData.initialized = 1;
   wakeData.wakePoints = n_bins;
@@ -763,6 +754,7 @@ void track_through_corgplates(double **part, long np, CORGPLATES *corgplates, do
   wakeData.change_p0 = corgplates->change_p0;
   wakeData.allowLongBeam = corgplates->allowLongBeam;
   wakeData.acausalAllowed = wakeData.i0 = 0;
+  wakeData.convolutionMode = WAKE_CONVOLUTION_DIRECT;
   wakeData.rampPasses = corgplates->rampPasses;
   wakeData.initialized = 1;
   wakeData.wakePoints = n_bins;
@@ -0,0 +1,208 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: wakeConvolution.c
+ * purpose: convolution of beam histograms with wake functions, for WAKE, TRWAKE, and
+ * the other wake elements.
+ *
+ * convolveArrays() is the direct sum. convolveOccupiedBins() does the same sum only for
+ * bins that are needed, and convolveWithWakeSpectrum() uses FFTs (one transform, or
+ * overlap-add blocks) with a cached spectrum of the wake. These are kept apart from the
+ * element code so that wakeConvolutionTest can check them against each other.
+ */
+#include "mdb.h"
+#include "track.h"
+#include "match_string.h"
+#include "fftpackC.h"
+
+void convolveArrays(double *output, long outputs,
+                    double *a1, long n1,
+                    double *a2, long n2, long di2) {
+  long ib, ib1, ib2, di;
+  elementProfilerStartCollective(PROFILE_WAKE);
+  for (ib = 0; ib < outputs; ib++) {
+    output[ib] = 0;
+    ib2 = ib + di2;
+    ib1 = di = 0;
+    if (ib2 >= n2) {
+      di = ib2 - n2 + 1;
+      ib1 += di;
+      ib2 -= di;
+    }
+    for (; ib1 < n1 && ib2 >= 0; ib1++, ib2--)
+      output[ib] += a1[ib1] * a2[ib2];
+  }
+  elementProfilerEndCollective(PROFILE_WAKE);
+}
+
+/* Equivalent to convolveArrays(output, n, a1, n, a2, n2, di2), except that the output is only
+ * computed for bins that hold particles (per pbin) or are next to such bins, since only those
+ * are used in kicking the particles, and that empty bins of a1 are skipped. The time needed is
+ * thus set by the occupied bins rather than by the full binning window, which is mostly empty
+ * for bunch trains and beams with long tails. Other output bins are set to zero.
+ */
+void convolveOccupiedBins(double *output, long n, double *a1, double *a2, long n2, long di2,
+                          long *pbin, long np) {
+  long *occupied, nOccupied, ib, ib1, ip, j, jFirst;
+  char *needed;
+
+  elementProfilerStartCollective(PROFILE_WAKE);
+  occupied = tmalloc(sizeof(*occupied) * (n + 1));
+  needed = tmalloc(sizeof(*needed) * (n + 1));
+  for (ib = nOccupied = 0; ib < n; ib++) {
+    output[ib] = 0;
+    needed[ib] = 0;
+    if (a1[ib])
+      occupied[nOccupied++] = ib;
+  }
+  for (ip = 0; ip < np; ip++) {
+    if ((ib = pbin[ip]) < 0 || ib >= n)
+      continue;
+    needed[ib] = 1;
+    if (ib > 0)
+      needed[ib - 1] = 1;
+    if (ib < n - 1)
+      needed[ib + 1] = 1;
+  }
+
+  jFirst = 0;
+  for (ib = 0; ib < n; ib++) {
+    if (!needed[ib])
+      continue;
+    /* bin ib1 contributes through a2[ib+di2-ib1], so ib+di2-n2 < ib1 <= ib+di2 */
+    while (jFirst < nOccupied && occupied[jFirst] <= ib + di2 - n2)
+      jFirst++;
+    for (j = jFirst; j < nOccupied && (ib1 = occupied[j]) <= ib + di2; j++)
+      output[ib] += a1[ib1] * a2[ib + di2 - ib1];
+  }
+
+  free(occupied);
+  free(needed);
+  elementProfilerEndCollective(PROFILE_WAKE);
+}
+
+static char *wakeConvolutionModeChoice[N_WAKE_CONVOLUTION_MODES] = {
+  "direct",
+  "fft",
+  "overlap-add",
+};
+
+long parseWakeConvolutionMode(char *mode, char *elementType) {
+  long code;
+  if (!mode || !strlen(mode))
+    return WAKE_CONVOLUTION_DIRECT;
+  if ((code = match_string(mode, wakeConvolutionModeChoice, N_WAKE_CONVOLUTION_MODES, 0)) < 0)
+    bombElegantVA("Unknown CONVOLUTION value \"%s\" for %s element. Use \"direct\", \"fft\", or \"overlap-add\".\n",
+                  mode, elementType);
+  return code;
+}
+
+/* Smallest FFT length used for the blocks of the overlap-add method */
+#define WAKE_OVERLAP_ADD_MIN_FFT 1024
+
+static long nextPowerOfTwo(long n) {
+  long m = 1;
+  while (m < n)
+    m *= 2;
+  return m;
+}
+
+/* Chooses the FFT length for convolving an n-bin histogram with an n2-point wake whose t=0 point
+ * is at index di2, and the number of wake points that need to be included. With the "fft" method
+ * the whole histogram is done in one transform. With "overlap-add", the histogram is done in blocks
+ * about as long as the wake, if that gives a shorter transform.
+ */
+static long chooseWakeFFTLength(long n, long n2, long di2, long mode, long *wakePoints) {
+  long nw, nFFT, nFFTBlock;
+
+  /* output bin ib uses wake points up to ib+di2 */
+  nw = n2 < n + di2 ? n2 : n + di2;
+  nFFT = nextPowerOfTwo(n + nw - 1);
+  if (mode == WAKE_CONVOLUTION_OVERLAP_ADD) {
+    nFFTBlock = nextPowerOfTwo(2 * nw > WAKE_OVERLAP_ADD_MIN_FFT ? 2 * nw : WAKE_OVERLAP_ADD_MIN_FFT);
+    if (nFFTBlock < nFFT)
+      nFFT = nFFTBlock;
+  }
+  *wakePoints = nw;
+  return nFFT;
+}
+
+static void prepareWakeSpectrum(WAKE_SPECTRUM *spectrum, double *W, long wakePoints, long nFFT) {
+  long i;
+
+  if (spectrum->data && spectrum->nFFT == nFFT && spectrum->wakePoints == wakePoints && spectrum->W == W)
+    return;
+  spectrum->data = trealloc(spectrum->data, sizeof(*spectrum->data) * (nFFT + 2));
+  for (i = 0; i < nFFT; i++)
+    spectrum->data[i] = i < wakePoints ? W[i] : 0;
+  realFFT2(spectrum->data, spectrum->data, nFFT, 0);
+  /* the forward transform is normalized by 1/nFFT, which must be undone for one of the two factors */
+  for (i = 0; i < nFFT + 2; i++)
+    spectrum->data[i] *= nFFT;
+  spectrum->nFFT = nFFT;
+  spectrum->wakePoints = wakePoints;
+  spectrum->W = W;
+}
+
+/* Computes the wake spectrum needed for an n-bin histogram ahead of time, e.g., when the number of
+ * bins is fixed. convolveWithWakeSpectrum() recomputes it only if the FFT length changes.
+ */
+void setUpWakeSpectrum(WAKE_SPECTRUM *spectrum, double *W, long n, long n2, long di2, long mode) {
+  long nFFT, nw;
+  if (mode == WAKE_CONVOLUTION_DIRECT || !W || n <= 0)
+    return;
+  nFFT = chooseWakeFFTLength(n, n2, di2, mode, &nw);
+  prepareWakeSpectrum(spectrum, W, nw, nFFT);
+}
+
+/* Same result as convolveArrays(output, n, a1, n, W, n2, di2), up to rounding, computed with FFTs
+ * using the cached spectrum of the wake. For overlap-add, blocks of the histogram are transformed
+ * separately (empty blocks are skipped) and the results summed.
+ */
+void convolveWithWakeSpectrum(double *output, long n, double *a1, double *W, long n2, long di2,
+                              long mode, WAKE_SPECTRUM *spectrum) {
+  long nFFT, nw, blockLength, iStart, nBlock, k, ib;
+  double *buffer, *S, re, im;
+
+  elementProfilerStartCollective(PROFILE_WAKE);
+  nFFT = chooseWakeFFTLength(n, n2, di2, mode, &nw);
+  prepareWakeSpectrum(spectrum, W, nw, nFFT);
+  S = spectrum->data;
+  blockLength = nFFT - nw + 1;
+  buffer = tmalloc(sizeof(*buffer) * (nFFT + 2));
+
+  for (ib = 0; ib < n; ib++)
+    output[ib] = 0;
+  for (iStart = 0; iStart < n; iStart += blockLength) {
+    nBlock = n - iStart < blockLength ? n - iStart : blockLength;
+    for (k = 0; k < nBlock; k++)
+      if (a1[iStart + k])
+        break;
+    if (k == nBlock)
+      continue;
+    for (k = 0; k < nFFT; k++)
+      buffer[k] = k < nBlock ? a1[iStart + k] : 0;
+    realFFT2(buffer, buffer, nFFT, 0);
+    for (k = 0; k < nFFT + 2; k += 2) {
+      re = buffer[k] * S[k] - buffer[k + 1] * S[k + 1];
+      im = buffer[k] * S[k + 1] + buffer[k + 1] * S[k];
+      buffer[k] = re;
+      buffer[k + 1] = im;
+    }
+    realFFT2(buffer, buffer, nFFT, INVERSE_FFT);
+    /* buffer[k] is the convolution at index iStart+k, which is the output for bin iStart+k-di2 */
+    for (k = 0; k < nBlock + nw - 1; k++) {
+      ib = iStart + k - di2;
+      if (ib >= 0 && ib < n)
+        output[ib] += buffer[k];
+    }
+  }
+  free(buffer);
+  elementProfilerEndCollective(PROFILE_WAKE);
+}
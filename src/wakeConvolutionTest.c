@@ -0,0 +1,106 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* Checks convolveWithWakeSpectrum() with the "fft" and "overlap-add" methods against the
+ * direct sum of convolveArrays(), for causal (i0=0) and acausal wakes that are shorter and
+ * longer than the binning window, and for a histogram with long empty stretches (bunch train).
+ * Prints the largest difference for each case and exits with status 1 if any is too large.
+ */
+#include "mdb.h"
+#include "track.h"
+
+/* the element profiler isn't linked */
+void elementProfilerStartCollective(long category) {}
+void elementProfilerEndCollective(long category) {}
+
+#define TOLERANCE 1e-10
+
+static void makeHistogram(double *a1, long n, long train) {
+  long i;
+  for (i = 0; i < n; i++) {
+    if (train && (i / 500) % 4 != 0)
+      a1[i] = 0;
+    else
+      a1[i] = exp(-sqr((i % 500 - 250) / 80.0)) * (1 + 0.1 * sin(0.37 * i));
+  }
+}
+
+static void makeWake(double *W, long n2, long i0) {
+  long i;
+  for (i = 0; i < n2; i++) {
+    if (i < i0)
+      W[i] = 0.2 * sin(0.05 * (i0 - i)) * exp((i - i0) / 30.0);
+    else
+      W[i] = cos(0.11 * (i - i0)) * exp(-(i - i0) / (0.3 * n2));
+  }
+}
+
+static long checkConvolution(long n, long n2, long i0, long train) {
+  static char *modeName[N_WAKE_CONVOLUTION_MODES] = {"direct", "fft", "overlap-add"};
+  double *a1, *W, *direct, *output, maxDirect, maxDiff;
+  WAKE_SPECTRUM spectrum;
+  long i, mode, failed;
+
+  a1 = tmalloc(sizeof(*a1) * n);
+  W = tmalloc(sizeof(*W) * n2);
+  direct = tmalloc(sizeof(*direct) * n);
+  output = tmalloc(sizeof(*output) * n);
+  makeHistogram(a1, n, train);
+  makeWake(W, n2, i0);
+  convolveArrays(direct, n, a1, n, W, n2, i0);
+  for (i = 0, maxDirect = 0; i < n; i++)
+    if (fabs(direct[i]) > maxDirect)
+      maxDirect = fabs(direct[i]);
+
+  failed = 0;
+  for (mode = WAKE_CONVOLUTION_FFT; mode <= WAKE_CONVOLUTION_OVERLAP_ADD; mode++) {
+    memset(&spectrum, 0, sizeof(spectrum));
+    setUpWakeSpectrum(&spectrum, W, n, n2, i0, mode);
+    convolveWithWakeSpectrum(output, n, a1, W, n2, i0, mode, &spectrum);
+    for (i = 0, maxDiff = 0; i < n; i++)
+      if (fabs(output[i] - direct[i]) > maxDiff)
+        maxDiff = fabs(output[i] - direct[i]);
+    printf("bins=%6ld  wake points=%6ld  i0=%5ld  %-6s  %-11s  nFFT=%6ld  max |difference|/max |direct| = %.3e%s\n",
+           n, n2, i0, train ? "train" : "bunch", modeName[mode], spectrum.nFFT, maxDiff / maxDirect,
+           maxDiff > TOLERANCE * maxDirect ? "  FAILED" : "");
+    if (maxDiff > TOLERANCE * maxDirect)
+      failed = 1;
+    free(spectrum.data);
+  }
+
+  free(a1);
+  free(W);
+  free(direct);
+  free(output);
+  return failed;
+}
+
+int main(int argc, char **argv) {
+  long failed;
+
+  failed = 0;
+  /* wake shorter than the window: overlap-add uses several blocks */
+  failed |= checkConvolution(20000, 300, 0, 0);
+  failed |= checkConvolution(20000, 300, 150, 0);
+  failed |= checkConvolution(20000, 300, 0, 1);
+  failed |= checkConvolution(20000, 300, 150, 1);
+  /* wake longer than the window: only part of it is used */
+  failed |= checkConvolution(2000, 5000, 0, 0);
+  failed |= checkConvolution(2000, 5000, 2500, 0);
+  failed |= checkConvolution(2000, 5000, 4000, 1);
+  /* acausal part longer than the window */
+  failed |= checkConvolution(1000, 3000, 2000, 0);
+
+  if (failed) {
+    printf("wakeConvolutionTest: FAILED\n");
+    return 1;
+  }
+  printf("wakeConvolutionTest: passed\n");
+  return 0;
+}
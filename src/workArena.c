@@ -0,0 +1,72 @@
+/*************************************************************************\
+* Copyright (c) 2026 The University of Chicago, as Operator of Argonne
+* National Laboratory.
+* Copyright (c) 2026 The Regents of the University of California, as
+* Operator of Los Alamos National Laboratory.
+* This file is distributed subject to a Software License Agreement found
+* in the file LICENSE that is included with this distribution.
+\*************************************************************************/
+
+/* file: workArena.c
+ * purpose: persistent scratch buffers for collective elements.
+ *
+ * Impedance and wake elements need work arrays (histograms, spectra, particle
+ * copies) sized by the number of bins and particles. Allocating and freeing
+ * them on every pass costs a measurable fraction of the time in long
+ * multi-bunch runs. Instead, an element keeps a WORK_ARENA of numbered
+ * buffers that grow as needed and are kept from pass to pass. Buffers are not
+ * initialized, and their contents are lost when they grow.
+ */
+#include "mdb.h"
+#include "track.h"
+
+/* Returns buffer number index of the arena, with room for at least size bytes.
+ * The arena is created on first use.
+ */
+void *getWorkBuffer(WORK_ARENA **arena, long index, long size) {
+  WORK_ARENA *wa;
+  long i;
+
+  if (index < 0 || size < 0)
+    bombElegant("invalid arguments (getWorkBuffer)", NULL);
+  if (!(wa = *arena)) {
+    wa = *arena = tmalloc(sizeof(**arena));
+    wa->nBuffers = 0;
+    wa->buffer = NULL;
+    wa->size = NULL;
+  }
+  if (index >= wa->nBuffers) {
+    wa->buffer = trealloc(wa->buffer, sizeof(*wa->buffer) * (index + 1));
+    wa->size = trealloc(wa->size, sizeof(*wa->size) * (index + 1));
+    for (i = wa->nBuffers; i <= index; i++) {
+      wa->buffer[i] = NULL;
+      wa->size[i] = 0;
+    }
+    wa->nBuffers = index + 1;
+  }
+  if (size > wa->size[index] || !wa->buffer[index]) {
+    if (wa->buffer[index])
+      free(wa->buffer[index]);
+    /* leave some room so that slowly-growing requests don't reallocate every time */
+    if (size < wa->size[index] + wa->size[index] / 4)
+      size = wa->size[index] + wa->size[index] / 4;
+    wa->buffer[index] = tmalloc(size ? size : 1);
+    wa->size[index] = size;
+  }
+  return wa->buffer[index];
+}
+
+void freeWorkArena(WORK_ARENA **arena) {
+  long i;
+  if (!*arena)
+    return;
+  for (i = 0; i < (*arena)->nBuffers; i++)
+    if ((*arena)->buffer[i])
+      free((*arena)->buffer[i]);
+  if ((*arena)->buffer)
+    free((*arena)->buffer);
+  if ((*arena)->size)
+    free((*arena)->size);
+  free(*arena);
+  *arena = NULL;
+}
@@ -53,6 +53,16 @@ static SDDS_DEFINITION wake_parameter[WAKE_PARAMETERS] = {
 void set_up_zlongit(ZLONGIT *zlongit, RUN *run, long pass, long particles, CHARGE *charge,
                     double timeSpan);
 
+/* indices of buffers in zlongit->workArena */
+#define ZL_ITIME 0
+#define ZL_IFREQ 1
+#define ZL_VTIME 2
+#define ZL_PBIN 3
+#define ZL_TIME 4
+#define ZL_PART 5
+#define ZL_PART_DATA 6
+#define ZL_MPI_BUFFER 7
+
 void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po,
                            RUN *run, long i_pass, CHARGE *charge) {
   double *Itime = NULL;    /* array for histogram of particle density */
@@ -62,6 +72,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
   double *time0 = NULL;    /* array to record arrival time of each particle */
   double *time = NULL;     /* array to record arrival time of each particle */
   double **part = NULL;    /* particle buffer for working bucket */
+  double *partData;
   long *ibParticle = NULL; /* array to record which bucket each particle is in */
   long **ipBucket = NULL;  /* array to record particle indices in part0 array for all particles in each bucket */
   long *npBucket = NULL;   /* array to record how many particles are in each bucket */
@@ -148,7 +159,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
         time = time0;
         part = part0;
         np = np0;
-        pbin = trealloc(pbin, sizeof(*pbin) * (max_np = np));
+        pbin = getWorkBuffer(&zlongit->workArena, ZL_PBIN, sizeof(*pbin) * (max_np = np));
       } else {
         if (npBucket)
           np = npBucket[iBucket];
@@ -172,11 +183,12 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
           printf("ZLONGIT: setting up work arrays, iBucket=%ld, np=%ld\n", iBucket, np);
           fflush(stdout);
 #endif
-          if (part)
-            free_czarray_2d((void **)part, max_np, totalPropertiesPerParticle);
-          part = (double **)czarray_2d(sizeof(double), np, totalPropertiesPerParticle);
-          time = (double *)trealloc(time, sizeof(*time) * np);
-          pbin = trealloc(pbin, sizeof(*pbin) * np);
+          part = getWorkBuffer(&zlongit->workArena, ZL_PART, sizeof(*part) * np);
+          partData = getWorkBuffer(&zlongit->workArena, ZL_PART_DATA, sizeof(*partData) * np * totalPropertiesPerParticle);
+          for (ip = 0; ip < np; ip++)
+            part[ip] = partData + ip * totalPropertiesPerParticle;
+          time = getWorkBuffer(&zlongit->workArena, ZL_TIME, sizeof(*time) * np);
+          pbin = getWorkBuffer(&zlongit->workArena, ZL_PBIN, sizeof(*pbin) * np);
           max_np = np;
         }
         if (np > 0) {
@@ -211,12 +223,9 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
       printf("Allocating histogram arrays, nb=%ld\n", nb);
       fflush(stdout);
 #endif
-      if (!Itime)
-        Itime = tmalloc(2 * sizeof(*Itime) * nb);
-      if (!Ifreq)
-        Ifreq = tmalloc(2 * sizeof(*Ifreq) * nb);
-      if (!Vtime)
-        Vtime = tmalloc(2 * sizeof(*Vtime) * (nb + 1));
+      Itime = getWorkBuffer(&zlongit->workArena, ZL_ITIME, 2 * sizeof(*Itime) * nb);
+      Ifreq = getWorkBuffer(&zlongit->workArena, ZL_IFREQ, 2 * sizeof(*Ifreq) * nb);
+      Vtime = getWorkBuffer(&zlongit->workArena, ZL_VTIME, 2 * sizeof(*Vtime) * (nb + 1));
 
       if ((tmax - tmin) * 2 > nb * dt) {
         TRACKING_CONTEXT tcontext;
@@ -258,6 +267,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
              tmin, tmax, dt, nb);
 #endif
 
+      elementProfilerStartCollective(PROFILE_HISTOGRAM);
       for (ib = 0; ib < nb; ib++)
         Itime[2 * ib] = Itime[2 * ib + 1] = 0;
 
@@ -280,6 +290,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
         pbin[ip] = ib;
         n_binned++;
       }
+      elementProfilerEndCollective(PROFILE_HISTOGRAM);
 #if (!USE_MPI)
       if (n_binned != np) {
         char warningBuffer[1024];
@@ -337,11 +348,9 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
         printf("histogram transfer: offset = %ld, length = %ld, nb = %ld\n", offset, length, nb);
         fflush(stdout);
 #  endif
-        buffer = malloc(sizeof(double) * length);
+        buffer = getWorkBuffer(&zlongit->workArena, ZL_MPI_BUFFER, sizeof(double) * length);
         MPI_Allreduce(&Itime[offset], buffer, length, MPI_DOUBLE, MPI_SUM, workers);
         memcpy(&Itime[offset], buffer, sizeof(double) * length);
-        free(buffer);
-        buffer = NULL;
       }
 #  ifdef USE_MPE
       MPE_Log_event(event1b, 0, "end histogram");
@@ -370,6 +379,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
 #endif
 
       /* Take the FFT of I(t) to get I(f) */
+      elementProfilerStartCollective(PROFILE_WAKE);
       memcpy(Ifreq, Itime, 2 * nb * sizeof(*Ifreq));
       realFFT(Ifreq, nb, 0);
 
@@ -393,6 +403,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
       /* Compute inverse FFT of V(f) to get V(t) */
       realFFT(Vfreq, nb, INVERSE_FFT);
       Vtime = Vfreq;
+      elementProfilerEndCollective(PROFILE_WAKE);
 #ifdef USE_MPE
       MPE_Log_event(event2b, 0, "end computation");
 #endif
@@ -435,12 +446,14 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
                 SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
               }
             }
+            elementProfilerStartCollective(PROFILE_OUTPUT);
             if (!SDDS_WriteTable(zlongit->SDDS_wake)) {
               SDDS_SetError("Problem writing SDDS table for wake output (track_through_zlongit)");
               SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
             }
             if (!inhibitFileSync)
               SDDS_DoFSync(zlongit->SDDS_wake);
+            elementProfilerEndCollective(PROFILE_OUTPUT);
           }
         }
 #if USE_MPI
@@ -530,19 +543,7 @@ void track_through_zlongit(double **part0, long np0, ZLONGIT *zlongit, double Po
   fflush(stdout);
 #endif
 
-  if (Itime)
-    free(Itime);
-  if (Vtime)
-    free(Vtime);
-  if (Ifreq)
-    free(Ifreq);
-  if (part && part != part0 && max_np > 0)
-    free_czarray_2d((void **)part, max_np, totalPropertiesPerParticle);
-  if (time && time != time0)
-    free(time);
-  if (pbin)
-    free(pbin);
-
+  /* work buffers are kept in zlongit->workArena for the next pass */
   if (isSlave || !notSinglePart)
     free_bunch_index_memory(time0, ibParticle, ipBucket, npBucket, nBuckets);
 
@@ -44,6 +44,18 @@ void set_up_ztransverse(ZTRANSVERSE *ztransverse, RUN *run, long pass, long part
                         double timeSpan);
 double *getTransverseImpedance(SDDS_DATASET *SDDSin, char *ZName);
 
+/* indices of buffers in ztransverse->workArena */
+#define ZT_POSITIME_X 0
+#define ZT_POSITIME_Y 1
+#define ZT_POSIFREQ 2
+#define ZT_VTIME 3
+#define ZT_PBIN 4
+#define ZT_PZ 5
+#define ZT_TIME 6
+#define ZT_PART 7
+#define ZT_PART_DATA 8
+#define ZT_MPI_BUFFER 9
+
 void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransverse, double Po,
                                RUN *run, long i_pass, CHARGE *charge) {
   double *posItime[2] = {NULL, NULL}; /* array for particle density times x, y*/
@@ -55,6 +67,7 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
   double *time = NULL;  /* array to record arrival time of each particle */
   double *pz = NULL;
   double **part = NULL;    /* particle buffer for working bucket */
+  double *partData;
   long *ibParticle = NULL; /* array to record which bucket each particle is in */
   long **ipBucket = NULL;  /* array to record particle indices in part0 array for all particles in each bucket */
   long *npBucket = NULL;   /* array to record how many particles are in each bucket */
@@ -120,8 +133,8 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
         time = time0;
         part = part0;
         np = np0;
-        pbin = trealloc(pbin, sizeof(*pbin) * (max_np = np));
-        pz = trealloc(pz, sizeof(*pz) * np);
+        pbin = getWorkBuffer(&ztransverse->workArena, ZT_PBIN, sizeof(*pbin) * (max_np = np));
+        pz = getWorkBuffer(&ztransverse->workArena, ZT_PZ, sizeof(*pz) * np);
       } else {
         if (npBucket)
           np = npBucket[iBucket];
@@ -145,12 +158,13 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
         fflush(stdout);
 #endif
         if (np > max_np) {
-          if (part)
-            free_czarray_2d((void **)part, max_np, totalPropertiesPerParticle);
-          part = (double **)czarray_2d(sizeof(double), np, totalPropertiesPerParticle);
-          time = (double *)tmalloc(sizeof(*time) * np);
-          pbin = trealloc(pbin, sizeof(*pbin) * np);
-          pz = trealloc(pz, sizeof(*pz) * np);
+          part = getWorkBuffer(&ztransverse->workArena, ZT_PART, sizeof(*part) * np);
+          partData = getWorkBuffer(&ztransverse->workArena, ZT_PART_DATA, sizeof(*partData) * np * totalPropertiesPerParticle);
+          for (ip = 0; ip < np; ip++)
+            part[ip] = partData + ip * totalPropertiesPerParticle;
+          time = getWorkBuffer(&ztransverse->workArena, ZT_TIME, sizeof(*time) * np);
+          pbin = getWorkBuffer(&ztransverse->workArena, ZT_PBIN, sizeof(*pbin) * np);
+          pz = getWorkBuffer(&ztransverse->workArena, ZT_PZ, sizeof(*pz) * np);
           max_np = np;
         }
         for (ip = 0; ip < np; ip++) {
@@ -211,10 +225,10 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
       }
 
       if (nb > max_n_bins) {
-        posItime[0] = trealloc(posItime[0], 2 * sizeof(**posItime) * (max_n_bins = nb));
-        posItime[1] = trealloc(posItime[1], 2 * sizeof(**posItime) * (max_n_bins = nb));
-        posIfreq = trealloc(posIfreq, 2 * sizeof(*posIfreq) * (max_n_bins = nb));
-        Vtime = trealloc(Vtime, 2 * sizeof(*Vtime) * (max_n_bins + 1));
+        posItime[0] = getWorkBuffer(&ztransverse->workArena, ZT_POSITIME_X, 2 * sizeof(**posItime) * (max_n_bins = nb));
+        posItime[1] = getWorkBuffer(&ztransverse->workArena, ZT_POSITIME_Y, 2 * sizeof(**posItime) * nb);
+        posIfreq = getWorkBuffer(&ztransverse->workArena, ZT_POSIFREQ, 2 * sizeof(*posIfreq) * nb);
+        Vtime = getWorkBuffer(&ztransverse->workArena, ZT_VTIME, 2 * sizeof(*Vtime) * (nb + 1));
       }
 
       for (ib = 0; ib < nb; ib++)
@@ -253,10 +267,9 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
           printf("plane = %ld, offset = %ld, length=%ld, nb=%ld\n", plane, offset, length, nb);
           fflush(stdout);
 #  endif
-          buffer = malloc(sizeof(double) * length);
+          buffer = getWorkBuffer(&ztransverse->workArena, ZT_MPI_BUFFER, sizeof(double) * length);
           MPI_Allreduce(&posItime[plane][offset], buffer, length, MPI_DOUBLE, MPI_SUM, workers);
           memcpy(&posItime[plane][offset], buffer, sizeof(double) * length);
-          free(buffer);
 #  if MPI_DEBUG
           printf("posItime buffer shared\n");
           fflush(stdout);
@@ -278,6 +291,7 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
 #endif
 
           /* Take the FFT of (x*I)(t) to get (x*I)(f) */
+          elementProfilerStartCollective(PROFILE_WAKE);
           memcpy(posIfreq, posItime[plane], 2 * nb * sizeof(*posIfreq));
           realFFT(posIfreq, nb, 0);
 
@@ -314,6 +328,7 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
           /* Compute inverse FFT of V(f) to get V(t) */
           realFFT(Vfreq, nb, INVERSE_FFT);
           Vtime = Vfreq;
+          elementProfilerEndCollective(PROFILE_WAKE);
 
 #if MPI_DEBUG
           printf("IFFT completed\n");
@@ -363,12 +378,14 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
               }
             }
             if (!first) {
+              elementProfilerStartCollective(PROFILE_OUTPUT);
               if (!SDDS_WriteTable(ztransverse->SDDS_wake)) {
                 SDDS_SetError("Problem writing SDDS table for wake output (track_through_ztransverse)");
                 SDDS_PrintErrors(stderr, SDDS_VERBOSE_PrintErrors | SDDS_EXIT_PrintErrors);
               }
               if (!inhibitFileSync)
                 SDDS_DoFSync(ztransverse->SDDS_wake);
+              elementProfilerEndCollective(PROFILE_OUTPUT);
             }
           }
         }
@@ -413,24 +430,9 @@ void track_through_ztransverse(double **part0, long np0, ZTRANSVERSE *ztransvers
   printf("Preparing to free memory\n");
   fflush(stdout);
 #endif
-  if (part && part != part0)
-    free_czarray_2d((void **)part, max_np, totalPropertiesPerParticle);
-  if (time && time != time0)
-    free(time);
+  /* work buffers are kept in ztransverse->workArena for the next pass */
   if (isSlave || !notSinglePart)
     free_bunch_index_memory(time0, ibParticle, ipBucket, npBucket, nBuckets);
-  if (pbin)
-    free(pbin);
-  if (pz)
-    free(pz);
-  if (posItime[0])
-    free(posItime[0]);
-  if (posItime[1])
-    free(posItime[1]);
-  if (Vtime)
-    free(Vtime);
-  if (posIfreq)
-    free(posIfreq);
 
 #if USE_MPI
   MPI_Barrier(workers);